@@ -29,6 +29,14 @@ done
 [ -n "$SSID" ] || { echo "SSID required"; exit 2; }
 [ -n "$PSK"  ] || { echo "Password required"; exit 2; }
 
+# Native connector: no iwpriv forks, waits on events, prints a timing breakdown.
+if [ -x /usr/sbin/sta_connect ]; then
+  set -- -B "$BAND"
+  [ -n "$BSSID" ] && set -- "$@" -b "$BSSID"
+  [ $MIXED -eq 1 ] && set -- "$@" -m
+  exec /usr/sbin/sta_connect "$@" "$SSID" "$PSK"
+fi
+
 # Pick STA iface (5 GHz first)
 IF_5G=""
 IF_24G=""
@@ -11,7 +11,8 @@ define Device/custom_m7628ar4
         wpad-basic-mbedtls wireless-regdb \
         luci-app-package-manager \
         nano-tiny coreutils-timeout kmod-zram zram-swap kmod-lib-lz4 \
-        wfb-ng wfb-ng-tun kmod-usb2 kmod-usb-ohci kmod-usb-ehci kmod-usb-storage block-mount bash
+        wfb-ng wfb-ng-tun kmod-usb2 kmod-usb-ohci kmod-usb-ehci kmod-usb-storage block-mount bash \
+        kmod-input-gpio-keys -kmod-button-hotplug
 endef
 TARGET_DEVICES += custom_m7628ar4
 
@@ -34,6 +35,7 @@ define Device/custom_m7628ar4
     nano-tiny coreutils-timeout kmod-zram zram-swap \
     -kmod-mt76 -kmod-mt76x02-common -kmod-mt76x2 -kmod-mt76x2-common \
     -ppp -ppp-mod-pppoe -luci-proto-ppp \
-    -odhcpd-ipv6only -odhcp6c -luci-proto-ipv6
+    -odhcpd-ipv6only -odhcp6c -luci-proto-ipv6 \
+    kmod-input-gpio-keys -kmod-button-hotplug
 endef
 TARGET_DEVICES += custom_m7628ar4
@@ -0,0 +1,111 @@
+#!/bin/sh
+# gpio_sim.sh -- Drive wds-switchd's GPIO chardev backend from a gpio-sim chip
+# Usage:
+#   tests/gpio_sim.sh [WDS_SWITCHD]     # default: ./wds-switchd (make)
+#
+# 1. Free line: flips the simulated pull on line 11 and expects the hook to
+#    see "released 1" then "pressed 0".
+# 2. Busy line: hogs line 11 as "gpio-keys" (what the dts key does on the
+#    router), expects the EBUSY warning and the fallback to -e auto, and, with
+#    /dev/uinput, a switch change from tests/uinput_switch reaching the hook.
+# Exits 77 (skip) without root, configfs or the gpio-sim module.
+
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+DAEMON=${1:-$DIR/wds-switchd}
+CFS=/sys/kernel/config/gpio-sim
+
+skip() { echo "gpio_sim: skipped, $1" >&2; exit 77; }
+[ "$(id -u)" -eq 0 ] || skip "needs root"
+[ -x "$DAEMON" ] || skip "no $DAEMON (make)"
+modprobe gpio-sim 2>/dev/null
+[ -d $CFS ] || mount -t configfs none /sys/kernel/config 2>/dev/null
+[ -d $CFS ] || skip "no gpio-sim in configfs"
+
+TMP=$(mktemp -d /tmp/gpio-sim.XXXXXX)
+PIDS=""
+cleanup() {
+  for p in $PIDS; do kill "$p" 2>/dev/null; done
+  sleep 0.2
+  for c in wds-free wds-busy; do
+    [ -d $CFS/$c ] || continue
+    echo 0 >$CFS/$c/live
+    rmdir $CFS/$c/bank0/line11/hog $CFS/$c/bank0/line11 $CFS/$c/bank0 $CFS/$c 2>/dev/null
+  done
+  rm -rf "$TMP"
+}
+trap cleanup EXIT INT TERM
+fail() { echo "gpio_sim: FAIL, $1" >&2; cat "$TMP"/*.log >&2 2>/dev/null; exit 1; }
+
+# make_chip NAME [HOG_CONSUMER]: 16 lines, line 11 optionally hogged; prints gpiochipN.
+make_chip() {
+  mkdir -p $CFS/$1/bank0
+  echo 16 >$CFS/$1/bank0/num_lines
+  if [ -n "$2" ]; then
+    mkdir -p $CFS/$1/bank0/line11/hog
+    echo "$2" >$CFS/$1/bank0/line11/hog/name
+    echo input >$CFS/$1/bank0/line11/hog/direction
+  fi
+  echo 1 >$CFS/$1/live || fail "gpio-sim $1 did not go live"
+  cat $CFS/$1/bank0/chip_name
+}
+
+# wait_for FILE PATTERN: up to 2 s.
+wait_for() {
+  i=0
+  until grep -q "$2" "$1" 2>/dev/null; do
+    i=$((i + 1))
+    [ $i -lt 40 ] || return 1
+    sleep 0.05
+  done
+}
+
+cat >"$TMP/hook.sh" <<EOF
+#!/bin/sh
+echo "\$1 \$2" >>"$TMP/hook.out"
+EOF
+chmod +x "$TMP/hook.sh"
+
+# --- 1. free line ------------------------------------------------------------
+CHIP=$(make_chip wds-free)
+SIM=/sys/devices/platform/$(cat $CFS/wds-free/dev_name)/$CHIP/sim_gpio11
+echo pull-down >"$SIM/pull"
+"$DAEMON" -f -c "/dev/$CHIP" -l 11 -d 10 -x "$TMP/hook.sh" 2>"$TMP/free.log" &
+PIDS="$PIDS $!"
+wait_for "$TMP/free.log" "started (/dev/$CHIP line 11, initial=0)" || fail "cdev backend did not start"
+echo pull-up >"$SIM/pull"
+wait_for "$TMP/hook.out" "^released 1" || fail "no released after pull-up"
+echo pull-down >"$SIM/pull"
+wait_for "$TMP/hook.out" "^pressed 0" || fail "no pressed after pull-down"
+echo "gpio_sim: cdev backend ok"
+
+# --- 2. line held by gpio-keys -------------------------------------------------
+rm -f "$TMP/hook.out"
+CHIP=$(make_chip wds-busy gpio-keys)
+if [ -c /dev/uinput ]; then
+  UIS=$DIR/tests/uinput_switch
+  [ -x "$UIS" ] || { UIS=$TMP/uinput_switch; cc -std=c11 -O2 "$DIR/tests/uinput_switch.c" -o "$UIS"; } ||
+    fail "building uinput_switch"
+  mkfifo "$TMP/sw"
+  "$UIS" <"$TMP/sw" >"$TMP/uinput.log" &
+  PIDS="$PIDS $!"
+  exec 3>"$TMP/sw"
+  wait_for "$TMP/uinput.log" ready || fail "uinput device not created"
+fi
+"$DAEMON" -f -c "/dev/$CHIP" -l 11 -x "$TMP/hook.sh" 2>"$TMP/busy.log" &
+DPID=$!
+PIDS="$PIDS $DPID"
+wait_for "$TMP/busy.log" 'held by "gpio-keys"' || fail "EBUSY not reported"
+wait_for "$TMP/busy.log" "falling back" || fail "no fallback to the input device"
+if [ -c /dev/uinput ]; then
+  wait_for "$TMP/busy.log" "started (input EV_SW" || fail "input fallback did not start"
+  echo 1 >&3
+  wait_for "$TMP/hook.out" "^pressed 0" || fail "no pressed from the input device"
+  echo 0 >&3
+  wait_for "$TMP/hook.out" "^released 1" || fail "no released from the input device"
+  exec 3>&-
+  echo "gpio_sim: EBUSY fallback to input device ok"
+else
+  sleep 0.2
+  kill -0 $DPID 2>/dev/null && fail "daemon kept running without a line or input device"
+  echo "gpio_sim: EBUSY fallback ok (no /dev/uinput, input step skipped)"
+fi
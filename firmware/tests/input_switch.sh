@@ -0,0 +1,88 @@
+#!/bin/sh
+# input_switch.sh -- Drive wds-switchd's input backend (-e auto) from a uinput switch
+# Usage:
+#   tests/input_switch.sh [WDS_SWITCHD]     # default: ./wds-switchd (make)
+#
+# tests/uinput_switch stands in for the gpio-keys "wds" device. Checks that
+# -e auto finds it by code, that the action table runs pressed/released/any
+# entries in order for each change, and that -K reads an EV_KEY layout.
+# Exits 77 (skip) without root or /dev/uinput.
+
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+DAEMON=${1:-$DIR/wds-switchd}
+
+skip() { echo "input_switch: skipped, $1" >&2; exit 77; }
+[ "$(id -u)" -eq 0 ] || skip "needs root"
+[ -x "$DAEMON" ] || skip "no $DAEMON (make)"
+modprobe uinput 2>/dev/null
+[ -c /dev/uinput ] || skip "no /dev/uinput"
+
+TMP=$(mktemp -d /tmp/input-switch.XXXXXX)
+PIDS=""
+cleanup() {
+  exec 3>&- 2>/dev/null
+  for p in $PIDS; do kill "$p" 2>/dev/null; done
+  rm -rf "$TMP"
+}
+trap cleanup EXIT INT TERM
+fail() { echo "input_switch: FAIL, $1" >&2; cat "$TMP"/*.log "$TMP/out" >&2 2>/dev/null; exit 1; }
+
+UIS=$DIR/tests/uinput_switch
+[ -x "$UIS" ] || { UIS=$TMP/uinput_switch; cc -std=c11 -O2 "$DIR/tests/uinput_switch.c" -o "$UIS"; } ||
+  fail "building uinput_switch"
+
+# wait_lines N: until $TMP/out has N lines, up to 2 s.
+wait_lines() {
+  i=0
+  until [ "$(wc -l <"$TMP/out" 2>/dev/null || echo 0)" -ge "$1" ]; do
+    i=$((i + 1))
+    [ $i -lt 40 ] || return 1
+    sleep 0.05
+  done
+}
+
+cat >"$TMP/actions" <<EOF
+# comment and blank lines are skipped
+
+any      echo "any \$1 \$2" >>$TMP/out
+pressed  echo "on" >>$TMP/out
+released echo "off" >>$TMP/out
+bogus    echo "never" >>$TMP/out
+EOF
+
+# run_case NAME UINPUT_ARGS DAEMON_ARGS
+run_case() {
+  rm -f "$TMP/out" "$TMP/sw"
+  mkfifo "$TMP/sw"
+  "$UIS" $2 <"$TMP/sw" >"$TMP/uinput.log" &
+  PIDS="$PIDS $!"
+  exec 3>"$TMP/sw"
+  i=0
+  until grep -q ready "$TMP/uinput.log" 2>/dev/null; do
+    i=$((i + 1)); [ $i -lt 40 ] || fail "$1: uinput device not created"; sleep 0.05
+  done
+
+  "$DAEMON" -f -e auto $3 -a "$TMP/actions" -x /nonexistent 2>"$TMP/$1.log" &
+  DPID=$!
+  PIDS="$PIDS $DPID"
+  i=0
+  until grep -q "started (input" "$TMP/$1.log" 2>/dev/null; do
+    i=$((i + 1)); [ $i -lt 40 ] || fail "$1: daemon did not start"; sleep 0.05
+  done
+  grep -q "using .*(wds-test-keys)" "$TMP/$1.log" || fail "$1: auto did not pick the uinput device"
+
+  echo 1 >&3
+  wait_lines 2 || fail "$1: no actions after switch on"
+  echo 0 >&3
+  wait_lines 4 || fail "$1: no actions after switch off"
+  printf 'any pressed 0\non\nany released 1\noff\n' | cmp -s - "$TMP/out" ||
+    fail "$1: unexpected action output"
+
+  kill $DPID
+  exec 3>&-
+  wait 2>/dev/null
+  echo "input_switch: $1 ok"
+}
+
+run_case ev_sw "" ""
+run_case ev_key "-K 247" "-K 247"
@@ -0,0 +1,70 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+/*
+ * uinput_switch: a stand-in for the gpio-keys "wds" device in tests.
+ * Registers an input device reporting one EV_SW (-k, default SW_RFKILL_ALL)
+ * or EV_KEY (-K) code, then emits value 1/0 for every "1"/"0" line on stdin.
+ * Prints "ready" once the device exists; exits on EOF.
+ */
+
+static void emit(int fd, int type, int code, int value) {
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (unsigned short)type;
+    ev.code = (unsigned short)code;
+    ev.value = value;
+    if (write(fd, &ev, sizeof(ev)) != (ssize_t)sizeof(ev)) {
+        fprintf(stderr, "uinput write failed: %s\n", strerror(errno));
+    }
+}
+
+int main(int argc, char **argv) {
+    int type = EV_SW, code = SW_RFKILL_ALL, opt;
+    while ((opt = getopt(argc, argv, "k:K:")) != -1) {
+        switch (opt) {
+            case 'k': type = EV_SW; code = atoi(optarg); break;
+            case 'K': type = EV_KEY; code = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-k SW_CODE|-K KEY_CODE] < values\n", argv[0]);
+                return 2;
+        }
+    }
+
+    int fd = open("/dev/uinput", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "open(/dev/uinput) failed: %s\n", strerror(errno));
+        return 1;
+    }
+    ioctl(fd, UI_SET_EVBIT, type);
+    ioctl(fd, type == EV_SW ? UI_SET_SWBIT : UI_SET_KEYBIT, code);
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_HOST;
+    snprintf(setup.name, sizeof(setup.name), "wds-test-keys");
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        fprintf(stderr, "creating uinput device failed: %s\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+    printf("ready\n");
+    fflush(stdout);
+
+    char line[16];
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] != '0' && line[0] != '1') continue;
+        emit(fd, type, code, line[0] - '0');
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+    }
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,508 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <glob.h>
+#include <linux/gpio.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * wds-switchd: watches the WDS slide switch and runs HOOK "pressed|released" VALUE
+ * on every debounced change, or the matching entries of an action table (-a).
+ * Backends: the gpio-keys input device (-e, EV_SW or EV_KEY events), the GPIO
+ * character device (line events) or sysfs edge + poll(POLLPRI) (-s). All of
+ * them sleep in poll() without a timeout while the switch is idle.
+ */
+
+#define MAX_ACTIONS 16
+
+enum backend { BACKEND_CDEV, BACKEND_SYSFS, BACKEND_INPUT };
+
+/* One line of the action table: run cmd when the switch enters state. */
+struct action {
+    char state[12];      /* "pressed", "released" or "any" */
+    char cmd[256];
+};
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_signal(int sig) { (void)sig; g_stop = 1; }
+
+struct watcher {
+    int fd;              /* line request fd (cdev), value fd (sysfs) or event fd (input) */
+    enum backend backend;
+    int sysfs_gpio;
+    int ev_type;         /* EV_SW or EV_KEY, input backend only */
+    int ev_code;
+    const struct action *actions;
+    size_t nactions;
+    int debounce_ms;
+    const char *hook;
+    int reported;        /* last value handed to the hook */
+    pid_t hook_pid;
+    bool dispatch_pending;
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [-e DEV|auto] [-k CODE|-K CODE] [-c CHIP] [-l LINE] [-s GPIO] [-d MS] [-x HOOK] [-a FILE] [-f]\n"
+        "  -e, --input     gpio-keys input device, or \"auto\" to find the one reporting CODE\n"
+        "  -k, --sw-code   EV_SW code of the switch (default: 3, SW_RFKILL_ALL)\n"
+        "  -K, --key-code  Use an EV_KEY code instead (e.g. 247, KEY_RFKILL)\n"
+        "  -c, --chip      GPIO character device (default: /dev/gpiochip0)\n"
+        "  -l, --line      Line offset on CHIP (default: 11, sysfs gpio523); if a\n"
+        "                  driver already holds it (EBUSY), falls back to -e auto\n"
+        "  -s, --sysfs     Use legacy sysfs GPIO number with edge interrupts instead\n"
+        "  -d, --debounce  Debounce window in ms (default: 30, 0 with -e)\n"
+        "  -x, --hook      Hook to run on change (default: /usr/sbin/wds-toggle.sh)\n"
+        "  -a, --actions   Action table: lines of \"pressed|released|any COMMAND\"\n"
+        "  -f, --foreground  Log to stderr as well as syslog\n",
+        argv0);
+}
+
+static int write_file(const char *path, const char *value) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return n < 0 ? -1 : 0;
+}
+
+static int open_cdev(struct watcher *w, const char *chip, unsigned line) {
+    int chip_fd = open(chip, O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) {
+        syslog(LOG_ERR, "open(%s) failed: %s", chip, strerror(errno));
+        return -1;
+    }
+
+    struct gpio_v2_line_request req;
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = line;
+    req.num_lines = 1;
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT |
+                       GPIO_V2_LINE_FLAG_EDGE_RISING |
+                       GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    snprintf(req.consumer, sizeof(req.consumer), "wds-switchd");
+
+    int rc = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    int saved = errno;
+    if (rc < 0 && saved == EBUSY) {
+        /* Usually gpio-keys or gpio-button-hotplug bound to the dts "wds" key. */
+        struct gpio_v2_line_info info;
+        memset(&info, 0, sizeof(info));
+        info.offset = line;
+        if (ioctl(chip_fd, GPIO_V2_GET_LINEINFO_IOCTL, &info) == 0 && info.consumer[0]) {
+            syslog(LOG_WARNING, "%s line %u is held by \"%s\"", chip, line, info.consumer);
+        }
+    }
+    close(chip_fd);
+    if (rc < 0) {
+        syslog(LOG_ERR, "GPIO_V2_GET_LINE_IOCTL(%s line %u) failed: %s", chip, line, strerror(saved));
+        errno = saved;
+        return -1;
+    }
+    w->fd = req.fd;
+    return 0;
+}
+
+static int open_sysfs(struct watcher *w, int gpio) {
+    char path[96], buf[16];
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio);
+    if (access(path, F_OK) != 0) {
+        snprintf(buf, sizeof(buf), "%d", gpio);
+        if (write_file("/sys/class/gpio/export", buf) != 0) {
+            syslog(LOG_ERR, "export gpio%d failed: %s", gpio, strerror(errno));
+            return -1;
+        }
+    }
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/direction", gpio);
+    write_file(path, "in");
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/edge", gpio);
+    if (write_file(path, "both") != 0) {
+        syslog(LOG_ERR, "gpio%d has no edge interrupt support: %s", gpio, strerror(errno));
+        return -1;
+    }
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio);
+    w->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (w->fd < 0) {
+        syslog(LOG_ERR, "open(%s) failed: %s", path, strerror(errno));
+        return -1;
+    }
+    w->backend = BACKEND_SYSFS;
+    w->sysfs_gpio = gpio;
+    return 0;
+}
+
+static bool test_bit(const unsigned long *bits, int bit) {
+    size_t per = 8 * sizeof(unsigned long);
+    return (bits[bit / per] >> (bit % per)) & 1ul;
+}
+
+#define BITS_LONGS(n) (((n) + 8 * sizeof(unsigned long)) / (8 * sizeof(unsigned long)))
+
+static bool input_has_code(int fd, int type, int code) {
+    unsigned long bits[BITS_LONGS(KEY_MAX)];
+    memset(bits, 0, sizeof(bits));
+    if (ioctl(fd, EVIOCGBIT(type, sizeof(bits)), bits) < 0) return false;
+    return test_bit(bits, code);
+}
+
+static int open_input(struct watcher *w, const char *dev) {
+    int max = w->ev_type == EV_SW ? SW_MAX : KEY_MAX;
+    if (w->ev_code < 0 || w->ev_code > max) {
+        syslog(LOG_ERR, "event code %d out of range (max %d)", w->ev_code, max);
+        return -1;
+    }
+    if (strcmp(dev, "auto") != 0) {
+        w->fd = open(dev, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+        if (w->fd < 0) {
+            syslog(LOG_ERR, "open(%s) failed: %s", dev, strerror(errno));
+            return -1;
+        }
+        if (!input_has_code(w->fd, w->ev_type, w->ev_code)) {
+            syslog(LOG_ERR, "%s does not report %s code %d", dev,
+                   w->ev_type == EV_SW ? "EV_SW" : "EV_KEY", w->ev_code);
+            close(w->fd);
+            w->fd = -1;
+            return -1;
+        }
+        w->backend = BACKEND_INPUT;
+        return 0;
+    }
+
+    glob_t g;
+    if (glob("/dev/input/event*", 0, NULL, &g) != 0) {
+        syslog(LOG_ERR, "no input devices (is kmod-input-gpio-keys loaded?)");
+        return -1;
+    }
+    for (size_t i = 0; i < g.gl_pathc; i++) {
+        int fd = open(g.gl_pathv[i], O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+        if (fd < 0) continue;
+        if (input_has_code(fd, w->ev_type, w->ev_code)) {
+            char name[64] = "?";
+            ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+            syslog(LOG_NOTICE, "using %s (%s)", g.gl_pathv[i], name);
+            w->fd = fd;
+            w->backend = BACKEND_INPUT;
+            globfree(&g);
+            return 0;
+        }
+        close(fd);
+    }
+    globfree(&g);
+    syslog(LOG_ERR, "no input device reports %s code %d",
+           w->ev_type == EV_SW ? "EV_SW" : "EV_KEY", w->ev_code);
+    return -1;
+}
+
+/*
+ * Action table lines: STATE COMMAND..., '#' starts a comment. STATE is
+ * pressed, released or any; COMMAND runs via /bin/sh -c with $1/$2 set to
+ * the state and value, like the hook.
+ */
+static int load_actions(const char *path, struct action *actions, size_t *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        syslog(LOG_ERR, "fopen(%s) failed: %s", path, strerror(errno));
+        return -1;
+    }
+    char line[320];
+    int lineno = 0;
+    *count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\0') continue;
+
+        size_t state_len = strcspn(p, " \t");
+        char *cmd = p + state_len;
+        cmd += strspn(cmd, " \t");
+        if (!*cmd || state_len >= sizeof(actions[0].state)) {
+            syslog(LOG_WARNING, "%s:%d: expected STATE COMMAND", path, lineno);
+            continue;
+        }
+        p[state_len] = '\0';
+        if (strcmp(p, "pressed") != 0 && strcmp(p, "released") != 0 && strcmp(p, "any") != 0) {
+            syslog(LOG_WARNING, "%s:%d: unknown state '%s'", path, lineno, p);
+            continue;
+        }
+        if (*count == MAX_ACTIONS) {
+            syslog(LOG_WARNING, "%s: more than %d actions, ignoring the rest", path, MAX_ACTIONS);
+            break;
+        }
+        struct action *a = &actions[(*count)++];
+        snprintf(a->state, sizeof(a->state), "%s", p);
+        snprintf(a->cmd, sizeof(a->cmd), "%s", cmd);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Returns the raw line level: 0 while the switch is on (active low), like the GPIO backends. */
+static int read_value(struct watcher *w) {
+    if (w->backend == BACKEND_INPUT) {
+        unsigned long bits[BITS_LONGS(KEY_MAX)];
+        memset(bits, 0, sizeof(bits));
+        int rc = w->ev_type == EV_SW ? ioctl(w->fd, EVIOCGSW(sizeof(bits)), bits)
+                                     : ioctl(w->fd, EVIOCGKEY(sizeof(bits)), bits);
+        if (rc < 0) return -1;
+        return test_bit(bits, w->ev_code) ? 0 : 1;
+    }
+    if (w->backend == BACKEND_SYSFS) {
+        char c;
+        if (pread(w->fd, &c, 1, 0) != 1) return -1;
+        return c == '0' ? 0 : 1;
+    }
+    struct gpio_v2_line_values vals = { .bits = 0, .mask = 1 };
+    if (ioctl(w->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &vals) < 0) return -1;
+    return (int)(vals.bits & 1);
+}
+
+/* Consumes pending edge notifications; the level itself is re-read after debounce. */
+static void drain_events(struct watcher *w) {
+    if (w->backend == BACKEND_SYSFS) {
+        char buf[8];
+        pread(w->fd, buf, sizeof(buf), 0);
+        return;
+    }
+    if (w->backend == BACKEND_INPUT) {
+        struct input_event ev[16];
+        while (read(w->fd, ev, sizeof(ev)) > 0) {
+        }
+        return;
+    }
+    struct gpio_v2_line_event ev[16];
+    while (read(w->fd, ev, sizeof(ev)) > 0) {
+    }
+}
+
+static void reap_hook(struct watcher *w) {
+    if (w->hook_pid <= 0) return;
+    int status;
+    pid_t r = waitpid(w->hook_pid, &status, WNOHANG);
+    if (r == w->hook_pid) {
+        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            syslog(LOG_WARNING, "%s exited with %d", w->hook, WEXITSTATUS(status));
+        }
+        w->hook_pid = 0;
+    }
+}
+
+/* Runs in the hook child: matching actions execute in table order, one at a time. */
+static void run_actions(const struct watcher *w, const char *state, const char *value) {
+    for (size_t i = 0; i < w->nactions; i++) {
+        const struct action *a = &w->actions[i];
+        if (strcmp(a->state, "any") != 0 && strcmp(a->state, state) != 0) continue;
+        pid_t pid = fork();
+        if (pid < 0) continue;
+        if (pid == 0) {
+            execl("/bin/sh", "sh", "-c", a->cmd, "wds-switchd", state, value, (char *)NULL);
+            _exit(127);
+        }
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            syslog(LOG_WARNING, "action '%s' exited with %d", a->cmd, WEXITSTATUS(status));
+        }
+    }
+}
+
+/* Hooks never overlap: a change seen while one runs is dispatched when it exits. */
+static void dispatch(struct watcher *w, uint64_t edge_ms) {
+    if (w->hook_pid > 0) {
+        w->dispatch_pending = true;
+        return;
+    }
+    w->dispatch_pending = false;
+
+    int cur = read_value(w);
+    if (cur < 0) {
+        syslog(LOG_ERR, "reading switch value failed: %s", strerror(errno));
+        return;
+    }
+    if (cur == w->reported) return;
+    w->reported = cur;
+
+    const char *state = cur == 0 ? "pressed" : "released";
+    syslog(LOG_NOTICE, "WDS switch %s (value=%d, %llu ms after edge)", state, cur,
+           (unsigned long long)(now_ms() - edge_ms));
+
+    if (!w->nactions && access(w->hook, X_OK) != 0) return;
+    char value[12];
+    snprintf(value, sizeof(value), "%d", cur);
+    pid_t pid = fork();
+    if (pid < 0) {
+        syslog(LOG_ERR, "fork failed: %s", strerror(errno));
+        return;
+    }
+    if (pid == 0) {
+        if (!w->nactions) {
+            execl(w->hook, w->hook, state, value, (char *)NULL);
+            _exit(127);
+        }
+        run_actions(w, state, value);
+        _exit(0);
+    }
+    w->hook_pid = pid;
+}
+
+int main(int argc, char **argv) {
+    const char *chip = "/dev/gpiochip0";
+    const char *input_dev = NULL;
+    const char *actions_path = NULL;
+    static struct action actions[MAX_ACTIONS];
+    unsigned line = 11;
+    int sysfs_gpio = -1;
+    int foreground = 0;
+    struct watcher w = {
+        .fd = -1,
+        .ev_type = EV_SW,
+        .ev_code = SW_RFKILL_ALL,
+        .debounce_ms = -1,
+        .hook = "/usr/sbin/wds-toggle.sh",
+        .reported = -1,
+    };
+
+    static struct option long_opts[] = {
+        {"input",      required_argument, 0, 'e'},
+        {"sw-code",    required_argument, 0, 'k'},
+        {"key-code",   required_argument, 0, 'K'},
+        {"chip",       required_argument, 0, 'c'},
+        {"line",       required_argument, 0, 'l'},
+        {"sysfs",      required_argument, 0, 's'},
+        {"debounce",   required_argument, 0, 'd'},
+        {"hook",       required_argument, 0, 'x'},
+        {"actions",    required_argument, 0, 'a'},
+        {"foreground", no_argument,       0, 'f'},
+        {"help",       no_argument,       0, 'h'},
+        {0,0,0,0}
+    };
+
+    for (;;) {
+        int opt, idx = 0;
+        opt = getopt_long(argc, argv, "e:k:K:c:l:s:d:x:a:fh", long_opts, &idx);
+        if (opt == -1) break;
+        switch (opt) {
+            case 'e': input_dev = optarg; break;
+            case 'k': w.ev_type = EV_SW; w.ev_code = atoi(optarg); break;
+            case 'K': w.ev_type = EV_KEY; w.ev_code = atoi(optarg); break;
+            case 'c': chip = optarg; break;
+            case 'l': line = (unsigned)atoi(optarg); break;
+            case 's': sysfs_gpio = atoi(optarg); break;
+            case 'd': w.debounce_ms = atoi(optarg); break;
+            case 'x': w.hook = optarg; break;
+            case 'a': actions_path = optarg; break;
+            case 'f': foreground = 1; break;
+            case 'h': usage(argv[0]); return 0;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+    openlog("wds-switchd", LOG_PID | (foreground ? LOG_PERROR : 0), LOG_DAEMON);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (actions_path) {
+        if (load_actions(actions_path, actions, &w.nactions) != 0) return 1;
+        w.actions = actions;
+        syslog(LOG_NOTICE, "loaded %zu actions from %s", w.nactions, actions_path);
+    }
+
+    int rc;
+    if (input_dev) rc = open_input(&w, input_dev);
+    else if (sysfs_gpio >= 0) rc = open_sysfs(&w, sysfs_gpio);
+    else {
+        rc = open_cdev(&w, chip, line);
+        if (rc != 0 && errno == EBUSY) {
+            syslog(LOG_NOTICE, "falling back to the input device that reports the switch");
+            rc = open_input(&w, "auto");
+        }
+    }
+    if (rc != 0) return 1;
+    /* gpio-keys already debounces in the kernel. */
+    if (w.debounce_ms < 0) w.debounce_ms = w.backend == BACKEND_INPUT ? 0 : 30;
+    if (w.backend == BACKEND_CDEV) {
+        fcntl(w.fd, F_SETFL, fcntl(w.fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    w.reported = read_value(&w);
+    if (w.backend == BACKEND_INPUT) {
+        syslog(LOG_NOTICE, "started (input %s code %d, initial=%d)",
+               w.ev_type == EV_SW ? "EV_SW" : "EV_KEY", w.ev_code, w.reported);
+    } else if (w.backend == BACKEND_SYSFS) {
+        syslog(LOG_NOTICE, "started (gpio%d via sysfs edge, initial=%d)", w.sysfs_gpio, w.reported);
+    } else {
+        syslog(LOG_NOTICE, "started (%s line %u, initial=%d)", chip, line, w.reported);
+    }
+
+    bool settling = false;
+    uint64_t last_edge_ms = 0;
+    while (!g_stop) {
+        int timeout = -1;
+        uint64_t now = now_ms();
+        if (settling) {
+            uint64_t due = last_edge_ms + (uint64_t)w.debounce_ms;
+            timeout = due > now ? (int)(due - now) : 0;
+        }
+        if (w.hook_pid > 0 && (timeout < 0 || timeout > 100)) {
+            timeout = 100;
+        }
+
+        struct pollfd pfd = {
+            .fd = w.fd,
+            .events = w.backend == BACKEND_SYSFS ? (POLLPRI | POLLERR) : POLLIN,
+        };
+        int prc = poll(&pfd, 1, timeout);
+        if (prc < 0) {
+            if (errno == EINTR) continue;
+            syslog(LOG_ERR, "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (prc > 0 && pfd.revents) {
+            drain_events(&w);
+            last_edge_ms = now_ms();
+            settling = true;
+            continue;
+        }
+
+        reap_hook(&w);
+        now = now_ms();
+        if (settling && now >= last_edge_ms + (uint64_t)w.debounce_ms) {
+            settling = false;
+            dispatch(&w, last_edge_ms);
+        } else if (!settling && w.dispatch_pending) {
+            dispatch(&w, last_edge_ms);
+        }
+    }
+
+    close(w.fd);
+    if (w.backend == BACKEND_SYSFS) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", w.sysfs_gpio);
+        write_file("/sys/class/gpio/unexport", buf);
+    }
+    syslog(LOG_NOTICE, "stopped");
+    closelog();
+    return 0;
+}
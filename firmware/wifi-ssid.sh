@@ -3,6 +3,12 @@
 act="$1"; key="$2"
 [ -n "$act" ] && [ -n "$key" ] || { echo "usage: wifi-ssid on|off <ssid-or-section>"; exit 2; }
 
+# Prefer the single-vif switcher; it leaves the other radio untouched.
+if [ -x /usr/sbin/wifi-vif-switch ]; then
+  /usr/sbin/wifi-vif-switch "$act" "$key" && exit 0
+  echo "wifi-vif-switch failed, falling back to wifi reload"
+fi
+
 # 1) exact section name?
 if uci -q get "wireless.$key" >/dev/null 2>&1; then
   sec="$key"
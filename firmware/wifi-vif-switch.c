@@ -0,0 +1,605 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * wifi-vif-switch: enable/disable a single wifi-iface without `wifi reload`.
+ *
+ * The vif is toggled administratively (IFF_UP) so only that interface loses
+ * its link; the other radio keeps running. Link state is followed over
+ * rtnetlink and the measured downtime is reported. uci is updated afterwards
+ * so the next boot or reload matches. The logical network is not touched, so
+ * no iface ifup/ifdown is faked; hotplug.d/wifi-vif scripts get ACTION=up|down
+ * with DEVICE, SECTION and RADIO instead.
+ */
+
+#define WIRELESS_CONFIG "/etc/config/wireless"
+#define MAX_SECTIONS 32
+#define STATUS_MAX 16384
+
+struct vif {
+    char section[64];
+    char device[32];
+    char ssid[64];
+    char ifname[IFNAMSIZ];
+    char mode[16];
+    int anon_index;       /* position among wifi-iface sections, for @wifi-iface[N] */
+};
+
+/* One interface from `ubus call network.wireless status`. */
+struct live_vif {
+    char radio[32];
+    char section[64];
+    char ifname[IFNAMSIZ];
+    char ssid[64];
+    char mode[16];
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s on|off <ssid-or-section> [-i IFNAME] [-t MS] [-n]\n"
+        "       %s switch <from> <to> [-t MS] [-n]\n"
+        "  -i, --ifname    Interface name if netifd does not report it\n"
+        "  -t, --timeout   How long to wait for the link to come up (default: 15000 ms)\n"
+        "  -n, --no-persist  Do not write the change back to uci\n",
+        argv0, argv0);
+}
+
+/* Strips quotes from a uci token in place. */
+static char *uci_value(char *tok) {
+    while (*tok && isspace((unsigned char)*tok)) tok++;
+    char *end = tok + strlen(tok);
+    while (end > tok && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    size_t len = strlen(tok);
+    if (len >= 2 && (tok[0] == '\'' || tok[0] == '"') && tok[len - 1] == tok[0]) {
+        tok[len - 1] = '\0';
+        tok++;
+    }
+    return tok;
+}
+
+/* Returns -1 if src did not fit. */
+static int copy_str(char *dst, size_t len, const char *src) {
+    return snprintf(dst, len, "%s", src) < (int)len ? 0 : -1;
+}
+
+static int load_wireless(struct vif *vifs, size_t *nvifs) {
+    FILE *fp = fopen(WIRELESS_CONFIG, "r");
+    if (!fp) {
+        fprintf(stderr, "fopen(%s) failed: %s\n", WIRELESS_CONFIG, strerror(errno));
+        return -1;
+    }
+
+    struct vif *cur_vif = NULL;
+    int iface_index = 0;
+    char line[512];
+    *nvifs = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (*p == '#' || *p == '\0') continue;
+
+        char keyword[16] = {0}, type[32] = {0};
+        int consumed = 0;
+        if (sscanf(p, "%15s %31s %n", keyword, type, &consumed) < 2) continue;
+
+        if (strcmp(keyword, "config") == 0) {
+            char *name = uci_value(p + consumed);
+            cur_vif = NULL;
+            if (strcmp(type, "wifi-iface") == 0 && *nvifs < MAX_SECTIONS) {
+                cur_vif = &vifs[(*nvifs)++];
+                memset(cur_vif, 0, sizeof(*cur_vif));
+                cur_vif->anon_index = iface_index++;
+                if (*name) {
+                    copy_str(cur_vif->section, sizeof(cur_vif->section), name);
+                } else {
+                    snprintf(cur_vif->section, sizeof(cur_vif->section), "@wifi-iface[%d]", cur_vif->anon_index);
+                }
+            }
+            continue;
+        }
+        if (strcmp(keyword, "option") != 0 || !cur_vif) continue;
+
+        char *value = uci_value(p + consumed);
+        if (strcmp(type, "device") == 0) copy_str(cur_vif->device, sizeof(cur_vif->device), value);
+        else if (strcmp(type, "ssid") == 0) copy_str(cur_vif->ssid, sizeof(cur_vif->ssid), value);
+        else if (strcmp(type, "ifname") == 0) copy_str(cur_vif->ifname, sizeof(cur_vif->ifname), value);
+        else if (strcmp(type, "mode") == 0) copy_str(cur_vif->mode, sizeof(cur_vif->mode), value);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static struct vif *find_vif(struct vif *vifs, size_t n, const char *key) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(vifs[i].section, key) == 0) return &vifs[i];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(vifs[i].ssid, key) == 0) return &vifs[i];
+    }
+    return NULL;
+}
+
+/* Like run_cmd, but collects up to len-1 bytes of stdout into out. */
+static int run_capture(char *const argv[], char *out, size_t len) {
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) < 0) return -1;
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(pfd[1], STDOUT_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(pfd[1]);
+    size_t used = 0;
+    for (;;) {
+        ssize_t n = read(pfd[0], out + used, len - 1 - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        used += (size_t)n;
+        if (used == len - 1) break;
+    }
+    out[used] = '\0';
+    close(pfd[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* Splits a `"key": value` line of ubus's indented JSON; value keeps no quotes or comma. */
+static bool json_pair(char *line, char **key, char **value) {
+    char *p = line + strspn(line, " \t");
+    if (*p != '"') return false;
+    char *kend = strchr(p + 1, '"');
+    if (!kend || kend[1] != ':') return false;
+    *kend = '\0';
+    *key = p + 1;
+    char *v = kend + 2;
+    v += strspn(v, " \t");
+    size_t vl = strcspn(v, "\r\n");
+    while (vl && (v[vl - 1] == ',' || isspace((unsigned char)v[vl - 1]))) vl--;
+    v[vl] = '\0';
+    if (vl >= 2 && v[0] == '"' && v[vl - 1] == '"') {
+        v[vl - 1] = '\0';
+        v++;
+    }
+    *value = v;
+    return true;
+}
+
+/*
+ * Reads netifd's view of the vifs. Each radio is a top-level object whose
+ * "interfaces" entries carry "section", "ifname" (only once created) and the
+ * resolved "config" (ssid, mode). Returns the number found, or -1.
+ */
+static int load_live(struct live_vif *live, size_t max) {
+    static char buf[STATUS_MAX];
+    char *argv[] = { "/bin/ubus", "call", "network.wireless", "status", NULL };
+    if (run_capture(argv, buf, sizeof(buf)) != 0) return -1;
+
+    char radio[32] = "";
+    struct live_vif *cur = NULL;
+    size_t n = 0;
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        char *key, *value;
+        /* Radios sit one level in: a single tab before the key. */
+        if (line[0] == '\t' && line[1] == '"' && json_pair(line, &key, &value)) {
+            if (strcmp(value, "{") == 0) {
+                copy_str(radio, sizeof(radio), key);
+                cur = NULL;
+            }
+            continue;
+        }
+        if (!json_pair(line, &key, &value)) continue;
+        if (strcmp(key, "section") == 0) {
+            cur = n < max ? &live[n++] : NULL;
+            if (!cur) continue;
+            memset(cur, 0, sizeof(*cur));
+            copy_str(cur->radio, sizeof(cur->radio), radio);
+            copy_str(cur->section, sizeof(cur->section), value);
+        } else if (!cur) {
+            continue;
+        } else if (strcmp(key, "ifname") == 0) {
+            copy_str(cur->ifname, sizeof(cur->ifname), value);
+        } else if (strcmp(key, "ssid") == 0) {
+            copy_str(cur->ssid, sizeof(cur->ssid), value);
+        } else if (strcmp(key, "mode") == 0) {
+            copy_str(cur->mode, sizeof(cur->mode), value);
+        }
+    }
+    return (int)n;
+}
+
+/*
+ * Finds the vif's current netdev in netifd's status. Named sections match
+ * by name; anonymous ones (netifd reports them as cfgXXXXXX) by radio, ssid
+ * and mode. Returns 0 with the name, 1 when netifd has not created it (yet),
+ * -1 when the status is unavailable.
+ */
+static int live_ifname(const struct vif *v, char *out, size_t len) {
+    struct live_vif live[MAX_SECTIONS];
+    int n = load_live(live, MAX_SECTIONS);
+    if (n < 0) return -1;
+    const char *mode = v->mode[0] ? v->mode : "ap";
+    for (int i = 0; i < n; i++) {
+        const struct live_vif *l = &live[i];
+        bool match = v->section[0] == '@'
+            ? strcmp(l->radio, v->device) == 0 && strcmp(l->ssid, v->ssid) == 0 &&
+              strcmp(l->mode[0] ? l->mode : "ap", mode) == 0
+            : strcmp(l->section, v->section) == 0;
+        if (!match) continue;
+        if (!l->ifname[0]) return 1;
+        return copy_str(out, len, l->ifname) == 0 ? 0 : -1;
+    }
+    return 1;
+}
+
+static int get_flags(int sock, const char *ifname, short *flags) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    copy_str(ifr.ifr_name, sizeof(ifr.ifr_name), ifname);
+    if (ioctl(sock, SIOCGIFFLAGS, &ifr) < 0) return -1;
+    *flags = ifr.ifr_flags;
+    return 0;
+}
+
+static int set_up(int sock, const char *ifname, bool up) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    copy_str(ifr.ifr_name, sizeof(ifr.ifr_name), ifname);
+    if (ioctl(sock, SIOCGIFFLAGS, &ifr) < 0) return -1;
+    if (up) ifr.ifr_flags |= IFF_UP;
+    else ifr.ifr_flags &= ~IFF_UP;
+    return ioctl(sock, SIOCSIFFLAGS, &ifr);
+}
+
+static int open_rtnl(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK };
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Waits until ifname reports the wanted state: RUNNING (associated, carrier up)
+ * for "up", or gone / not UP for "down". Returns elapsed ms or -1 on timeout.
+ */
+static long wait_link(int rtnl, int ioc, const char *ifname, bool want_running,
+                      uint64_t start_ms, int timeout_ms) {
+    char buf[8192];
+    for (;;) {
+        short flags = 0;
+        bool exists = get_flags(ioc, ifname, &flags) == 0;
+        bool done = want_running ? (exists && (flags & IFF_RUNNING))
+                                 : (!exists || !(flags & IFF_UP));
+        if (done) return (long)(now_ms() - start_ms);
+
+        long remaining = (long)timeout_ms - (long)(now_ms() - start_ms);
+        if (remaining <= 0) return -1;
+        struct pollfd pfd = { .fd = rtnl, .events = POLLIN };
+        int rc = poll(&pfd, 1, (int)remaining);
+        if (rc < 0 && errno != EINTR) return -1;
+        if (rc > 0) {
+            /* Any link message is a cue to re-check; drain without parsing. */
+            while (recv(rtnl, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+    }
+}
+
+static int run_cmd(char *const argv[], char *const envp[]) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            dup2(devnull, STDOUT_FILENO);
+        }
+        if (envp) execve(argv[0], argv, envp);
+        else execv(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void persist(const struct vif *v, bool enable) {
+    char assign[160];
+    snprintf(assign, sizeof(assign), "wireless.%s.disabled=%d", v->section, enable ? 0 : 1);
+    char *set_argv[] = { "/sbin/uci", "set", assign, NULL };
+    char *commit_argv[] = { "/sbin/uci", "commit", "wireless", NULL };
+    if (run_cmd(set_argv, NULL) != 0 || run_cmd(commit_argv, NULL) != 0) {
+        syslog(LOG_WARNING, "uci update for %s failed", v->section);
+    }
+}
+
+/* netdev-level event only: the logical network never went through ifup/ifdown. */
+static void hotplug(const struct vif *v, const char *ifname, bool up) {
+    if (access("/sbin/hotplug-call", X_OK) != 0) return;
+    char action[32], device[48], section[80], radio[48];
+    snprintf(action, sizeof(action), "ACTION=%s", up ? "up" : "down");
+    snprintf(device, sizeof(device), "DEVICE=%s", ifname);
+    snprintf(section, sizeof(section), "SECTION=%s", v->section);
+    snprintf(radio, sizeof(radio), "RADIO=%s", v->device);
+    char *envp[] = { action, device, section, radio, "PATH=/usr/sbin:/usr/bin:/sbin:/bin", NULL };
+    char *argv[] = { "/sbin/hotplug-call", "wifi-vif", NULL };
+    run_cmd(argv, envp);
+}
+
+/*
+ * Brings up a vif that netifd never created (disabled at boot). netifd
+ * works from the config it loaded last, where the vif is still disabled,
+ * so `network.wireless up` alone would not create it: `network reload`
+ * makes it re-read the committed uci first. Only radios whose wireless
+ * config changed are reconfigured, so the other radio keeps its link.
+ */
+static int netifd_radio_up(const struct vif *v) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "{\"device\":\"%s\"}", v->device);
+    char *reload_argv[] = { "/bin/ubus", "call", "network", "reload", NULL };
+    char *up_argv[] = { "/bin/ubus", "call", "network.wireless", "up", msg, NULL };
+    if (run_cmd(reload_argv, NULL) != 0) return -1;
+    return run_cmd(up_argv, NULL);
+}
+
+struct ctx {
+    int ioc;
+    int rtnl;
+    int timeout_ms;
+    bool persist;
+    struct vif vifs[MAX_SECTIONS];
+    size_t nvifs;
+};
+
+static int resolve(struct ctx *c, const char *key, const char *ifname_override,
+                   struct vif **out, char *ifname, size_t len) {
+    struct vif *v = find_vif(c->vifs, c->nvifs, key);
+    if (!v) {
+        fprintf(stderr, "No matching wifi-iface for '%s'\n", key);
+        return -1;
+    }
+    ifname[0] = '\0';
+    if (ifname_override) {
+        copy_str(ifname, len, ifname_override);
+    } else if (live_ifname(v, ifname, len) < 0) {
+        /* No netifd status: only an explicit uci ifname is trustworthy. */
+        if (!v->ifname[0]) {
+            fprintf(stderr, "netifd status unavailable and %s has no ifname; use -i\n", v->section);
+            return -1;
+        }
+        copy_str(ifname, len, v->ifname);
+    }
+    *out = v;
+    return 0;
+}
+
+static int do_off(struct ctx *c, struct vif *v, const char *ifname, uint64_t start) {
+    if (!ifname[0]) {
+        printf("off %s: no interface, already down\n", v->section);
+        return 0;
+    }
+    if (set_up(c->ioc, ifname, false) < 0 && errno != ENODEV) {
+        fprintf(stderr, "Bringing %s down failed: %s\n", ifname, strerror(errno));
+        return -1;
+    }
+    long ms = wait_link(c->rtnl, c->ioc, ifname, false, start, c->timeout_ms);
+    if (ms < 0) {
+        printf("off %s (%s): still up after %d ms\n", v->section, ifname, c->timeout_ms);
+        return -1;
+    }
+    printf("off %s (%s) down after %ld ms\n", v->section, ifname, ms);
+    return 0;
+}
+
+/* Waits on link events until netifd reports an ifname for v. */
+static int wait_created(struct ctx *c, const struct vif *v, char *ifname, size_t len, uint64_t start_ms) {
+    char buf[8192];
+    for (;;) {
+        if (live_ifname(v, ifname, len) == 0) return 0;
+        long remaining = (long)c->timeout_ms - (long)(now_ms() - start_ms);
+        if (remaining <= 0) return -1;
+        struct pollfd pfd = { .fd = c->rtnl, .events = POLLIN };
+        int rc = poll(&pfd, 1, (int)remaining);
+        if (rc < 0 && errno != EINTR) return -1;
+        if (rc > 0) {
+            while (recv(c->rtnl, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+    }
+}
+
+/*
+ * ifname may be empty (vif not created yet); it is filled in once netifd
+ * creates it. A vif enabled in uci for that is disabled again on failure.
+ */
+static long do_on(struct ctx *c, struct vif *v, char *ifname, size_t len, uint64_t start) {
+    short flags;
+    bool created = false;
+    if (ifname[0] && get_flags(c->ioc, ifname, &flags) == 0) {
+        if (set_up(c->ioc, ifname, true) < 0) {
+            fprintf(stderr, "Bringing %s up failed: %s\n", ifname, strerror(errno));
+            return -2;
+        }
+    } else {
+        /* netifd needs the config flag before it will create the vif. */
+        persist(v, true);
+        if (netifd_radio_up(v) != 0) {
+            fprintf(stderr, "netifd could not bring up %s\n", v->device);
+            persist(v, false);
+            return -2;
+        }
+        created = true;
+        if (!ifname[0] && wait_created(c, v, ifname, len, start) != 0) {
+            persist(v, false);
+            return -1;
+        }
+    }
+    long ms = wait_link(c->rtnl, c->ioc, ifname, true, start, c->timeout_ms);
+    if (ms < 0 && created) persist(v, false);
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    const char *ifname_override = NULL;
+    struct ctx c = { .ioc = -1, .rtnl = -1, .timeout_ms = 15000, .persist = true };
+
+    static struct option long_opts[] = {
+        {"ifname",     required_argument, 0, 'i'},
+        {"timeout",    required_argument, 0, 't'},
+        {"no-persist", no_argument,       0, 'n'},
+        {"help",       no_argument,       0, 'h'},
+        {0,0,0,0}
+    };
+    for (;;) {
+        int opt, idx = 0;
+        opt = getopt_long(argc, argv, "i:t:nh", long_opts, &idx);
+        if (opt == -1) break;
+        switch (opt) {
+            case 'i': ifname_override = optarg; break;
+            case 't': c.timeout_ms = atoi(optarg); break;
+            case 'n': c.persist = false; break;
+            case 'h': usage(argv[0]); return 0;
+            default:  usage(argv[0]); return 2;
+        }
+    }
+    int nargs = argc - optind;
+    const char *act = nargs > 0 ? argv[optind] : NULL;
+    bool is_switch = act && strcmp(act, "switch") == 0;
+    if (!act || nargs != (is_switch ? 3 : 2)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!is_switch && strcmp(act, "on") != 0 && strcmp(act, "off") != 0) {
+        fprintf(stderr, "unknown action: %s\n", act);
+        return 2;
+    }
+
+    openlog("wifi-vif-switch", LOG_PID, LOG_DAEMON);
+    if (load_wireless(c.vifs, &c.nvifs) != 0) return 1;
+
+    c.ioc = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    c.rtnl = open_rtnl();
+    if (c.ioc < 0 || c.rtnl < 0) {
+        fprintf(stderr, "socket setup failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    int rc = 0;
+    if (is_switch) {
+        struct vif *from, *to;
+        char from_if[IFNAMSIZ], to_if[IFNAMSIZ];
+        if (resolve(&c, argv[optind + 1], NULL, &from, from_if, sizeof(from_if)) != 0 ||
+            resolve(&c, argv[optind + 2], NULL, &to, to_if, sizeof(to_if)) != 0) {
+            return 1;
+        }
+        uint64_t start = now_ms();
+        if (do_off(&c, from, from_if, start) != 0) return 1;
+        long downtime = do_on(&c, to, to_if, sizeof(to_if), start);
+        if (downtime == -2) {
+            rc = 1;
+        } else if (downtime < 0) {
+            printf("switch %s -> %s: %s not running after %d ms\n",
+                   from->section, to->section, to_if, c.timeout_ms);
+            syslog(LOG_WARNING, "switch %s -> %s timed out", from->section, to->section);
+            rc = 1;
+        } else {
+            printf("switch %s (%s) -> %s (%s): downtime %ld ms\n",
+                   from->section, from_if, to->section, to_if, downtime);
+            syslog(LOG_NOTICE, "switch %s -> %s: downtime %ld ms", from->section, to->section, downtime);
+        }
+        /* Never leave the device without a link: take `to` down again and bring `from` back. */
+        bool restored = false;
+        if (rc != 0 && from_if[0]) {
+            if (to_if[0]) do_off(&c, to, to_if, now_ms());
+            uint64_t back_start = now_ms();
+            long back = do_on(&c, from, from_if, sizeof(from_if), back_start);
+            restored = back >= 0;
+            if (restored) {
+                printf("switch %s -> %s failed; %s (%s) restored after %ld ms\n",
+                       from->section, to->section, from->section, from_if, back);
+                syslog(LOG_WARNING, "switch %s -> %s failed, %s restored", from->section, to->section,
+                       from->section);
+            } else {
+                printf("switch %s -> %s failed; restoring %s (%s) failed too, no link\n",
+                       from->section, to->section, from->section, from_if);
+                syslog(LOG_ERR, "switch %s -> %s failed, %s not restored", from->section, to->section,
+                       from->section);
+            }
+        }
+        if (c.persist && rc == 0) {
+            persist(from, false);
+            persist(to, true);
+        }
+        if (from_if[0] && !restored) hotplug(from, from_if, false);
+        if (rc == 0) hotplug(to, to_if, true);
+    } else {
+        bool enable = strcmp(act, "on") == 0;
+        struct vif *v;
+        char ifname[IFNAMSIZ];
+        if (resolve(&c, argv[optind + 1], ifname_override, &v, ifname, sizeof(ifname)) != 0) return 1;
+        uint64_t start = now_ms();
+        if (enable) {
+            long ms = do_on(&c, v, ifname, sizeof(ifname), start);
+            if (ms == -2) {
+                rc = 1;
+            } else if (ms < 0) {
+                printf("on %s (%s): not running after %d ms\n", v->section, ifname, c.timeout_ms);
+                rc = 1;
+            } else {
+                printf("on %s (%s): running after %ld ms\n", v->section, ifname, ms);
+                syslog(LOG_NOTICE, "on %s (%s): running after %ld ms", v->section, ifname, ms);
+            }
+        } else if (do_off(&c, v, ifname, start) != 0) {
+            rc = 1;
+        }
+        if (c.persist && rc == 0) persist(v, enable);
+        if (rc == 0 && ifname[0]) hotplug(v, ifname, enable);
+    }
+
+    close(c.rtnl);
+    close(c.ioc);
+    closelog();
+    return rc;
+}
@@ -0,0 +1,151 @@
+#define _GNU_SOURCE
+#include "mtk_iwpriv.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/wireless.h>
+
+/* From the MTK driver's rt_os.h (oid.h). */
+#define RTPRIV_IOCTL_SET         (SIOCIWFIRSTPRIV + 0x02)
+#define RTPRIV_IOCTL_STATISTICS  (SIOCIWFIRSTPRIV + 0x09)
+
+int mtk_iwpriv_open(struct mtk_iwpriv *p, const char *ifname, const char *mock) {
+    memset(p, 0, sizeof(*p));
+    p->fd = -1;
+    if (strlen(ifname) >= sizeof(p->ifname)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(p->ifname, ifname, strlen(ifname) + 1);
+    p->mock = mock;
+    if (mock) {
+        p->mock_log = fopen(mock, "a");
+        if (!p->mock_log) return -1;
+        setvbuf(p->mock_log, NULL, _IOLBF, 0);
+    }
+    p->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    return p->fd < 0 ? -1 : 0;
+}
+
+void mtk_iwpriv_close(struct mtk_iwpriv *p) {
+    if (p->fd >= 0) close(p->fd);
+    if (p->mock_log) fclose(p->mock_log);
+    p->fd = -1;
+    p->mock_log = NULL;
+}
+
+static void prepare(struct mtk_iwpriv *p, struct iwreq *wrq) {
+    memset(wrq, 0, sizeof(*wrq));
+    memcpy(wrq->ifr_name, p->ifname, sizeof(wrq->ifr_name));
+}
+
+int mtk_iwpriv_set(struct mtk_iwpriv *p, const char *key, const char *value) {
+    char arg[256];
+    int n = snprintf(arg, sizeof(arg), "%s=%s", key, value);
+    if (n < 0 || (size_t)n >= sizeof(arg)) {
+        errno = E2BIG;
+        return -1;
+    }
+    if (p->mock_log) {
+        fprintf(p->mock_log, "%s set %s\n", p->ifname, arg);
+        return 0;
+    }
+    struct iwreq wrq;
+    prepare(p, &wrq);
+    wrq.u.data.pointer = arg;
+    wrq.u.data.length = (uint16_t)(n + 1);
+    return ioctl(p->fd, RTPRIV_IOCTL_SET, &wrq) < 0 ? -1 : 0;
+}
+
+static int read_mock(const struct mtk_iwpriv *p, const char *suffix, char *out, size_t len) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", p->mock, suffix);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        out[0] = '\0';
+        return -1;
+    }
+    size_t n = fread(out, 1, len - 1, fp);
+    fclose(fp);
+    out[n] = '\0';
+    return (int)n;
+}
+
+int mtk_iwpriv_stat(struct mtk_iwpriv *p, char *out, size_t len) {
+    if (len == 0) return -1;
+    if (p->mock) return read_mock(p, ".stat", out, len);
+    struct iwreq wrq;
+    prepare(p, &wrq);
+    wrq.u.data.pointer = out;
+    wrq.u.data.length = (uint16_t)(len > 0xffff ? 0xffff : len);
+    if (ioctl(p->fd, RTPRIV_IOCTL_STATISTICS, &wrq) < 0) return -1;
+    size_t n = wrq.u.data.length < len ? wrq.u.data.length : len - 1;
+    out[n] = '\0';
+    return (int)n;
+}
+
+int mtk_iwpriv_get_bssid(struct mtk_iwpriv *p, uint8_t bssid[6]) {
+    if (p->mock) {
+        char buf[64];
+        unsigned m[6];
+        if (read_mock(p, ".ap", buf, sizeof(buf)) < 0 ||
+            sscanf(buf, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+            memset(bssid, 0, 6);
+            return 0;
+        }
+        for (int i = 0; i < 6; i++) bssid[i] = (uint8_t)m[i];
+    } else {
+        struct iwreq wrq;
+        prepare(p, &wrq);
+        if (ioctl(p->fd, SIOCGIWAP, &wrq) < 0) return -1;
+        memcpy(bssid, wrq.u.ap_addr.sa_data, 6);
+    }
+    static const uint8_t zero[6], bcast[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    return memcmp(bssid, zero, 6) != 0 && memcmp(bssid, bcast, 6) != 0;
+}
+
+int mtk_iwpriv_get_channel(struct mtk_iwpriv *p) {
+    if (p->mock) {
+        char buf[64], mac[32];
+        int channel;
+        if (read_mock(p, ".ap", buf, sizeof(buf)) < 0 ||
+            sscanf(buf, "%31s %d", mac, &channel) != 2) {
+            return -1;
+        }
+        return channel;
+    }
+    struct iwreq wrq;
+    prepare(p, &wrq);
+    if (ioctl(p->fd, SIOCGIWFREQ, &wrq) < 0) return -1;
+    /* Drivers report either a channel number (e == 0, m < 1000) or a frequency. */
+    double f = wrq.u.freq.m;
+    for (int i = 0; i < wrq.u.freq.e; i++) f *= 10.0;
+    if (f < 1000.0) return (int)f;
+    int mhz = (int)(f / 1e6);
+    if (mhz == 2484) return 14;
+    if (mhz >= 2412 && mhz < 2484) return (mhz - 2407) / 5;
+    if (mhz >= 5000 && mhz < 5900) return (mhz - 5000) / 5;
+    return -1;
+}
+
+int mtk_iwpriv_if_flags(struct mtk_iwpriv *p) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, p->ifname, sizeof(ifr.ifr_name));
+    if (ioctl(p->fd, SIOCGIFFLAGS, &ifr) < 0) return -1;
+    return ifr.ifr_flags & 0xffff;
+}
+
+int mtk_iwpriv_if_up(struct mtk_iwpriv *p, int up) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, p->ifname, sizeof(ifr.ifr_name));
+    if (ioctl(p->fd, SIOCGIFFLAGS, &ifr) < 0) return -1;
+    if (up) ifr.ifr_flags |= IFF_UP;
+    else ifr.ifr_flags &= ~IFF_UP;
+    return ioctl(p->fd, SIOCSIFFLAGS, &ifr);
+}
@@ -0,0 +1,45 @@
+#ifndef MTK_IWPRIV_H
+#define MTK_IWPRIV_H
+
+/*
+ * Direct access to the MediaTek driver's private ioctls, i.e. what
+ * `iwpriv <if> set Key=Value` and `iwpriv <if> stat` do, without a fork per call.
+ *
+ * With a mock path, sets are appended to that file as "<if> set Key=Value"
+ * lines, stat returns the contents of "<mock>.stat" and the BSSID/channel
+ * come from "<mock>.ap" ("aa:bb:cc:dd:ee:ff CHANNEL"), so callers can be
+ * exercised on a machine without the driver.
+ */
+
+#include <net/if.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct mtk_iwpriv {
+    int fd;
+    char ifname[IFNAMSIZ];
+    const char *mock;
+    FILE *mock_log;
+};
+
+int mtk_iwpriv_open(struct mtk_iwpriv *p, const char *ifname, const char *mock);
+void mtk_iwpriv_close(struct mtk_iwpriv *p);
+
+/* Equivalent of `iwpriv IF set KEY=VALUE`. Returns 0 or -1 with errno set. */
+int mtk_iwpriv_set(struct mtk_iwpriv *p, const char *key, const char *value);
+
+/* Equivalent of `iwpriv IF stat`; out is NUL-terminated. Returns length or -1. */
+int mtk_iwpriv_stat(struct mtk_iwpriv *p, char *out, size_t len);
+
+/* Current AP (SIOCGIWAP). Returns 1 when associated, 0 when not, -1 on error. */
+int mtk_iwpriv_get_bssid(struct mtk_iwpriv *p, uint8_t bssid[6]);
+
+/* Current channel number (SIOCGIWFREQ), or -1. */
+int mtk_iwpriv_get_channel(struct mtk_iwpriv *p);
+
+/* Flags from SIOCGIFFLAGS, or -1. */
+int mtk_iwpriv_if_flags(struct mtk_iwpriv *p);
+int mtk_iwpriv_if_up(struct mtk_iwpriv *p, int up);
+
+#endif
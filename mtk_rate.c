@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+#include "mtk_rate.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void mtk_fixed_rate_init_ht(struct mtk_fixed_rate *r, int mcs) {
+    memset(r, 0, sizeof(*r));
+    r->wcid = 1;
+    r->mode = MTK_MODE_HT;
+    r->mcs = mcs;
+    r->preamble = 1;
+}
+
+static bool is_bit(int v) { return v == 0 || v == 1; }
+
+const char *mtk_fixed_rate_validate(const struct mtk_fixed_rate *r) {
+    if (r->wcid < 0 || r->wcid > 255) return "wcid must be 0..255";
+    if (!is_bit(r->sgi)) return "sgi must be 0 or 1";
+    if (!is_bit(r->stbc)) return "stbc must be 0 or 1";
+    if (!is_bit(r->ldpc)) return "ldpc must be 0 or 1";
+    if (!is_bit(r->preamble)) return "preamble must be 0 or 1";
+    if (!is_bit(r->spe)) return "spe must be 0 or 1";
+    switch (r->mode) {
+        case MTK_MODE_CCK:
+            if (r->mcs < 0 || r->mcs > 3) return "CCK rate index must be 0..3";
+            if (r->bw != 0) return "CCK is 20 MHz only";
+            break;
+        case MTK_MODE_OFDM:
+            if (r->mcs < 0 || r->mcs > 7) return "OFDM rate index must be 0..7";
+            if (r->bw != 0) return "OFDM is 20 MHz only";
+            break;
+        case MTK_MODE_HT:
+            if (r->mcs < 0 || r->mcs > 32) return "HT MCS must be 0..32";
+            if (r->mcs == 32 && r->bw != 1) return "HT MCS 32 needs 40 MHz";
+            if (r->bw < 0 || r->bw > 1) return "HT bandwidth must be 20 or 40";
+            if (r->vht_nss != 0) return "HT takes no VhtNss";
+            break;
+        case MTK_MODE_VHT:
+            if (r->mcs < 0 || r->mcs > 9) return "VHT MCS must be 0..9";
+            if (r->bw < 0 || r->bw > 2) return "VHT bandwidth must be 20, 40 or 80";
+            if (r->vht_nss < 1 || r->vht_nss > 4) return "VHT needs VhtNss 1..4";
+            if (r->mcs == 9 && r->bw == 0 && r->vht_nss != 3) return "VHT MCS 9 is invalid at 20 MHz";
+            break;
+        default:
+            return "mode must be 0 (CCK), 1 (OFDM), 2 (HT) or 4 (VHT)";
+    }
+    return NULL;
+}
+
+int mtk_fixed_rate_format(const struct mtk_fixed_rate *r, char *buf, size_t len) {
+    int n = snprintf(buf, len, "%d-%d-%d-%d-%d-%d-%d-%d-%d-%d",
+                     r->wcid, r->mode, r->bw, r->mcs, r->vht_nss,
+                     r->sgi, r->preamble, r->stbc, r->ldpc, r->spe);
+    return n < 0 || (size_t)n >= len ? -1 : n;
+}
+
+/* Case-insensitive search limited to [s, end). */
+static const char *find_token(const char *s, const char *end, const char *tok) {
+    size_t tl = strlen(tok);
+    for (; s + tl <= end; s++) {
+        if (strncasecmp(s, tok, tl) == 0) return s;
+    }
+    return NULL;
+}
+
+/* Number right after tok (optionally after ':', '=' or spaces), or -1. */
+static int number_after(const char *s, const char *end, const char *tok) {
+    const char *p = find_token(s, end, tok);
+    if (!p) return -1;
+    p += strlen(tok);
+    while (p < end && (*p == ' ' || *p == ':' || *p == '=')) p++;
+    if (p >= end || !isdigit((unsigned char)*p)) return -1;
+    return atoi(p);
+}
+
+int mtk_parse_last_tx_rate(const char *stat, struct mtk_tx_rate *out) {
+    out->mode = -1;
+    out->mcs = -1;
+    out->bw_mhz = -1;
+    out->sgi = -1;
+
+    const char *line = strstr(stat, "Last TX Rate");
+    if (!line) return -1;
+    const char *s = strchr(line, '=');
+    const char *end = strchr(line, '\n');
+    if (!end) end = line + strlen(line);
+    if (!s || s > end) return -1;
+    s++;
+
+    if (find_token(s, end, "VHT")) out->mode = MTK_MODE_VHT;
+    else if (find_token(s, end, "HT")) out->mode = MTK_MODE_HT;
+    else if (find_token(s, end, "OFDM")) out->mode = MTK_MODE_OFDM;
+    else if (find_token(s, end, "CCK")) out->mode = MTK_MODE_CCK;
+
+    out->mcs = number_after(s, end, "MCS");
+
+    int bw = number_after(s, end, "BW");
+    if (bw < 0) {
+        /* "40M", "40MHz" or "80 MHz" without a BW prefix */
+        for (const char *p = s; p < end; p++) {
+            if (isdigit((unsigned char)*p) && (p == s || !isalnum((unsigned char)p[-1]))) {
+                int v = atoi(p);
+                const char *q = p;
+                while (q < end && isdigit((unsigned char)*q)) q++;
+                while (q < end && *q == ' ') q++;
+                if ((v == 20 || v == 40 || v == 80 || v == 160) && q < end && (*q == 'M' || *q == 'm')) {
+                    bw = v;
+                    break;
+                }
+            }
+        }
+    }
+    out->bw_mhz = bw;
+
+    if (find_token(s, end, "SGI") || find_token(s, end, "400ns") || find_token(s, end, "Short GI")) {
+        out->sgi = 1;
+    } else if (find_token(s, end, "LGI") || find_token(s, end, "800ns") || find_token(s, end, "Long GI")) {
+        out->sgi = 0;
+    }
+    return 0;
+}
+
+bool mtk_tx_rate_matches(const struct mtk_fixed_rate *want, const struct mtk_tx_rate *seen) {
+    if (seen->mcs < 0 || seen->mcs != want->mcs) return false;
+    if (seen->mode >= 0 && seen->mode != want->mode) return false;
+    if (seen->bw_mhz >= 0 && seen->bw_mhz != mtk_bw_mhz(want->bw)) return false;
+    if (seen->sgi >= 0 && seen->sgi != want->sgi) return false;
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef MTK_RATE_H
+#define MTK_RATE_H
+
+/*
+ * MTK FixedRate tuple encoding and `iwpriv <if> stat` rate parsing.
+ *
+ *   FixedRate=[WCID]-[Mode]-[BW]-[MCS]-[VhtNss]-[SGI]-[Preamble]-[STBC]-[LDPC]-[SPE_EN]
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum mtk_phy_mode {
+    MTK_MODE_CCK = 0,
+    MTK_MODE_OFDM = 1,
+    MTK_MODE_HT = 2,
+    MTK_MODE_VHT = 4,
+};
+
+struct mtk_fixed_rate {
+    int wcid;
+    int mode;        /* enum mtk_phy_mode */
+    int bw;          /* 0 = 20, 1 = 40, 2 = 80 MHz */
+    int mcs;
+    int vht_nss;     /* 0 for HT */
+    int sgi;
+    int preamble;
+    int stbc;
+    int ldpc;
+    int spe;
+};
+
+/* HT defaults used by set_rate.sh: WCID 1, 20 MHz, LGI, preamble 1. */
+void mtk_fixed_rate_init_ht(struct mtk_fixed_rate *r, int mcs);
+
+/* Returns NULL when valid, otherwise a short reason. */
+const char *mtk_fixed_rate_validate(const struct mtk_fixed_rate *r);
+
+/* Writes the tuple without the "FixedRate=" prefix. Returns length or -1. */
+int mtk_fixed_rate_format(const struct mtk_fixed_rate *r, char *buf, size_t len);
+
+static inline int mtk_bw_mhz(int bw) { return 20 << bw; }
+
+struct mtk_tx_rate {
+    int mode;        /* enum mtk_phy_mode, -1 if not reported */
+    int mcs;         /* -1 if not reported */
+    int bw_mhz;      /* -1 if not reported */
+    int sgi;         /* 0/1, -1 if not reported */
+};
+
+/*
+ * Parses the "Last TX Rate" line of stat output. Driver builds differ
+ * ("MCS7, BW20, SGI", "HT MCS 7 40M LGI", "VHT 1SS MCS9, 80MHz, 400ns GI"),
+ * so fields are picked out by token. Returns 0, or -1 if the line is absent.
+ */
+int mtk_parse_last_tx_rate(const char *stat, struct mtk_tx_rate *out);
+
+/* True when every field the driver reported agrees with the requested tuple. */
+bool mtk_tx_rate_matches(const struct mtk_fixed_rate *want, const struct mtk_tx_rate *seen);
+
+#endif
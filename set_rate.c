@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mtk_iwpriv.h"
+#include "mtk_rate.h"
+
+/*
+ * set_rate: native set_rate.sh. Applies FixedRate with the private "set"
+ * ioctl (one per WCID, back to back), then polls `stat` with backoff until
+ * Last TX Rate shows the new rate and reports the apply->effective latency.
+ */
+
+#define MAX_WCIDS 16
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+static void sleep_us(long us) {
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [-t MS] [-n] [-v NSS] [-M MOCK] <if> <mcs> [20|40|80] [sgi 0|1] [wcid[,wcid...]] [stbc 0|1] [ldpc 0|1]\n"
+        "  -t MS    Wait up to MS for Last TX Rate to show the new rate (default: 1000)\n"
+        "  -n       Apply only, skip readback\n"
+        "  -v NSS   VHT with NSS spatial streams instead of HT\n"
+        "  -M MOCK  Mock ioctl layer (see mtk_iwpriv.h)\n"
+        "  Several WCIDs are applied back to back and verified once.\n",
+        argv0);
+}
+
+static int parse_bit(const char *arg, const char *name, int *out) {
+    if (strcmp(arg, "0") != 0 && strcmp(arg, "1") != 0) {
+        fprintf(stderr, "[set_rate] ERROR: %s must be 0 or 1\n", name);
+        return -1;
+    }
+    *out = arg[0] - '0';
+    return 0;
+}
+
+static int parse_wcids(const char *arg, int *wcids, int *count) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    *count = 0;
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *end;
+        long v = strtol(tok, &end, 10);
+        if (*end || v < 0 || v > 255 || *count == MAX_WCIDS) {
+            fprintf(stderr, "[set_rate] ERROR: invalid wcid list '%s'\n", arg);
+            return -1;
+        }
+        wcids[(*count)++] = (int)v;
+    }
+    return *count ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    int timeout_ms = 1000;
+    bool verify = true;
+    int vht_nss = 0;
+    const char *mock = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:nv:M:h")) != -1) {
+        switch (opt) {
+            case 't': timeout_ms = atoi(optarg); break;
+            case 'n': verify = false; break;
+            case 'v': vht_nss = atoi(optarg); break;
+            case 'M': mock = optarg; break;
+            case 'h': usage(argv[0]); return 0;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+    int nargs = argc - optind;
+    if (nargs < 2 || nargs > 7) {
+        usage(argv[0]);
+        return 1;
+    }
+    char **a = argv + optind;
+    const char *ifname = a[0];
+
+    char *end;
+    long mcs = strtol(a[1], &end, 10);
+    if (*end || a[1][0] == '\0') {
+        fprintf(stderr, "[set_rate] ERROR: invalid MCS '%s'\n", a[1]);
+        return 1;
+    }
+
+    struct mtk_fixed_rate rate;
+    mtk_fixed_rate_init_ht(&rate, (int)mcs);
+    if (vht_nss > 0) {
+        rate.mode = MTK_MODE_VHT;
+        rate.vht_nss = vht_nss;
+    }
+    int bw_mhz = nargs > 2 ? atoi(a[2]) : 20;
+    switch (bw_mhz) {
+        case 20: rate.bw = 0; break;
+        case 40: rate.bw = 1; break;
+        case 80: rate.bw = 2; break;
+        default:
+            printf("[set_rate] WARN: unsupported bw '%s', using 20\n", a[2]);
+            rate.bw = 0;
+            bw_mhz = 20;
+    }
+    int wcids[MAX_WCIDS] = {1}, nwcids = 1;
+    if ((nargs > 3 && parse_bit(a[3], "sgi", &rate.sgi) != 0) ||
+        (nargs > 4 && parse_wcids(a[4], wcids, &nwcids) != 0) ||
+        (nargs > 5 && parse_bit(a[5], "stbc", &rate.stbc) != 0) ||
+        (nargs > 6 && parse_bit(a[6], "ldpc", &rate.ldpc) != 0)) {
+        return 1;
+    }
+
+    struct mtk_iwpriv p;
+    if (mtk_iwpriv_open(&p, ifname, mock) != 0) {
+        fprintf(stderr, "[set_rate] ERROR: cannot open %s: %s\n", ifname, strerror(errno));
+        return 1;
+    }
+
+    printf("[set_rate] iface=%s mode=%s mcs=%d bw=%dMHz sgi=%d stbc=%d ldpc=%d wcids=%s\n",
+           ifname, rate.mode == MTK_MODE_VHT ? "vht" : "ht", rate.mcs, bw_mhz,
+           rate.sgi, rate.stbc, rate.ldpc, nargs > 4 ? a[4] : "1");
+
+    /* Validate every tuple before touching the driver so a batch is all-or-nothing. */
+    char tuples[MAX_WCIDS][64];
+    for (int i = 0; i < nwcids; i++) {
+        rate.wcid = wcids[i];
+        const char *why = mtk_fixed_rate_validate(&rate);
+        if (why) {
+            fprintf(stderr, "[set_rate] ERROR: %s\n", why);
+            mtk_iwpriv_close(&p);
+            return 1;
+        }
+        mtk_fixed_rate_format(&rate, tuples[i], sizeof(tuples[i]));
+    }
+
+    uint64_t t0 = now_us();
+    for (int i = 0; i < nwcids; i++) {
+        if (mtk_iwpriv_set(&p, "FixedRate", tuples[i]) != 0) {
+            fprintf(stderr, "[set_rate] ERROR: driver rejected FixedRate on %s (tuple=%s): %s\n",
+                    ifname, tuples[i], strerror(errno));
+            mtk_iwpriv_close(&p);
+            return 1;
+        }
+        printf("[set_rate] applied FixedRate=%s\n", tuples[i]);
+    }
+    uint64_t applied = now_us();
+    printf("[set_rate] apply took %.2f ms for %d tuple(s)\n", (applied - t0) / 1000.0, nwcids);
+
+    int rc = 0;
+    if (verify) {
+        static char stat[8192];
+        struct mtk_tx_rate seen = { .mcs = -1 };
+        long backoff_us = 2000;
+        int polls = 0;
+        bool matched = false;
+        for (;;) {
+            polls++;
+            if (mtk_iwpriv_stat(&p, stat, sizeof(stat)) >= 0 &&
+                mtk_parse_last_tx_rate(stat, &seen) == 0 &&
+                mtk_tx_rate_matches(&rate, &seen)) {
+                matched = true;
+                break;
+            }
+            long elapsed_ms = (long)((now_us() - applied) / 1000);
+            if (elapsed_ms >= timeout_ms) break;
+            long left_us = (long)timeout_ms * 1000 - (long)(now_us() - applied);
+            sleep_us(backoff_us < left_us ? backoff_us : left_us);
+            if (backoff_us < 50000) backoff_us *= 2;
+        }
+        double ms = (now_us() - applied) / 1000.0;
+        if (matched) {
+            printf("[verify] Last TX Rate = MCS%d after %.1f ms (%d polls)\n", seen.mcs, ms, polls);
+        } else {
+            printf("[verify] Last TX Rate not at MCS%d after %.1f ms (last seen: MCS%d); "
+                   "no traffic on the link?\n", rate.mcs, ms, seen.mcs);
+            rc = 2;
+        }
+    }
+
+    mtk_iwpriv_close(&p);
+    return rc;
+}
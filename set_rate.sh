@@ -14,6 +14,17 @@
 
 set -e
 
+# Native backend: one ioctl, readback with backoff instead of sleep 1 + grep.
+# It exits 2 when the rate was applied but Last TX Rate never showed it (idle
+# link); this script only ever reported that, so keep exiting 0 for set -e callers.
+SET_RATE_BIN="${SET_RATE_BIN:-/usr/sbin/set_rate}"
+if [ -x "$SET_RATE_BIN" ]; then
+  rc=0
+  "$SET_RATE_BIN" "$@" || rc=$?
+  [ "$rc" -eq 2 ] && rc=0
+  exit "$rc"
+fi
+
 err(){ echo "[set_rate] ERROR: $*" >&2; exit 1; }
 usage(){ echo "Usage: $0 <if> <mcs 0..32> [20|40] [sgi 0|1] [wcid] [stbc 0|1] [ldpc 0|1]" >&2; exit 1; }
 
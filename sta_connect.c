@@ -0,0 +1,618 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mtk_iwpriv.h"
+
+/*
+ * sta_connect: native replacement for connect_sta.sh.
+ *
+ * ApCli backend (default): configures the MTK ApCli with direct iwpriv ioctls
+ * and waits for the AP address over rtnetlink (wireless events) instead of
+ * sleeping. wpa_supplicant backend (-w): drives the control socket and
+ * timestamps its events, which gives the full scan/auth/assoc/4-way split.
+ * The last BSSID and channel per SSID are cached for a directed attempt next
+ * time; if that does not connect quickly, a full scan follows.
+ */
+
+#define CACHE_PATH "/tmp/sta_connect.cache"   /* STA_CONNECT_CACHE overrides it (tests) */
+#define WPAS_CTRL_DIR "/var/run/wpa_supplicant"
+
+enum phase { PH_CONFIG, PH_SCAN, PH_AUTH, PH_ASSOC, PH_4WAY, PH_LINK, PH_DHCP, PH_COUNT };
+static const char *const phase_names[PH_COUNT] = {
+    "config", "scan", "auth", "assoc", "4way", "link", "dhcp",
+};
+
+struct options {
+    const char *ssid;
+    const char *psk;
+    const char *bssid;
+    const char *ifname;
+    const char *ctrl_dir;
+    const char *mock;
+    int band;
+    bool mixed;
+    bool wpas;
+    bool dhcp;
+    bool use_cache;
+    int timeout_ms;
+    int directed_ms;
+};
+
+struct cache_entry {
+    char bssid[18];
+    int channel;          /* ApCli: channel number; wpa_supplicant: MHz */
+};
+
+struct timing {
+    long ms[PH_COUNT];    /* -1 = not observed */
+    bool directed;
+    bool fell_back;
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [options] SSID PSK\n"
+        "  -b, --bssid MAC     Lock to this AP\n"
+        "  -B, --band 5|2      Preferred band for the ApCli interface (default: 5)\n"
+        "  -m, --mixed         WPA1WPA2 + TKIPAES instead of WPA2PSK + AES\n"
+        "  -i, --ifname IF     STA interface (default: apclii0, then apcli0)\n"
+        "  -w, --wpas          Use wpa_supplicant's control interface instead of iwpriv\n"
+        "  -C, --ctrl DIR      wpa_supplicant control directory (default: " WPAS_CTRL_DIR ")\n"
+        "  -M, --mock FILE     ApCli mock: log iwpriv sets to FILE, read FILE.ap (see mtk_iwpriv.h)\n"
+        "  -t, --timeout MS    Give up association after MS (default: 15000)\n"
+        "  -N, --no-dhcp       Skip DHCP\n"
+        "  -n, --no-cache      Ignore the cached BSSID/channel\n",
+        argv0);
+}
+
+static bool if_exists(const char *ifname) {
+    return if_nametoindex(ifname) != 0;
+}
+
+static const char *cache_path(void) {
+    const char *env = getenv("STA_CONNECT_CACHE");
+    return env && *env ? env : CACHE_PATH;
+}
+
+static int cache_load(const char *ifname, const char *ssid, struct cache_entry *out) {
+    FILE *fp = fopen(cache_path(), "r");
+    if (!fp) return -1;
+    char line[256], ifn[IFNAMSIZ + 1], bssid[18];
+    int channel, rc = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        /* ifname bssid channel ssid (ssid last so it may contain spaces) */
+        int off = 0;
+        if (sscanf(line, "%16s %17s %d %n", ifn, bssid, &channel, &off) != 3 || !off) continue;
+        char *s = line + off;
+        s[strcspn(s, "\n")] = '\0';
+        if (strcmp(ifn, ifname) == 0 && strcmp(s, ssid) == 0) {
+            memcpy(out->bssid, bssid, sizeof(out->bssid));
+            out->channel = channel;
+            rc = 0;
+        }
+    }
+    fclose(fp);
+    return rc;
+}
+
+static void cache_store(const char *ifname, const char *ssid, const struct cache_entry *e) {
+    char lines[16][256];
+    int n = 0;
+    FILE *fp = fopen(cache_path(), "r");
+    if (fp) {
+        char line[256], ifn[IFNAMSIZ + 1], bssid[18];
+        int channel, off;
+        while (n < 15 && fgets(line, sizeof(line), fp)) {
+            off = 0;
+            if (sscanf(line, "%16s %17s %d %n", ifn, bssid, &channel, &off) == 3 && off) {
+                char *s = line + off;
+                s[strcspn(s, "\n")] = '\0';
+                if (strcmp(ifn, ifname) == 0 && strcmp(s, ssid) == 0) continue;
+                snprintf(lines[n++], sizeof(lines[0]), "%s %s %d %s\n", ifn, bssid, channel, s);
+            }
+        }
+        fclose(fp);
+    }
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d", cache_path(), (int)getpid());
+    fp = fopen(tmp, "w");
+    if (!fp) return;
+    fprintf(fp, "%s %s %d %s\n", ifname, e->bssid, e->channel, ssid);
+    for (int i = 0; i < n; i++) fputs(lines[i], fp);
+    fclose(fp);
+    rename(tmp, cache_path());
+}
+
+static int open_rtnl(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK };
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Runs udhcpc in the foreground until it has a lease (or gives up). */
+static long run_dhcp(const char *ifname) {
+    uint64_t start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execlp("udhcpc", "udhcpc", "-i", ifname, "-f", "-q", "-n", "-t", "5", "-T", "1", (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return (long)(now_ms() - start);
+}
+
+/* ---- ApCli backend ---- */
+
+static int apcli_configure(struct mtk_iwpriv *p, const struct options *o,
+                           const char *bssid, int channel) {
+    const char *auth = o->mixed ? "WPA1WPA2" : "WPA2PSK";
+    const char *enc = o->mixed ? "TKIPAES" : "AES";
+    struct { const char *key, *value; } sets[] = {
+        { "ApCliEnable", "0" },
+        { "ApCliAuthMode", auth },
+        { "ApCliEncrypType", enc },
+        { "ApCliSsid", o->ssid },
+        { "ApCliWPAPSK", o->psk },
+        { "ApCliBssid", bssid ? bssid : "00:00:00:00:00:00" },
+    };
+    for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        if (mtk_iwpriv_set(p, sets[i].key, sets[i].value) < 0) {
+            fprintf(stderr, "[sta] iwpriv %s set %s failed: %s\n", p->ifname, sets[i].key, strerror(errno));
+            return -1;
+        }
+    }
+    if (channel > 0) {
+        char ch[12];
+        snprintf(ch, sizeof(ch), "%d", channel);
+        mtk_iwpriv_set(p, "Channel", ch);
+    }
+    if (!p->mock && mtk_iwpriv_if_up(p, 1) < 0) {
+        fprintf(stderr, "[sta] bringing %s up failed: %s\n", p->ifname, strerror(errno));
+        return -1;
+    }
+    return mtk_iwpriv_set(p, "ApCliEnable", "1");
+}
+
+/*
+ * Waits for SIOCGIWAP to report an AP, then for IFF_RUNNING. The driver's
+ * wireless events arrive as RTM_NEWLINK, which wakes us; the 200 ms re-check
+ * only covers builds that do not emit them.
+ */
+static int apcli_wait(struct mtk_iwpriv *p, int rtnl, uint64_t start, int timeout_ms,
+                      long *assoc_ms, long *link_ms) {
+    char buf[4096];
+    uint8_t bssid[6];
+    *assoc_ms = -1;
+    *link_ms = -1;
+    for (;;) {
+        uint64_t now = now_ms();
+        if (*assoc_ms < 0 && mtk_iwpriv_get_bssid(p, bssid) == 1) *assoc_ms = (long)(now - start);
+        if (*assoc_ms >= 0) {
+            int flags = p->mock ? IFF_RUNNING : mtk_iwpriv_if_flags(p);
+            if (flags >= 0 && (flags & IFF_RUNNING)) {
+                *link_ms = (long)(now - start);
+                return 0;
+            }
+        }
+        long remaining = (long)timeout_ms - (long)(now - start);
+        if (remaining <= 0) return -1;
+        struct pollfd pfd = { .fd = rtnl, .events = POLLIN };
+        int rc = poll(&pfd, rtnl >= 0 ? 1 : 0, remaining < 200 ? (int)remaining : 200);
+        if (rc < 0 && errno != EINTR) return -1;
+        if (rc > 0) {
+            while (recv(rtnl, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+    }
+}
+
+static int connect_apcli(const struct options *o, const char *ifname, struct timing *t) {
+    struct mtk_iwpriv p;
+    if (mtk_iwpriv_open(&p, ifname, o->mock) != 0) {
+        fprintf(stderr, "[sta] cannot open %s: %s\n", ifname, strerror(errno));
+        return -1;
+    }
+    int rtnl = open_rtnl();
+
+    struct cache_entry cached;
+    const char *bssid = o->bssid;
+    int channel = 0;
+    if (!bssid && o->use_cache && cache_load(ifname, o->ssid, &cached) == 0) {
+        bssid = cached.bssid;
+        channel = cached.channel;
+        t->directed = true;
+    }
+
+    int rc = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint64_t start = now_ms();
+        if (apcli_configure(&p, o, bssid, channel) != 0) break;
+        uint64_t configured = now_ms();
+        t->ms[PH_CONFIG] = (long)(configured - start);
+
+        long assoc, link;
+        int budget = t->directed && attempt == 0 ? o->directed_ms : o->timeout_ms;
+        if (apcli_wait(&p, rtnl, configured, budget, &assoc, &link) == 0) {
+            /* ApCli does scan+auth+assoc internally; only AP-known and carrier are visible. */
+            t->ms[PH_ASSOC] = assoc;
+            t->ms[PH_LINK] = link - assoc;
+            rc = 0;
+            break;
+        }
+        if (!t->directed || attempt > 0 || o->bssid) {
+            fprintf(stderr, "[sta] no association on %s within %d ms\n", ifname, budget);
+            break;
+        }
+        fprintf(stderr, "[sta] cached AP %s not found, doing a full scan\n", bssid);
+        bssid = NULL;
+        channel = 0;
+        t->fell_back = true;
+    }
+
+    if (rc == 0) {
+        uint8_t mac[6];
+        struct cache_entry e = { .channel = mtk_iwpriv_get_channel(&p) };
+        if (mtk_iwpriv_get_bssid(&p, mac) == 1 && e.channel > 0) {
+            snprintf(e.bssid, sizeof(e.bssid), "%02x:%02x:%02x:%02x:%02x:%02x",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            cache_store(ifname, o->ssid, &e);
+            printf("[sta] associated to %s on channel %d\n", e.bssid, e.channel);
+        }
+    }
+    if (rtnl >= 0) close(rtnl);
+    mtk_iwpriv_close(&p);
+    return rc;
+}
+
+/* ---- wpa_supplicant backend ---- */
+
+struct wpas {
+    int fd;
+    char local[108];
+};
+
+static int wpas_open(struct wpas *w, const char *dir, const char *ifname) {
+    w->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (w->fd < 0) return -1;
+    struct sockaddr_un local = { .sun_family = AF_UNIX };
+    snprintf(w->local, sizeof(w->local), "/tmp/sta_connect-%d", (int)getpid());
+    memcpy(local.sun_path, w->local, strlen(w->local) + 1);
+    unlink(w->local);
+    if (bind(w->fd, (struct sockaddr *)&local, sizeof(local)) < 0) return -1;
+
+    struct sockaddr_un dest = { .sun_family = AF_UNIX };
+    int n = snprintf(dest.sun_path, sizeof(dest.sun_path), "%s/%s", dir, ifname);
+    if (n < 0 || (size_t)n >= sizeof(dest.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return connect(w->fd, (struct sockaddr *)&dest, sizeof(dest));
+}
+
+static void wpas_close(struct wpas *w) {
+    if (w->fd >= 0) close(w->fd);
+    unlink(w->local);
+}
+
+/* Unsolicited messages start with "<level>"; replies do not. */
+static bool wpas_is_event(const char *msg) {
+    return msg[0] == '<';
+}
+
+struct wpas_events {
+    uint64_t start;
+    uint64_t scan_start, scan_done, auth, assoc_try, associated, key_done, connected;
+    char bssid[18];
+    int disconnects;
+};
+
+static void wpas_event(struct wpas_events *ev, const char *msg) {
+    const char *body = strchr(msg, '>');
+    body = body ? body + 1 : msg;
+    uint64_t now = now_ms();
+    if (strncmp(body, "CTRL-EVENT-SCAN-STARTED", 23) == 0) {
+        if (!ev->scan_start) ev->scan_start = now;
+    } else if (strncmp(body, "CTRL-EVENT-SCAN-RESULTS", 23) == 0) {
+        ev->scan_done = now;
+    } else if (strncmp(body, "SME: Trying to authenticate", 27) == 0) {
+        ev->auth = now;
+    } else if (strncmp(body, "Trying to associate", 19) == 0) {
+        ev->assoc_try = now;
+    } else if (strncmp(body, "Associated with", 15) == 0) {
+        ev->associated = now;
+    } else if (strncmp(body, "WPA: Key negotiation completed", 30) == 0) {
+        ev->key_done = now;
+    } else if (strncmp(body, "CTRL-EVENT-CONNECTED", 20) == 0) {
+        ev->connected = now;
+        const char *to = strstr(body, "Connection to ");
+        if (to) sscanf(to + 14, "%17s", ev->bssid);
+    } else if (strncmp(body, "CTRL-EVENT-DISCONNECTED", 23) == 0) {
+        ev->disconnects++;
+    }
+}
+
+static int wpas_request(struct wpas *w, struct wpas_events *ev, const char *cmd,
+                        char *reply, size_t len) {
+    if (send(w->fd, cmd, strlen(cmd), 0) < 0) return -1;
+    uint64_t deadline = now_ms() + 2000;
+    for (;;) {
+        long remaining = (long)(deadline - now_ms());
+        if (remaining <= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+        if (poll(&pfd, 1, (int)remaining) <= 0) continue;
+        ssize_t n = recv(w->fd, reply, len - 1, 0);
+        if (n < 0) return -1;
+        reply[n] = '\0';
+        if (wpas_is_event(reply)) {
+            wpas_event(ev, reply);
+            continue;
+        }
+        return (int)n;
+    }
+}
+
+static int wpas_cmd_ok(struct wpas *w, struct wpas_events *ev, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static int wpas_cmd_ok(struct wpas *w, struct wpas_events *ev, const char *fmt, ...) {
+    char cmd[256], reply[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(cmd, sizeof(cmd), fmt, ap);
+    va_end(ap);
+    if (wpas_request(w, ev, cmd, reply, sizeof(reply)) < 0) {
+        fprintf(stderr, "[sta] wpa_supplicant: %.*s: %s\n", (int)strcspn(cmd, " "), cmd, strerror(errno));
+        return -1;
+    }
+    if (strncmp(reply, "OK", 2) != 0) {
+        fprintf(stderr, "[sta] wpa_supplicant: %.*s: %s", (int)strcspn(cmd, " "), cmd, reply);
+        return -1;
+    }
+    return 0;
+}
+
+static int wpas_configure(struct wpas *w, struct wpas_events *ev, const struct options *o,
+                          const char *bssid, int freq, int *net_id) {
+    char reply[64];
+    if (wpas_cmd_ok(w, ev, "REMOVE_NETWORK all") != 0) return -1;
+    if (wpas_request(w, ev, "ADD_NETWORK", reply, sizeof(reply)) < 0) return -1;
+    *net_id = atoi(reply);
+    int id = *net_id;
+    if (wpas_cmd_ok(w, ev, "SET_NETWORK %d ssid \"%s\"", id, o->ssid) != 0 ||
+        wpas_cmd_ok(w, ev, "SET_NETWORK %d psk \"%s\"", id, o->psk) != 0 ||
+        wpas_cmd_ok(w, ev, "SET_NETWORK %d key_mgmt WPA-PSK", id) != 0) {
+        return -1;
+    }
+    if (o->mixed) {
+        if (wpas_cmd_ok(w, ev, "SET_NETWORK %d proto WPA RSN", id) != 0 ||
+            wpas_cmd_ok(w, ev, "SET_NETWORK %d pairwise CCMP TKIP", id) != 0) {
+            return -1;
+        }
+    }
+    if (bssid && wpas_cmd_ok(w, ev, "SET_NETWORK %d bssid %s", id, bssid) != 0) return -1;
+    if (freq > 0 && wpas_cmd_ok(w, ev, "SET_NETWORK %d scan_freq %d", id, freq) != 0) return -1;
+    return wpas_cmd_ok(w, ev, "SELECT_NETWORK %d", id);
+}
+
+static int wpas_wait(struct wpas *w, struct wpas_events *ev, int timeout_ms) {
+    char msg[512];
+    for (;;) {
+        if (ev->connected) return 0;
+        long remaining = (long)timeout_ms - (long)(now_ms() - ev->start);
+        if (remaining <= 0) return -1;
+        struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+        int rc = poll(&pfd, 1, (int)remaining);
+        if (rc < 0 && errno != EINTR) return -1;
+        if (rc <= 0) continue;
+        ssize_t n = recv(w->fd, msg, sizeof(msg) - 1, 0);
+        if (n <= 0) continue;
+        msg[n] = '\0';
+        if (wpas_is_event(msg)) wpas_event(ev, msg);
+    }
+}
+
+static long span(uint64_t from, uint64_t to) {
+    return from && to && to >= from ? (long)(to - from) : -1;
+}
+
+static void wpas_fill_timing(const struct wpas_events *ev, uint64_t configured, struct timing *t) {
+    uint64_t assoc_start = ev->assoc_try ? ev->assoc_try : ev->auth;
+    t->ms[PH_SCAN] = span(ev->scan_start ? ev->scan_start : configured, ev->scan_done);
+    t->ms[PH_AUTH] = span(ev->auth, ev->assoc_try);
+    t->ms[PH_ASSOC] = span(assoc_start, ev->associated);
+    t->ms[PH_4WAY] = span(ev->associated, ev->key_done ? ev->key_done : ev->connected);
+}
+
+static int connect_wpas(const struct options *o, const char *ifname, struct timing *t) {
+    struct wpas w = { .fd = -1 };
+    struct wpas_events ev;
+    memset(&ev, 0, sizeof(ev));
+    if (wpas_open(&w, o->ctrl_dir, ifname) != 0) {
+        fprintf(stderr, "[sta] cannot reach wpa_supplicant at %s/%s: %s\n",
+                o->ctrl_dir, ifname, strerror(errno));
+        wpas_close(&w);
+        return -1;
+    }
+    if (wpas_cmd_ok(&w, &ev, "ATTACH") != 0) {
+        wpas_close(&w);
+        return -1;
+    }
+
+    struct cache_entry cached;
+    const char *bssid = o->bssid;
+    int freq = 0;
+    if (!bssid && o->use_cache && cache_load(ifname, o->ssid, &cached) == 0) {
+        bssid = cached.bssid;
+        freq = cached.channel;
+        t->directed = true;
+    }
+
+    int rc = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        memset(&ev, 0, sizeof(ev));
+        uint64_t start = now_ms();
+        int net_id;
+        if (wpas_configure(&w, &ev, o, bssid, freq, &net_id) != 0) break;
+        uint64_t configured = now_ms();
+        t->ms[PH_CONFIG] = (long)(configured - start);
+        ev.start = configured;
+
+        int budget = t->directed && attempt == 0 ? o->directed_ms : o->timeout_ms;
+        if (wpas_wait(&w, &ev, budget) == 0) {
+            wpas_fill_timing(&ev, configured, t);
+            rc = 0;
+            break;
+        }
+        if (!t->directed || attempt > 0 || o->bssid) {
+            fprintf(stderr, "[sta] no connection on %s within %d ms (%d disconnects)\n",
+                    ifname, budget, ev.disconnects);
+            break;
+        }
+        fprintf(stderr, "[sta] cached AP %s not found, doing a full scan\n", bssid);
+        bssid = NULL;
+        freq = 0;
+        t->fell_back = true;
+    }
+
+    if (rc == 0) {
+        char status[1024];
+        struct cache_entry e = {0};
+        if (wpas_request(&w, &ev, "STATUS", status, sizeof(status)) > 0) {
+            const char *f = strstr(status, "\nfreq=");
+            if (f) e.channel = atoi(f + 6);
+        }
+        if (ev.bssid[0] && e.channel > 0) {
+            snprintf(e.bssid, sizeof(e.bssid), "%s", ev.bssid);
+            cache_store(ifname, o->ssid, &e);
+            printf("[sta] associated to %s on %d MHz\n", e.bssid, e.channel);
+        }
+    }
+    wpas_cmd_ok(&w, &ev, "DETACH");
+    wpas_close(&w);
+    return rc;
+}
+
+static void print_timing(const struct timing *t, long total) {
+    printf("[sta] timing (ms):");
+    for (int i = 0; i < PH_COUNT; i++) {
+        if (t->ms[i] >= 0) printf(" %s=%ld", phase_names[i], t->ms[i]);
+        else printf(" %s=-", phase_names[i]);
+    }
+    printf(" total=%ld%s%s\n", total, t->directed ? " directed" : "",
+           t->fell_back ? " fallback-scan" : "");
+}
+
+int main(int argc, char **argv) {
+    struct options o = {
+        .ctrl_dir = WPAS_CTRL_DIR,
+        .band = 5,
+        .dhcp = true,
+        .use_cache = true,
+        .timeout_ms = 15000,
+        .directed_ms = 3000,
+    };
+
+    static struct option long_opts[] = {
+        {"bssid",    required_argument, 0, 'b'},
+        {"band",     required_argument, 0, 'B'},
+        {"mixed",    no_argument,       0, 'm'},
+        {"ifname",   required_argument, 0, 'i'},
+        {"wpas",     no_argument,       0, 'w'},
+        {"ctrl",     required_argument, 0, 'C'},
+        {"mock",     required_argument, 0, 'M'},
+        {"timeout",  required_argument, 0, 't'},
+        {"no-dhcp",  no_argument,       0, 'N'},
+        {"no-cache", no_argument,       0, 'n'},
+        {"help",     no_argument,       0, 'h'},
+        {0,0,0,0}
+    };
+    for (;;) {
+        int opt, idx = 0;
+        opt = getopt_long(argc, argv, "b:B:mi:wC:M:t:Nnh", long_opts, &idx);
+        if (opt == -1) break;
+        switch (opt) {
+            case 'b': o.bssid = optarg; break;
+            case 'B': o.band = atoi(optarg); break;
+            case 'm': o.mixed = true; break;
+            case 'i': o.ifname = optarg; break;
+            case 'w': o.wpas = true; break;
+            case 'C': o.ctrl_dir = optarg; break;
+            case 'M': o.mock = optarg; break;
+            case 't': o.timeout_ms = atoi(optarg); break;
+            case 'N': o.dhcp = false; break;
+            case 'n': o.use_cache = false; break;
+            case 'h': usage(argv[0]); return 0;
+            default:  usage(argv[0]); return 2;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    o.ssid = argv[optind];
+    o.psk = argv[optind + 1];
+    if (o.directed_ms > o.timeout_ms) o.directed_ms = o.timeout_ms;
+
+    const char *ifname = o.ifname;
+    if (!ifname) {
+        bool have5 = if_exists("apclii0"), have24 = if_exists("apcli0");
+        if (o.band == 2 && have24) ifname = "apcli0";
+        else if (have5) ifname = "apclii0";
+        else if (have24) ifname = "apcli0";
+        else {
+            fprintf(stderr, "No ApCli interface found (apclii0/apcli0).\n");
+            return 3;
+        }
+    }
+    printf("[sta] Using STA interface: %s (%s)\n", ifname, o.wpas ? "wpa_supplicant" : "ApCli");
+
+    struct timing t;
+    for (int i = 0; i < PH_COUNT; i++) t.ms[i] = -1;
+    t.directed = false;
+    t.fell_back = false;
+
+    uint64_t start = now_ms();
+    int rc = o.wpas ? connect_wpas(&o, ifname, &t) : connect_apcli(&o, ifname, &t);
+    if (rc == 0 && o.dhcp) {
+        t.ms[PH_DHCP] = run_dhcp(ifname);
+        if (t.ms[PH_DHCP] < 0) fprintf(stderr, "[sta] DHCP on %s failed\n", ifname);
+    }
+    print_timing(&t, (long)(now_ms() - start));
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#!/bin/sh
+# hwsim_rig.sh -- Run wifi_metrics_sender against mac80211_hwsim, no Wi-Fi hardware needed
+# Usage:
+#   hwsim_rig.sh [--sender PATH] [--feed PATH] [--out FILE] [--secs N] [--keep]
+# Examples:
+#   hwsim_rig.sh                                  # binaries from ./, results to ./hwsim-results.tsv
+#   hwsim_rig.sh --sender /tmp/wms --secs 20
+#
+# Loads mac80211_hwsim with two radios, puts an open AP (hostapd) and a STA
+# (wpa_supplicant) in separate network namespaces, and runs the sender on the
+# STA against real nl80211/debugfs station data with osd_feed on the AP side.
+# Measures, and appends one line per run keyed by git commit to --out:
+#   fetch_ms      mean station fetch time (sender's own histogram)
+#   cpu_ms_tick   sender CPU time per tick (utime+stime / ticks)
+#   rssi_react_ms AP txpower step 20 -> 0 dBm until the RSSI score drops 10 points
+#   rtt_react_ms  netem delay 50ms on the AP until probe RTT p90 >= 40 ms
+#   loss_react_ms netem loss 30% on both sides until probe loss >= 15 %; the
+#                 run fails if it never gets there
+#   fec_recovered samples osd_feed filled in from the sender's -e 3 repeats;
+#                 the run fails if the loss step recovered none
+#   feed_avg_us / feed_max_us  osd_feed sample->OSD forward latency (-L)
+# Needs root, mac80211_hwsim, sch_netem, hostapd, wpa_supplicant, iw, tc,
+# ping, curl and python3 (stand-in OSD socket reader).
+
+set -e
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+SENDER="$DIR/wifi_metrics_sender"
+FEED="$DIR/osd_feed"
+OUT="./hwsim-results.tsv"
+SECS=10
+KEEP=0
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --sender) SENDER="$2"; shift 2 ;;
+    --feed)   FEED="$2";   shift 2 ;;
+    --out)    OUT="$2";    shift 2 ;;
+    --secs)   SECS="$2";   shift 2 ;;
+    --keep)   KEEP=1;      shift 1 ;;
+    *) echo "Unknown arg: $1" >&2; exit 2 ;;
+  esac
+done
+
+[ "$(id -u)" -eq 0 ] || { echo "Run as root" >&2; exit 2; }
+for t in hostapd wpa_supplicant iw tc ping curl python3; do
+  command -v "$t" >/dev/null 2>&1 || { echo "Missing tool: $t" >&2; exit 2; }
+done
+[ -x "$SENDER" ] || { echo "Sender not found: $SENDER" >&2; exit 2; }
+[ -x "$FEED" ]   || { echo "osd_feed not found: $FEED" >&2; exit 2; }
+
+NS_AP=wm-ap
+NS_STA=wm-sta
+AP_IP=10.77.0.1
+STA_IP=10.77.0.2
+PORT=5005
+EXPORTER=127.0.0.1:9100
+TMP=$(mktemp -d /tmp/hwsim-rig.XXXXXX)
+PIDS=""
+
+cleanup() {
+  for p in $PIDS; do kill "$p" 2>/dev/null || true; done
+  sleep 0.3
+  ip netns del $NS_AP 2>/dev/null || true
+  ip netns del $NS_STA 2>/dev/null || true
+  [ $KEEP -eq 1 ] || rmmod mac80211_hwsim 2>/dev/null || true
+  [ $KEEP -eq 1 ] && echo "[rig] logs kept in $TMP" || rm -rf "$TMP"
+}
+trap cleanup EXIT INT TERM
+
+now_ms() { date +%s%3N; }
+in_ap()  { ip netns exec $NS_AP "$@"; }
+in_sta() { ip netns exec $NS_STA "$@"; }
+
+# First sample of a metric from the sender's /metrics; $2 narrows by label.
+metric() {
+  in_sta curl -s "http://$EXPORTER/metrics" | grep "^$1[{ ]" | grep -- "${2:-}" | awk '{print $2; exit}'
+}
+
+# Polls until "awk expression on v" holds; prints elapsed ms or "timeout".
+react() {
+  start=$(now_ms)
+  while [ $(( $(now_ms) - start )) -lt 10000 ]; do
+    v=$(metric "$1" "$2")
+    if [ -n "$v" ] && awk -v v="$v" "BEGIN{exit !($3)}"; then
+      echo $(( $(now_ms) - start ))
+      return
+    fi
+    sleep 0.05
+  done
+  echo timeout
+}
+
+# --- radios -----------------------------------------------------------------
+rmmod mac80211_hwsim 2>/dev/null || true
+modprobe mac80211_hwsim radios=2
+sleep 0.5
+set -- $(ls /sys/class/ieee80211 | sort -V | tail -n 2)
+PHY_AP=$1
+PHY_STA=$2
+echo "[rig] hwsim radios: AP=$PHY_AP STA=$PHY_STA"
+
+ip netns add $NS_AP
+ip netns add $NS_STA
+iw phy "$PHY_AP" set netns name $NS_AP
+iw phy "$PHY_STA" set netns name $NS_STA
+IF_AP=$(in_ap iw dev | awk '/Interface/ {print $2; exit}')
+IF_STA=$(in_sta iw dev | awk '/Interface/ {print $2; exit}')
+in_ap ip link set lo up
+in_sta ip link set lo up
+
+cat > "$TMP/hostapd.conf" <<EOF
+interface=$IF_AP
+driver=nl80211
+ssid=wm-rig
+hw_mode=g
+channel=6
+ieee80211n=1
+EOF
+cat > "$TMP/wpa.conf" <<EOF
+network={
+  ssid="wm-rig"
+  key_mgmt=NONE
+}
+EOF
+
+in_ap hostapd -B -P "$TMP/hostapd.pid" "$TMP/hostapd.conf" >"$TMP/hostapd.log"
+PIDS="$PIDS $(cat "$TMP/hostapd.pid")"
+in_sta wpa_supplicant -B -P "$TMP/wpa.pid" -i "$IF_STA" -c "$TMP/wpa.conf" >"$TMP/wpa.log"
+PIDS="$PIDS $(cat "$TMP/wpa.pid")"
+
+i=0
+until in_sta iw dev "$IF_STA" link | grep -q Connected; do
+  i=$((i + 1))
+  [ $i -lt 100 ] || { echo "[rig] STA did not associate" >&2; exit 1; }
+  sleep 0.1
+done
+in_ap ip addr add $AP_IP/24 dev "$IF_AP"
+in_sta ip addr add $STA_IP/24 dev "$IF_STA"
+echo "[rig] $IF_STA associated to $IF_AP"
+
+# --- receiver, traffic, sender ------------------------------------------------
+in_ap python3 -c "
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+s.bind(sys.argv[1])
+while True: s.recv(4096)
+" "$TMP/osd.sock" &
+PIDS="$PIDS $!"
+sleep 0.2
+in_ap "$FEED" -s "$TMP/osd.sock" -b $AP_IP -p $PORT -L >"$TMP/feed.log" 2>&1 &
+FEED_PID=$!
+PIDS="$PIDS $FEED_PID"
+
+in_sta ping -q -i 0.01 -s 1000 $AP_IP >/dev/null 2>&1 &
+PIDS="$PIDS $!"
+
+# ip netns exec remounts /sys for the namespace, which hides debugfs.
+in_sta sh -c "mount -t debugfs none /sys/kernel/debug 2>/dev/null; \
+  exec \"$SENDER\" -d $IF_STA -H $AP_IP -p $PORT -i 100 -k 100 -e 3 -P $EXPORTER" >"$TMP/sender.log" 2>&1 &
+SENDER_PID=$!
+PIDS="$PIDS $SENDER_PID"
+
+echo "[rig] baseline for ${SECS}s"
+sleep 2
+cpu0=$(awk '{print $14 + $15}' /proc/$SENDER_PID/stat)
+ticks0=$(metric wifi_metrics_ticks_total)
+sleep "$SECS"
+cpu1=$(awk '{print $14 + $15}' /proc/$SENDER_PID/stat)
+ticks1=$(metric wifi_metrics_ticks_total)
+hz=$(getconf CLK_TCK)
+CPU_MS=$(awk -v c=$((cpu1 - cpu0)) -v t=$((ticks1 - ticks0)) -v hz="$hz" \
+  'BEGIN{printf "%.3f", t > 0 ? c * 1000 / hz / t : 0}')
+FETCH_MS=$(awk -v s="$(metric wifi_metrics_fetch_seconds_sum)" -v n="$(metric wifi_metrics_fetch_seconds_count)" \
+  'BEGIN{printf "%.3f", n > 0 ? s * 1000 / n : 0}')
+
+echo "[rig] RSSI step"
+in_ap iw dev "$IF_AP" set txpower fixed 2000
+sleep 2
+RSSI0=$(metric wifi_metrics_rssi_score)
+in_ap iw dev "$IF_AP" set txpower fixed 0
+RSSI_MS=$(react wifi_metrics_rssi_score "" "v <= $RSSI0 - 10")
+
+echo "[rig] netem delay step"
+sleep 2
+in_ap tc qdisc add dev "$IF_AP" root netem delay 50ms
+RTT_MS=$(react wifi_metrics_probe_rtt_seconds 'quantile="0.9"' "v >= 0.040")
+in_ap tc qdisc del dev "$IF_AP" root
+
+# The AP side drops probe echoes, the STA side telemetry datagrams on their way to osd_feed.
+echo "[rig] netem loss step"
+sleep 2
+in_ap tc qdisc add dev "$IF_AP" root netem loss 30%
+in_sta tc qdisc add dev "$IF_STA" root netem loss 30%
+LOSS_MS=$(react wifi_metrics_probe_loss_ratio "" "v >= 0.15")
+in_sta tc qdisc del dev "$IF_STA" root
+in_ap tc qdisc del dev "$IF_AP" root
+if [ "$LOSS_MS" = timeout ]; then
+  echo "[rig] FAIL: probe loss stayed at $(metric wifi_metrics_probe_loss_ratio) under netem loss 30%" >&2
+  exit 1
+fi
+
+kill -INT $FEED_PID
+sleep 0.3
+FEED_AVG=$(awk '/latency/ {sub("avg=", "", $5); v=$5} END{print v}' "$TMP/feed.log")
+FEED_MAX=$(awk '/latency/ {sub("max=", "", $7); v=$7} END{print v}' "$TMP/feed.log")
+FEC_RECOVERED=$(awk '/redundancy:/ {sub("recovered=", "", $4); v=$4} END{print v + 0}' "$TMP/feed.log")
+if [ "$FEC_RECOVERED" -eq 0 ]; then
+  echo "[rig] FAIL: osd_feed recovered no samples through netem loss 30% with -e 3" >&2
+  exit 1
+fi
+
+COMMIT=$(git -C "$DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+[ -s "$OUT" ] || printf 'commit\tdate\tkernel\tfetch_ms\tcpu_ms_tick\trssi_react_ms\trtt_react_ms\tfeed_avg_us\tfeed_max_us\tloss_react_ms\tfec_recovered\n' >"$OUT"
+printf '%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n' "$COMMIT" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$(uname -r)" \
+  "$FETCH_MS" "$CPU_MS" "$RSSI_MS" "$RTT_MS" "${FEED_AVG:-na}" "${FEED_MAX:-na}" "$LOSS_MS" "$FEC_RECOVERED" | tee -a "$OUT"
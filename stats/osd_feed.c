@@ -16,6 +16,13 @@
 #include <math.h>
 #include <poll.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "osd_format.h"
 
 static volatile sig_atomic_t g_stop = 0;
 static void on_sigint(int sig) { (void)sig; g_stop = 1; }
@@ -28,32 +35,70 @@ static uint64_t now_ms(void) {
 
 static void usage(const char *argv0) {
     fprintf(stderr,
-        "Usage: %s [-s SOCKET] [-p PORT] [-b ADDR] [-T TTL_MS]\n"
+        "Usage: %s [-s SOCKET] [-p PORT] [-b ADDR] [-T TTL_MS] [-A MS] [-R HZ] [-l LAYOUT] [-L] [-B ROUNDS]\n"
+        "       %s -N WORKERS [-M SOURCES] [-m SHM] [-s 'DIR/%%s.sock'] [-p PORT] [-b ADDR] [-l LAYOUT]\n"
         "  -s, --socket   Path to UNIX DGRAM socket (default: /run/pixelpilot/osd.sock)\n"
         "  -p, --port     UDP port to listen on (default: 5005)\n"
         "  -b, --bind     UDP bind address (default: 0.0.0.0)\n"
-        "  -T, --ttl      Include ttl_ms in JSON (default: 0 = omit)\n",
-        argv0);
-}
-
-static int send_json(int fd, const char *sock_path, const char *json)
-{
-    size_t len = strlen(json);
-    ssize_t sent = send(fd, json, len, 0);
-    if (sent < 0) {
-        fprintf(stderr, "send() to %s failed: %s\n", sock_path, strerror(errno));
-        return -1;
-    }
-    return 0;
+        "  -T, --ttl      Include ttl_ms in JSON (default: 0 = omit)\n"
+        "  -A, --alert    How long an event alert stays on the OSD (default: 3000 ms)\n"
+        "  -R, --rate     Publish at HZ, extrapolating between samples and fading stale values\n"
+        "                 (default: 0 = only when a sample arrives)\n"
+        "  -l, --layout   OSD layout file: entries, labels, precision, counters\n"
+        "  -L, --latency  Report sample->OSD latency from the sender's t_us (same host only)\n"
+        "  -B, --bench    Time ROUNDS payload builds (snprintf vs. template) and exit\n"
+        "Server mode, many senders into one host:\n"
+        "  -N, --workers  Ingest threads, one SO_REUSEPORT socket each\n"
+        "  -M, --max-sources  Source slots (default: 4096)\n"
+        "  -m, --shm      Shared-memory snapshot (default: /dev/shm/osd_feed)\n"
+        "  -s with %%s    Also publish each source to its own socket, %%s = addr_port\n",
+        argv0, argv0);
 }
 
 #define MAX_ENTRIES 8
 
+/* The last two samples of an entry; t_us is the sender's clock (0 if not sent). */
 struct metric_entry {
     char label[64];
     double value;
+    double prev_value;
+    uint64_t t_ms, prev_t_ms;
+    double t_us, prev_t_us;
 };
 
+static void entry_set(struct metric_entry *e, double value, uint64_t now, double t_us) {
+    e->prev_value = e->value;
+    e->prev_t_ms = e->t_ms;
+    e->prev_t_us = e->t_us;
+    e->value = value;
+    e->t_ms = now;
+    e->t_us = t_us;
+}
+
+/*
+ * -R value at now: continues the last step for at most one sample interval
+ * (sender timestamps when both samples have them), then holds. Past
+ * fade_after_ms without data it decays toward 0 with time constant fade_ms
+ * instead of dropping there in one frame.
+ */
+static double entry_render(const struct metric_entry *e, uint64_t now, uint64_t fade_after_ms, double fade_ms) {
+    double v = e->value;
+    if (e->prev_t_ms && e->t_ms > e->prev_t_ms) {
+        double dt = e->prev_t_us > 0.0 && e->t_us > e->prev_t_us ? (e->t_us - e->prev_t_us) / 1000.0
+                                                                   : (double)(e->t_ms - e->prev_t_ms);
+        double ahead = (double)(now - e->t_ms);
+        if (ahead > dt) ahead = dt;
+        v += (e->value - e->prev_value) * ahead / dt;
+        /* Scores never leave 0..100, so neither does their extrapolation. */
+        if (e->value >= 0.0 && e->value <= 100.0 && e->prev_value >= 0.0 && e->prev_value <= 100.0) {
+            v = v < 0.0 ? 0.0 : v > 100.0 ? 100.0 : v;
+        }
+    }
+    uint64_t age = now - e->t_ms;
+    if (age > fade_after_ms) v *= exp(-(double)(age - fade_after_ms) / fade_ms);
+    return v;
+}
+
 struct snapshot_entry {
     char label[64];
     double value;
@@ -190,65 +235,364 @@ static size_t extract_known_metrics(const char *payload, char labels[][64], doub
     return count;
 }
 
-static int build_osd_payload(const char *texts[], const double values[],
-                             const bool present[], size_t count,
-                             int ttl_ms, char *out, size_t out_len) {
-    char text_part[256] = "[";
-    char value_part[256] = "[";
-    size_t text_off = 1;
-    size_t value_off = 1;
-    bool first = true;
-    for (size_t i = 0; i < count; i++) {
-        if (!present[i]) continue;
-        if (!texts[i]) continue;
-        if (!first) {
-            if (text_off + 1 >= sizeof(text_part) || value_off + 1 >= sizeof(value_part)) {
-                return -1;
+/*
+ * Datagrams tagged with "type" are side channels from the sender. Only
+ * "fast" (the nl80211 RSSI path) carries OSD values; it updates the
+ * matching entries in place instead of replacing the whole set.
+ */
+static bool payload_has_type(const char *payload, const char *type) {
+    char pattern[48];
+    if (!type) return strstr(payload, "\"type\":") != NULL;
+    snprintf(pattern, sizeof(pattern), "\"type\":\"%s\"", type);
+    return strstr(payload, pattern) != NULL;
+}
+
+/* "event" datagrams from the sender's priority lane become a temporary OSD entry. */
+struct osd_alert {
+    char text[64];
+    double value;
+    uint64_t until_ms;
+    double last_seq;
+    bool shown;
+};
+
+static bool parse_string_field(const char *payload, const char *key, char *out, size_t len) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *pos = strstr(payload, pattern);
+    if (!pos) return false;
+    pos += strlen(pattern);
+    size_t n = 0;
+    while (pos[n] && pos[n] != '"' && n + 1 < len) {
+        out[n] = pos[n];
+        n++;
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+static bool handle_event(const char *payload, struct osd_alert *alert, uint64_t now, int alert_ms) {
+    char event[32];
+    double seq = -1.0;
+    if (!parse_string_field(payload, "event", event, sizeof(event))) return false;
+    if (parse_metric(payload, "seq", &seq) && seq == alert->last_seq) return false;
+    alert->last_seq = seq;
+
+    snprintf(alert->text, sizeof(alert->text), "%s", osd_event_text(event));
+    if (!parse_metric(payload, "value", &alert->value)) alert->value = 0.0;
+    alert->until_ms = now + (uint64_t)alert_ms;
+    fprintf(stdout, "Event: %s (%.0f)\n", event, alert->value);
+    fflush(stdout);
+    return true;
+}
+
+/*
+ * Sender -e: "seq" numbers routine samples and "red" repeats the previous
+ * ones, newest first, as [seq,age_ms,v...] in the datagram's "text" order
+ * (null where a score was missing). A gap in seq is filled from the first
+ * datagram after it; whatever that one doesn't carry counts as lost.
+ */
+#define FEC_MAX_SAMPLES  8
+
+struct fec_sample {
+    double seq;
+    double age_ms;
+    double values[MAX_ENTRIES];
+    bool have[MAX_ENTRIES];
+};
+
+struct fec_stats {
+    double last_seq;   /* -1 until the first numbered sample */
+    double last_t_us;
+    uint64_t received, recovered, lost, late;
+};
+
+static size_t parse_redundant(const char *payload, struct fec_sample out[], size_t max) {
+    const char *pos = strstr(payload, "\"red\":[");
+    if (!pos) return 0;
+    pos += strlen("\"red\":[");
+    size_t count = 0;
+    while (*pos == '[' && count < max) {
+        struct fec_sample *r = &out[count];
+        memset(r, 0, sizeof(*r));
+        char *end;
+        r->seq = strtod(pos + 1, &end);
+        if (end == pos + 1 || *end != ',') break;
+        pos = end + 1;
+        r->age_ms = strtod(pos, &end);
+        if (end == pos) break;
+        pos = end;
+        for (size_t i = 0; *pos == ','; i++) {
+            pos++;
+            if (strncmp(pos, "null", 4) == 0) {
+                pos += 4;
+                continue;
             }
-            text_part[text_off++] = ',';
-            value_part[value_off++] = ',';
+            double v = strtod(pos, &end);
+            if (end == pos) return count;
+            if (i < MAX_ENTRIES) {
+                r->values[i] = v;
+                r->have[i] = true;
+            }
+            pos = end;
+        }
+        if (*pos != ']') break;
+        pos++;
+        count++;
+        if (*pos == ',') pos++;
+    }
+    return count;
+}
+
+/*
+ * False for a late or repeated sample. On a gap, copies the repeated samples
+ * that fall into it to out[], oldest first, and counts the rest as lost.
+ */
+static bool fec_accept(struct fec_stats *st, const char *payload, struct fec_sample out[], size_t *nout) {
+    *nout = 0;
+    double seq, t_us;
+    if (!parse_metric(payload, "seq", &seq)) return true;
+    if (!parse_metric(payload, "t_us", &t_us)) t_us = 0.0;
+    st->received++;
+    if (st->last_seq >= 0.0 && seq <= st->last_seq) {
+        /* A restarted sender counts from 1 again, but its clock moved on. */
+        if (t_us <= st->last_t_us) {
+            st->late++;
+            return false;
         }
-        int written_text = snprintf(text_part + text_off, sizeof(text_part) - text_off,
-                                    "\"%s\"", texts[i]);
-        if (written_text < 0 || text_off + (size_t)written_text >= sizeof(text_part)) {
-            return -1;
+        st->last_seq = -1.0;
+    }
+    if (st->last_seq >= 0.0 && seq > st->last_seq + 1.0) {
+        struct fec_sample red[FEC_MAX_SAMPLES];
+        size_t n = parse_redundant(payload, red, FEC_MAX_SAMPLES);
+        double after = st->last_seq;
+        for (size_t i = n; i-- > 0;) {
+            if (red[i].seq > after && red[i].seq < seq) {
+                out[(*nout)++] = red[i];
+                after = red[i].seq;
+            }
         }
-        text_off += (size_t)written_text;
+        st->recovered += *nout;
+        st->lost += (uint64_t)(seq - st->last_seq - 1.0) - *nout;
+    }
+    st->last_seq = seq;
+    st->last_t_us = t_us;
+    return true;
+}
 
-        int written_value = snprintf(value_part + value_off, sizeof(value_part) - value_off,
-                                     "%.2f", values[i]);
-        if (written_value < 0 || value_off + (size_t)written_value >= sizeof(value_part)) {
-            return -1;
+static size_t merge_entries(struct metric_entry entries[], size_t count,
+                            char labels[][64], const double values[], size_t n, uint64_t now) {
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = 0;
+        while (j < count && strcmp(entries[j].label, labels[i]) != 0) j++;
+        if (j == count) {
+            if (count == MAX_ENTRIES) continue;
+            memset(&entries[j], 0, sizeof(entries[j]));
+            strncpy(entries[j].label, labels[i], sizeof(entries[j].label) - 1);
+            count++;
         }
-        value_off += (size_t)written_value;
-        first = false;
+        entry_set(&entries[j], values[i], now, 0.0);
     }
+    return count;
+}
+
+/*
+ * -l layout file: one OSD entry per line, in display order,
+ *   METRIC [prec=N] [counter=0|1] [hz=0|1] [label=TEXT TO END OF LINE]
+ * METRIC is the incoming label ("RSSI", "Link", "Host", ...). Defaults are
+ * prec=2 counter=1 hz=1 label=METRIC, which is also what every entry gets
+ * without a layout. Metrics not listed are not shown.
+ */
+struct layout_line {
+    char metric[64];
+    struct osd_item item;
+};
 
-    if (text_off + 1 >= sizeof(text_part) || value_off + 1 >= sizeof(value_part)) {
+struct layout {
+    struct layout_line lines[OSD_TPL_MAX_ITEMS];
+    size_t count;
+};
+
+static void layout_default(struct osd_item *item, const char *label) {
+    memset(item, 0, sizeof(*item));
+    snprintf(item->label, sizeof(item->label), "%s", label);
+    item->precision = 2;
+    item->counter = true;
+    item->rate = true;
+}
+
+static int layout_load(struct layout *l, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "open(%s) failed: %s\n", path, strerror(errno));
         return -1;
     }
-    text_part[text_off++] = ']';
-    text_part[text_off] = '\0';
-    value_part[value_off++] = ']';
-    value_part[value_off] = '\0';
+    char line[256];
+    int lineno = 0, rc = 0;
+    l->count = 0;
+    while (rc == 0 && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p || *p == '#') continue;
+        if (l->count == OSD_TPL_MAX_ITEMS) {
+            fprintf(stderr, "%s:%d: more than %d entries\n", path, lineno, OSD_TPL_MAX_ITEMS);
+            rc = -1;
+            break;
+        }
+        struct layout_line *ll = &l->lines[l->count];
+        size_t n = strcspn(p, " \t");
+        snprintf(ll->metric, sizeof(ll->metric), "%.*s", (int)n, p);
+        layout_default(&ll->item, "");
+        memcpy(ll->item.label, ll->metric, sizeof(ll->item.label));
+        p += n;
+        while (*p) {
+            while (isspace((unsigned char)*p)) p++;
+            if (!*p) break;
+            if (strncmp(p, "label=", 6) == 0) {
+                memset(ll->item.label, 0, sizeof(ll->item.label));
+                snprintf(ll->item.label, sizeof(ll->item.label), "%s", p + 6);
+                break;
+            }
+            n = strcspn(p, " \t");
+            int v;
+            if (sscanf(p, "prec=%d", &v) == 1 && v >= 0 && v <= 4) ll->item.precision = v;
+            else if (sscanf(p, "counter=%d", &v) == 1) ll->item.counter = v != 0;
+            else if (sscanf(p, "hz=%d", &v) == 1) ll->item.rate = v != 0;
+            else {
+                fprintf(stderr, "%s:%d: bad option '%.*s'\n", path, lineno, (int)n, p);
+                rc = -1;
+                break;
+            }
+            p += n;
+        }
+        l->count++;
+    }
+    fclose(fp);
+    return rc;
+}
 
-    if (ttl_ms > 0) {
-        return snprintf(out, out_len,
-                        "{\"text\":%s,\"value\":%s,\"ttl_ms\":%d}\n",
-                        text_part, value_part, ttl_ms);
+/* Items to show, in layout order (or entry order without a layout). */
+static size_t layout_items(const struct layout *l, const struct metric_entry entries[], const bool present[],
+                           const double values[], size_t count, struct osd_item items[], double out[], size_t max) {
+    size_t n = 0;
+    if (!l->count) {
+        for (size_t i = 0; i < count && n < max; ++i) {
+            if (!present[i]) continue;
+            layout_default(&items[n], entries[i].label);
+            out[n++] = values[i];
+        }
+        return n;
     }
-    return snprintf(out, out_len,
-                    "{\"text\":%s,\"value\":%s}\n",
-                    text_part, value_part);
+    for (size_t k = 0; k < l->count && n < max; ++k) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!present[i] || strcmp(entries[i].label, l->lines[k].metric) != 0) continue;
+            items[n] = l->lines[k].item;
+            out[n++] = values[i];
+            break;
+        }
+    }
+    return n;
+}
+
+/* -B: the per-send cost of the old snprintf path vs. the compiled template. */
+static int osd_bench(long rounds) {
+    static const char *labels[] = { "RSSI", "Link", "Queue", "Host", "Link TX", "Link RX" };
+    enum { N = sizeof(labels) / sizeof(labels[0]) };
+    double values[N] = { 84.62, 97.1, 100.0, 63.25, 99.0, 41.5 };
+    struct osd_item items[N];
+    memset(items, 0, sizeof(items));
+    for (size_t i = 0; i < N; i++) layout_default(&items[i], labels[i]);
+    static struct osd_template t;
+    if (rounds <= 0 || osd_template_compile(&t, items, N, 0) != 0) return 1;
+
+    char out_old[1024], out_new[1024];
+    volatile size_t sink = 0;
+    uint64_t t0 = osd_now_us();
+    for (long r = 0; r < rounds; r++) {
+        char text_buf[N][64];
+        const char *texts[N];
+        bool present[N];
+        for (size_t i = 0; i < N; i++) {
+            osd_format_label(text_buf[i], sizeof(text_buf[i]), labels[i], (uint64_t)r, 9.87);
+            texts[i] = text_buf[i];
+            present[i] = true;
+        }
+        values[0] = (double)(r % 10000) / 100.0;
+        sink += (size_t)osd_build_payload(texts, values, present, N, 0, out_old, sizeof(out_old));
+    }
+    uint64_t t1 = osd_now_us();
+    for (long r = 0; r < rounds; r++) {
+        values[0] = (double)(r % 10000) / 100.0;
+        sink += (size_t)osd_template_render(&t, values, (uint64_t)r, 9.87, out_new, sizeof(out_new));
+    }
+    uint64_t t2 = osd_now_us();
+    (void)sink;
+    printf("%zu entries, %ld rounds: snprintf %.0f ns/send, template %.0f ns/send (%zu ops)\n",
+           (size_t)N, rounds, (double)(t1 - t0) * 1000.0 / rounds, (double)(t2 - t1) * 1000.0 / rounds, t.nops);
+    if (strcmp(out_old, out_new) != 0) {
+        fprintf(stderr, "output differs:\n  %s  %s", out_old, out_new);
+        return 1;
+    }
+    return 0;
 }
 
-static int ensure_unix_connection(int *fd, const char *sock_path)
+/*
+ * Reflector for the sender's -k probes: echo at once, small, with the kernel
+ * receive time so packet-train spacing survives a batched read.
+ */
+static void echo_probe(int fd, const char *payload, const struct sockaddr_in *src, uint64_t rx_us)
 {
-    if (*fd >= 0) {
-        return 0;
+    double seq, train, idx, t_us = 0.0;
+    char echo[192];
+    int len;
+    parse_metric(payload, "t_us", &t_us);
+    if (parse_metric(payload, "train", &train) && parse_metric(payload, "idx", &idx)) {
+        len = snprintf(echo, sizeof(echo),
+                       "{\"type\":\"probe_echo\",\"train\":%.0f,\"idx\":%.0f,\"t_us\":%.0f,\"rx_us\":%llu}\n",
+                       train, idx, t_us, (unsigned long long)rx_us);
+    } else if (parse_metric(payload, "seq", &seq)) {
+        len = snprintf(echo, sizeof(echo),
+                       "{\"type\":\"probe_echo\",\"seq\":%.0f,\"t_us\":%.0f,\"rx_us\":%llu}\n",
+                       seq, t_us, (unsigned long long)rx_us);
+    } else {
+        return;
     }
+    if (len > 0 && (size_t)len < sizeof(echo)) {
+        sendto(fd, echo, (size_t)len, 0, (const struct sockaddr *)src, sizeof(*src));
+    }
+}
 
-    int new_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+/*
+ * PixelPilot side: a non-blocking DGRAM socket with a one-slot mailbox.
+ * A payload that can't go out right now (EAGAIN/ENOBUFS: the OSD is behind)
+ * stays in the slot and is retried on POLLOUT; a newer one replaces it
+ * (coalesced) rather than queueing. Only real errors close the socket, and
+ * then the slot is kept for the next connect.
+ */
+struct publisher {
+    const char *path;
+    int fd;
+    char slot[1024];
+    size_t slot_len;
+    bool pending;
+    double slot_t_us;
+    uint64_t last_connect_ms;
+    uint64_t sent, coalesced, retried, dropped, reconnects;
+    struct osd_latency *latency;
+    bool quiet;
+};
+
+#define CONNECT_RETRY_MS 1000
+
+static int publisher_connect(struct publisher *p, uint64_t now)
+{
+    if (p->fd >= 0) return 0;
+    if (p->last_connect_ms != 0 && now - p->last_connect_ms < CONNECT_RETRY_MS) return -1;
+    p->last_connect_ms = now;
+
+    int new_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (new_fd < 0) {
         fprintf(stderr, "socket(AF_UNIX,SOCK_DGRAM) failed: %s\n", strerror(errno));
         return -1;
@@ -257,50 +601,507 @@ static int ensure_unix_connection(int *fd, const char *sock_path)
     struct sockaddr_un addr;
     memset(&addr, 0, sizeof(addr));
     addr.sun_family = AF_UNIX;
-    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
-        fprintf(stderr, "Socket path too long: %s\n", sock_path);
+    if (strlen(p->path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", p->path);
         close(new_fd);
         return -1;
     }
-    strcpy(addr.sun_path, sock_path);
+    strcpy(addr.sun_path, p->path);
 
     if (connect(new_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        fprintf(stderr, "connect(%s) failed: %s\n", sock_path, strerror(errno));
+        fprintf(stderr, "connect(%s) failed: %s\n", p->path, strerror(errno));
         close(new_fd);
         return -1;
     }
 
-    *fd = new_fd;
-    fprintf(stdout, "Connected to UNIX socket %s\n", sock_path);
+    p->fd = new_fd;
+    if (p->sent || p->dropped) p->reconnects++;
+    fprintf(stdout, "Connected to UNIX socket %s\n", p->path);
     fflush(stdout);
     return 0;
 }
 
+static void publisher_print(const struct publisher *p)
+{
+    fprintf(stdout, "[osd_feed] publisher: sent=%llu coalesced=%llu retried=%llu dropped=%llu reconnects=%llu\n",
+            (unsigned long long)p->sent, (unsigned long long)p->coalesced, (unsigned long long)p->retried,
+            (unsigned long long)p->dropped, (unsigned long long)p->reconnects);
+    fflush(stdout);
+}
+
+/* Tries to deliver the slot; true once it is out. */
+static bool publisher_flush(struct publisher *p, uint64_t now)
+{
+    if (!p->pending || publisher_connect(p, now) != 0) return false;
+    if (send(p->fd, p->slot, p->slot_len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR) {
+            p->retried++;
+            return false;
+        }
+        fprintf(stderr, "send() to %s failed: %s\n", p->path, strerror(errno));
+        if (errno == EMSGSIZE) {
+            p->pending = false;
+            p->dropped++;
+            return false;
+        }
+        close(p->fd);
+        p->fd = -1;
+        p->last_connect_ms = now;
+        return false;
+    }
+    p->pending = false;
+    p->sent++;
+    if (p->latency && p->slot_t_us > 0.0) {
+        osd_latency_observe(p->latency, (uint64_t)p->slot_t_us, osd_now_us());
+        if (p->latency->n % 100 == 0) {
+            osd_latency_print(p->latency, "osd_feed");
+            publisher_print(p);
+        }
+    }
+    if (!p->quiet) {
+        fprintf(stdout, "Forwarded: %.*s", (int)p->slot_len, p->slot);
+        fflush(stdout);
+    }
+    return true;
+}
+
+/* Latest value wins: json replaces whatever is still waiting in the slot. */
+static void publisher_offer(struct publisher *p, const char *json, size_t len, double t_us, uint64_t now)
+{
+    if (len > sizeof(p->slot)) {
+        p->dropped++;
+        return;
+    }
+    if (p->pending) p->coalesced++;
+    memcpy(p->slot, json, len);
+    p->slot_len = len;
+    p->slot_t_us = t_us;
+    p->pending = true;
+    publisher_flush(p, now);
+}
+
+/* Poll timeout that also covers a pending reconnect. */
+static int publisher_timeout_ms(const struct publisher *p, uint64_t now, int timeout_ms)
+{
+    if (!p->pending || p->fd >= 0) return timeout_ms;
+    uint64_t due = p->last_connect_ms + CONNECT_RETRY_MS;
+    int left = due > now ? (int)(due - now) : 0;
+    return left < timeout_ms ? left : timeout_ms;
+}
+
+/*
+ * Server mode (-N WORKERS): many drones into one ground station. Each
+ * worker owns one SO_REUSEPORT socket, all bound before any thread starts,
+ * so the kernel's flow hash pins a drone to one worker and each worker's
+ * source table is its own shard: no locks on the ingest path. Workers drain
+ * their socket with recvmmsg and write sources into the shared-memory
+ * snapshot (struct osd_shm) under per-slot seqlocks. The main thread is the
+ * publishing stage: it reads slots lock-free and, when -s contains "%s",
+ * sends each changed drone's text/value datagram to its own socket.
+ */
+#define SERVER_BATCH 64
+#define SERVER_MTU 2048
+
+struct source_ref {
+    uint64_t key; /* (addr << 16 | port) + 1, 0 = empty */
+    uint32_t slot;
+};
+
+struct worker {
+    int fd;
+    pthread_t thread;
+    struct osd_shm *shm;
+    struct source_ref *table;
+    size_t mask;
+    int alert_ms;
+    _Atomic uint64_t datagrams;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t rejected;
+};
+
+/* This worker's slot for src; allocates one on first sight, NULL when full. */
+static struct osd_shm_slot *worker_source(struct worker *w, const struct sockaddr_in *src, uint64_t now)
+{
+    uint64_t key = (((uint64_t)ntohl(src->sin_addr.s_addr) << 16) | ntohs(src->sin_port)) + 1;
+    size_t i = (size_t)(key * 0x9e3779b97f4a7c15ull >> 32) & w->mask;
+    for (size_t probes = 0; probes <= w->mask; probes++, i = (i + 1) & w->mask) {
+        if (w->table[i].key == key) return &w->shm->slot[w->table[i].slot];
+        if (w->table[i].key) continue;
+        uint32_t slot = atomic_fetch_add(&w->shm->used, 1);
+        if (slot >= w->shm->slot_count) {
+            atomic_fetch_sub(&w->shm->used, 1);
+            return NULL;
+        }
+        w->table[i].key = key;
+        w->table[i].slot = slot;
+        struct osd_shm_slot *s = &w->shm->slot[slot];
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &src->sin_addr, ip, sizeof(ip));
+        osd_shm_write_begin(s);
+        snprintf(s->source, sizeof(s->source), "%s:%u", ip, (unsigned)ntohs(src->sin_port));
+        s->t_ms = now;
+        osd_shm_write_end(s);
+        return s;
+    }
+    return NULL;
+}
+
+static void worker_handle(struct worker *w, const struct sockaddr_in *src, const char *buf, uint64_t now)
+{
+    if (payload_has_type(buf, "probe")) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        echo_probe(w->fd, buf, src, (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull);
+        return;
+    }
+    char labels[MAX_ENTRIES][64];
+    double values[MAX_ENTRIES];
+    size_t n = 0;
+    bool event = payload_has_type(buf, "event");
+    bool fast = !event && payload_has_type(buf, "fast");
+    if (fast) {
+        n = extract_known_metrics(buf, labels, values, MAX_ENTRIES);
+    } else if (!event && !payload_has_type(buf, NULL)) {
+        n = extract_text_value_arrays(buf, labels, values, MAX_ENTRIES);
+        if (n == 0) n = extract_known_metrics(buf, labels, values, MAX_ENTRIES);
+    }
+    if (!event && n == 0) return;
+
+    /*
+     * The sender's event lane shares the routine port, but older senders
+     * and relays may not: "src_port" names the routine lane so the alert
+     * lands in that drone's slot instead of a new one.
+     */
+    struct sockaddr_in key = *src;
+    double port;
+    if (event && parse_metric(buf, "src_port", &port) && port >= 1.0 && port <= 65535.0) {
+        key.sin_port = htons((uint16_t)port);
+    }
+    struct osd_shm_slot *s = worker_source(w, &key, now);
+    if (!s) {
+        atomic_fetch_add_explicit(&w->rejected, 1, memory_order_relaxed);
+        return;
+    }
+    osd_shm_write_begin(s);
+    if (event) {
+        char name[32];
+        if (parse_string_field(buf, "event", name, sizeof(name))) {
+            snprintf(s->alert, sizeof(s->alert), "%s", osd_event_text(name));
+            if (!parse_metric(buf, "value", &s->alert_value)) s->alert_value = 0.0;
+            s->alert_until_ms = now + (uint64_t)w->alert_ms;
+        }
+    } else {
+        if (!fast) s->count = 0;
+        for (size_t i = 0; i < n && i < OSD_SHM_ENTRIES; i++) {
+            uint32_t j = 0;
+            while (j < s->count && strncmp(s->label[j], labels[i], sizeof(s->label[j]) - 1) != 0) j++;
+            if (j == s->count) {
+                if (j == OSD_SHM_ENTRIES) continue;
+                snprintf(s->label[j], sizeof(s->label[j]), "%s", labels[i]);
+                s->count++;
+            }
+            s->value[j] = values[i];
+        }
+        if (!fast && !parse_metric(buf, "t_us", &s->t_us)) s->t_us = 0.0;
+    }
+    s->updates++;
+    s->t_ms = now;
+    osd_shm_write_end(s);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    static _Thread_local char bufs[SERVER_BATCH][SERVER_MTU];
+    struct mmsghdr msgs[SERVER_BATCH];
+    struct iovec iov[SERVER_BATCH];
+    struct sockaddr_in src[SERVER_BATCH];
+    for (int i = 0; i < SERVER_BATCH; i++) {
+        iov[i] = (struct iovec){ .iov_base = bufs[i], .iov_len = SERVER_MTU - 1 };
+        msgs[i].msg_hdr = (struct msghdr){ .msg_name = &src[i], .msg_iov = &iov[i], .msg_iovlen = 1 };
+    }
+    while (!g_stop) {
+        for (int i = 0; i < SERVER_BATCH; i++) msgs[i].msg_hdr.msg_namelen = sizeof(src[i]);
+        int n = recvmmsg(w->fd, msgs, SERVER_BATCH, MSG_WAITFORONE, NULL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            fprintf(stderr, "recvmmsg() failed: %s\n", strerror(errno));
+            break;
+        }
+        uint64_t now = now_ms();
+        for (int i = 0; i < n; i++) {
+            bufs[i][msgs[i].msg_len] = '\0';
+            worker_handle(w, &src[i], bufs[i], now);
+        }
+        atomic_fetch_add_explicit(&w->datagrams, (uint64_t)n, memory_order_relaxed);
+        atomic_fetch_add_explicit(&w->batches, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/* Per-drone output socket state, indexed like the shm slots. */
+struct drone_out {
+    int fd;
+    uint32_t seq;
+    uint64_t last_try_ms;
+    uint64_t last_updates;
+    uint64_t last_ms;
+    bool alert_shown;
+};
+
+/* fmt with its "%s" replaced by the source, ':' turned into '_'. */
+static void drone_path(char *out, size_t len, const char *fmt, const char *source)
+{
+    const char *at = strstr(fmt, "%s");
+    char id[sizeof(((struct osd_shm_slot *)0)->source)];
+    snprintf(id, sizeof(id), "%s", source);
+    for (char *c = id; *c; c++) if (*c == ':') *c = '_';
+    snprintf(out, len, "%.*s%s%s", (int)(at - fmt), fmt, id, at + 2);
+}
+
+static void drone_publish(struct drone_out *d, const struct osd_shm_slot *s, const char *fmt,
+                          const struct layout *layout, int ttl_ms, uint64_t now, uint64_t *sent, uint64_t *dropped)
+{
+    if (d->fd < 0) {
+        if (d->last_try_ms && now - d->last_try_ms < CONNECT_RETRY_MS) return;
+        d->last_try_ms = now;
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        drone_path(addr.sun_path, sizeof(addr.sun_path), fmt, s->source);
+        int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            return;
+        }
+        d->fd = fd;
+    }
+
+    struct metric_entry entries[OSD_SHM_ENTRIES];
+    bool present[OSD_SHM_ENTRIES];
+    double values[OSD_SHM_ENTRIES];
+    memset(entries, 0, sizeof(entries));
+    for (uint32_t i = 0; i < s->count && i < OSD_SHM_ENTRIES; i++) {
+        snprintf(entries[i].label, sizeof(entries[i].label), "%s", s->label[i]);
+        values[i] = s->value[i];
+        present[i] = true;
+    }
+    struct osd_item items[OSD_TPL_MAX_ITEMS];
+    double out_values[OSD_TPL_MAX_ITEMS];
+    memset(items, 0, sizeof(items));
+    size_t n = layout_items(layout, entries, present, values, s->count, items, out_values, OSD_TPL_MAX_ITEMS);
+    if (s->alert_until_ms > now && n < OSD_TPL_MAX_ITEMS) {
+        snprintf(items[n].label, sizeof(items[n].label), "%s", s->alert);
+        items[n].precision = 2;
+        out_values[n++] = s->alert_value;
+    }
+    d->alert_shown = s->alert_until_ms > now;
+    double hz = d->last_ms && now > d->last_ms ? (double)(s->updates - d->last_updates) * 1000.0 / (double)(now - d->last_ms) : 0.0;
+    d->last_updates = s->updates;
+    d->last_ms = now;
+
+    static struct osd_template tpl;
+    char json[1024];
+    if (!osd_template_matches(&tpl, items, n, ttl_ms) && osd_template_compile(&tpl, items, n, ttl_ms) != 0) {
+        tpl.nops = 0;
+        return;
+    }
+    int len = osd_template_render(&tpl, out_values, s->updates, hz, json, sizeof(json));
+    if (len < 0) return;
+    if (send(d->fd, json, (size_t)len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        (*dropped)++;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+            close(d->fd);
+            d->fd = -1;
+            d->last_try_ms = now;
+        }
+        return;
+    }
+    (*sent)++;
+}
+
+static int server_socket(const struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket(AF_INET,SOCK_DGRAM) failed: %s\n", strerror(errno));
+        return -1;
+    }
+    int on = 1, rcvbuf = 4 << 20;
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        fprintf(stderr, "bind() failed: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int server_run(const struct sockaddr_in *addr, int nworkers, uint32_t max_sources, const char *shm_path,
+                      const char *sock_fmt, const struct layout *layout, int ttl_ms, int alert_ms)
+{
+    int rc = 1;
+    size_t shm_len = osd_shm_size(max_sources);
+    int shm_fd = open(shm_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (shm_fd < 0 || ftruncate(shm_fd, (off_t)shm_len) != 0) {
+        fprintf(stderr, "%s: %s\n", shm_path, strerror(errno));
+        if (shm_fd >= 0) close(shm_fd);
+        return 1;
+    }
+    struct osd_shm *shm = mmap(NULL, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (shm == MAP_FAILED) {
+        fprintf(stderr, "mmap(%s) failed: %s\n", shm_path, strerror(errno));
+        unlink(shm_path);
+        return 1;
+    }
+    shm->slot_count = max_sources;
+    shm->workers = (uint32_t)nworkers;
+    atomic_store(&shm->used, 0);
+
+    bool fanout = sock_fmt && strstr(sock_fmt, "%s");
+    struct rlimit rl;
+    if (fanout && getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    size_t table_len = 1;
+    while (table_len < 2 * (size_t)max_sources) table_len <<= 1;
+    struct worker *workers = calloc((size_t)nworkers, sizeof(*workers));
+    struct drone_out *out = fanout ? calloc(max_sources, sizeof(*out)) : NULL;
+    int started = 0;
+    if (!workers || (fanout && !out)) goto done;
+    for (int i = 0; i < nworkers; i++) workers[i].fd = -1;
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].fd = server_socket(addr);
+        workers[i].table = calloc(table_len, sizeof(struct source_ref));
+        if (workers[i].fd < 0 || !workers[i].table) goto done;
+        workers[i].mask = table_len - 1;
+        workers[i].shm = shm;
+        workers[i].alert_ms = alert_ms;
+    }
+    for (uint32_t i = 0; fanout && i < max_sources; i++) out[i].fd = -1;
+    /* Published last: a reader that sees the magic sees a complete header. */
+    atomic_thread_fence(memory_order_release);
+    shm->magic = OSD_SHM_MAGIC;
+    for (; started < nworkers; started++) {
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            g_stop = 1;
+            goto done;
+        }
+    }
+    fprintf(stdout, "Server: %d workers on port %u, up to %u sources, snapshot %s%s%s\n", nworkers,
+            (unsigned)ntohs(addr->sin_port), (unsigned)max_sources, shm_path,
+            fanout ? ", per-drone sockets " : "", fanout ? sock_fmt : "");
+    fflush(stdout);
+
+    uint64_t sent = 0, dropped = 0, last_report = now_ms(), last_total = 0;
+    while (!g_stop) {
+        struct timespec tick = { .tv_sec = 0, .tv_nsec = 10 * 1000000L };
+        nanosleep(&tick, NULL);
+        uint64_t now = now_ms();
+        uint32_t used = atomic_load(&shm->used);
+        if (used > max_sources) used = max_sources;
+        for (uint32_t i = 0; fanout && i < used; i++) {
+            struct osd_shm_slot snap;
+            uint32_t seq = atomic_load_explicit(&shm->slot[i].seq, memory_order_acquire);
+            bool alert_over = out[i].alert_shown && shm->slot[i].alert_until_ms <= now;
+            if ((seq == out[i].seq && !alert_over) || !osd_shm_read(&shm->slot[i], &snap)) continue;
+            out[i].seq = atomic_load_explicit(&snap.seq, memory_order_relaxed);
+            drone_publish(&out[i], &snap, sock_fmt, layout, ttl_ms, now, &sent, &dropped);
+        }
+        if (now - last_report >= 5000) {
+            uint64_t total = 0;
+            for (int w = 0; w < nworkers; w++) total += atomic_load(&workers[w].datagrams);
+            fprintf(stdout, "Server: %u sources, %.0f datagrams/s", used,
+                    (double)(total - last_total) * 1000.0 / (double)(now - last_report));
+            if (fanout) fprintf(stdout, ", %llu published, %llu dropped", (unsigned long long)sent, (unsigned long long)dropped);
+            fprintf(stdout, "\n");
+            fflush(stdout);
+            last_total = total;
+            last_report = now;
+        }
+    }
+    rc = 0;
+
+done:
+    g_stop = 1;
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+    for (int i = 0; workers && i < nworkers; i++) {
+        if (i < started) {
+            uint64_t d = atomic_load(&workers[i].datagrams), b = atomic_load(&workers[i].batches);
+            fprintf(stdout, "[worker %d] %llu datagrams, %.1f per recvmmsg, %llu rejected (table full)\n", i,
+                    (unsigned long long)d, b ? (double)d / (double)b : 0.0,
+                    (unsigned long long)atomic_load(&workers[i].rejected));
+        }
+        if (workers[i].fd >= 0) close(workers[i].fd);
+        free(workers[i].table);
+    }
+    for (uint32_t i = 0; out && i < max_sources; i++) {
+        if (out[i].fd >= 0) close(out[i].fd);
+    }
+    free(out);
+    free(workers);
+    munmap(shm, shm_len);
+    unlink(shm_path);
+    return rc;
+}
+
+#ifndef OSD_FEED_NO_MAIN
 int main(int argc, char **argv)
 {
     const char *sock_path = "/run/pixelpilot/osd.sock";
     const char *bind_addr = "0.0.0.0";
     int udp_port = 5005;
     int ttl_ms = 0;
+    int alert_ms = 3000;
+    bool report_latency = false;
+    double rate_hz = 0.0;
+    static struct layout layout;
+    int nworkers = 0;
+    long max_sources = 4096;
+    const char *shm_path = "/dev/shm/osd_feed";
 
     static struct option long_opts[] = {
         {"socket", required_argument, 0, 's'},
         {"port",   required_argument, 0, 'p'},
         {"bind",   required_argument, 0, 'b'},
         {"ttl",    required_argument, 0, 'T'},
+        {"alert",  required_argument, 0, 'A'},
+        {"rate",   required_argument, 0, 'R'},
+        {"layout", required_argument, 0, 'l'},
+        {"latency", no_argument,      0, 'L'},
+        {"bench",  required_argument, 0, 'B'},
+        {"workers", required_argument, 0, 'N'},
+        {"max-sources", required_argument, 0, 'M'},
+        {"shm",    required_argument, 0, 'm'},
         {"help",   no_argument,       0, 'h'},
         {0,0,0,0}
     };
 
     for (;;) {
         int opt, idx=0;
-        opt = getopt_long(argc, argv, "s:p:b:T:h", long_opts, &idx);
+        opt = getopt_long(argc, argv, "s:p:b:T:A:R:l:LB:N:M:m:h", long_opts, &idx);
         if (opt == -1) break;
         switch (opt) {
             case 's': sock_path = optarg; break;
             case 'p': udp_port = atoi(optarg); break;
             case 'b': bind_addr = optarg; break;
             case 'T': ttl_ms = atoi(optarg); break;
+            case 'A': alert_ms = atoi(optarg); break;
+            case 'R': rate_hz = atof(optarg); break;
+            case 'l':
+                if (layout_load(&layout, optarg) != 0) return 1;
+                break;
+            case 'L': report_latency = true; break;
+            case 'B': return osd_bench(atol(optarg));
+            case 'N': nworkers = atoi(optarg); break;
+            case 'M': max_sources = atol(optarg); break;
+            case 'm': shm_path = optarg; break;
             case 'h': usage(argv[0]); return 0;
             default:  usage(argv[0]); return 1;
         }
@@ -309,7 +1110,9 @@ int main(int argc, char **argv)
     signal(SIGINT, on_sigint);
     signal(SIGTERM, on_sigint);
 
-    int unix_fd = -1;
+    struct osd_latency latency = {0};
+    struct publisher pub = { .path = sock_path, .fd = -1, .latency = report_latency ? &latency : NULL,
+                             .quiet = rate_hz > 0.0 };
     int udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (udp_fd < 0) {
         fprintf(stderr, "socket(AF_INET,SOCK_DGRAM) failed: %s\n", strerror(errno));
@@ -328,12 +1131,25 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (nworkers > 0) {
+        close(udp_fd);
+        if (max_sources < 1 || max_sources > (1 << 20)) {
+            fprintf(stderr, "Invalid source count: %ld\n", max_sources);
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
+        return server_run(&addr, nworkers, (uint32_t)max_sources, shm_path, sock_path, &layout, ttl_ms, alert_ms);
+    }
+
     if (bind(udp_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         fprintf(stderr, "bind() failed: %s\n", strerror(errno));
         close(udp_fd);
         return 1;
     }
 
+    int on = 1;
+    setsockopt(udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
     fprintf(stdout, "Listening on %s:%d for UDP metrics\n", bind_addr, udp_port);
     fflush(stdout);
 
@@ -344,23 +1160,46 @@ int main(int argc, char **argv)
     bool snapshot_valid = false;
 
     const uint64_t stale_timeout_ms = 5000;
-    const uint64_t connect_retry_ms = 1000;
-    uint64_t last_connect_attempt_ms = 0;
+    /* -R: frames every frame_ms; stale entries start fading after one second. */
+    const uint64_t frame_ms = rate_hz > 0.0 ? (uint64_t)ceil(1000.0 / rate_hz) : 0;
+    const uint64_t fade_after_ms = 1000;
+    const double fade_ms = (double)(stale_timeout_ms - fade_after_ms) / 3.0;
+    uint64_t next_frame_ms = 0;
+    uint64_t data_counter = 0;
+    double data_hz = 0.0;
     uint64_t start_ms = now_ms();
     uint64_t last_data_ms = 0;
     uint64_t last_fallback_send_ms = 0;
     uint64_t last_send_ms = 0;
     uint64_t update_counter = 0;
+    struct osd_alert alert = { .last_seq = -1.0 };
+    double sample_t_us = 0.0;
+    struct fec_stats fec = { .last_seq = -1.0 };
+    struct fec_sample recovered[FEC_MAX_SAMPLES];
+    size_t recovered_count = 0;
 
-    char udp_buf[512];
-    char json_buf[512];
+    char udp_buf[2048];
+    char json_buf[1024];
+    static struct osd_template tpl;
     while (!g_stop) {
-        struct pollfd pfd = {
-            .fd = udp_fd,
-            .events = POLLIN
+        struct pollfd pfds[2] = {
+            { .fd = udp_fd, .events = POLLIN },
+            { .fd = pub.pending ? pub.fd : -1, .events = POLLOUT },
         };
 
-        int poll_rc = poll(&pfd, 1, 1000);
+        int timeout_ms = 1000;
+        if (alert.shown) {
+            uint64_t t = now_ms();
+            timeout_ms = alert.until_ms > t ? (int)(alert.until_ms - t) : 0;
+            if (timeout_ms > 1000) timeout_ms = 1000;
+        }
+        if (frame_ms && entry_count > 0) {
+            uint64_t t = now_ms();
+            int left = next_frame_ms > t ? (int)(next_frame_ms - t) : 0;
+            if (left < timeout_ms) timeout_ms = left;
+        }
+        timeout_ms = publisher_timeout_ms(&pub, now_ms(), timeout_ms);
+        int poll_rc = poll(pfds, 2, timeout_ms);
         if (poll_rc < 0) {
             if (errno == EINTR) {
                 continue;
@@ -372,32 +1211,87 @@ int main(int argc, char **argv)
         uint64_t now = now_ms();
         bool packet_updated = false;
 
-        if (poll_rc > 0 && (pfd.revents & POLLIN)) {
-            ssize_t n = recvfrom(udp_fd, udp_buf, sizeof(udp_buf) - 1, 0, NULL, NULL);
+        if (pub.pending && ((pfds[1].revents & (POLLOUT | POLLERR | POLLHUP)) || pub.fd < 0)) {
+            publisher_flush(&pub, now);
+        }
+
+        if (poll_rc > 0 && (pfds[0].revents & POLLIN)) {
+            struct sockaddr_in src;
+            char control[CMSG_SPACE(sizeof(struct timespec))];
+            struct iovec iov = { .iov_base = udp_buf, .iov_len = sizeof(udp_buf) - 1 };
+            struct msghdr mh = { .msg_name = &src, .msg_namelen = sizeof(src), .msg_iov = &iov, .msg_iovlen = 1,
+                                 .msg_control = control, .msg_controllen = sizeof(control) };
+            ssize_t n = recvmsg(udp_fd, &mh, 0);
             if (n < 0) {
                 if (errno == EINTR) continue;
-                fprintf(stderr, "recvfrom() failed: %s\n", strerror(errno));
+                fprintf(stderr, "recvmsg() failed: %s\n", strerror(errno));
             } else {
                 udp_buf[n] = '\0';
+                struct timespec rx_ts;
+                clock_gettime(CLOCK_REALTIME, &rx_ts);
+                for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+                    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                        memcpy(&rx_ts, CMSG_DATA(c), sizeof(rx_ts));
+                    }
+                }
 
                 char parsed_labels[MAX_ENTRIES][64];
                 double parsed_values[MAX_ENTRIES];
-                size_t parsed_count = extract_text_value_arrays(udp_buf, parsed_labels, parsed_values, MAX_ENTRIES);
-                if (parsed_count == 0) {
-                    parsed_count = extract_known_metrics(udp_buf, parsed_labels, parsed_values, MAX_ENTRIES);
+                size_t parsed_count = 0;
+                if (payload_has_type(udp_buf, "probe")) {
+                    echo_probe(udp_fd, udp_buf, &src,
+                               (uint64_t)rx_ts.tv_sec * 1000000ull + (uint64_t)rx_ts.tv_nsec / 1000ull);
+                    continue;
+                } else if (payload_has_type(udp_buf, "event")) {
+                    packet_updated = handle_event(udp_buf, &alert, now, alert_ms);
+                } else if (payload_has_type(udp_buf, "fast")) {
+                    size_t n = extract_known_metrics(udp_buf, parsed_labels, parsed_values, MAX_ENTRIES);
+                    if (n > 0) {
+                        entry_count = merge_entries(entries, entry_count, parsed_labels, parsed_values, n, now);
+                        last_data_ms = now;
+                        packet_updated = true;
+                    }
+                } else if (!payload_has_type(udp_buf, NULL)) {
+                    parsed_count = extract_text_value_arrays(udp_buf, parsed_labels, parsed_values, MAX_ENTRIES);
+                    if (parsed_count == 0) {
+                        parsed_count = extract_known_metrics(udp_buf, parsed_labels, parsed_values, MAX_ENTRIES);
+                    }
                 }
 
-                if (parsed_count > 0) {
+                if (parsed_count > 0 && fec_accept(&fec, udp_buf, recovered, &recovered_count)) {
+                    if (!parse_metric(udp_buf, "t_us", &sample_t_us)) sample_t_us = 0.0;
                     entry_count = parsed_count;
                     for (size_t i = 0; i < entry_count; ++i) {
-                        strncpy(entries[i].label, parsed_labels[i], sizeof(entries[i].label) - 1);
-                        entries[i].label[sizeof(entries[i].label) - 1] = '\0';
-                        entries[i].value = parsed_values[i];
+                        if (strcmp(entries[i].label, parsed_labels[i]) != 0) {
+                            memset(&entries[i], 0, sizeof(entries[i]));
+                            strncpy(entries[i].label, parsed_labels[i], sizeof(entries[i].label) - 1);
+                        }
+                    }
+                    /*
+                     * A filled-in sample is never shown: the current one
+                     * replaces it in the same pass. It only matters to -R,
+                     * where the newest one becomes the step entry_render
+                     * extrapolates from, at the time it was taken, so the
+                     * slope spans one interval instead of the whole gap.
+                     * Older ones would be overwritten too; fec.recovered
+                     * counts them all.
+                     */
+                    if (frame_ms && recovered_count > 0) {
+                        const struct fec_sample *r = &recovered[recovered_count - 1];
+                        uint64_t age = (uint64_t)r->age_ms < now ? (uint64_t)r->age_ms : 0;
+                        double t_us = sample_t_us > r->age_ms * 1000.0 ? sample_t_us - r->age_ms * 1000.0 : 0.0;
+                        for (size_t i = 0; i < entry_count; ++i) {
+                            if (r->have[i]) entry_set(&entries[i], r->values[i], now - age, t_us);
+                        }
+                    }
+                    for (size_t i = 0; i < entry_count; ++i) {
+                        entry_set(&entries[i], parsed_values[i], now, sample_t_us);
                     }
                     for (size_t i = entry_count; i < MAX_ENTRIES; ++i) {
-                        entries[i].label[0] = '\0';
-                        entries[i].value = 0.0;
+                        memset(&entries[i], 0, sizeof(entries[i]));
                     }
+                    data_counter++;
+                    data_hz = last_data_ms && now > last_data_ms ? 1000.0 / (double)(now - last_data_ms) : 0.0;
                     last_data_ms = now;
                     packet_updated = true;
                 }
@@ -406,7 +1300,7 @@ int main(int argc, char **argv)
 
         bool have_entries = entry_count > 0;
         bool fallback_active = false;
-        if (have_entries) {
+        if (have_entries && !frame_ms) {
             if (last_data_ms == 0) {
                 if (now - start_ms >= stale_timeout_ms) {
                     fallback_active = true;
@@ -416,7 +1310,8 @@ int main(int argc, char **argv)
             }
         }
 
-        if (!have_entries) {
+        bool alert_active = alert.until_ms > now;
+        if (!have_entries && !alert_active && !alert.shown) {
             continue;
         }
 
@@ -430,10 +1325,14 @@ int main(int argc, char **argv)
                 continue;
             }
             present[i] = true;
-            current_values[i] = fallback_active ? 0.0 : entries[i].value;
+            if (frame_ms) {
+                current_values[i] = entry_render(&entries[i], now, fade_after_ms, fade_ms);
+            } else {
+                current_values[i] = fallback_active ? 0.0 : entries[i].value;
+            }
         }
 
-        bool changed = !snapshot_valid || send_count != last_sent_count;
+        bool changed = !snapshot_valid || send_count != last_sent_count || alert_active != alert.shown;
         if (!changed) {
             for (size_t i = 0; i < send_count; ++i) {
                 if (!present[i] && !last_sent[i].present) continue;
@@ -456,95 +1355,84 @@ int main(int argc, char **argv)
         }
 
         bool should_send = packet_updated || changed || fallback_tick;
+        if (frame_ms) should_send = packet_updated || (changed && now >= next_frame_ms);
         if (!should_send) {
             continue;
         }
 
+        /* With -R the label keeps counting telemetry samples, not frames. */
         uint64_t next_count = update_counter + 1;
         double freq_hz = 0.0;
-        if (last_send_ms != 0) {
+        if (frame_ms) {
+            freq_hz = data_hz;
+        } else if (last_send_ms != 0) {
             uint64_t delta_ms = now - last_send_ms;
             if (delta_ms > 0) {
                 freq_hz = 1000.0 / (double)delta_ms;
             }
         }
 
-        char text_buf[MAX_ENTRIES][64];
-        const char *text_ptrs[MAX_ENTRIES];
-        bool present_arr[MAX_ENTRIES];
-        double values_arr[MAX_ENTRIES];
-        size_t emit_count = 0;
-        for (size_t i = 0; i < send_count && emit_count < MAX_ENTRIES; ++i) {
-            if (!present[i]) continue;
-            values_arr[emit_count] = current_values[i];
-            snprintf(text_buf[emit_count], sizeof(text_buf[emit_count]),
-                     "%.32s #%llu @ %.2f Hz",
-                     entries[i].label[0] ? entries[i].label : "Metric",
-                     (unsigned long long)next_count,
-                     freq_hz);
-            text_ptrs[emit_count] = text_buf[emit_count];
-            present_arr[emit_count] = true;
+        struct osd_item items[OSD_TPL_MAX_ITEMS];
+        double values_arr[OSD_TPL_MAX_ITEMS];
+        memset(items, 0, sizeof(items));
+        size_t emit_count = layout_items(&layout, entries, present, current_values, send_count,
+                                         items, values_arr, OSD_TPL_MAX_ITEMS);
+        if (alert_active && emit_count < OSD_TPL_MAX_ITEMS) {
+            snprintf(items[emit_count].label, sizeof(items[emit_count].label), "%s", alert.text);
+            items[emit_count].precision = 2;
+            values_arr[emit_count] = alert.value;
             emit_count++;
         }
 
-        if (emit_count == 0) {
+        if (emit_count == 0 && !alert.shown) {
             continue;
         }
 
-        int written = build_osd_payload(text_ptrs, values_arr, present_arr,
-                                        emit_count, ttl_ms, json_buf, sizeof(json_buf));
-        if (written < 0 || (size_t)written >= sizeof(json_buf)) {
+        if (!osd_template_matches(&tpl, items, emit_count, ttl_ms) &&
+            osd_template_compile(&tpl, items, emit_count, ttl_ms) != 0) {
+            tpl.nops = 0;
             fprintf(stderr, "Failed to build JSON payload\n");
             continue;
         }
-
-        if (unix_fd < 0) {
-            if (last_connect_attempt_ms == 0 || (now - last_connect_attempt_ms) >= connect_retry_ms) {
-                if (ensure_unix_connection(&unix_fd, sock_path) != 0) {
-                    last_connect_attempt_ms = now;
-                } else {
-                    last_connect_attempt_ms = now;
-                }
-            }
-        }
-
-        if (unix_fd < 0) {
-            continue;
-        }
-
-        if (send_json(unix_fd, sock_path, json_buf) != 0) {
-            close(unix_fd);
-            unix_fd = -1;
-            last_connect_attempt_ms = now;
+        int written = osd_template_render(&tpl, values_arr, frame_ms ? data_counter : next_count, freq_hz,
+                                          json_buf, sizeof(json_buf));
+        if (written < 0) {
+            fprintf(stderr, "Failed to build JSON payload\n");
             continue;
         }
 
+        publisher_offer(&pub, json_buf, (size_t)written, report_latency ? sample_t_us : 0.0, now);
+        sample_t_us = 0.0;
         last_send_ms = now;
         update_counter = next_count;
-
-        fprintf(stdout, "Forwarded: %s", json_buf);
-        fflush(stdout);
+        next_frame_ms = now + frame_ms;
 
         if (fallback_active) {
             last_fallback_send_ms = now;
         }
 
-        for (size_t i = 0; i < emit_count; ++i) {
+        alert.shown = alert_active;
+        for (size_t i = 0; i < send_count; ++i) {
             strncpy(last_sent[i].label, entries[i].label, sizeof(last_sent[i].label) - 1);
             last_sent[i].label[sizeof(last_sent[i].label) - 1] = '\0';
-            last_sent[i].value = values_arr[i];
-            last_sent[i].present = true;
-        }
-        for (size_t i = emit_count; i < last_sent_count; ++i) {
-            last_sent[i].present = false;
+            last_sent[i].value = current_values[i];
+            last_sent[i].present = present[i];
         }
-        last_sent_count = emit_count;
+        last_sent_count = send_count;
         snapshot_valid = true;
     }
 
-    if (unix_fd >= 0) {
-        close(unix_fd);
+    if (report_latency) osd_latency_print(&latency, "osd_feed");
+    publisher_print(&pub);
+    if (fec.received) {
+        fprintf(stdout, "[osd_feed] redundancy: samples=%llu recovered=%llu lost=%llu late=%llu\n",
+                (unsigned long long)fec.received, (unsigned long long)fec.recovered,
+                (unsigned long long)fec.lost, (unsigned long long)fec.late);
+    }
+    if (pub.fd >= 0) {
+        close(pub.fd);
     }
     close(udp_fd);
     return 0;
 }
+#endif
@@ -0,0 +1,342 @@
+#ifndef OSD_FORMAT_H
+#define OSD_FORMAT_H
+
+/*
+ * OSD message format shared by osd_feed and wifi_metrics_sender -O.
+ *
+ * One UNIX DGRAM datagram per update:
+ *   {"text":["RSSI #12 @ 10.00 Hz",...],"value":[84.62,...][,"ttl_ms":N]}
+ * Labels carry the update counter and the publish rate so a stalled feed
+ * is visible on the OSD itself.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static inline uint64_t osd_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+/*
+ * Sample-to-OSD latency. Samples carry "t_us", CLOCK_MONOTONIC when the
+ * station counters came back, so this is only meaningful when the collector
+ * and the publisher share a clock (same host).
+ */
+struct osd_latency {
+    uint64_t n;
+    uint64_t sum_us;
+    uint64_t max_us;
+};
+
+static inline void osd_latency_observe(struct osd_latency *l, uint64_t t_us, uint64_t now_us) {
+    if (!t_us || now_us < t_us) return;
+    uint64_t d = now_us - t_us;
+    l->n++;
+    l->sum_us += d;
+    if (d > l->max_us) l->max_us = d;
+}
+
+static inline void osd_latency_print(const struct osd_latency *l, const char *tag) {
+    if (!l->n) return;
+    printf("[%s] sample->OSD latency: n=%llu avg=%.0f us max=%llu us\n", tag,
+           (unsigned long long)l->n, (double)l->sum_us / (double)l->n,
+           (unsigned long long)l->max_us);
+    fflush(stdout);
+}
+
+/* OSD text for the sender's "event" datagrams; unknown events show as-is. */
+static inline const char *osd_event_text(const char *event) {
+    static const struct { const char *event; const char *text; } event_texts[] = {
+        {"beacon_loss", "! Beacon loss"},
+        {"disconnect", "! Link lost"},
+        {"connect", "Link up"},
+    };
+    for (size_t i = 0; i < sizeof(event_texts) / sizeof(event_texts[0]); ++i) {
+        if (strcmp(event, event_texts[i].event) == 0) return event_texts[i].text;
+    }
+    return event;
+}
+
+static inline void osd_format_label(char *out, size_t len, const char *label,
+                                    uint64_t counter, double freq_hz) {
+    snprintf(out, len, "%.32s #%llu @ %.2f Hz", label && label[0] ? label : "Metric",
+             (unsigned long long)counter, freq_hz);
+}
+
+static inline int osd_build_payload(const char *texts[], const double values[],
+                                    const bool present[], size_t count,
+                                    int ttl_ms, char *out, size_t out_len) {
+    char text_part[256] = "[";
+    char value_part[256] = "[";
+    size_t text_off = 1;
+    size_t value_off = 1;
+    bool first = true;
+    for (size_t i = 0; i < count; i++) {
+        if (!present[i]) continue;
+        if (!texts[i]) continue;
+        if (!first) {
+            if (text_off + 1 >= sizeof(text_part) || value_off + 1 >= sizeof(value_part)) {
+                return -1;
+            }
+            text_part[text_off++] = ',';
+            value_part[value_off++] = ',';
+        }
+        int written_text = snprintf(text_part + text_off, sizeof(text_part) - text_off,
+                                    "\"%s\"", texts[i]);
+        if (written_text < 0 || text_off + (size_t)written_text >= sizeof(text_part)) {
+            return -1;
+        }
+        text_off += (size_t)written_text;
+
+        int written_value = snprintf(value_part + value_off, sizeof(value_part) - value_off,
+                                     "%.2f", values[i]);
+        if (written_value < 0 || value_off + (size_t)written_value >= sizeof(value_part)) {
+            return -1;
+        }
+        value_off += (size_t)written_value;
+        first = false;
+    }
+
+    if (text_off + 1 >= sizeof(text_part) || value_off + 1 >= sizeof(value_part)) {
+        return -1;
+    }
+    text_part[text_off++] = ']';
+    text_part[text_off] = '\0';
+    value_part[value_off++] = ']';
+    value_part[value_off] = '\0';
+
+    if (ttl_ms > 0) {
+        return snprintf(out, out_len,
+                        "{\"text\":%s,\"value\":%s,\"ttl_ms\":%d}\n",
+                        text_part, value_part, ttl_ms);
+    }
+    return snprintf(out, out_len,
+                    "{\"text\":%s,\"value\":%s}\n",
+                    text_part, value_part);
+}
+
+/*
+ * Precompiled output. The item list (labels, value precision, whether the
+ * label carries " #counter" and " @ rate Hz") is compiled once into ops
+ * over a literal buffer; a send copies the literal runs and prints only the
+ * numbers, without snprintf. Recompile when the item list changes.
+ */
+#define OSD_TPL_MAX_ITEMS 8
+#define OSD_TPL_MAX_OPS 64
+#define OSD_TPL_NUM_MAX 24 /* widest number an op prints */
+
+struct osd_item {
+    char label[64];
+    int precision; /* 0..4 decimals */
+    bool counter;
+    bool rate;
+};
+
+enum osd_op_kind { OSD_OP_LIT, OSD_OP_COUNTER, OSD_OP_RATE, OSD_OP_VALUE };
+
+/* LIT copies lit[off, off + len); VALUE prints value[arg] with len decimals. */
+struct osd_op {
+    uint8_t kind;
+    uint8_t arg;
+    uint16_t off;
+    uint16_t len;
+};
+
+struct osd_template {
+    struct osd_item items[OSD_TPL_MAX_ITEMS];
+    size_t count;
+    int ttl_ms;
+    char lit[1024];
+    size_t lit_len;
+    struct osd_op ops[OSD_TPL_MAX_OPS];
+    size_t nops;
+    size_t nums;
+};
+
+static inline bool osd_tpl_op(struct osd_template *t, uint8_t kind, uint8_t arg, uint16_t len) {
+    if (t->nops == OSD_TPL_MAX_OPS) return false;
+    t->ops[t->nops++] = (struct osd_op){ .kind = kind, .arg = arg, .len = len };
+    t->nums++;
+    return true;
+}
+
+/* Appends literal text, extending the previous op when it is a literal too. */
+static inline bool osd_tpl_lit(struct osd_template *t, const char *s, size_t n) {
+    if (t->lit_len + n > sizeof(t->lit)) return false;
+    struct osd_op *last = t->nops ? &t->ops[t->nops - 1] : NULL;
+    if (!last || last->kind != OSD_OP_LIT) {
+        if (t->nops == OSD_TPL_MAX_OPS) return false;
+        last = &t->ops[t->nops++];
+        *last = (struct osd_op){ .kind = OSD_OP_LIT, .off = (uint16_t)t->lit_len };
+    }
+    memcpy(t->lit + t->lit_len, s, n);
+    t->lit_len += n;
+    last->len = (uint16_t)(last->len + n);
+    return true;
+}
+
+static inline bool osd_tpl_str(struct osd_template *t, const char *s) {
+    return osd_tpl_lit(t, s, strlen(s));
+}
+
+/* The layout osd_build_payload() would produce for these items; -1 if it does not fit. */
+static inline int osd_template_compile(struct osd_template *t, const struct osd_item items[],
+                                       size_t count, int ttl_ms) {
+    if (count > OSD_TPL_MAX_ITEMS) return -1;
+    memset(t, 0, sizeof(*t));
+    memcpy(t->items, items, count * sizeof(items[0]));
+    t->count = count;
+    t->ttl_ms = ttl_ms;
+    bool ok = osd_tpl_str(t, "{\"text\":[");
+    for (size_t i = 0; ok && i < count; i++) {
+        const char *label = items[i].label[0] ? items[i].label : "Metric";
+        ok = osd_tpl_str(t, i ? ",\"" : "\"");
+        for (size_t j = 0; ok && label[j] && j < 32; j++) {
+            if (label[j] == '"' || label[j] == '\\') ok = osd_tpl_lit(t, "\\", 1);
+            if (ok) ok = osd_tpl_lit(t, &label[j], 1);
+        }
+        if (ok && items[i].counter) ok = osd_tpl_str(t, " #") && osd_tpl_op(t, OSD_OP_COUNTER, 0, 0);
+        if (ok && items[i].rate) ok = osd_tpl_str(t, " @ ") && osd_tpl_op(t, OSD_OP_RATE, 0, 2) &&
+                                      osd_tpl_str(t, " Hz");
+        if (ok) ok = osd_tpl_str(t, "\"");
+    }
+    if (ok) ok = osd_tpl_str(t, "],\"value\":[");
+    for (size_t i = 0; ok && i < count; i++) {
+        int prec = items[i].precision < 0 ? 0 : items[i].precision > 4 ? 4 : items[i].precision;
+        ok = (!i || osd_tpl_str(t, ",")) && osd_tpl_op(t, OSD_OP_VALUE, (uint8_t)i, (uint16_t)prec);
+    }
+    if (ok) ok = osd_tpl_str(t, "]");
+    if (ok && ttl_ms > 0) {
+        char ttl[32];
+        snprintf(ttl, sizeof(ttl), ",\"ttl_ms\":%d", ttl_ms);
+        ok = osd_tpl_str(t, ttl);
+    }
+    if (ok) ok = osd_tpl_str(t, "}\n");
+    return ok ? 0 : -1;
+}
+
+static inline bool osd_template_matches(const struct osd_template *t, const struct osd_item items[],
+                                        size_t count, int ttl_ms) {
+    return t->nops && t->count == count && t->ttl_ms == ttl_ms &&
+           memcmp(t->items, items, count * sizeof(items[0])) == 0;
+}
+
+static inline char *osd_put_u64(char *p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+/* %.<prec>f for |v| < 1e15; anything else (NaN included) prints as 0. */
+static inline char *osd_put_fixed(char *p, double v, int prec) {
+    static const uint64_t scale[] = { 1, 10, 100, 1000, 10000 };
+    if (!(v > -1e15 && v < 1e15)) v = 0.0;
+    bool neg = v < 0.0;
+    uint64_t q = (uint64_t)((neg ? -v : v) * (double)scale[prec] + 0.5);
+    if (neg && q) *p++ = '-';
+    p = osd_put_u64(p, q / scale[prec]);
+    if (prec) {
+        *p++ = '.';
+        uint64_t frac = q % scale[prec];
+        for (int i = prec - 1; i >= 0; i--) {
+            p[i] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        p += prec;
+    }
+    return p;
+}
+
+/* Renders one datagram; returns its length, or -1 if out is too small. */
+static inline int osd_template_render(const struct osd_template *t, const double values[],
+                                      uint64_t counter, double freq_hz, char *out, size_t out_len) {
+    if (t->lit_len + t->nums * OSD_TPL_NUM_MAX + 1 > out_len) return -1;
+    char *p = out;
+    for (size_t i = 0; i < t->nops; i++) {
+        const struct osd_op *op = &t->ops[i];
+        switch (op->kind) {
+            case OSD_OP_LIT:
+                memcpy(p, t->lit + op->off, op->len);
+                p += op->len;
+                break;
+            case OSD_OP_COUNTER: p = osd_put_u64(p, counter); break;
+            case OSD_OP_RATE:    p = osd_put_fixed(p, freq_hz, op->len); break;
+            case OSD_OP_VALUE:   p = osd_put_fixed(p, values[op->arg], op->len); break;
+        }
+    }
+    *p = '\0';
+    return (int)(p - out);
+}
+
+/*
+ * Shared-memory snapshot written by osd_feed -N (one slot per source) for
+ * OSD renderers and osd_loadgen. Each slot is a seqlock: the single writer
+ * makes seq odd, updates, makes it even; readers copy and retry on a change.
+ * Slots are handed out in arrival order and never reused while the file
+ * exists; `used` is the high-water mark.
+ */
+#define OSD_SHM_MAGIC 0x3144534fu /* "OSD1" */
+#define OSD_SHM_ENTRIES 8
+
+struct osd_shm_slot {
+    _Atomic uint32_t seq;
+    uint32_t count;
+    char source[24];      /* "a.b.c.d:port" */
+    uint64_t updates;     /* datagrams applied */
+    uint64_t t_ms;        /* CLOCK_MONOTONIC ms of the last one */
+    double t_us;          /* sender's t_us of the last sample, 0 if none */
+    char label[OSD_SHM_ENTRIES][32];
+    double value[OSD_SHM_ENTRIES];
+    char alert[32];
+    double alert_value;
+    uint64_t alert_until_ms;
+};
+
+struct osd_shm {
+    uint32_t magic;
+    uint32_t slot_count;
+    uint32_t workers;
+    _Atomic uint32_t used;
+    struct osd_shm_slot slot[];
+};
+
+static inline size_t osd_shm_size(uint32_t slots) {
+    return sizeof(struct osd_shm) + (size_t)slots * sizeof(struct osd_shm_slot);
+}
+
+static inline void osd_shm_write_begin(struct osd_shm_slot *s) {
+    uint32_t q = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, q + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void osd_shm_write_end(struct osd_shm_slot *s) {
+    uint32_t q = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, q + 1, memory_order_release);
+}
+
+/* Consistent copy of a slot; false if the writer kept it busy. */
+static inline bool osd_shm_read(const struct osd_shm_slot *s, struct osd_shm_slot *out) {
+    for (int tries = 0; tries < 64; tries++) {
+        uint32_t q = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (q & 1u) continue;
+        memcpy((void *)out, (const void *)s, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == q) return true;
+    }
+    return false;
+}
+
+#endif
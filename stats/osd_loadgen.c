@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osd_format.h"
+
+/*
+ * osd_loadgen: many fake drones against osd_feed -N. Each source is its own
+ * UDP socket (own source port, so SO_REUSEPORT spreads them over the
+ * workers) sending sender-style samples at -r Hz. With -m it reads the
+ * server's shared-memory snapshot before and after the run and reports the
+ * ingest rate per worker, which is the number to compare across -N.
+ */
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_signal(int sig) { (void)sig; g_stop = 1; }
+
+struct gen_thread {
+    pthread_t thread;
+    int *fds;
+    int count;
+    double rate_hz;
+    uint64_t sent;
+    uint64_t failed;
+};
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [-H HOST] [-p PORT] [-n SOURCES] [-r HZ] [-t THREADS] [-d SECONDS] [-m SHM]\n"
+        "  -H HOST     osd_feed -N address (default: 127.0.0.1)\n"
+        "  -p PORT     UDP port (default: 5005)\n"
+        "  -n SOURCES  Simulated senders, one socket each (default: 1000)\n"
+        "  -r HZ       Samples per second per sender; 0 = as fast as possible (default: 10)\n"
+        "  -t THREADS  Generator threads (default: 2)\n"
+        "  -d SECONDS  Run time (default: 10)\n"
+        "  -m SHM      Server snapshot to measure ingest from (e.g. /dev/shm/osd_feed)\n",
+        argv0);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *gen_main(void *arg) {
+    struct gen_thread *g = arg;
+    char payload[256];
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    long period_ns = g->rate_hz > 0.0 ? (long)(1e9 / g->rate_hz) : 0;
+    for (uint64_t round = 0; !g_stop; round++) {
+        for (int i = 0; i < g->count && !g_stop; i++) {
+            double rssi = 40.0 + (double)((round + (uint64_t)i) % 50);
+            int len = snprintf(payload, sizeof(payload),
+                               "{\"text\":[\"RSSI\",\"Link\",\"Queue\",\"Host\"],"
+                               "\"value\":[%.2f,%.2f,100.00,90.00],\"t_us\":%llu}\n",
+                               rssi, 100.0 - rssi / 2.0, (unsigned long long)osd_now_us());
+            if (send(g->fds[i], payload, (size_t)len, 0) < 0) {
+                g->failed++;
+            } else {
+                g->sent++;
+            }
+        }
+        if (!period_ns) continue;
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !g_stop) {
+        }
+    }
+    return NULL;
+}
+
+/* Sum of slot updates in the server snapshot, or -1 if it can't be read. */
+static int64_t shm_updates(const struct osd_shm *shm, uint32_t *workers, uint32_t *sources) {
+    if (shm->magic != OSD_SHM_MAGIC) return -1;
+    uint32_t used = atomic_load(&((struct osd_shm *)shm)->used);
+    if (used > shm->slot_count) used = shm->slot_count;
+    int64_t total = 0;
+    for (uint32_t i = 0; i < used; i++) {
+        struct osd_shm_slot s;
+        if (osd_shm_read(&shm->slot[i], &s)) total += (int64_t)s.updates;
+    }
+    *workers = shm->workers;
+    *sources = used;
+    return total;
+}
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    int port = 5005;
+    int sources = 1000;
+    double rate_hz = 10.0;
+    int nthreads = 2;
+    double duration_s = 10.0;
+    const char *shm_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:n:r:t:d:m:h")) != -1) {
+        switch (opt) {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'n': sources = atoi(optarg); break;
+            case 'r': rate_hz = atof(optarg); break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'd': duration_s = atof(optarg); break;
+            case 'm': shm_path = optarg; break;
+            case 'h': usage(argv[0]); return 0;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+    if (sources < 1 || nthreads < 1 || port <= 0 || port > 65535 || duration_s <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (nthreads > sources) nthreads = sources;
+
+    struct sockaddr_in dest = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    if (inet_pton(AF_INET, host, &dest.sin_addr) != 1) {
+        fprintf(stderr, "inet_pton failed for host %s\n", host);
+        return 1;
+    }
+
+    const struct osd_shm *shm = NULL;
+    size_t shm_len = 0;
+    if (shm_path) {
+        int fd = open(shm_path, O_RDONLY | O_CLOEXEC);
+        struct osd_shm head;
+        if (fd < 0 || read(fd, &head, sizeof(head)) != (ssize_t)sizeof(head) || head.magic != OSD_SHM_MAGIC) {
+            fprintf(stderr, "%s: no osd_feed -N snapshot\n", shm_path);
+            if (fd >= 0) close(fd);
+            return 1;
+        }
+        shm_len = osd_shm_size(head.slot_count);
+        shm = mmap(NULL, shm_len, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (shm == MAP_FAILED) {
+            fprintf(stderr, "mmap(%s) failed: %s\n", shm_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    int *fds = calloc((size_t)sources, sizeof(*fds));
+    struct gen_thread *threads = calloc((size_t)nthreads, sizeof(*threads));
+    if (!fds || !threads) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < sources; i++) {
+        fds[i] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fds[i] < 0 || connect(fds[i], (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            fprintf(stderr, "source %d: %s (raise ulimit -n?)\n", i, strerror(errno));
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    uint32_t workers = 0, seen = 0;
+    int64_t before = shm ? shm_updates(shm, &workers, &seen) : -1;
+    double t0 = now_s();
+    for (int t = 0, first = 0; t < nthreads; t++) {
+        int n = sources / nthreads + (t < sources % nthreads ? 1 : 0);
+        threads[t].fds = fds + first;
+        threads[t].count = n;
+        threads[t].rate_hz = rate_hz;
+        first += n;
+        if (pthread_create(&threads[t].thread, NULL, gen_main, &threads[t]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+    while (!g_stop && now_s() - t0 < duration_s) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 50 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    g_stop = 1;
+    uint64_t sent = 0, failed = 0;
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t].thread, NULL);
+        sent += threads[t].sent;
+        failed += threads[t].failed;
+    }
+    double elapsed = now_s() - t0;
+
+    /* Let the server drain its socket buffers before the second reading. */
+    struct timespec settle = { .tv_sec = 0, .tv_nsec = 300 * 1000000L };
+    nanosleep(&settle, NULL);
+    printf("offered: %d sources x %.0f Hz, %llu sent in %.2f s = %.0f/s, %llu send errors\n",
+           sources, rate_hz, (unsigned long long)sent, elapsed, (double)sent / elapsed, (unsigned long long)failed);
+    int64_t after = shm ? shm_updates(shm, &workers, &seen) : -1;
+    if (before >= 0 && after >= 0) {
+        double rate = (double)(after - before) / elapsed;
+        printf("ingested: %lld (%.1f%%) = %.0f/s over %u workers, %.0f/s per worker, %u sources in snapshot\n",
+               (long long)(after - before), sent ? 100.0 * (double)(after - before) / (double)sent : 0.0,
+               rate, workers, workers ? rate / workers : 0.0, seen);
+    }
+
+    for (int i = 0; i < sources; i++) close(fds[i]);
+    free(fds);
+    free(threads);
+    if (shm) munmap((void *)shm, shm_len);
+    return 0;
+}
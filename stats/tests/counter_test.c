@@ -0,0 +1,177 @@
+/* counter_set wrap/reset handling, built against the sender's own code. */
+#define WIFI_METRICS_NO_MAIN
+#include "../wifi_metrics_sender.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/* A sample carrying every station counter at value v and rx duplicates at dup. */
+static struct station_sample sample_all(uint64_t v, uint64_t dup) {
+    struct station_sample s = { .signal_dbm = -50.0 };
+    for (int i = 0; i < CTR_COUNT; i++) {
+        sample_set(&s, (enum counter_id)i, counter_sources[i] == CTR_SRC_STATION ? v : dup);
+    }
+    return s;
+}
+
+static void test_first_sample(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(1000, 50);
+    CHECK(counter_set_update(&set, &s, 1.0) == 0);
+    for (int i = 0; i < CTR_COUNT; i++) {
+        CHECK(set.c[i].valid);
+        CHECK(!set.c[i].has_delta);
+        CHECK(set.c[i].delta == 0);
+        CHECK(set.c[i].total == 0);
+    }
+
+    s = sample_all(1100, 55);
+    CHECK(counter_set_update(&set, &s, 1.0) == 0);
+    CHECK(set.c[CTR_TX_PACKETS].has_delta);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 100);
+    CHECK(set.c[CTR_RX_DUPLICATES].delta == 5);
+    CHECK(set.wraps == 0 && set.resets == 0);
+}
+
+static void test_wrap_at_2_32(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(UINT32_MAX - 9, 0);
+    counter_set_update(&set, &s, 1.0);
+    s = sample_all(5, 0);
+    CHECK(counter_set_update(&set, &s, 1.0) == 0);
+    CHECK(set.c[CTR_TX_PACKETS].has_delta);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 15);       /* 10 up to 2^32, then 0..5 */
+    CHECK(set.c[CTR_TX_PACKETS].total == 15);
+    CHECK(set.c[CTR_TX_PACKETS].last == 5);
+    CHECK(set.wraps == CTR_COUNT - 1);              /* every station counter wrapped */
+    CHECK(set.resets == 0);
+
+    /* A "wrap" larger than the interval could produce is a reset instead. */
+    set = (struct counter_set){0};
+    s = sample_all(UINT32_MAX - 9, 0);
+    counter_set_update(&set, &s, 0.1);
+    s = sample_all(COUNTER_MAX_RATE * 0.1, 0);
+    CHECK(counter_set_update(&set, &s, 0.1) == 1u << CTR_SRC_STATION);
+    CHECK(set.c[CTR_TX_PACKETS].delta == (uint64_t)(COUNTER_MAX_RATE * 0.1));
+    CHECK(set.wraps == 0 && set.resets == 1);
+
+    /* 64-bit counters past 2^32 never wrap at 2^32. */
+    set = (struct counter_set){0};
+    s = sample_all(0, (1ull << 32) + 100);
+    counter_set_update(&set, &s, 1.0);
+    s = sample_all(0, 7);
+    CHECK(counter_set_update(&set, &s, 1.0) == 1u << CTR_SRC_DEBUGFS);
+    CHECK(set.c[CTR_RX_DUPLICATES].delta == 7);
+}
+
+static void test_reset(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(5000, 10);
+    counter_set_update(&set, &s, 1.0);
+    s = sample_all(6000, 12);
+    counter_set_update(&set, &s, 1.0);
+    CHECK(set.c[CTR_TX_PACKETS].total == 1000);
+
+    /* Driver reset: counters restart from zero; the restart value is the delta. */
+    s = sample_all(40, 14);
+    CHECK(counter_set_update(&set, &s, 1.0) == 1u << CTR_SRC_STATION);
+    CHECK(set.c[CTR_TX_PACKETS].has_delta);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 40);
+    CHECK(set.c[CTR_TX_PACKETS].total == 1040);
+    CHECK(set.c[CTR_RX_DUPLICATES].delta == 2);     /* other source untouched */
+    CHECK(set.resets == 1);
+
+    /* counter_set_reset (reassociation) starts over without a delta, keeps totals. */
+    counter_set_reset(&set);
+    s = sample_all(90, 20);
+    CHECK(counter_set_update(&set, &s, 1.0) == 0);
+    CHECK(!set.c[CTR_TX_PACKETS].has_delta);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 0);
+    CHECK(set.c[CTR_TX_PACKETS].total == 1040);
+    s = sample_all(95, 21);
+    counter_set_update(&set, &s, 1.0);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 5);
+}
+
+static void test_source_wide_reset(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(0, 100);
+    sample_set(&s, CTR_TX_PACKETS, 50000);
+    sample_set(&s, CTR_TX_RETRIES, 100);
+    counter_set_update(&set, &s, 1.0);
+
+    /* TX packets went down, TX retries happened to grow: both restarted. */
+    s = sample_all(0, 130);
+    sample_set(&s, CTR_TX_PACKETS, 300);
+    sample_set(&s, CTR_TX_RETRIES, 120);
+    CHECK(counter_set_update(&set, &s, 1.0) == 1u << CTR_SRC_STATION);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 300);
+    CHECK(set.c[CTR_TX_RETRIES].delta == 120);      /* not 20 */
+    CHECK(set.c[CTR_RX_DUPLICATES].delta == 30);
+    CHECK(set.resets == 1);
+}
+
+/* Reset from near 2^32: a small restart value must not pass for a wrap. */
+static void test_reset_near_2_32(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(1000, 0);
+    sample_set(&s, CTR_TX_PACKETS, 4000000000u);
+    counter_set_update(&set, &s, 1.0);
+
+    /* tx_packets "wraps" by ~295M while rx_packets drops: the source reset. */
+    s = sample_all(20, 0);
+    sample_set(&s, CTR_TX_PACKETS, 10);
+    CHECK(counter_set_update(&set, &s, 1.0) == 1u << CTR_SRC_STATION);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 10);
+    CHECK(set.c[CTR_TX_PACKETS].total == 10);
+    CHECK(set.c[CTR_RX_PACKETS].delta == 20);
+    CHECK(set.wraps == 0 && set.resets == 1);
+
+    /* Every other counter grows: a lone u32 counter at 3.3e9 restarting is still a reset. */
+    set = (struct counter_set){0};
+    s = sample_all(100, 0);
+    sample_set(&s, CTR_TX_PACKETS, 3300000000u);
+    counter_set_update(&set, &s, 1.0);
+    s = sample_all(150, 0);
+    sample_set(&s, CTR_TX_PACKETS, 10);
+    CHECK(counter_set_update(&set, &s, 1.0) == 1u << CTR_SRC_STATION);
+    CHECK(set.c[CTR_TX_PACKETS].delta == 10);
+    CHECK(set.c[CTR_RX_PACKETS].delta == 150);
+    CHECK(set.wraps == 0);
+}
+
+static void test_missing_counter(void) {
+    struct counter_set set = {0};
+    struct station_sample s = sample_all(100, 1);
+    counter_set_update(&set, &s, 1.0);
+    s = sample_all(200, 2);
+    s.have &= ~(1u << CTR_BEACON_LOSS);
+    counter_set_update(&set, &s, 1.0);
+    CHECK(!set.c[CTR_BEACON_LOSS].valid);
+    CHECK(!set.c[CTR_BEACON_LOSS].has_delta);
+    s = sample_all(300, 3);
+    counter_set_update(&set, &s, 1.0);
+    CHECK(!set.c[CTR_BEACON_LOSS].has_delta);       /* back, but first reading again */
+    CHECK(set.c[CTR_TX_PACKETS].delta == 100);
+}
+
+int main(void) {
+    test_first_sample();
+    test_wrap_at_2_32();
+    test_reset();
+    test_source_wide_reset();
+    test_reset_near_2_32();
+    test_missing_counter();
+    if (failures) {
+        fprintf(stderr, "counter_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("counter_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* Per-chain signal decoding of the nl80211 fast path (fast_parse_station). */
+#define WIFI_METRICS_NO_MAIN
+#include "../wifi_metrics_sender.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/*
+ * Builds a NEW_STATION attribute payload with signal and the given chains;
+ * dbm[i] == 0 leaves chain i out of the CHAIN_SIGNAL nest.
+ */
+static size_t build_station(char *buf, int8_t signal, const int8_t dbm[FAST_MAX_CHAINS]) {
+    char chains[64], sta[128];
+    size_t coff = 0, soff = 0, off = 0;
+    for (int i = 0; i < FAST_MAX_CHAINS; i++) {
+        if (dbm[i]) nl_put_attr(chains, &coff, (uint16_t)i, &dbm[i], 1);
+    }
+    nl_put_attr(sta, &soff, NL80211_STA_INFO_SIGNAL, &signal, 1);
+    nl_put_attr(sta, &soff, NL80211_STA_INFO_CHAIN_SIGNAL | NLA_F_NESTED, chains, (uint16_t)coff);
+    nl_put_attr(buf, &off, NL80211_ATTR_STA_INFO | NLA_F_NESTED, sta, (uint16_t)soff);
+    return off;
+}
+
+static void test_all_chains(void) {
+    char buf[256];
+    struct fast_sample prev = { .best_chain = -1 }, out;
+    size_t len = build_station(buf, -30, (const int8_t[FAST_MAX_CHAINS]){ -35, -33 });
+    CHECK(fast_parse_station(buf, len, &prev, &out) == 0);
+    CHECK(out.chains == 2);
+    CHECK(out.chain_dbm[0] == -35 && out.chain_dbm[1] == -33);
+    CHECK(out.best_chain == 1);
+    CHECK(out.imbalance_db == 2);
+    CHECK(out.combining_gain_db == 3);
+}
+
+static void test_missing_chain(void) {
+    char buf[256];
+    struct fast_sample prev = { .best_chain = -1 }, out;
+
+    /* Chain 0 unreported: chains 1 and 3 must keep their indices. */
+    size_t len = build_station(buf, -40, (const int8_t[FAST_MAX_CHAINS]){ 0, -50, 0, -44 });
+    CHECK(fast_parse_station(buf, len, &prev, &out) == 0);
+    CHECK(out.chains == 4);
+    CHECK(isnan(out.chain_dbm[0]) && isnan(out.chain_dbm[2]));
+    CHECK(out.chain_dbm[1] == -50 && out.chain_dbm[3] == -44);
+    CHECK(out.best_chain == 3);
+    CHECK(out.imbalance_db == 6);
+    CHECK(out.combining_gain_db == 4);
+
+    /* Best chain moves from 3 to 1: one switch, counted by chain index. */
+    prev = out;
+    len = build_station(buf, -40, (const int8_t[FAST_MAX_CHAINS]){ 0, -41, 0, -60 });
+    CHECK(fast_parse_station(buf, len, &prev, &out) == 0);
+    CHECK(out.best_chain == 1);
+    CHECK(out.best_chain_switches == 1);
+}
+
+static void test_no_chains(void) {
+    char buf[256];
+    struct fast_sample prev = { .best_chain = -1 }, out;
+    size_t len = build_station(buf, -40, (const int8_t[FAST_MAX_CHAINS]){ 0 });
+    CHECK(fast_parse_station(buf, len, &prev, &out) == 0);
+    CHECK(out.chains == 0);
+    CHECK(out.best_chain == -1);
+    CHECK(isnan(out.imbalance_db));
+}
+
+int main(void) {
+    test_all_chains();
+    test_missing_chain();
+    test_no_chains();
+    if (failures) {
+        fprintf(stderr, "fast_chain_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("fast_chain_test: ok\n");
+    return 0;
+}
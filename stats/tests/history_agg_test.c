@@ -0,0 +1,56 @@
+/* history_format_agg: bucket sample counts versus per-metric counts. */
+#define WIFI_METRICS_NO_MAIN
+#include "../wifi_metrics_sender.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void push(struct history_ring *ring, uint32_t t_ms, int8_t signal, uint8_t rssi, uint8_t link_tx) {
+    struct history_sample *hs = &ring->samples[ring->head];
+    *hs = (struct history_sample){
+        .t_ms = t_ms, .signal_dbm = signal, .rssi = rssi, .link_tx = link_tx,
+        .link_rx = HISTORY_SCORE_NONE, .link_all = HISTORY_SCORE_NONE,
+    };
+    ring->head = (ring->head + 1) % ring->capacity;
+    if (ring->count < ring->capacity) ring->count++;
+}
+
+static void test_counts(void) {
+    static struct history_sample store[16];
+    struct history_ring ring = {.samples = store, .capacity = 16, .fd = -1};
+    static char buf[4096];
+
+    /* Bucket 0: four samples, RSSI on two, link_tx on one, signal on three. */
+    push(&ring, 0, -60, 180, HISTORY_SCORE_NONE);
+    push(&ring, 250, -62, HISTORY_SCORE_NONE, 100);
+    push(&ring, 500, INT8_MIN, HISTORY_SCORE_NONE, HISTORY_SCORE_NONE);
+    push(&ring, 750, -64, 160, HISTORY_SCORE_NONE);
+    /* Bucket 1: one sample with no RSSI at all. */
+    push(&ring, 1000, -70, HISTORY_SCORE_NONE, HISTORY_SCORE_NONE);
+
+    size_t len = history_format_agg(&ring, 2000, 2000, 1000, buf, sizeof(buf));
+    CHECK(len > 0 && len < sizeof(buf));
+    CHECK(strstr(buf, "{\"t\":0,\"n\":4,") != NULL);
+    CHECK(strstr(buf, "\"signal\":[-64.0,-62.00,-60.0,3]") != NULL);
+    CHECK(strstr(buf, "\"rssi\":[80.0,85.00,90.0,2]") != NULL);
+    CHECK(strstr(buf, "\"link_tx\":[50.0,50.00,50.0,1]") != NULL);
+    CHECK(strstr(buf, "{\"t\":1000,\"n\":1,") != NULL);
+    CHECK(strstr(buf, "\"n\":1,\"signal\":[-70.0,-70.00,-70.0,1],\"rssi\":null") != NULL);
+    if (failures) fprintf(stderr, "%s", buf);
+}
+
+int main(void) {
+    test_counts();
+    if (failures) {
+        fprintf(stderr, "history_agg_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("history_agg_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,51 @@
+/* RTM_GETLINK state query behind iface_watch's initial and post-ENOBUFS state. */
+#define WIFI_METRICS_NO_MAIN
+#include "../wifi_metrics_sender.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void test_flags(void) {
+    CHECK(link_is_up(IFF_UP, -1));
+    CHECK(link_is_up(IFF_UP, LINK_OPER_UP));
+    CHECK(link_is_up(IFF_UP, LINK_OPER_UNKNOWN));
+    CHECK(!link_is_up(IFF_UP, 2));                  /* IF_OPER_DOWN: no carrier */
+    CHECK(!link_is_up(IFF_UP, 5));                  /* IF_OPER_DORMANT: not associated */
+    CHECK(!link_is_up(0, LINK_OPER_UP));
+}
+
+static void test_query(void) {
+    CHECK(link_query_up((int)if_nametoindex("lo")) == 1);
+    CHECK(link_query_up(INT_MAX) == 0);
+
+    /* A dummy netdev toggled with ip(8); needs root, skipped otherwise. */
+    if (system("ip link add wmlinktest0 type dummy 2>/dev/null") != 0) {
+        printf("link_state_test: no dummy netdev, up/down toggle skipped\n");
+        return;
+    }
+    int idx = (int)if_nametoindex("wmlinktest0");
+    CHECK(idx > 0 && link_query_up(idx) == 0);
+    CHECK(system("ip link set wmlinktest0 up") == 0);
+    CHECK(link_query_up(idx) == 1);
+    CHECK(system("ip link set wmlinktest0 down") == 0);
+    CHECK(link_query_up(idx) == 0);
+    CHECK(system("ip link del wmlinktest0") == 0);
+    CHECK(link_query_up(idx) == 0);
+}
+
+int main(void) {
+    test_flags();
+    test_query();
+    if (failures) {
+        fprintf(stderr, "link_state_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("link_state_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* -O publisher: template output, alert merge and drop accounting. */
+#define WIFI_METRICS_NO_MAIN
+#include "../wifi_metrics_sender.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static int recv_text(int fd, char *buf, size_t len) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, 1000) != 1) return -1;
+    ssize_t n = recv(fd, buf, len - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return (int)n;
+}
+
+int main(void) {
+    char path[] = "/tmp/osd-pub-test.XXXXXX";
+    if (!mkdtemp(path)) return 1;
+    char sock_path[64];
+    snprintf(sock_path, sizeof(sock_path), "%s/osd.sock", path);
+
+    int rx = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", sock_path);
+    if (rx < 0 || bind(rx, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        perror("bind");
+        return 1;
+    }
+
+    static struct osd_publisher p;
+    CHECK(osd_publisher_open(&p, sock_path, false) == 0);
+
+    /* First sample: same bytes the old snprintf builder (and osd_feed) produced. */
+    struct metrics m;
+    memset(&m, 0, sizeof(m));
+    m.valid_rssi = true;
+    m.rssi_norm = 84.62;
+    m.valid_link_tx = true;
+    m.link_tx_norm = 97.1;
+    osd_publisher_sample(&p, &m);
+
+    char got[1024], want[1024], text_buf[2][64];
+    const char *texts[2] = { text_buf[0], text_buf[1] };
+    const double values[2] = { 84.62, 97.1 };
+    const bool present[2] = { true, true };
+    osd_format_label(text_buf[0], sizeof(text_buf[0]), "RSSI", 1, 0.0);
+    osd_format_label(text_buf[1], sizeof(text_buf[1]), "Link TX", 1, 0.0);
+    osd_build_payload(texts, values, present, 2, 0, want, sizeof(want));
+    CHECK(recv_text(rx, got, sizeof(got)) > 0);
+    if (strcmp(got, want) != 0) {
+        fprintf(stderr, "got  %swant %s", got, want);
+        failures++;
+    }
+
+    /* An event adds a plain alert entry without counter or rate. */
+    osd_publisher_event(&p, "disconnect", 0.0);
+    CHECK(recv_text(rx, got, sizeof(got)) > 0);
+    CHECK(strstr(got, "\"RSSI #2 @ ") != NULL);
+    CHECK(strstr(got, ",\"! Link lost\"],\"value\":[84.62,97.10,0.00]}\n") != NULL);
+    CHECK(p.counter == 2 && p.drops == 0);
+
+    /* Fast-path RSSI merge reuses the compiled template. */
+    size_t nops = p.tpl.nops;
+    osd_publisher_rssi(&p, 50.0);
+    CHECK(recv_text(rx, got, sizeof(got)) > 0);
+    CHECK(strstr(got, "\"value\":[50.00,97.10,0.00]") != NULL);
+    CHECK(p.tpl.nops == nops);
+
+    /* No reader: counted as a drop, never queued. */
+    close(rx);
+    unlink(sock_path);
+    osd_publisher_sample(&p, &m);
+    CHECK(p.drops == 1);
+    CHECK(p.counter == 3);
+
+    osd_publisher_close(&p);
+    rmdir(path);
+    if (failures) {
+        fprintf(stderr, "osd_publisher_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("osd_publisher_test: ok\n");
+    return 0;
+}
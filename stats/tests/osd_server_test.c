@@ -0,0 +1,73 @@
+/* osd_feed -N: a drone's routine samples and events share one source slot. */
+#define OSD_FEED_NO_MAIN
+#include "../osd_feed.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void send_to(int fd, const struct sockaddr_in *dst, const char *payload) {
+    if (sendto(fd, payload, strlen(payload), 0, (const struct sockaddr *)dst, sizeof(*dst)) < 0) {
+        perror("sendto");
+        failures++;
+    }
+}
+
+int main(void) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    static struct worker w;
+    w.fd = server_socket(&addr);
+    socklen_t len = sizeof(addr);
+    if (w.fd < 0 || getsockname(w.fd, (struct sockaddr *)&addr, &len) < 0) return 1;
+    w.shm = calloc(1, osd_shm_size(8));
+    w.table = calloc(16, sizeof(struct source_ref));
+    if (!w.shm || !w.table) return 1;
+    w.shm->slot_count = 8;
+    w.mask = 15;
+    w.alert_ms = 3000;
+    pthread_create(&w.thread, NULL, worker_main, &w);
+
+    /* Routine and event lanes on separate sockets, so separate source ports. */
+    int routine = socket(AF_INET, SOCK_DGRAM, 0), events = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local = { .sin_family = AF_INET };
+    len = sizeof(local);
+    if (routine < 0 || events < 0 || bind(routine, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+        getsockname(routine, (struct sockaddr *)&local, &len) < 0) {
+        perror("socket");
+        return 1;
+    }
+    char event[160];
+    snprintf(event, sizeof(event),
+             "{\"type\":\"event\",\"event\":\"disconnect\",\"seq\":1,\"station\":\"\",\"value\":0,\"src_port\":%u}\n",
+             (unsigned)ntohs(local.sin_port));
+    send_to(routine, &addr, "{\"text\":[\"RSSI\"],\"value\":[80.00]}\n");
+    send_to(events, &addr, event);
+
+    for (int i = 0; i < 100 && atomic_load(&w.datagrams) < 2; i++) usleep(10000);
+    g_stop = 1;
+    pthread_join(w.thread, NULL);
+
+    CHECK(atomic_load(&w.datagrams) == 2);
+    CHECK(atomic_load(&w.shm->used) == 1);
+    const struct osd_shm_slot *s = &w.shm->slot[0];
+    CHECK(s->updates == 2);
+    CHECK(s->count == 1 && s->value[0] == 80.0);
+    CHECK(strcmp(s->alert, osd_event_text("disconnect")) == 0);
+
+    close(routine);
+    close(events);
+    close(w.fd);
+    free(w.table);
+    free(w.shm);
+    if (failures) {
+        fprintf(stderr, "osd_server_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("osd_server_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#!/bin/sh
+# ubus_get.sh -- Call wifi_metrics.get on a -DWITH_UBUS sender against a private ubusd
+# Usage:
+#   tests/ubus_get.sh [SENDER]     # default: ./wifi_metrics_sender-ubus (make ubus)
+#
+# Associates a mac80211_hwsim STA to a hostapd AP in two namespaces, starts a
+# stand-in ubusd on a temporary socket (-s) and runs the sender with -u on the
+# STA. Passes when `ubus call wifi_metrics get` returns the interface, the AP's
+# MAC, a tick count and an RSSI score, and when the object is back after ubusd
+# restarts without the sender spinning meanwhile. Exits 77 (skip) without root,
+# ubusd, ubus, mac80211_hwsim, hostapd or wpa_supplicant.
+
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+SENDER=${1:-$DIR/wifi_metrics_sender-ubus}
+
+skip() { echo "ubus_get: skipped, $1" >&2; exit 77; }
+[ "$(id -u)" -eq 0 ] || skip "needs root"
+for t in ubusd ubus hostapd wpa_supplicant iw; do
+  command -v $t >/dev/null 2>&1 || skip "missing $t"
+done
+[ -x "$SENDER" ] || skip "no $SENDER (make ubus)"
+modprobe mac80211_hwsim radios=2 2>/dev/null || skip "no mac80211_hwsim"
+
+NS_AP=wmu-ap
+NS_STA=wmu-sta
+TMP=$(mktemp -d /tmp/ubus-get.XXXXXX)
+PIDS=""
+
+cleanup() {
+  for p in $PIDS; do kill "$p" 2>/dev/null; done
+  sleep 0.3
+  ip netns del $NS_AP 2>/dev/null
+  ip netns del $NS_STA 2>/dev/null
+  rmmod mac80211_hwsim 2>/dev/null
+  rm -rf "$TMP"
+}
+trap cleanup EXIT INT TERM
+fail() { echo "ubus_get: FAIL, $1" >&2; cat "$TMP/sender.log" >&2; exit 1; }
+
+sleep 0.5
+set -- $(ls /sys/class/ieee80211 | sort -V | tail -n 2)
+ip netns add $NS_AP
+ip netns add $NS_STA
+iw phy "$1" set netns name $NS_AP
+iw phy "$2" set netns name $NS_STA
+IF_AP=$(ip netns exec $NS_AP iw dev | awk '/Interface/ {print $2; exit}')
+IF_STA=$(ip netns exec $NS_STA iw dev | awk '/Interface/ {print $2; exit}')
+AP_MAC=$(ip netns exec $NS_AP cat /sys/class/net/"$IF_AP"/address)
+
+printf 'interface=%s\ndriver=nl80211\nssid=wmu\nhw_mode=g\nchannel=1\n' "$IF_AP" >"$TMP/hostapd.conf"
+printf 'network={\n  ssid="wmu"\n  key_mgmt=NONE\n}\n' >"$TMP/wpa.conf"
+ip netns exec $NS_AP hostapd -B -P "$TMP/hostapd.pid" "$TMP/hostapd.conf" >/dev/null || fail "hostapd"
+PIDS="$PIDS $(cat "$TMP/hostapd.pid")"
+ip netns exec $NS_STA wpa_supplicant -B -P "$TMP/wpa.pid" -i "$IF_STA" -c "$TMP/wpa.conf" >/dev/null || fail "wpa_supplicant"
+PIDS="$PIDS $(cat "$TMP/wpa.pid")"
+i=0
+until ip netns exec $NS_STA iw dev "$IF_STA" link | grep -q Connected; do
+  i=$((i + 1))
+  [ $i -lt 100 ] || fail "STA did not associate"
+  sleep 0.1
+done
+
+ubusd -s "$TMP/ubus.sock" &
+UBUSD=$!
+PIDS="$PIDS $UBUSD"
+sleep 0.2
+ip netns exec $NS_STA ip link set lo up
+ip netns exec $NS_STA "$SENDER" -d "$IF_STA" -H 127.0.0.1 -i 100 -u -s "$TMP/ubus.sock" \
+  >"$TMP/sender.log" 2>&1 &
+SENDER_PID=$!
+PIDS="$PIDS $SENDER_PID"
+
+i=0
+until ubus -s "$TMP/ubus.sock" call wifi_metrics get >"$TMP/get.json" 2>/dev/null &&
+      grep -q '"rssi": [0-9]' "$TMP/get.json"; do
+  i=$((i + 1))
+  [ $i -lt 50 ] || fail "no rssi from get: $(cat "$TMP/get.json" 2>/dev/null)"
+  sleep 0.1
+done
+
+grep -q "\"device\": \"$IF_STA\"" "$TMP/get.json" || fail "device is not $IF_STA"
+grep -qi "\"station\": \"$AP_MAC\"" "$TMP/get.json" || fail "station is not $AP_MAC"
+grep -q '"ticks": [1-9]' "$TMP/get.json" || fail "ticks did not advance"
+
+# ubusd restart: the sender must not spin on the dead socket and must publish again.
+kill "$UBUSD"
+cpu0=$(awk '{print $14 + $15}' /proc/$SENDER_PID/stat)
+sleep 2
+cpu1=$(awk '{print $14 + $15}' /proc/$SENDER_PID/stat)
+[ $((cpu1 - cpu0)) -lt 50 ] || fail "sender used $((cpu1 - cpu0)) ticks of CPU in 2 s without ubusd"
+grep -q "ubus connection lost" "$TMP/sender.log" || fail "connection loss not noticed"
+ubusd -s "$TMP/ubus.sock" &
+PIDS="$PIDS $!"
+i=0
+until ubus -s "$TMP/ubus.sock" call wifi_metrics get >"$TMP/get.json" 2>/dev/null; do
+  i=$((i + 1))
+  [ $i -lt 100 ] || fail "wifi_metrics not back after the ubusd restart"
+  sleep 0.1
+done
+echo "ubus_get: ok ($IF_STA -> $AP_MAC, survives an ubusd restart)"
@@ -1,29 +1,162 @@
 #define _GNU_SOURCE
 #include <arpa/inet.h>
+#include <dirent.h>
 #include <errno.h>
 #include <ctype.h>
 #include <math.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
 #include <time.h>
 #include <unistd.h>
 #include <limits.h>
 
+#include "osd_format.h"
+#include "wmlog_format.h"
+
+#ifdef WITH_UBUS
+#include <libubus.h>
+#include <libubox/blobmsg.h>
+#endif
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_signal(int sig) { (void)sig; g_stop = 1; }
+
+enum counter_id {
+    CTR_TX_PACKETS,
+    CTR_TX_RETRIES,
+    CTR_TX_FAILED,
+    CTR_BEACON_LOSS,
+    CTR_RX_PACKETS,
+    CTR_RX_DROP_MISC,
+    CTR_RX_DUPLICATES,
+    CTR_COUNT
+};
+
+/* Counters are kept as read from the driver; `have` has a bit per counter_id that was reported. */
 struct station_sample {
     double signal_dbm;
-    double tx_packets;
-    double tx_retries;
-    double tx_failed;
-    double beacon_loss;
-    double rx_packets;
-    double rx_duplicates;
-    double rx_drop_misc;
+    uint64_t counter[CTR_COUNT];
+    uint32_t have;
+};
+
+#define SAMPLE_HAS(s, id) (((s)->have >> (id)) & 1u)
+
+static void sample_set(struct station_sample *s, enum counter_id id, uint64_t value) {
+    s->counter[id] = value;
+    s->have |= 1u << id;
+}
+
+static double sample_counter(const struct station_sample *s, enum counter_id id) {
+    return SAMPLE_HAS(s, id) ? (double)s->counter[id] : NAN;
+}
+
+#define AQM_MAX_TIDS 16
+#define AQM_ACS      4
+#define QUEUE_DELAY_CAP_MS 250.0
+
+static const char *const aqm_ac_names[AQM_ACS] = { "VO", "VI", "BE", "BK" };
+
+/* Derived from the per-station mac80211 `aqm` file; see aqm_update(). */
+struct queue_metrics {
+    double backlog_bytes;
+    double backlog_packets;
+    double drop_rate;         /* drops + overlimit per second */
+    double mark_rate;         /* CoDel ECN marks per second */
+    double delay_ms;          /* backlog / recent drain rate, capped */
+    double ac_backlog_bytes[AQM_ACS];
+    double ac_drop_rate[AQM_ACS];
+    double score;
+    bool valid;
+};
+
+enum host_psi { HOST_PSI_CPU, HOST_PSI_MEMORY, HOST_PSI_IO, HOST_PSI_COUNT };
+
+static const char *const host_psi_names[HOST_PSI_COUNT] = { "cpu", "memory", "io" };
+
+/* Router load from /proc and zram; see host_update(). NAN marks inputs the kernel lacks. */
+struct host_metrics {
+    double cpu_busy_pct;
+    double softirq_pct;       /* share of CPU time spent in softirq */
+    double net_rx_rate;       /* NET_RX softirqs per second, all CPUs */
+    double net_tx_rate;
+    double softnet_drop_rate; /* backlog drops per second (softnet_stat col 2) */
+    double softnet_squeeze_rate;
+    double psi_some_avg10[HOST_PSI_COUNT];
+    double mem_avail_pct;
+    double zram_orig_bytes;
+    double zram_used_bytes;
+    double zram_ratio;        /* orig / compressed */
+    double score;
+    bool valid;
+};
+
+/* Channel quality from mac80211 statistics and mt76 false CCA; see rf_update(). NAN marks missing inputs. */
+struct rf_metrics {
+    double fcs_error_rate;    /* frames failing FCS per second, whole channel */
+    double fcs_error_ratio;   /* FCS errors / (FCS errors + station RX packets) */
+    double false_cca_rate;    /* per second, from the driver's per-window count */
+    double ack_fail_rate;
+    double rts_fail_ratio;    /* RTS failures / RTS attempts */
+    double score;
+    bool valid;
+};
+
+#define FAST_MAX_CHAINS 4
+
+/* One nl80211 GET_STATION reply, see fast_path_tick(). */
+struct fast_sample {
+    double signal_dbm;
+    double signal_avg_dbm;
+    double chain_dbm[FAST_MAX_CHAINS]; /* by chain index, NAN where not reported */
+    int chains;               /* highest reported chain index + 1 */
+    double rx_rate_mbps;
+    int rx_mcs;               /* HT/VHT MCS, -1 for legacy rates */
+    double imbalance_db;      /* strongest - weakest chain */
+    double combining_gain_db; /* combined signal - strongest chain */
+    int best_chain;
+    uint64_t best_chain_switches;
+};
+
+#define PROBE_WINDOW         64
+#define PROBE_TRAIN_LEN      8
+#define PROBE_TRAIN_BYTES    1000
+#define PROBE_TRAIN_EVERY_MS 10000
+#define PROBE_TIMEOUT_MS     1000
+#define PROBE_ECHO_BYTES     128     /* charged per expected echo */
+#define PROBE_UDP_OVERHEAD   28      /* IPv4 + UDP headers */
+#define PROBE_CAPACITY_KEEP  5
+#define PROBE_REPORT_MS      1000
+
+/* Active probing results, see prober_tick(). */
+struct probe_stats {
+    double rtt_p50_ms;
+    double rtt_p90_ms;
+    double rtt_p99_ms;
+    double loss;              /* over the last PROBE_WINDOW pings */
+    double capacity_mbps;     /* median of recent packet trains, NAN until one completes */
+    uint64_t sent;
+    uint64_t echoed;
+    uint64_t trains;
+    uint64_t budget_skips;
 };
 
 struct metrics {
@@ -49,20 +182,159 @@ struct metrics {
     bool   valid_link_all;
 
     struct station_sample raw_station;
+    struct queue_metrics queue;
+    struct host_metrics host;
+    struct rf_metrics rf;
+    uint64_t t_us;           /* CLOCK_MONOTONIC when the counters were fetched */
+};
+
+/* 1 h at 10 Hz; 16 bytes per sample caps the ring at ~576 KiB. */
+#define HISTORY_MAX_SAMPLES 36000
+#define HISTORY_MAX_BUCKETS 360
+#define HISTORY_REPLY_MAX   32768
+#define HISTORY_SCORE_NONE  0xff
+
+/* Scores are stored in half-point steps (0..200); HISTORY_SCORE_NONE marks a gap. */
+struct history_sample {
+    uint32_t t_ms;
+    int8_t   signal_dbm;
+    uint8_t  rssi;
+    uint8_t  link_tx;
+    uint8_t  link_rx;
+    uint8_t  link_all;
+    uint16_t tx_pps;
+    uint16_t rx_pps;
+};
+
+struct history_ring {
+    struct history_sample *samples;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int fd;
+    const char *path;
+};
+
+/* Power of two; the sample loop never waits on the writer, it drops instead. */
+#define LOG_QUEUE_SLOTS  256
+#define LOG_FLUSH_MS     10000
+#define LOG_SYNC_BLOCKS  4
+#define LOG_MAX_FILES    8
+#define LOG_POLL_MS      200
+
+struct metrics_log {
+    /* Single-producer (sample loop) / single-consumer (writer thread) ring. */
+    struct wmlog_record queue[LOG_QUEUE_SLOTS];
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_bool stop;
+    atomic_ulong dropped;
+    pthread_t thread;
+    bool running;
+
+    /* Writer thread state. */
+    const char *dir;
+    uint64_t cap_bytes;
+    uint64_t file_cap_bytes;
+    int fd;
+    unsigned seq;
+    uint64_t file_bytes;
+    unsigned blocks_since_sync;
+    struct wmlog_record block[WMLOG_BLOCK_RECORDS];
+    size_t block_count;
+    struct timespec block_start;
+    uint8_t buf[WMLOG_BLOCK_HEADER + WMLOG_BLOCK_PAYLOAD_MAX];
+};
+
+#define EXPORTER_CLIENTS   4
+#define EXPORTER_REQ_MAX   1024
+#define EXPORTER_BODY_MAX  16384
+#define LATENCY_BUCKETS    11
+
+static const double latency_bounds_s[LATENCY_BUCKETS] = {
+    0.001, 0.002, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5,
+};
+
+struct latency_histogram {
+    uint64_t buckets[LATENCY_BUCKETS + 1];
+    double sum_s;
+    uint64_t count;
+};
+
+struct exporter_client {
+    int fd;
+    size_t req_len;
+    size_t out_len;
+    size_t out_off;
+    char req[EXPORTER_REQ_MAX];
+    char out[EXPORTER_BODY_MAX + 256];
+};
+
+/* Everything a scrape renders; updated once per tick, never sampled on demand. */
+struct exporter_snapshot {
+    struct metrics metrics;
+    bool have_metrics;
+    char device[64];
+    char station[32];
+    struct timespec updated;
+    uint64_t ticks;
+    uint64_t send_errors;
+    uint64_t fetch_errors;
+    uint64_t counter_wraps;
+    uint64_t counter_resets;
+    struct latency_histogram tick_latency;
+    struct latency_histogram fetch_latency;
+    struct fast_sample fast;
+    bool have_fast;
+    struct probe_stats probe;
+    bool have_probe;
 };
 
+struct exporter {
+    int listen_fd;
+    struct exporter_client clients[EXPORTER_CLIENTS];
+    char body[EXPORTER_BODY_MAX];
+    struct exporter_snapshot snap;
+};
+
+/* -e/-E redundancy limits; see transport_fec_format(). */
+#define FEC_MAX_DEPTH      8
+#define FEC_BUDGET_DEFAULT 256
+#define FEC_BUDGET_MAX     512
+
 static void usage(const char *argv0) {
     fprintf(stderr,
-        "Usage: %s [-d DEVICE] [-m MAC] [-L] [-H HOST] [-p PORT] [-i MS] [-c COUNT] [-v]\n"
-        "  -d DEVICE   Wireless interface (default: auto-detect managed STA)\n"
+        "Usage: %s [-d DEVICE] [-m MAC] [-L] [-H HOST] [-p PORT] [-i MS] [-c COUNT]\n"
+        "          [-Q PATH] [-R SECONDS] [-W DIR] [-S MB] [-P [ADDR:]PORT] [-F MS] [-T N] [-O PATH]\n"
+        "          [-e N] [-E BYTES] [-k MS] [-b BYTES] [-r SECONDS] [-U] [-u] [-v]\n"
+        "  -d DEVICE   Wireless interface (default: first station-mode nl80211 interface)\n"
         "  -m MAC      Lock onto specific peer MAC address\n"
         "  -L          List associated station MACs and exit\n"
         "  -H HOST     UDP receiver (default: 127.0.0.1)\n"
         "  -p PORT     UDP receiver port (default: 5005)\n"
         "  -i MS       Interval between sends (default: 1000 ms)\n"
         "  -c COUNT    Number of packets to send (default: 0 = infinite)\n"
+        "  -Q PATH     Keep an in-memory history ring and serve queries on this UNIX DGRAM socket\n"
+        "  -R SECONDS  History depth for -Q (default: 3600, bounded by %d samples)\n"
+        "  -W DIR      Append a binary metrics log (wm-NNNNNN.wml) under DIR, e.g. a USB stick\n"
+        "  -S MB       Total size cap for -W before the oldest file is removed (default: 64)\n"
+        "  -P [ADDR:]PORT  Serve OpenMetrics text at http://ADDR:PORT/metrics (default ADDR: 0.0.0.0)\n"
+        "  -F MS       Fast path: sample signal, per-chain RSSI and RX rate over nl80211 every MS\n"
+        "  -T N        Thin routine samples: send only when a score moved or every N ticks (default: 1)\n"
+        "  -O PATH     Publish OSD updates in-process to this UNIX DGRAM socket (replaces osd_feed;\n"
+        "              UDP output stops unless -H is also given)\n"
+        "  -e N        Repeat the previous N samples (max %d) in each datagram so osd_feed can fill losses\n"
+        "  -E BYTES    Byte cap per datagram for -e (default: %d, max %d)\n"
+        "  -k MS       Probe RTT every MS and capacity every %d s via osd_feed's echo\n"
+        "  -b BYTES    Probe airtime budget in bytes/s, echoes included (default: 4000)\n"
+        "  -r SECONDS  Send a per-rate success/goodput report from minstrel's rc_stats_csv every SECONDS\n"
+        "  -B FILE     Time parsing of an rc_stats_csv file and exit\n"
+        "  -U          Collect station counters via ubus iwinfo instead of forking iw (needs -DWITH_UBUS)\n"
+        "  -u          Publish the latest snapshot as ubus object wifi_metrics (needs -DWITH_UBUS)\n"
+        "  -s PATH     ubusd socket for -U/-u (default: libubus's own)\n"
         "  -v          Verbose logging of raw metrics\n",
-        argv0);
+        argv0, HISTORY_MAX_SAMPLES, FEC_MAX_DEPTH, FEC_BUDGET_DEFAULT, FEC_BUDGET_MAX,
+        PROBE_TRAIN_EVERY_MS / 1000);
 }
 
 static double clamp(double value, double lo, double hi) {
@@ -122,45 +394,6 @@ static int resolve_phy_name(const char *iface, char *phy_out, size_t phy_len) {
     return 0;
 }
 
-static int detect_default_interface(char *out, size_t out_len) {
-    FILE *fp = popen("iw dev", "r");
-    if (!fp) {
-        fprintf(stderr, "popen(iw dev) failed: %s\n", strerror(errno));
-        return -1;
-    }
-
-    char line[256];
-    char current[64] = {0};
-    bool found = false;
-
-    while (fgets(line, sizeof(line), fp)) {
-        char *trimmed = trim(line);
-        if (strncmp(trimmed, "Interface ", 10) == 0) {
-            sscanf(trimmed + 10, "%63s", current);
-        } else if (strncmp(trimmed, "type ", 5) == 0 && current[0]) {
-            char type[32] = {0};
-            sscanf(trimmed + 5, "%31s", type);
-            if (strcmp(type, "managed") == 0) {
-                strncpy(out, current, out_len - 1);
-                out[out_len - 1] = '\0';
-                found = true;
-                break;
-            }
-        }
-    }
-
-    int status = pclose(fp);
-    if (status == -1) {
-        fprintf(stderr, "iw dev command failed to close\n");
-        return -1;
-    }
-    if (!found) {
-        fprintf(stderr, "No managed interface found via iw dev\n");
-        return -1;
-    }
-    return 0;
-}
-
 static int list_stations(const char *iface) {
     char cmd[160];
     int written = snprintf(cmd, sizeof(cmd), "iw dev %s station dump", iface);
@@ -322,13 +555,18 @@ static int fetch_station_metrics(const char *iface, const char *target_mac,
     bool found = false;
     memset(out, 0, sizeof(*out));
     out->signal_dbm = NAN;
-    out->tx_packets = NAN;
-    out->tx_retries = NAN;
-    out->tx_failed = NAN;
-    out->beacon_loss = NAN;
-    out->rx_packets = NAN;
-    out->rx_duplicates = NAN;
-    out->rx_drop_misc = NAN;
+
+    static const struct {
+        const char *prefix;
+        enum counter_id id;
+    } iw_counters[] = {
+        { "tx packets:", CTR_TX_PACKETS },
+        { "tx retries:", CTR_TX_RETRIES },
+        { "tx failed:", CTR_TX_FAILED },
+        { "beacon loss:", CTR_BEACON_LOSS },
+        { "rx packets:", CTR_RX_PACKETS },
+        { "rx drop misc:", CTR_RX_DROP_MISC },
+    };
 
     while (fgets(line, sizeof(line), fp)) {
         char *trimmed = trim(line);
@@ -352,35 +590,15 @@ static int fetch_station_metrics(const char *iface, const char *target_mac,
             if (sscanf(trimmed, "signal: %lf", &sig) == 1) {
                 out->signal_dbm = sig;
             }
-        } else if (strncmp(trimmed, "tx packets:", 11) == 0) {
-            unsigned long long packets = 0;
-            if (sscanf(trimmed + 11, "%llu", &packets) == 1) {
-                out->tx_packets = (double)packets;
-            }
-        } else if (strncmp(trimmed, "tx retries:", 11) == 0) {
-            unsigned long long retries = 0;
-            if (sscanf(trimmed + 11, "%llu", &retries) == 1) {
-                out->tx_retries = (double)retries;
-            }
-        } else if (strncmp(trimmed, "tx failed:", 10) == 0) {
-            unsigned long long failed = 0;
-            if (sscanf(trimmed + 10, "%llu", &failed) == 1) {
-                out->tx_failed = (double)failed;
-            }
-        } else if (strncmp(trimmed, "beacon loss:", 12) == 0) {
-            unsigned long long loss = 0;
-            if (sscanf(trimmed + 12, "%llu", &loss) == 1) {
-                out->beacon_loss = (double)loss;
-            }
-        } else if (strncmp(trimmed, "rx packets:", 11) == 0) {
-            unsigned long long rxp = 0;
-            if (sscanf(trimmed + 11, "%llu", &rxp) == 1) {
-                out->rx_packets = (double)rxp;
-            }
-        } else if (strncmp(trimmed, "rx drop misc:", 13) == 0) {
-            unsigned long long drop = 0;
-            if (sscanf(trimmed + 13, "%llu", &drop) == 1) {
-                out->rx_drop_misc = (double)drop;
+        } else {
+            for (size_t i = 0; i < sizeof(iw_counters) / sizeof(iw_counters[0]); i++) {
+                size_t plen = strlen(iw_counters[i].prefix);
+                unsigned long long value;
+                if (strncmp(trimmed, iw_counters[i].prefix, plen) == 0 &&
+                    sscanf(trimmed + plen, "%llu", &value) == 1) {
+                    sample_set(out, iw_counters[i].id, value);
+                    break;
+                }
             }
         }
     }
@@ -398,7 +616,7 @@ static int fetch_station_metrics(const char *iface, const char *target_mac,
     return 0;
 }
 
-static int fetch_rx_duplicates(const char *phy, const char *iface, const char *mac, double *out_value) {
+static int fetch_rx_duplicates(const char *phy, const char *iface, const char *mac, uint64_t *out_value) {
     if (!phy || !iface || !mac || !out_value) return -1;
 
     char mac_lower[32];
@@ -413,188 +631,953 @@ static int fetch_rx_duplicates(const char *phy, const char *iface, const char *m
         return -1;
     }
 
-    double total = 0.0;
+    uint64_t total = 0;
     char line[256];
     while (fgets(line, sizeof(line), fp)) {
         char *colon = strchr(line, ':');
         if (!colon) continue;
-        colon++;
-        double value = strtod(colon, NULL);
-        if (!isnan(value)) {
-            total += value;
-        }
+        total += strtoull(colon + 1, NULL, 10);
     }
     fclose(fp);
     *out_value = total;
     return 0;
 }
 
-struct tx_counter_snapshot {
-    double tx_packets;
-    double tx_retries;
-    double tx_failed;
-    double beacon_loss;
-    bool valid;
+enum aqm_field {
+    AQM_TID, AQM_AC, AQM_BACKLOG_BYTES, AQM_BACKLOG_PACKETS, AQM_DROPS,
+    AQM_MARKS, AQM_OVERLIMIT, AQM_TX_BYTES, AQM_FIELDS
 };
 
-struct tx_link_metrics {
-    double ratio;
-    double retries_per_s;
-    double fails_per_s;
-    double beacon_per_s;
-    double packets_per_s;
-    double composite;
-    bool has_delta;
+static const char *const aqm_field_names[AQM_FIELDS] = {
+    "tid", "ac", "backlog-bytes", "backlog-packets", "drops",
+    "marks", "overlimit", "tx-bytes",
 };
 
-static bool compute_tx_link_metrics(const struct station_sample *current,
-                                    const struct tx_counter_snapshot *prev,
-                                    double interval_seconds,
-                                    struct tx_link_metrics *out) {
-    if (!out) return false;
-    memset(out, 0, sizeof(*out));
-    out->ratio = NAN;
-    out->composite = NAN;
-    out->has_delta = false;
+struct aqm_tid {
+    uint64_t v[AQM_FIELDS];
+    bool present;
+};
 
-    if (isnan(current->tx_packets) || isnan(current->tx_retries) ||
-        isnan(current->tx_failed) || isnan(current->beacon_loss)) {
-        return false;
-    }
+/*
+ * Holds the aqm file open and re-reads it with pread() into a fixed buffer,
+ * so a tick costs one syscall and no allocation. Column positions come from
+ * the header line because they have moved between kernel versions.
+ */
+struct aqm_reader {
+    int fd;
+    char mac[32];
+    int column[AQM_FIELDS];
+    struct aqm_tid prev[AQM_MAX_TIDS];
+    struct aqm_tid cur[AQM_MAX_TIDS];
+    bool have_prev;
+    char buf[4096];
+};
 
-    if (!prev || !prev->valid) {
-        out->ratio = 0.0;
-        out->composite = 100.0;
-        out->has_delta = false;
-        return true;
-    }
+static void aqm_close(struct aqm_reader *r) {
+    if (r->fd >= 0) close(r->fd);
+    r->fd = -1;
+    r->mac[0] = '\0';
+    r->have_prev = false;
+}
 
-    double delta_packets = current->tx_packets - prev->tx_packets;
-    double delta_retries = current->tx_retries - prev->tx_retries;
-    double delta_failed  = current->tx_failed  - prev->tx_failed;
-    double delta_beacon  = current->beacon_loss - prev->beacon_loss;
+static int aqm_open(struct aqm_reader *r, const char *phy, const char *iface, const char *mac) {
+    char mac_lower[32];
+    normalize_mac(mac, mac_lower, sizeof(mac_lower));
+    /* A station without an aqm file (no debugfs, non-mac80211 driver) is not retried. */
+    if (strcmp(r->mac, mac_lower) == 0) return r->fd >= 0 ? 0 : -1;
+    aqm_close(r);
 
-    if (delta_packets < 0.0 || delta_retries < 0.0 ||
-        delta_failed < 0.0 || delta_beacon < 0.0) {
-        out->ratio = 0.0;
-        out->composite = 100.0;
-        out->has_delta = false;
-        return true;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "/sys/kernel/debug/ieee80211/%s/netdev:%s/stations/%s/aqm",
+             phy, iface, mac_lower);
+    snprintf(r->mac, sizeof(r->mac), "%s", mac_lower);
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    return r->fd >= 0 ? 0 : -1;
+}
+
+static void aqm_parse_header(struct aqm_reader *r, char *line) {
+    for (int f = 0; f < AQM_FIELDS; f++) r->column[f] = -1;
+    int col = 0;
+    for (char *save = NULL, *tok = strtok_r(line, " \t", &save); tok;
+         tok = strtok_r(NULL, " \t", &save), col++) {
+        for (int f = 0; f < AQM_FIELDS; f++) {
+            if (strcmp(tok, aqm_field_names[f]) == 0) r->column[f] = col;
+        }
     }
+}
 
-    if (interval_seconds <= 0.0) interval_seconds = 1.0;
+/* Returns the number of TID rows parsed, or -1 if the file could not be read. */
+static int aqm_read(struct aqm_reader *r) {
+    ssize_t n = pread(r->fd, r->buf, sizeof(r->buf) - 1, 0);
+    if (n <= 0) return -1;
+    r->buf[n] = '\0';
 
-    out->packets_per_s = delta_packets / interval_seconds;
-    out->retries_per_s = delta_retries / interval_seconds;
-    out->fails_per_s   = delta_failed  / interval_seconds;
-    out->beacon_per_s  = delta_beacon  / interval_seconds;
+    memset(r->cur, 0, sizeof(r->cur));
+    bool have_header = false;
+    int rows = 0;
+    for (char *save = NULL, *line = strtok_r(r->buf, "\n", &save); line;
+         line = strtok_r(NULL, "\n", &save)) {
+        if (strncmp(line, "tid", 3) == 0) {
+            aqm_parse_header(r, line);
+            have_header = r->column[AQM_TID] >= 0;
+            continue;
+        }
+        if (!have_header || !isdigit((unsigned char)line[0])) continue;
 
-    double denom = delta_packets;
-    if (denom <= 0.0) denom = 1.0;
-    double weighted_failed = delta_failed * 4.0;
-    double ratio = (delta_retries + weighted_failed) / denom;
-    if (ratio < 0.0) ratio = 0.0;
-    out->ratio = ratio;
+        uint64_t vals[AQM_FIELDS] = {0};
+        int col = 0;
+        for (char *p = line; *p && col < 32; col++) {
+            while (*p == ' ' || *p == '\t') p++;
+            if (!*p) break;
+            char *end;
+            unsigned long long v = strtoull(p, &end, 10);
+            for (int f = 0; f < AQM_FIELDS; f++) {
+                if (r->column[f] == col) vals[f] = v;
+            }
+            p = end;
+            while (*p && *p != ' ' && *p != '\t') p++;
+        }
+        uint64_t tid = vals[AQM_TID];
+        if (tid >= AQM_MAX_TIDS || vals[AQM_AC] >= AQM_ACS) continue;
+        memcpy(r->cur[tid].v, vals, sizeof(vals));
+        r->cur[tid].present = true;
+        rows++;
+    }
+    return rows;
+}
 
-    double ratio_score  = 100.0 * (1.0 - clamp(ratio / 0.10, 0.0, 1.0));
-    double retry_score  = 100.0 * (1.0 - clamp(out->retries_per_s / 60.0, 0.0, 1.0));
-    double fail_score   = 100.0 * (1.0 - clamp(out->fails_per_s   / 3.0,  0.0, 1.0));
-    double beacon_score = 100.0 * (1.0 - clamp(out->beacon_per_s  / 1.0,  0.0, 1.0));
+/*
+ * Queue score: 60 % estimated queueing delay (0 ms -> 100, >= 100 ms -> 0),
+ * 25 % drops+overlimit (>= 10/s -> 0), 15 % ECN marks (>= 50/s -> 0).
+ */
+static bool aqm_update(struct aqm_reader *r, double interval_s, struct queue_metrics *out) {
+    memset(out, 0, sizeof(*out));
+    if (r->fd < 0 || aqm_read(r) <= 0) {
+        r->have_prev = false;
+        return false;
+    }
+    if (interval_s <= 0.0) interval_s = 1.0;
 
-    double composite = 0.55 * ratio_score +
-                       0.25 * retry_score +
-                       0.10 * fail_score +
-                       0.10 * beacon_score;
+    double drain_bytes = 0.0, drops = 0.0, marks = 0.0;
+    bool reset = false;
+    for (int tid = 0; tid < AQM_MAX_TIDS; tid++) {
+        const struct aqm_tid *c = &r->cur[tid];
+        if (!c->present) continue;
+        int ac = (int)c->v[AQM_AC];
+        out->backlog_bytes += (double)c->v[AQM_BACKLOG_BYTES];
+        out->backlog_packets += (double)c->v[AQM_BACKLOG_PACKETS];
+        out->ac_backlog_bytes[ac] += (double)c->v[AQM_BACKLOG_BYTES];
 
-    out->composite = clamp(composite, 0.0, 100.0);
-    out->has_delta = true;
+        const struct aqm_tid *p = &r->prev[tid];
+        if (!r->have_prev || !p->present) continue;
+        if (c->v[AQM_TX_BYTES] < p->v[AQM_TX_BYTES] || c->v[AQM_DROPS] < p->v[AQM_DROPS] ||
+            c->v[AQM_MARKS] < p->v[AQM_MARKS] || c->v[AQM_OVERLIMIT] < p->v[AQM_OVERLIMIT]) {
+            reset = true;
+            continue;
+        }
+        double d = (double)(c->v[AQM_DROPS] - p->v[AQM_DROPS]) +
+                   (double)(c->v[AQM_OVERLIMIT] - p->v[AQM_OVERLIMIT]);
+        drops += d;
+        out->ac_drop_rate[ac] += d / interval_s;
+        marks += (double)(c->v[AQM_MARKS] - p->v[AQM_MARKS]);
+        drain_bytes += (double)(c->v[AQM_TX_BYTES] - p->v[AQM_TX_BYTES]);
+    }
+    bool had_prev = r->have_prev && !reset;
+    memcpy(r->prev, r->cur, sizeof(r->prev));
+    r->have_prev = true;
+    if (!had_prev) return false;
+
+    out->drop_rate = drops / interval_s;
+    out->mark_rate = marks / interval_s;
+    double drain_rate = drain_bytes / interval_s;
+    if (out->backlog_bytes <= 0.0) {
+        out->delay_ms = 0.0;
+    } else if (drain_rate > 0.0) {
+        out->delay_ms = fmin(out->backlog_bytes * 1000.0 / drain_rate, QUEUE_DELAY_CAP_MS);
+    } else {
+        out->delay_ms = QUEUE_DELAY_CAP_MS;
+    }
+
+    double delay_score = 100.0 * (1.0 - clamp(out->delay_ms / 100.0, 0.0, 1.0));
+    double drop_score  = 100.0 * (1.0 - clamp(out->drop_rate / 10.0, 0.0, 1.0));
+    double mark_score  = 100.0 * (1.0 - clamp(out->mark_rate / 50.0, 0.0, 1.0));
+    out->score = clamp(0.60 * delay_score + 0.25 * drop_score + 0.15 * mark_score, 0.0, 100.0);
+    out->valid = true;
     return true;
 }
 
-struct rx_snapshot {
-    double rx_packets;
-    double rx_duplicates;
-    double rx_drop_misc;
+enum host_file {
+    HOST_STAT, HOST_SOFTIRQS, HOST_SOFTNET, HOST_MEMINFO, HOST_ZRAM,
+    HOST_PRESSURE, HOST_FILES = HOST_PRESSURE + HOST_PSI_COUNT
 };
 
-struct rx_link_metrics {
-    double ratio;
-    double retry_rate;
-    double drop_rate;
-    double packets_per_s;
-    double composite;
-    bool has_delta;
+static const char *const host_paths[HOST_FILES] = {
+    "/proc/stat", "/proc/softirqs", "/proc/net/softnet_stat", "/proc/meminfo",
+    "/sys/block/zram0/mm_stat",
+    "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
 };
 
-static bool compute_rx_link_metrics(const struct rx_snapshot *current,
-                                    const struct rx_snapshot *prev,
-                                    double interval_seconds,
-                                    struct rx_link_metrics *out) {
-    if (!out) return false;
+struct host_counters {
+    uint64_t cpu_total;
+    uint64_t cpu_idle;        /* idle + iowait */
+    uint64_t cpu_softirq;
+    uint64_t net_rx;
+    uint64_t net_tx;
+    uint64_t softnet_drops;
+    uint64_t softnet_squeeze;
+};
+
+/*
+ * Router-side load. Every file is opened once at startup and re-read with
+ * pread() into one fixed buffer per tick, like the aqm reader; files the
+ * kernel does not provide (no PSI, no zram) stay closed and their inputs
+ * drop out of the score.
+ */
+struct host_reader {
+    int fd[HOST_FILES];
+    struct host_counters prev;
+    bool have_prev;
+    char buf[8192];
+};
+
+static void host_open(struct host_reader *h) {
+    memset(h, 0, sizeof(*h));
+    for (int i = 0; i < HOST_FILES; i++) {
+        h->fd[i] = open(host_paths[i], O_RDONLY | O_CLOEXEC);
+    }
+}
+
+static void host_close(struct host_reader *h) {
+    for (int i = 0; i < HOST_FILES; i++) {
+        if (h->fd[i] >= 0) close(h->fd[i]);
+        h->fd[i] = -1;
+    }
+}
+
+static const char *host_read(struct host_reader *h, enum host_file f) {
+    if (h->fd[f] < 0) return NULL;
+    ssize_t n = pread(h->fd[f], h->buf, sizeof(h->buf) - 1, 0);
+    if (n <= 0) return NULL;
+    h->buf[n] = '\0';
+    return h->buf;
+}
+
+/* Sums the per-CPU columns of a /proc/softirqs row such as "NET_RX:". */
+static uint64_t host_softirq_row(const char *text, const char *name) {
+    const char *p = strstr(text, name);
+    if (!p) return 0;
+    p += strlen(name);
+    uint64_t total = 0;
+    while (*p && *p != '\n') {
+        char *end;
+        unsigned long long v = strtoull(p, &end, 10);
+        if (end == p) break;
+        total += v;
+        p = end;
+    }
+    return total;
+}
+
+static double host_meminfo_kb(const char *text, const char *key) {
+    const char *p = strstr(text, key);
+    return p ? strtod(p + strlen(key), NULL) : NAN;
+}
+
+/*
+ * Host score: 40 % CPU (busy <= 50 % -> 100, 100 % -> 0, capped by CPU PSI
+ * some avg10 >= 50 % -> 0), 30 % network backlog (>= 10 softnet drops/s or
+ * >= 100 squeezes/s -> 0), 30 % memory (MemAvailable >= 25 % -> 100,
+ * <= 5 % -> 0, capped by memory PSI some avg10 >= 20 % -> 0).
+ */
+static bool host_update(struct host_reader *h, double interval_s, struct host_metrics *out) {
     memset(out, 0, sizeof(*out));
-    out->ratio = NAN;
-    out->retry_rate = NAN;
-    out->drop_rate = NAN;
-    out->composite = NAN;
-    out->has_delta = false;
+    for (int i = 0; i < HOST_PSI_COUNT; i++) out->psi_some_avg10[i] = NAN;
+    out->mem_avail_pct = out->zram_orig_bytes = out->zram_used_bytes = out->zram_ratio = NAN;
+    if (interval_s <= 0.0) interval_s = 1.0;
 
-    if (!prev) {
-        out->ratio = 0.0;
-        out->retry_rate = 0.0;
-        out->drop_rate = 0.0;
-        out->composite = 100.0;
-        return true;
+    struct host_counters cur = {0};
+    const char *text = host_read(h, HOST_STAT);
+    if (!text) {
+        h->have_prev = false;
+        return false;
+    }
+    unsigned long long v[8] = {0};
+    if (sscanf(text, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 7) {
+        h->have_prev = false;
+        return false;
+    }
+    for (int i = 0; i < 8; i++) cur.cpu_total += v[i];
+    cur.cpu_idle = v[3] + v[4];
+    cur.cpu_softirq = v[6];
+
+    if ((text = host_read(h, HOST_SOFTIRQS))) {
+        cur.net_rx = host_softirq_row(text, "NET_RX:");
+        cur.net_tx = host_softirq_row(text, "NET_TX:");
+    }
+    if ((text = host_read(h, HOST_SOFTNET))) {
+        /* One line per CPU, hex: processed dropped time_squeeze ... */
+        for (const char *line = text; *line; ) {
+            unsigned int processed, dropped, squeeze;
+            if (sscanf(line, "%x %x %x", &processed, &dropped, &squeeze) == 3) {
+                cur.softnet_drops += dropped;
+                cur.softnet_squeeze += squeeze;
+            }
+            const char *nl = strchr(line, '\n');
+            if (!nl) break;
+            line = nl + 1;
+        }
+    }
+    if ((text = host_read(h, HOST_MEMINFO))) {
+        double total = host_meminfo_kb(text, "MemTotal:");
+        double avail = host_meminfo_kb(text, "MemAvailable:");
+        if (total > 0.0 && !isnan(avail)) out->mem_avail_pct = 100.0 * avail / total;
+    }
+    if ((text = host_read(h, HOST_ZRAM))) {
+        unsigned long long orig, compr, used;
+        if (sscanf(text, "%llu %llu %llu", &orig, &compr, &used) == 3) {
+            out->zram_orig_bytes = (double)orig;
+            out->zram_used_bytes = (double)used;
+            out->zram_ratio = compr ? (double)orig / (double)compr : NAN;
+        }
+    }
+    for (int i = 0; i < HOST_PSI_COUNT; i++) {
+        if ((text = host_read(h, HOST_PRESSURE + i))) {
+            const char *p = strstr(text, "some avg10=");
+            if (p) out->psi_some_avg10[i] = strtod(p + 11, NULL);
+        }
     }
 
-    double delta_packets = current->rx_packets - prev->rx_packets;
-    double delta_duplicates = current->rx_duplicates - prev->rx_duplicates;
-    double delta_drop = current->rx_drop_misc - prev->rx_drop_misc;
+    struct host_counters p = h->prev;
+    bool had_prev = h->have_prev && cur.cpu_total > p.cpu_total &&
+                    cur.cpu_idle >= p.cpu_idle && cur.cpu_softirq >= p.cpu_softirq &&
+                    cur.net_rx >= p.net_rx && cur.net_tx >= p.net_tx &&
+                    cur.softnet_drops >= p.softnet_drops && cur.softnet_squeeze >= p.softnet_squeeze;
+    h->prev = cur;
+    h->have_prev = true;
+    if (!had_prev) return false;
 
-    if (delta_packets < 0.0 || delta_duplicates < 0.0 || delta_drop < 0.0) {
-        out->ratio = 0.0;
-        out->retry_rate = 0.0;
-        out->drop_rate = 0.0;
-        out->composite = 100.0;
-        return true;
+    double total = (double)(cur.cpu_total - p.cpu_total);
+    out->cpu_busy_pct = 100.0 * (1.0 - (double)(cur.cpu_idle - p.cpu_idle) / total);
+    out->softirq_pct = 100.0 * (double)(cur.cpu_softirq - p.cpu_softirq) / total;
+    out->net_rx_rate = (double)(cur.net_rx - p.net_rx) / interval_s;
+    out->net_tx_rate = (double)(cur.net_tx - p.net_tx) / interval_s;
+    out->softnet_drop_rate = (double)(cur.softnet_drops - p.softnet_drops) / interval_s;
+    out->softnet_squeeze_rate = (double)(cur.softnet_squeeze - p.softnet_squeeze) / interval_s;
+
+    double cpu_score = 100.0 * (1.0 - clamp((out->cpu_busy_pct - 50.0) / 50.0, 0.0, 1.0));
+    if (!isnan(out->psi_some_avg10[HOST_PSI_CPU])) {
+        cpu_score = fmin(cpu_score, 100.0 * (1.0 - clamp(out->psi_some_avg10[HOST_PSI_CPU] / 50.0, 0.0, 1.0)));
+    }
+    double net_score = 100.0 * (1.0 - clamp(fmax(out->softnet_drop_rate / 10.0,
+                                                 out->softnet_squeeze_rate / 100.0), 0.0, 1.0));
+    double mem_score = 100.0;
+    if (!isnan(out->mem_avail_pct)) {
+        mem_score = 100.0 * clamp((out->mem_avail_pct - 5.0) / 20.0, 0.0, 1.0);
+    }
+    if (!isnan(out->psi_some_avg10[HOST_PSI_MEMORY])) {
+        mem_score = fmin(mem_score, 100.0 * (1.0 - clamp(out->psi_some_avg10[HOST_PSI_MEMORY] / 20.0, 0.0, 1.0)));
     }
+    out->score = clamp(0.40 * cpu_score + 0.30 * net_score + 0.30 * mem_score, 0.0, 100.0);
+    out->valid = true;
+    return true;
+}
 
-    if (interval_seconds <= 0.0) interval_seconds = 1.0;
+/* mt76 recomputes false CCA on its 100 ms watchdog (mt7603 mac work, mt76x2 calibration). */
+#define RF_CCA_WINDOW_MS 100
 
-    out->retry_rate = delta_duplicates / interval_seconds;
-    out->drop_rate  = delta_drop / interval_seconds;
-    out->packets_per_s = delta_packets / interval_seconds;
+enum rf_file { RF_FCS, RF_ACK_FAIL, RF_RTS_FAIL, RF_RTS_OK, RF_COUNTERS, RF_RADIO = RF_COUNTERS, RF_AGC, RF_FILES };
 
-    double denom = delta_packets;
-    if (denom <= 0.0) denom = 1.0;
-    double ratio = delta_duplicates / denom;
-    if (ratio < 0.0) ratio = 0.0;
-    out->ratio = ratio;
+static const char *const rf_paths[RF_FILES] = {
+    "statistics/dot11FCSErrorCount", "statistics/dot11ACKFailureCount",
+    "statistics/dot11RTSFailureCount", "statistics/dot11RTSSuccessCount",
+    "mt76/radio", "mt76/agc",
+};
 
-    double ratio_score      = 100.0 * (1.0 - clamp(ratio / 0.08, 0.0, 1.0));
-    double retry_rate_score = 100.0 * (1.0 - clamp(out->retry_rate / 50.0, 0.0, 1.0));
-    double drop_rate_score  = 100.0 * (1.0 - clamp(out->drop_rate  / 5.0,  0.0, 1.0));
+/*
+ * Per-phy interference inputs under /sys/kernel/debug/ieee80211/<phy>/,
+ * held open and re-read with pread() like the host reader. Which files the
+ * phy really has is settled once at open: a statistics file answering "Not
+ * supported" (no driver get_stats, e.g. phy0 on the router) is closed there
+ * and not retried until the phy changes. The dot11 files are running
+ * totals; mt76 false CCA ("radio" on mt7603, "agc" on mt76x2) is a count
+ * over the driver's last watchdog window.
+ */
+struct rf_reader {
+    char phy[64];
+    bool open;
+    int fd[RF_FILES];
+    uint64_t prev[RF_COUNTERS];
+    bool have_prev[RF_COUNTERS];
+    char buf[512];
+};
 
-    double composite = 0.7 * ratio_score + 0.2 * retry_rate_score + 0.1 * drop_rate_score;
-    out->composite = clamp(composite, 0.0, 100.0);
-    out->has_delta = true;
+static const char *rf_read(struct rf_reader *r, enum rf_file f) {
+    if (r->fd[f] < 0) return NULL;
+    ssize_t n = pread(r->fd[f], r->buf, sizeof(r->buf) - 1, 0);
+    if (n <= 0) return NULL;
+    r->buf[n] = '\0';
+    return r->buf;
+}
+
+static bool rf_read_counter(struct rf_reader *r, enum rf_file f, uint64_t *out) {
+    const char *text = rf_read(r, f);
+    if (!text) return false;
+    char *end;
+    unsigned long long v = strtoull(text, &end, 10);
+    if (end == text) return false;
+    *out = v;
     return true;
 }
 
-static struct metrics derive_metrics(const struct station_sample *sample,
-                                     const struct tx_link_metrics *tx,
-                                     const struct rx_link_metrics *rx,
-                                     double link_all, bool link_all_valid) {
-    struct metrics m = {0};
-    m.tx_retry_ratio = NAN;
-    m.tx_retry_rate = NAN;
-    m.tx_fail_rate = NAN;
-    m.tx_beacon_rate = NAN;
-    m.tx_packet_rate = NAN;
-    m.rx_retry_ratio = NAN;
-    m.rx_retry_rate = NAN;
-    m.rx_drop_rate = NAN;
-    m.link_tx_norm = NAN;
-    m.link_rx_norm = NAN;
+static bool rf_read_false_cca(struct rf_reader *r, double *out) {
+    const char *text = rf_read(r, RF_RADIO);
+    const char *p;
+    if (text && (p = strstr(text, "False CCA:"))) {
+        /* "False CCA: ofdm=12 cck=3" */
+        const char *ofdm = strstr(p, "ofdm=");
+        const char *cck = strstr(p, "cck=");
+        if (!ofdm && !cck) return false;
+        *out = (ofdm ? strtod(ofdm + 5, NULL) : 0.0) + (cck ? strtod(cck + 4, NULL) : 0.0);
+        return true;
+    }
+    text = rf_read(r, RF_AGC);
+    if (text && (p = strstr(text, "false_cca:"))) {
+        *out = strtod(p + 10, NULL);
+        return true;
+    }
+    return false;
+}
+
+static void rf_close(struct rf_reader *r) {
+    if (!r->open) return;
+    for (int i = 0; i < RF_FILES; i++) {
+        if (r->fd[i] >= 0) close(r->fd[i]);
+        r->fd[i] = -1;
+    }
+    memset(r->have_prev, 0, sizeof(r->have_prev));
+    r->phy[0] = '\0';
+    r->open = false;
+}
+
+static void rf_open(struct rf_reader *r, const char *phy) {
+    if (r->open && strcmp(r->phy, phy) == 0) return;
+    rf_close(r);
+    if (!phy[0]) return;
+    snprintf(r->phy, sizeof(r->phy), "%s", phy);
+    for (int i = 0; i < RF_FILES; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "/sys/kernel/debug/ieee80211/%s/%s", phy, rf_paths[i]);
+        r->fd[i] = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    r->open = true;
+    uint64_t v;
+    for (int i = 0; i < RF_COUNTERS; i++) {
+        if (r->fd[i] >= 0 && !rf_read_counter(r, i, &v)) {
+            close(r->fd[i]);
+            r->fd[i] = -1;
+        }
+    }
+    double cca;
+    if (!rf_read_false_cca(r, &cca)) {
+        for (int i = RF_RADIO; i < RF_FILES; i++) {
+            if (r->fd[i] >= 0) close(r->fd[i]);
+            r->fd[i] = -1;
+        }
+    }
+}
+
+/*
+ * Interference score: 50 % false CCA (<= 1000/s -> 100, >= 6000/s -> 0),
+ * 35 % FCS errors (<= 5 % of frames -> 100, >= 30 % -> 0), 15 % RTS
+ * failures (<= 10 % -> 100, >= 50 % -> 0). False CCA is energy that never
+ * decoded as a preamble, so it counts as is. Corrupt frames and lost RTS are
+ * also what a weak link produces, so they only count in proportion to how
+ * strong the station's signal is (-80 dBm -> not at all, -65 dBm -> fully):
+ * a low RSSI with a clean score is a weak link, a good RSSI with a low score
+ * is co-channel noise. Missing inputs drop out and the rest are reweighted.
+ */
+static bool rf_update(struct rf_reader *r, double signal_dbm, double rx_packet_rate,
+                      double interval_s, struct rf_metrics *out) {
+    memset(out, 0, sizeof(*out));
+    out->fcs_error_rate = out->fcs_error_ratio = out->false_cca_rate = NAN;
+    out->ack_fail_rate = out->rts_fail_ratio = NAN;
+    if (!r->open) return false;
+    if (interval_s <= 0.0) interval_s = 1.0;
+
+    double delta[RF_COUNTERS];
+    for (int i = 0; i < RF_COUNTERS; i++) {
+        uint64_t v = 0;
+        bool have = rf_read_counter(r, i, &v);
+        delta[i] = have && r->have_prev[i] && v >= r->prev[i] ? (double)(v - r->prev[i]) : NAN;
+        r->prev[i] = v;
+        r->have_prev[i] = have;
+    }
+    out->fcs_error_rate = delta[RF_FCS] / interval_s;
+    if (!isnan(delta[RF_FCS]) && !isnan(rx_packet_rate)) {
+        double frames = delta[RF_FCS] + rx_packet_rate * interval_s;
+        out->fcs_error_ratio = frames > 0.0 ? delta[RF_FCS] / frames : 0.0;
+    }
+    out->ack_fail_rate = delta[RF_ACK_FAIL] / interval_s;
+    double rts = delta[RF_RTS_FAIL] + delta[RF_RTS_OK];
+    if (!isnan(rts)) out->rts_fail_ratio = rts > 0.0 ? delta[RF_RTS_FAIL] / rts : 0.0;
+    double cca;
+    if (rf_read_false_cca(r, &cca)) out->false_cca_rate = cca * 1000.0 / RF_CCA_WINDOW_MS;
+
+    double strong = isnan(signal_dbm) ? 1.0 : clamp((signal_dbm + 80.0) / 15.0, 0.0, 1.0);
+    double penalty = 0.0, weight = 0.0;
+    if (!isnan(out->false_cca_rate)) {
+        penalty += 0.50 * clamp((out->false_cca_rate - 1000.0) / 5000.0, 0.0, 1.0);
+        weight += 0.50;
+    }
+    if (!isnan(out->fcs_error_ratio)) {
+        penalty += 0.35 * strong * clamp((out->fcs_error_ratio - 0.05) / 0.25, 0.0, 1.0);
+        weight += 0.35;
+    }
+    if (!isnan(out->rts_fail_ratio)) {
+        penalty += 0.15 * strong * clamp((out->rts_fail_ratio - 0.10) / 0.40, 0.0, 1.0);
+        weight += 0.15;
+    }
+    if (weight <= 0.0) return false;
+    out->score = clamp(100.0 * (1.0 - penalty / weight), 0.0, 100.0);
+    out->valid = true;
+    return true;
+}
+
+#define RC_MAX_RATES    512
+#define RC_REPORT_RATES 8
+#define RC_MAX_FIELDS   32
+
+struct rc_rate {
+    uint64_t attempts;        /* att_hist, cumulative */
+    uint64_t success;         /* succ_hist, cumulative */
+    uint32_t tp_max_x10;      /* minstrel's tp_max (Mbit/s x10) at 100% success */
+    char name[24];            /* "HT20 LGI MCS7" */
+    bool present;
+};
+
+/*
+ * Fixed table of minstrel rates indexed by rate idx. rc_stats_csv is
+ * rendered when the file is opened, so it is reopened per report and
+ * streamed through a 4 KiB chunk line by line; nothing is allocated.
+ */
+struct rc_table {
+    struct rc_rate prev[RC_MAX_RATES];
+    struct rc_rate cur[RC_MAX_RATES];
+    bool have_prev;
+    bool tried;
+    uint32_t last_report_ms;
+    uint32_t last_try_ms; /* a missing file is retried at the report cadence, not every tick */
+    char chunk[4096];
+};
+
+struct rc_report_rate {
+    int idx;
+    uint64_t attempts;
+    double per;
+    double share;
+};
+
+struct rc_report {
+    uint64_t attempts;
+    double per;
+    double goodput_mbps;      /* sum of share * tp_max * (1 - PER) */
+    size_t count;
+    struct rc_report_rate top[RC_REPORT_RATES];
+};
+
+/* "7.5" -> 75 */
+static uint32_t rc_parse_x10(const char *s) {
+    char *end;
+    unsigned long whole = strtoul(s, &end, 10);
+    unsigned long frac = (*end == '.' && isdigit((unsigned char)end[1])) ? (unsigned long)(end[1] - '0') : 0;
+    return (uint32_t)(whole * 10 + frac);
+}
+
+static bool rc_is_rate_token(const char *f) {
+    if (strncmp(f, "MCS", 3) == 0) return true;
+    /* CCK/OFDM rates print as "1M", "5.5M", "54M" */
+    size_t len = strlen(f);
+    return len >= 2 && isdigit((unsigned char)f[0]) && f[len - 1] == 'M';
+}
+
+/*
+ * One minstrel_ht CSV row: mode,guard,streams,flags,RATE,idx,airtime,
+ * tp_max,tp_avg,prob,retry,last_success,last_attempts,succ_hist,att_hist,...
+ * The leading columns differ between kernels, so the row is anchored on the
+ * RATE token instead of fixed positions.
+ */
+static void rc_parse_line(struct rc_table *t, char *line) {
+    char *fields[RC_MAX_FIELDS];
+    int n = 0;
+    for (char *p = line; n < RC_MAX_FIELDS; ) {
+        fields[n++] = p;
+        char *comma = strchr(p, ',');
+        if (!comma) break;
+        *comma = '\0';
+        p = comma + 1;
+    }
+    int k = -1;
+    for (int i = 0; i < n; i++) {
+        if (rc_is_rate_token(trim(fields[i]))) {
+            k = i;
+            break;
+        }
+    }
+    if (k < 0 || k + 10 >= n || !isdigit((unsigned char)fields[k + 1][0])) return;
+
+    unsigned long idx = strtoul(fields[k + 1], NULL, 10);
+    if (idx >= RC_MAX_RATES) return;
+    struct rc_rate *r = &t->cur[idx];
+    r->tp_max_x10 = rc_parse_x10(fields[k + 3]);
+    r->success = strtoull(fields[k + 9], NULL, 10);
+    r->attempts = strtoull(fields[k + 10], NULL, 10);
+    snprintf(r->name, sizeof(r->name), "%s %s %s",
+             k >= 2 ? fields[0] : "", k >= 2 ? fields[1] : "", fields[k]);
+    r->present = true;
+}
+
+static int rc_parse_file(struct rc_table *t, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    for (size_t i = 0; i < RC_MAX_RATES; i++) t->cur[i].present = false;
+
+    size_t carry = 0;
+    for (;;) {
+        ssize_t n = read(fd, t->chunk + carry, sizeof(t->chunk) - 1 - carry);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (carry) {
+                t->chunk[carry] = '\0';
+                rc_parse_line(t, t->chunk);
+            }
+            break;
+        }
+        size_t len = carry + (size_t)n;
+        char *start = t->chunk;
+        char *nl;
+        while ((nl = memchr(start, '\n', len - (size_t)(start - t->chunk))) != NULL) {
+            *nl = '\0';
+            rc_parse_line(t, start);
+            start = nl + 1;
+        }
+        carry = len - (size_t)(start - t->chunk);
+        if (carry == sizeof(t->chunk) - 1) carry = 0; /* overlong line: drop it */
+        memmove(t->chunk, start, carry);
+    }
+    close(fd);
+    return 0;
+}
+
+/* Deltas against the previous parse; returns false until two parses exist. */
+static bool rc_compute(struct rc_table *t, struct rc_report *out) {
+    memset(out, 0, sizeof(*out));
+    bool had_prev = t->have_prev;
+    uint64_t total_att = 0, total_succ = 0;
+    for (int i = 0; i < RC_MAX_RATES && had_prev; i++) {
+        const struct rc_rate *c = &t->cur[i], *p = &t->prev[i];
+        if (!c->present || !p->present || c->attempts < p->attempts || c->success < p->success) continue;
+        total_att += c->attempts - p->attempts;
+        total_succ += c->success - p->success;
+    }
+    if (had_prev && total_att > 0) {
+        out->attempts = total_att;
+        out->per = 1.0 - (double)total_succ / (double)total_att;
+        for (int i = 0; i < RC_MAX_RATES; i++) {
+            const struct rc_rate *c = &t->cur[i], *p = &t->prev[i];
+            if (!c->present || !p->present || c->attempts <= p->attempts || c->success < p->success) continue;
+            uint64_t att = c->attempts - p->attempts;
+            double per = clamp(1.0 - (double)(c->success - p->success) / (double)att, 0.0, 1.0);
+            double share = (double)att / (double)total_att;
+            out->goodput_mbps += share * (c->tp_max_x10 / 10.0) * (1.0 - per);
+
+            /* keep the RC_REPORT_RATES busiest rates, sorted by attempts */
+            size_t pos = out->count;
+            while (pos > 0 && out->top[pos - 1].attempts < att) pos--;
+            if (pos >= RC_REPORT_RATES) continue;
+            size_t last = out->count < RC_REPORT_RATES ? out->count : RC_REPORT_RATES - 1;
+            memmove(&out->top[pos + 1], &out->top[pos], (last - pos) * sizeof(out->top[0]));
+            out->top[pos] = (struct rc_report_rate){ .idx = i, .attempts = att, .per = per, .share = share };
+            if (out->count < RC_REPORT_RATES) out->count++;
+        }
+    }
+    memcpy(t->prev, t->cur, sizeof(t->prev));
+    t->have_prev = true;
+    return had_prev && total_att > 0;
+}
+
+static int rc_benchmark(const char *path) {
+    static struct rc_table t;
+    const int rounds = 200;
+    struct timespec a, b;
+    if (rc_parse_file(&t, path) != 0) {
+        fprintf(stderr, "open(%s) failed: %s\n", path, strerror(errno));
+        return 1;
+    }
+    size_t rows = 0;
+    for (int i = 0; i < RC_MAX_RATES; i++) rows += t.cur[i].present;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (int i = 0; i < rounds; i++) rc_parse_file(&t, path);
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    struct stat st;
+    long size = stat(path, &st) == 0 ? (long)st.st_size : -1;
+    printf("rc_stats_csv: %zu rates, %ld bytes, %.1f us per parse (%d rounds)\n",
+           rows, size, timespec_diff_seconds(&b, &a) * 1e6 / rounds, rounds);
+    return 0;
+}
+
+/*
+ * nl80211 and iwinfo report most station counters as u32, debugfs as u64.
+ * A decrease is a 32-bit wrap when the previous reading fit in 32 bits
+ * and the wrapped delta is plausible for the elapsed interval at
+ * COUNTER_MAX_RATE; anything else is a driver reset (reassociation,
+ * module reload), after which the counter restarted from zero. A reset on
+ * one counter of a source resets the whole source, since drivers clear
+ * station statistics together: every counter of it restarts, including
+ * one that happened to look like a wrap.
+ */
+#define COUNTER_MAX_RATE 1000000.0 /* events/s; well above any single station's packet rate */
+
+enum counter_source { CTR_SRC_STATION, CTR_SRC_DEBUGFS, CTR_SRC_COUNT };
+
+static const enum counter_source counter_sources[CTR_COUNT] = {
+    [CTR_TX_PACKETS] = CTR_SRC_STATION,
+    [CTR_TX_RETRIES] = CTR_SRC_STATION,
+    [CTR_TX_FAILED] = CTR_SRC_STATION,
+    [CTR_BEACON_LOSS] = CTR_SRC_STATION,
+    [CTR_RX_PACKETS] = CTR_SRC_STATION,
+    [CTR_RX_DROP_MISC] = CTR_SRC_STATION,
+    [CTR_RX_DUPLICATES] = CTR_SRC_DEBUGFS,
+};
+
+enum counter_event { CTR_EV_NONE, CTR_EV_FIRST, CTR_EV_WRAP, CTR_EV_RESET, CTR_EV_MISSING };
+
+struct counter_track {
+    uint64_t last;            /* last raw reading */
+    uint64_t total;           /* monotonic across wraps and resets */
+    uint64_t delta;           /* increment over the last update */
+    bool valid;               /* `last` holds a reading */
+    bool has_delta;           /* `delta` is meaningful this tick */
+};
+
+struct counter_set {
+    struct counter_track c[CTR_COUNT];
+    uint32_t wraps;
+    uint32_t resets;
+};
+
+static void counter_set_reset(struct counter_set *set) {
+    for (int i = 0; i < CTR_COUNT; i++) {
+        set->c[i].valid = false;
+        set->c[i].has_delta = false;
+        set->c[i].delta = 0;
+    }
+}
+
+static enum counter_event counter_classify(const struct counter_track *t, uint64_t raw, uint64_t wrap_max,
+                                           uint64_t *delta) {
+    if (!t->valid) {
+        *delta = 0;
+        return CTR_EV_FIRST;
+    }
+    if (raw >= t->last) {
+        *delta = raw - t->last;
+        return CTR_EV_NONE;
+    }
+    if (t->last <= UINT32_MAX) {
+        uint64_t wrapped = raw + (UINT32_MAX - t->last) + 1;
+        if (raw <= UINT32_MAX && wrapped <= wrap_max) {
+            *delta = wrapped;
+            return CTR_EV_WRAP;
+        }
+    }
+    *delta = raw;
+    return CTR_EV_RESET;
+}
+
+/*
+ * Folds one sample, interval_s after the previous one, into the tracks;
+ * returns the CTR_EV_RESET sources as a bitmask.
+ */
+static uint32_t counter_set_update(struct counter_set *set, const struct station_sample *s, double interval_s) {
+    enum counter_event ev[CTR_COUNT];
+    uint64_t delta[CTR_COUNT];
+    uint32_t reset_sources = 0;
+    uint64_t wrap_max = (uint64_t)(interval_s * COUNTER_MAX_RATE);
+    for (int i = 0; i < CTR_COUNT; i++) {
+        ev[i] = SAMPLE_HAS(s, i) ? counter_classify(&set->c[i], s->counter[i], wrap_max, &delta[i])
+                                 : CTR_EV_MISSING;
+        if (ev[i] == CTR_EV_RESET) reset_sources |= 1u << counter_sources[i];
+    }
+    for (int i = 0; i < CTR_COUNT; i++) {
+        struct counter_track *t = &set->c[i];
+        if (ev[i] == CTR_EV_MISSING) {
+            t->valid = false;
+            t->has_delta = false;
+            t->delta = 0;
+            continue;
+        }
+        /* Counters of a reset source that grew or seemed to wrap still restarted from zero. */
+        if ((ev[i] == CTR_EV_NONE || ev[i] == CTR_EV_WRAP) && (reset_sources >> counter_sources[i]) & 1u) {
+            ev[i] = CTR_EV_RESET;
+            delta[i] = s->counter[i];
+        }
+        if (ev[i] == CTR_EV_WRAP) set->wraps++;
+        t->delta = delta[i];
+        t->has_delta = ev[i] != CTR_EV_FIRST;
+        t->total += delta[i];
+        t->last = s->counter[i];
+        t->valid = true;
+    }
+    for (int src = 0; src < CTR_SRC_COUNT; src++) {
+        if ((reset_sources >> src) & 1u) set->resets++;
+    }
+    return reset_sources;
+}
+
+struct tx_link_metrics {
+    double ratio;
+    double retries_per_s;
+    double fails_per_s;
+    double beacon_per_s;
+    double packets_per_s;
+    double composite;
+    bool has_delta;
+};
+
+static bool compute_tx_link_metrics(const struct counter_set *ctr,
+                                    double interval_seconds,
+                                    struct tx_link_metrics *out) {
+    if (!out) return false;
+    memset(out, 0, sizeof(*out));
+    out->ratio = NAN;
+    out->composite = NAN;
+    out->has_delta = false;
+
+    const struct counter_track *packets = &ctr->c[CTR_TX_PACKETS];
+    const struct counter_track *retries = &ctr->c[CTR_TX_RETRIES];
+    const struct counter_track *failed = &ctr->c[CTR_TX_FAILED];
+    const struct counter_track *beacon = &ctr->c[CTR_BEACON_LOSS];
+    if (!packets->valid || !retries->valid || !failed->valid || !beacon->valid) {
+        return false;
+    }
+
+    if (!packets->has_delta || !retries->has_delta || !failed->has_delta || !beacon->has_delta) {
+        out->ratio = 0.0;
+        out->composite = 100.0;
+        out->has_delta = false;
+        return true;
+    }
+
+    double delta_packets = (double)packets->delta;
+    double delta_retries = (double)retries->delta;
+    double delta_failed  = (double)failed->delta;
+    double delta_beacon  = (double)beacon->delta;
+
+    if (interval_seconds <= 0.0) interval_seconds = 1.0;
+
+    out->packets_per_s = delta_packets / interval_seconds;
+    out->retries_per_s = delta_retries / interval_seconds;
+    out->fails_per_s   = delta_failed  / interval_seconds;
+    out->beacon_per_s  = delta_beacon  / interval_seconds;
+
+    double denom = delta_packets;
+    if (denom <= 0.0) denom = 1.0;
+    double weighted_failed = delta_failed * 4.0;
+    double ratio = (delta_retries + weighted_failed) / denom;
+    if (ratio < 0.0) ratio = 0.0;
+    out->ratio = ratio;
+
+    double ratio_score  = 100.0 * (1.0 - clamp(ratio / 0.10, 0.0, 1.0));
+    double retry_score  = 100.0 * (1.0 - clamp(out->retries_per_s / 60.0, 0.0, 1.0));
+    double fail_score   = 100.0 * (1.0 - clamp(out->fails_per_s   / 3.0,  0.0, 1.0));
+    double beacon_score = 100.0 * (1.0 - clamp(out->beacon_per_s  / 1.0,  0.0, 1.0));
+
+    double composite = 0.55 * ratio_score +
+                       0.25 * retry_score +
+                       0.10 * fail_score +
+                       0.10 * beacon_score;
+
+    out->composite = clamp(composite, 0.0, 100.0);
+    out->has_delta = true;
+    return true;
+}
+
+struct rx_link_metrics {
+    double ratio;
+    double retry_rate;
+    double drop_rate;
+    double packets_per_s;
+    double composite;
+    bool has_delta;
+};
+
+static bool compute_rx_link_metrics(const struct counter_set *ctr,
+                                    double interval_seconds,
+                                    struct rx_link_metrics *out) {
+    if (!out) return false;
+    memset(out, 0, sizeof(*out));
+    out->ratio = NAN;
+    out->retry_rate = NAN;
+    out->drop_rate = NAN;
+    out->composite = NAN;
+    out->has_delta = false;
+
+    /* Duplicates come from debugfs and drops are not reported by every source; both count as 0 when absent. */
+    const struct counter_track *packets = &ctr->c[CTR_RX_PACKETS];
+    const struct counter_track *dups = &ctr->c[CTR_RX_DUPLICATES];
+    const struct counter_track *drops = &ctr->c[CTR_RX_DROP_MISC];
+    if (!packets->valid) return false;
+
+    if (!packets->has_delta) {
+        out->ratio = 0.0;
+        out->retry_rate = 0.0;
+        out->drop_rate = 0.0;
+        out->composite = 100.0;
+        return true;
+    }
+
+    double delta_packets = (double)packets->delta;
+    double delta_duplicates = dups->has_delta ? (double)dups->delta : 0.0;
+    double delta_drop = drops->has_delta ? (double)drops->delta : 0.0;
+
+    if (interval_seconds <= 0.0) interval_seconds = 1.0;
+
+    out->retry_rate = delta_duplicates / interval_seconds;
+    out->drop_rate  = delta_drop / interval_seconds;
+    out->packets_per_s = delta_packets / interval_seconds;
+
+    double denom = delta_packets;
+    if (denom <= 0.0) denom = 1.0;
+    double ratio = delta_duplicates / denom;
+    if (ratio < 0.0) ratio = 0.0;
+    out->ratio = ratio;
+
+    double ratio_score      = 100.0 * (1.0 - clamp(ratio / 0.08, 0.0, 1.0));
+    double retry_rate_score = 100.0 * (1.0 - clamp(out->retry_rate / 50.0, 0.0, 1.0));
+    double drop_rate_score  = 100.0 * (1.0 - clamp(out->drop_rate  / 5.0,  0.0, 1.0));
+
+    double composite = 0.7 * ratio_score + 0.2 * retry_rate_score + 0.1 * drop_rate_score;
+    out->composite = clamp(composite, 0.0, 100.0);
+    out->has_delta = true;
+    return true;
+}
+
+static struct metrics derive_metrics(const struct station_sample *sample,
+                                     const struct tx_link_metrics *tx,
+                                     const struct rx_link_metrics *rx,
+                                     double link_all, bool link_all_valid) {
+    struct metrics m = {0};
+    m.tx_retry_ratio = NAN;
+    m.tx_retry_rate = NAN;
+    m.tx_fail_rate = NAN;
+    m.tx_beacon_rate = NAN;
+    m.tx_packet_rate = NAN;
+    m.rx_retry_ratio = NAN;
+    m.rx_retry_rate = NAN;
+    m.rx_drop_rate = NAN;
+    m.link_tx_norm = NAN;
+    m.link_rx_norm = NAN;
     m.link_all_norm = NAN;
     m.raw_station = *sample;
     if (!isnan(sample->signal_dbm)) {
@@ -622,150 +1605,2809 @@ static struct metrics derive_metrics(const struct station_sample *sample,
             m.valid_link_rx = true;
         }
     }
-    if (link_all_valid && !isnan(link_all)) {
-        m.link_all_norm = link_all;
-        m.valid_link_all = true;
+    if (link_all_valid && !isnan(link_all)) {
+        m.link_all_norm = link_all;
+        m.valid_link_all = true;
+    }
+    return m;
+}
+
+static void format_number(char *buf, size_t len, double value, const char *fmt) {
+    if (isnan(value) || isinf(value)) {
+        snprintf(buf, len, "null");
+    } else {
+        snprintf(buf, len, fmt, value);
+    }
+}
+
+/* Score entries shown on the OSD, in display order. */
+#define OSD_SCORE_ENTRIES 7
+
+static size_t score_entries(const struct metrics *m, const char *labels[], double values[]) {
+    size_t count = 0;
+    if (m->valid_rssi) {
+        labels[count] = "RSSI";
+        values[count] = m->rssi_norm;
+        count++;
+    }
+    if (m->valid_link_tx) {
+        labels[count] = "Link TX";
+        values[count] = m->link_tx_norm;
+        count++;
+    }
+    if (m->valid_link_rx) {
+        labels[count] = "Link RX";
+        values[count] = m->link_rx_norm;
+        count++;
+    }
+    if (m->queue.valid) {
+        labels[count] = "Queue";
+        values[count] = m->queue.score;
+        count++;
+    }
+    if (m->valid_link_all) {
+        labels[count] = "Link ALL";
+        values[count] = m->link_all_norm;
+        count++;
+    }
+    if (m->host.valid) {
+        labels[count] = "Host";
+        values[count] = m->host.score;
+        count++;
+    }
+    if (m->rf.valid) {
+        labels[count] = "Interference";
+        values[count] = m->rf.score;
+        count++;
+    }
+    return count;
+}
+
+/* extra is spliced in before "t_us" (the -e redundancy fields) and may be "". */
+static int send_udp_packet(int sock, const struct sockaddr_in *addr,
+                           const struct metrics *m, const char *extra) {
+    char payload[1472];
+    char raw_signal[32];
+    char raw_tx_ratio[32], raw_tx_retry_rate[32], raw_tx_fail_rate[32], raw_tx_beacon_rate[32], raw_tx_packet_rate[32];
+    char raw_rx_ratio[32], raw_rx_retry_rate[32], raw_rx_drop_rate[32], raw_rx_packet_rate[32];
+
+    format_number(raw_signal, sizeof(raw_signal), m->raw_station.signal_dbm, "%.2f");
+    format_number(raw_tx_ratio, sizeof(raw_tx_ratio), m->tx_retry_ratio, "%.6f");
+    format_number(raw_tx_retry_rate, sizeof(raw_tx_retry_rate), m->tx_retry_rate, "%.3f");
+    format_number(raw_tx_fail_rate, sizeof(raw_tx_fail_rate), m->tx_fail_rate, "%.3f");
+    format_number(raw_tx_beacon_rate, sizeof(raw_tx_beacon_rate), m->tx_beacon_rate, "%.3f");
+    format_number(raw_tx_packet_rate, sizeof(raw_tx_packet_rate), m->tx_packet_rate, "%.3f");
+    format_number(raw_rx_ratio, sizeof(raw_rx_ratio), m->rx_retry_ratio, "%.6f");
+    format_number(raw_rx_retry_rate, sizeof(raw_rx_retry_rate), m->rx_retry_rate, "%.3f");
+    format_number(raw_rx_drop_rate, sizeof(raw_rx_drop_rate), m->rx_drop_rate, "%.3f");
+    format_number(raw_rx_packet_rate, sizeof(raw_rx_packet_rate), m->rx_packet_rate, "%.3f");
+
+    const char *labels[OSD_SCORE_ENTRIES];
+    double values[OSD_SCORE_ENTRIES];
+    size_t count = score_entries(m, labels, values);
+
+    char text_buf[256] = "[";
+    char value_buf[256] = "[";
+    size_t text_off = 1;
+    size_t value_off = 1;
+    bool first = true;
+    for (size_t i = 0; i < count; i++) {
+        if (!first) {
+            text_buf[text_off++] = ',';
+            value_buf[value_off++] = ',';
+        }
+        int wt = snprintf(text_buf + text_off, sizeof(text_buf) - text_off,
+                          "\"%s\"", labels[i]);
+        if (wt < 0 || text_off + (size_t)wt >= sizeof(text_buf)) return -1;
+        text_off += (size_t)wt;
+
+        int wv = snprintf(value_buf + value_off, sizeof(value_buf) - value_off,
+                          "%.2f", values[i]);
+        if (wv < 0 || value_off + (size_t)wv >= sizeof(value_buf)) return -1;
+        value_off += (size_t)wv;
+        first = false;
+    }
+    text_buf[text_off++] = ']';
+    text_buf[text_off] = '\0';
+    value_buf[value_off++] = ']';
+    value_buf[value_off] = '\0';
+
+    double link_tx = m->valid_link_tx ? m->link_tx_norm : NAN;
+    double link_rx = m->valid_link_rx ? m->link_rx_norm : NAN;
+    double link_all = m->valid_link_all ? m->link_all_norm : NAN;
+
+    double link_fallback = !isnan(link_all) ? link_all :
+                           !isnan(link_tx) ? link_tx :
+                           !isnan(link_rx) ? link_rx : 0.0;
+
+    double rssi_value = m->valid_rssi ? m->rssi_norm : 0.0;
+    double link_value = link_fallback;
+    double link_tx_value = !isnan(link_tx) ? link_tx : link_value;
+    double link_rx_value = !isnan(link_rx) ? link_rx : link_value;
+    double link_all_value = !isnan(link_all) ? link_all : link_value;
+
+    char raw_link_tx[32], raw_link_rx[32], raw_link_all[32];
+    format_number(raw_link_tx, sizeof(raw_link_tx), link_tx, "%.2f");
+    format_number(raw_link_rx, sizeof(raw_link_rx), link_rx, "%.2f");
+    format_number(raw_link_all, sizeof(raw_link_all), link_all, "%.2f");
+
+    const struct queue_metrics *q = &m->queue;
+    char raw_queue[32], raw_queue_backlog[32], raw_queue_delay[32], raw_queue_drop[32], raw_queue_mark[32];
+    format_number(raw_queue, sizeof(raw_queue), q->valid ? q->score : NAN, "%.2f");
+    format_number(raw_queue_backlog, sizeof(raw_queue_backlog), q->valid ? q->backlog_bytes : NAN, "%.0f");
+    format_number(raw_queue_delay, sizeof(raw_queue_delay), q->valid ? q->delay_ms : NAN, "%.1f");
+    format_number(raw_queue_drop, sizeof(raw_queue_drop), q->valid ? q->drop_rate : NAN, "%.3f");
+    format_number(raw_queue_mark, sizeof(raw_queue_mark), q->valid ? q->mark_rate : NAN, "%.3f");
+
+    const struct host_metrics *h = &m->host;
+    char raw_host[32], raw_host_cpu[32], raw_host_softirq[32], raw_host_net_rx[32], raw_host_drop[32];
+    char raw_host_psi[HOST_PSI_COUNT][32], raw_host_mem[32], raw_host_zram[32];
+    format_number(raw_host, sizeof(raw_host), h->valid ? h->score : NAN, "%.2f");
+    format_number(raw_host_cpu, sizeof(raw_host_cpu), h->valid ? h->cpu_busy_pct : NAN, "%.1f");
+    format_number(raw_host_softirq, sizeof(raw_host_softirq), h->valid ? h->softirq_pct : NAN, "%.1f");
+    format_number(raw_host_net_rx, sizeof(raw_host_net_rx), h->valid ? h->net_rx_rate : NAN, "%.0f");
+    format_number(raw_host_drop, sizeof(raw_host_drop), h->valid ? h->softnet_drop_rate : NAN, "%.3f");
+    for (int i = 0; i < HOST_PSI_COUNT; i++) {
+        format_number(raw_host_psi[i], sizeof(raw_host_psi[i]), h->valid ? h->psi_some_avg10[i] : NAN, "%.2f");
+    }
+    format_number(raw_host_mem, sizeof(raw_host_mem), h->valid ? h->mem_avail_pct : NAN, "%.1f");
+    format_number(raw_host_zram, sizeof(raw_host_zram), h->valid ? h->zram_ratio : NAN, "%.2f");
+
+    const struct rf_metrics *rf = &m->rf;
+    char raw_rf[32], raw_rf_fcs_rate[32], raw_rf_fcs_ratio[32], raw_rf_cca[32], raw_rf_ack[32], raw_rf_rts[32];
+    format_number(raw_rf, sizeof(raw_rf), rf->valid ? rf->score : NAN, "%.2f");
+    format_number(raw_rf_fcs_rate, sizeof(raw_rf_fcs_rate), rf->valid ? rf->fcs_error_rate : NAN, "%.1f");
+    format_number(raw_rf_fcs_ratio, sizeof(raw_rf_fcs_ratio), rf->valid ? rf->fcs_error_ratio : NAN, "%.4f");
+    format_number(raw_rf_cca, sizeof(raw_rf_cca), rf->valid ? rf->false_cca_rate : NAN, "%.0f");
+    format_number(raw_rf_ack, sizeof(raw_rf_ack), rf->valid ? rf->ack_fail_rate : NAN, "%.1f");
+    format_number(raw_rf_rts, sizeof(raw_rf_rts), rf->valid ? rf->rts_fail_ratio : NAN, "%.3f");
+
+    int len = snprintf(payload, sizeof(payload),
+        "{\"rssi\":%.2f,\"link\":%.2f,\"link_tx\":%.2f,\"link_rx\":%.2f,\"link_all\":%.2f,"
+        "\"text\":%s,\"value\":%s,"
+        "\"raw\":{\"signal\":%s,"
+        "\"tx_retry_ratio\":%s,\"tx_retry_rate\":%s,\"tx_fail_rate\":%s,\"tx_beacon_rate\":%s,\"tx_packet_rate\":%s,"
+        "\"rx_retry_ratio\":%s,\"rx_retry_rate\":%s,\"rx_drop_rate\":%s,\"rx_packet_rate\":%s,"
+        "\"link_tx\":%s,\"link_rx\":%s,\"link_all\":%s,"
+        "\"queue\":%s,\"queue_backlog\":%s,\"queue_delay_ms\":%s,\"queue_drop_rate\":%s,\"queue_mark_rate\":%s,"
+        "\"host\":%s,\"host_cpu_pct\":%s,\"host_softirq_pct\":%s,\"host_net_rx_rate\":%s,\"host_softnet_drop_rate\":%s,"
+        "\"host_psi_cpu\":%s,\"host_psi_memory\":%s,\"host_psi_io\":%s,\"host_mem_avail_pct\":%s,\"host_zram_ratio\":%s,"
+        "\"interference\":%s,\"rf_fcs_rate\":%s,\"rf_fcs_ratio\":%s,\"rf_false_cca_rate\":%s,\"rf_ack_fail_rate\":%s,\"rf_rts_fail_ratio\":%s},"
+        "%s\"t_us\":%llu}\n",
+        rssi_value,
+        link_value,
+        link_tx_value,
+        link_rx_value,
+        link_all_value,
+        text_buf,
+        value_buf,
+        raw_signal,
+        raw_tx_ratio,
+        raw_tx_retry_rate,
+        raw_tx_fail_rate,
+        raw_tx_beacon_rate,
+        raw_tx_packet_rate,
+        raw_rx_ratio,
+        raw_rx_retry_rate,
+        raw_rx_drop_rate,
+        raw_rx_packet_rate,
+        raw_link_tx,
+        raw_link_rx,
+        raw_link_all,
+        raw_queue,
+        raw_queue_backlog,
+        raw_queue_delay,
+        raw_queue_drop,
+        raw_queue_mark,
+        raw_host,
+        raw_host_cpu,
+        raw_host_softirq,
+        raw_host_net_rx,
+        raw_host_drop,
+        raw_host_psi[HOST_PSI_CPU],
+        raw_host_psi[HOST_PSI_MEMORY],
+        raw_host_psi[HOST_PSI_IO],
+        raw_host_mem,
+        raw_host_zram,
+        raw_rf,
+        raw_rf_fcs_rate,
+        raw_rf_fcs_ratio,
+        raw_rf_cca,
+        raw_rf_ack,
+        raw_rf_rts,
+        extra,
+        (unsigned long long)m->t_us);
+    if (len < 0 || (size_t)len >= sizeof(payload)) {
+        fprintf(stderr, "Failed to format payload\n");
+        return -1;
+    }
+
+    ssize_t sent = sendto(sock, payload, len, 0,
+                          (const struct sockaddr *)addr, sizeof(*addr));
+    if (sent < 0) {
+        fprintf(stderr, "sendto failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * -O: combined mode. The collector hands each struct metrics straight to an
+ * OSD publisher in this process instead of a UDP hop through osd_feed. The
+ * datagrams come from the same compiled template as osd_feed's (osd_format.h,
+ * recompiled only when the entry list changes) and fast-path RSSI and event
+ * alerts merge the same way; an alert clears on the first sample after it
+ * expires. Sends are non-blocking so a stalled OSD never delays a tick.
+ */
+#define OSD_MAX_ENTRIES   8
+#define OSD_ALERT_MS      3000
+
+struct osd_publisher {
+    int fd;
+    struct sockaddr_un dest;
+    const char *labels[OSD_MAX_ENTRIES];
+    double values[OSD_MAX_ENTRIES];
+    size_t count;
+    char alert[32];
+    double alert_value;
+    uint64_t alert_until_us;
+    uint64_t counter;
+    uint64_t last_send_us;
+    uint64_t drops;           /* send failures and datagrams that did not fit */
+    struct osd_latency latency;
+    struct osd_template tpl;
+    bool verbose;
+};
+
+static int osd_publisher_open(struct osd_publisher *p, const char *path, bool verbose) {
+    memset(p, 0, sizeof(*p));
+    p->fd = -1;
+    if (strlen(path) >= sizeof(p->dest.sun_path)) {
+        fprintf(stderr, "OSD socket path too long: %s\n", path);
+        return -1;
+    }
+    p->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p->fd < 0) {
+        fprintf(stderr, "OSD socket failed: %s\n", strerror(errno));
+        return -1;
+    }
+    p->dest.sun_family = AF_UNIX;
+    strcpy(p->dest.sun_path, path);
+    p->verbose = verbose;
+    return 0;
+}
+
+static void osd_publisher_close(struct osd_publisher *p) {
+    if (p->fd < 0) return;
+    osd_latency_print(&p->latency, "osd");
+    if (p->drops) printf("[osd] %llu update(s) dropped\n", (unsigned long long)p->drops);
+    close(p->fd);
+    p->fd = -1;
+}
+
+/* t_us = 0 publishes without a latency sample (fast-path merges, alerts). */
+static void osd_publisher_emit(struct osd_publisher *p, uint64_t t_us) {
+    if (!p || p->fd < 0) return;
+    uint64_t now = osd_now_us();
+    struct osd_item items[OSD_TPL_MAX_ITEMS];
+    double values[OSD_TPL_MAX_ITEMS];
+    double freq_hz = p->last_send_us && now > p->last_send_us ? 1e6 / (double)(now - p->last_send_us) : 0.0;
+    memset(items, 0, sizeof(items));
+    size_t n = 0;
+    for (size_t i = 0; i < p->count && n < OSD_TPL_MAX_ITEMS; i++, n++) {
+        snprintf(items[n].label, sizeof(items[n].label), "%s", p->labels[i]);
+        items[n].precision = 2;
+        items[n].counter = true;
+        items[n].rate = true;
+        values[n] = p->values[i];
+    }
+    if (p->alert_until_us > now && n < OSD_TPL_MAX_ITEMS) {
+        snprintf(items[n].label, sizeof(items[n].label), "%s", p->alert);
+        items[n].precision = 2;
+        values[n++] = p->alert_value;
+    }
+    if (n == 0) return;
+
+    char json[1024];
+    if (!osd_template_matches(&p->tpl, items, n, 0) && osd_template_compile(&p->tpl, items, n, 0) != 0) {
+        p->tpl.nops = 0;
+        p->drops++;
+        return;
+    }
+    int len = osd_template_render(&p->tpl, values, p->counter + 1, freq_hz, json, sizeof(json));
+    if (len < 0) {
+        p->drops++;
+        return;
+    }
+    if (sendto(p->fd, json, (size_t)len, MSG_DONTWAIT, (const struct sockaddr *)&p->dest, sizeof(p->dest)) < 0) {
+        /* No reader yet, or it is behind: drop rather than queue stale scores. */
+        p->drops++;
+        return;
+    }
+    p->counter++;
+    p->last_send_us = now;
+    if (t_us) {
+        osd_latency_observe(&p->latency, t_us, osd_now_us());
+        if (p->verbose && p->latency.n % 100 == 0) osd_latency_print(&p->latency, "osd");
+    }
+}
+
+static void osd_publisher_sample(struct osd_publisher *p, const struct metrics *m) {
+    if (!p) return;
+    p->count = score_entries(m, p->labels, p->values);
+    osd_publisher_emit(p, m->t_us);
+}
+
+static void osd_publisher_rssi(struct osd_publisher *p, double rssi) {
+    if (!p) return;
+    for (size_t i = 0; i < p->count; i++) {
+        if (strcmp(p->labels[i], "RSSI") == 0) {
+            p->values[i] = rssi;
+            osd_publisher_emit(p, 0);
+            return;
+        }
+    }
+}
+
+static void osd_publisher_event(struct osd_publisher *p, const char *event, double value) {
+    if (!p) return;
+    snprintf(p->alert, sizeof(p->alert), "%s", osd_event_text(event));
+    p->alert_value = value;
+    p->alert_until_us = osd_now_us() + OSD_ALERT_MS * 1000ull;
+    osd_publisher_emit(p, 0);
+}
+
+/*
+ * Two lanes to the receiver. Routine samples go out on the plain socket and
+ * can be thinned with -T: a sample is skipped while no score moved by
+ * THIN_DEADBAND and fewer than -T ticks passed. Events (connect, disconnect,
+ * beacon-loss bursts) go out at once on a second socket marked DSCP EF and
+ * SO_PRIORITY 6, which mac80211 queues in AC_VO ahead of routine traffic.
+ */
+#define EVENT_TOS          0xb8
+#define EVENT_SO_PRIORITY  6
+#define EVENT_BEACON_BURST 3
+#define THIN_DEADBAND      1.0
+
+/*
+ * -e N: every routine datagram also carries the previous N sent samples,
+ * newest first, as "red":[[seq,age_ms,v...],...] with the values in this
+ * datagram's "text" order (null where that score was missing then) and
+ * age_ms relative to its t_us. "seq" numbers sent samples, so a receiver
+ * that sees a gap fills it from the next datagram that arrives; a burst
+ * shorter than N costs nothing but the overhead. -E caps those bytes per
+ * datagram, dropping the oldest samples first.
+ */
+struct fec_sample {
+    uint32_t seq;
+    uint64_t t_us;
+    size_t count;
+    const char *labels[OSD_SCORE_ENTRIES];
+    double values[OSD_SCORE_ENTRIES];
+};
+
+enum sender_event { EVENT_CONNECT, EVENT_DISCONNECT, EVENT_BEACON_LOSS };
+
+static const char *const sender_event_names[] = {
+    [EVENT_CONNECT] = "connect",
+    [EVENT_DISCONNECT] = "disconnect",
+    [EVENT_BEACON_LOSS] = "beacon_loss",
+};
+
+struct transport {
+    int sock;
+    int event_sock;
+    struct sockaddr_in dest;
+    int thin_max;
+    int skipped;
+    struct metrics last_sent;
+    bool have_last;
+    uint32_t event_seq;
+    uint16_t src_port;           /* routine lane's local port, named in events; 0 = unknown */
+    uint64_t thinned;
+    struct osd_publisher *osd;   /* -O; NULL when only UDP is used */
+    int fec_depth;
+    int fec_budget;
+    uint32_t sample_seq;
+    struct fec_sample fec[FEC_MAX_DEPTH];
+    int fec_head, fec_fill;
+};
+
+static void transport_open_events(struct transport *tx) {
+    tx->event_sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (tx->event_sock < 0) {
+        fprintf(stderr, "Event socket failed, events use the routine lane: %s\n", strerror(errno));
+        return;
+    }
+    int tos = EVENT_TOS, prio = EVENT_SO_PRIORITY;
+    if (setsockopt(tx->event_sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0 ||
+        setsockopt(tx->event_sock, SOL_SOCKET, SO_PRIORITY, &prio, sizeof(prio)) < 0) {
+        fprintf(stderr, "Event socket priority not set: %s\n", strerror(errno));
+    }
+    /*
+     * Share the routine lane's source port, so osd_feed -N's flow hash puts
+     * both lanes on one worker and its per-source slot gets the alerts.
+     */
+    int on = 1;
+    struct sockaddr_in local = { .sin_family = AF_INET };
+    socklen_t local_len = sizeof(local);
+    if (setsockopt(tx->sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+        bind(tx->sock, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+        getsockname(tx->sock, (struct sockaddr *)&local, &local_len) < 0) {
+        fprintf(stderr, "Routine socket bind failed: %s\n", strerror(errno));
+        return;
+    }
+    tx->src_port = ntohs(local.sin_port);
+    if (setsockopt(tx->event_sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+        bind(tx->event_sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        fprintf(stderr, "Event socket not on port %u (%s); events name it instead\n",
+                (unsigned)tx->src_port, strerror(errno));
+    }
+}
+
+static void transport_close(struct transport *tx) {
+    if (tx->event_sock >= 0) close(tx->event_sock);
+    tx->event_sock = -1;
+}
+
+static bool score_moved(bool valid_a, double a, bool valid_b, double b) {
+    if (valid_a != valid_b) return true;
+    return valid_a && fabs(a - b) >= THIN_DEADBAND;
+}
+
+static bool transport_due(struct transport *tx, const struct metrics *m) {
+    if (tx->thin_max <= 1 || !tx->have_last || tx->skipped + 1 >= tx->thin_max) return true;
+    const struct metrics *p = &tx->last_sent;
+    return score_moved(m->valid_rssi, m->rssi_norm, p->valid_rssi, p->rssi_norm) ||
+           score_moved(m->valid_link_tx, m->link_tx_norm, p->valid_link_tx, p->link_tx_norm) ||
+           score_moved(m->valid_link_rx, m->link_rx_norm, p->valid_link_rx, p->link_rx_norm) ||
+           score_moved(m->valid_link_all, m->link_all_norm, p->valid_link_all, p->link_all_norm) ||
+           score_moved(m->queue.valid, m->queue.score, p->queue.valid, p->queue.score) ||
+           score_moved(m->host.valid, m->host.score, p->host.valid, p->host.score) ||
+           score_moved(m->rf.valid, m->rf.score, p->rf.valid, p->rf.score);
+}
+
+/* One "red" element: s's values looked up by this datagram's labels (static strings). */
+static int fec_format_sample(const struct fec_sample *s, const char *labels[], size_t count,
+                             uint64_t t_us, char *buf, size_t len) {
+    uint64_t age_ms = t_us > s->t_us ? (t_us - s->t_us) / 1000ull : 0;
+    int off = snprintf(buf, len, "[%u,%llu", s->seq, (unsigned long long)age_ms);
+    for (size_t i = 0; i < count && off > 0 && (size_t)off < len; i++) {
+        size_t j = 0;
+        while (j < s->count && s->labels[j] != labels[i]) j++;
+        off += j < s->count ? snprintf(buf + off, len - (size_t)off, ",%.1f", s->values[j])
+                            : snprintf(buf + off, len - (size_t)off, ",null");
+    }
+    if (off < 0 || (size_t)off + 1 >= len) return -1;
+    buf[off++] = ']';
+    buf[off] = '\0';
+    return off;
+}
+
+/* Numbers m and builds its "seq"/"red" fields into buf, then remembers m for later datagrams. */
+static void transport_fec_format(struct transport *tx, const struct metrics *m, char *buf, size_t len) {
+    struct fec_sample cur = { .seq = ++tx->sample_seq, .t_us = m->t_us };
+    cur.count = score_entries(m, cur.labels, cur.values);
+
+    size_t off = (size_t)snprintf(buf, len, "\"seq\":%u,", cur.seq);
+    size_t start = off;
+    size_t cap = off + (size_t)tx->fec_budget < len ? off + (size_t)tx->fec_budget : len;
+    int carried = 0;
+    for (int k = 0; k < tx->fec_fill && k < tx->fec_depth; k++) {
+        const struct fec_sample *s = &tx->fec[(tx->fec_head + FEC_MAX_DEPTH - 1 - k) % FEC_MAX_DEPTH];
+        char one[160];
+        int n = fec_format_sample(s, cur.labels, cur.count, cur.t_us, one, sizeof(one));
+        /* '"red":[' or ',' before it, "]," after it and the terminator. */
+        size_t need = (carried ? 1 : 7) + (size_t)n + 3;
+        if (n < 0 || off + need > cap) break;
+        off += (size_t)snprintf(buf + off, len - off, "%s%s", carried ? "," : "\"red\":[", one);
+        carried++;
+    }
+    if (carried) {
+        off += (size_t)snprintf(buf + off, len - off, "],");
+    } else {
+        buf[start] = '\0';
+    }
+
+    tx->fec[tx->fec_head] = cur;
+    tx->fec_head = (tx->fec_head + 1) % FEC_MAX_DEPTH;
+    if (tx->fec_fill < FEC_MAX_DEPTH) tx->fec_fill++;
+}
+
+/* Returns 1 when the sample was thinned, 0 when sent, -1 on send errors. */
+static int transport_send_sample(struct transport *tx, const struct metrics *m) {
+    osd_publisher_sample(tx->osd, m);
+    if (tx->sock < 0) return 0;
+    if (!transport_due(tx, m)) {
+        tx->skipped++;
+        tx->thinned++;
+        return 1;
+    }
+    tx->skipped = 0;
+    tx->last_sent = *m;
+    tx->have_last = true;
+    char fec[FEC_BUDGET_MAX + 32] = "";
+    if (tx->fec_depth > 0) transport_fec_format(tx, m, fec, sizeof(fec));
+    return send_udp_packet(tx->sock, &tx->dest, m, fec);
+}
+
+static int transport_send_event(struct transport *tx, enum sender_event ev,
+                                const char *station, double value) {
+    osd_publisher_event(tx->osd, sender_event_names[ev], value);
+    if (tx->sock < 0) return 0;
+    char payload[176];
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"type\":\"event\",\"event\":\"%s\",\"seq\":%u,\"station\":\"%s\",\"value\":%.0f,"
+                       "\"src_port\":%u}\n",
+                       sender_event_names[ev], ++tx->event_seq, station ? station : "", value,
+                       (unsigned)tx->src_port);
+    if (len < 0 || (size_t)len >= sizeof(payload)) return -1;
+    int fd = tx->event_sock >= 0 ? tx->event_sock : tx->sock;
+    if (sendto(fd, payload, (size_t)len, 0, (const struct sockaddr *)&tx->dest, sizeof(tx->dest)) < 0) {
+        fprintf(stderr, "event sendto failed: %s\n", strerror(errno));
+        return -1;
+    }
+    /* The next routine sample follows immediately so the OSD sees the new state. */
+    tx->have_last = false;
+    return 0;
+}
+
+static uint8_t history_pack_score(bool valid, double value) {
+    if (!valid || isnan(value)) return HISTORY_SCORE_NONE;
+    return (uint8_t)lround(clamp(value, 0.0, 100.0) * 2.0);
+}
+
+static uint16_t history_pack_rate(double value) {
+    if (isnan(value) || value <= 0.0) return 0;
+    if (value >= 65535.0) return 65535;
+    return (uint16_t)lround(value);
+}
+
+static int history_open(struct history_ring *ring, const char *path,
+                        int depth_s, int interval_ms) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    long period_ms = interval_ms > 0 ? interval_ms : 1000;
+    long capacity = ((long)depth_s * 1000L + period_ms - 1) / period_ms;
+    if (capacity < 1) capacity = 1;
+    if (capacity > HISTORY_MAX_SAMPLES) capacity = HISTORY_MAX_SAMPLES;
+
+    ring->samples = calloc((size_t)capacity, sizeof(*ring->samples));
+    if (!ring->samples) {
+        fprintf(stderr, "History ring allocation failed (%ld samples)\n", capacity);
+        return -1;
+    }
+    ring->capacity = (size_t)capacity;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        free(ring->samples);
+        ring->samples = NULL;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket(AF_UNIX,SOCK_DGRAM) failed: %s\n", strerror(errno));
+        free(ring->samples);
+        ring->samples = NULL;
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "bind(%s) failed: %s\n", path, strerror(errno));
+        close(fd);
+        free(ring->samples);
+        ring->samples = NULL;
+        return -1;
+    }
+    ring->fd = fd;
+    ring->path = path;
+
+    printf("History ring: %zu samples x %zu bytes = %zu bytes, query socket %s\n",
+           ring->capacity, sizeof(struct history_sample),
+           ring->capacity * sizeof(struct history_sample), path);
+    fflush(stdout);
+    return 0;
+}
+
+static void history_close(struct history_ring *ring) {
+    if (ring->fd >= 0) {
+        close(ring->fd);
+        unlink(ring->path);
+        ring->fd = -1;
+    }
+    free(ring->samples);
+    ring->samples = NULL;
+}
+
+static void history_record(struct history_ring *ring, uint32_t t_ms,
+                           const struct metrics *m) {
+    if (!ring->samples) return;
+    struct history_sample *hs = &ring->samples[ring->head];
+    double sig = m->raw_station.signal_dbm;
+    hs->t_ms = t_ms;
+    hs->signal_dbm = isnan(sig) ? INT8_MIN : (int8_t)lround(clamp(sig, -127.0, 127.0));
+    hs->rssi = history_pack_score(m->valid_rssi, m->rssi_norm);
+    hs->link_tx = history_pack_score(m->valid_link_tx, m->link_tx_norm);
+    hs->link_rx = history_pack_score(m->valid_link_rx, m->link_rx_norm);
+    hs->link_all = history_pack_score(m->valid_link_all, m->link_all_norm);
+    hs->tx_pps = history_pack_rate(m->tx_packet_rate);
+    hs->rx_pps = history_pack_rate(m->rx_packet_rate);
+    ring->head = (ring->head + 1) % ring->capacity;
+    if (ring->count < ring->capacity) ring->count++;
+}
+
+static const struct history_sample *history_at(const struct history_ring *ring, size_t idx) {
+    size_t oldest = (ring->head + ring->capacity - ring->count) % ring->capacity;
+    return &ring->samples[(oldest + idx) % ring->capacity];
+}
+
+static int buf_append(char *buf, size_t len, size_t *off, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static int buf_append(char *buf, size_t len, size_t *off, const char *fmt, ...) {
+    if (*off >= len) return -1;
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(buf + *off, len - *off, fmt, ap);
+    va_end(ap);
+    if (w < 0 || *off + (size_t)w >= len) return -1;
+    *off += (size_t)w;
+    return 0;
+}
+
+static int send_rate_report(int sock, const struct sockaddr_in *addr, const struct rc_table *t,
+                            const struct rc_report *r, const char *station, double interval_s) {
+    char payload[1400];
+    size_t off = 0;
+    buf_append(payload, sizeof(payload), &off,
+               "{\"type\":\"rates\",\"station\":\"%s\",\"interval_s\":%.1f,\"attempts\":%llu,"
+               "\"per\":%.4f,\"goodput_mbps\":%.1f,\"rates\":[",
+               station, interval_s, (unsigned long long)r->attempts, r->per, r->goodput_mbps);
+    for (size_t i = 0; i < r->count; i++) {
+        const struct rc_report_rate *e = &r->top[i];
+        buf_append(payload, sizeof(payload), &off,
+                   "%s{\"rate\":\"%s\",\"idx\":%d,\"att\":%llu,\"per\":%.4f,\"share\":%.3f,\"tp\":%.1f}",
+                   i ? "," : "", t->cur[e->idx].name, e->idx,
+                   (unsigned long long)e->attempts, e->per, e->share, t->cur[e->idx].tp_max_x10 / 10.0);
+    }
+    if (buf_append(payload, sizeof(payload), &off, "]}\n") != 0) {
+        fprintf(stderr, "Rate report truncated\n");
+        return -1;
+    }
+    if (sendto(sock, payload, off, 0, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        fprintf(stderr, "sendto failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void history_append_score(char *buf, size_t len, size_t *off, uint8_t packed) {
+    if (packed == HISTORY_SCORE_NONE) {
+        buf_append(buf, len, off, "null");
+    } else {
+        buf_append(buf, len, off, "%.1f", packed / 2.0);
+    }
+}
+
+static size_t history_format_range(const struct history_ring *ring, uint32_t now_ms,
+                                   uint32_t since_ms, size_t max,
+                                   char *buf, size_t len) {
+    size_t off = 0;
+    buf_append(buf, len, &off, "{\"now\":%u,\"samples\":[", now_ms);
+    size_t emitted = 0;
+    for (size_t i = 0; i < ring->count && emitted < max; i++) {
+        const struct history_sample *hs = history_at(ring, i);
+        if (hs->t_ms < since_ms) continue;
+        size_t mark = off;
+        if (buf_append(buf, len, &off, "%s{\"t\":%u,\"signal\":", emitted ? "," : "", hs->t_ms) != 0)
+            break;
+        if (hs->signal_dbm == INT8_MIN) buf_append(buf, len, &off, "null");
+        else buf_append(buf, len, &off, "%d", hs->signal_dbm);
+        buf_append(buf, len, &off, ",\"rssi\":");
+        history_append_score(buf, len, &off, hs->rssi);
+        buf_append(buf, len, &off, ",\"link_tx\":");
+        history_append_score(buf, len, &off, hs->link_tx);
+        buf_append(buf, len, &off, ",\"link_rx\":");
+        history_append_score(buf, len, &off, hs->link_rx);
+        buf_append(buf, len, &off, ",\"link_all\":");
+        history_append_score(buf, len, &off, hs->link_all);
+        /* Leave room for the closing "]}" so a full buffer still yields valid JSON. */
+        if (buf_append(buf, len, &off, ",\"tx_pps\":%u,\"rx_pps\":%u}", hs->tx_pps, hs->rx_pps) != 0 ||
+            off + 4 >= len) {
+            off = mark;
+            break;
+        }
+        emitted++;
+    }
+    buf_append(buf, len, &off, "],\"count\":%zu}\n", emitted);
+    return off;
+}
+
+struct history_agg {
+    int min;
+    int max;
+    long sum;
+    unsigned n;
+};
+
+static void history_agg_add(struct history_agg *a, int value) {
+    if (a->n == 0 || value < a->min) a->min = value;
+    if (a->n == 0 || value > a->max) a->max = value;
+    a->sum += value;
+    a->n++;
+}
+
+static void history_agg_format(char *buf, size_t len, size_t *off, const char *key,
+                               const struct history_agg *a, double scale) {
+    if (a->n == 0) {
+        buf_append(buf, len, off, ",\"%s\":null", key);
+        return;
+    }
+    buf_append(buf, len, off, ",\"%s\":[%.1f,%.2f,%.1f,%u]", key,
+                   a->min * scale, (double)a->sum / a->n * scale, a->max * scale, a->n);
+}
+
+/* A bucket's "n" counts all of its samples; each metric carries its own count of valid ones. */
+static size_t history_format_agg(const struct history_ring *ring, uint32_t now_ms,
+                                 uint32_t window_ms, uint32_t bucket_ms,
+                                 char *buf, size_t len) {
+    enum { AGG_SIGNAL, AGG_RSSI, AGG_TX, AGG_RX, AGG_ALL, AGG_FIELDS };
+    static struct history_agg buckets[HISTORY_MAX_BUCKETS][AGG_FIELDS];
+    static unsigned samples[HISTORY_MAX_BUCKETS];
+
+    if (bucket_ms == 0) bucket_ms = 1000;
+    if (window_ms > now_ms) window_ms = now_ms;
+    uint32_t nbuckets = (window_ms + bucket_ms - 1) / bucket_ms;
+    if (nbuckets == 0) nbuckets = 1;
+    if (nbuckets > HISTORY_MAX_BUCKETS) {
+        nbuckets = HISTORY_MAX_BUCKETS;
+        window_ms = nbuckets * bucket_ms;
+        if (window_ms > now_ms) window_ms = now_ms;
+    }
+    uint32_t start_ms = now_ms - window_ms;
+    memset(buckets, 0, sizeof(buckets[0]) * nbuckets);
+    memset(samples, 0, sizeof(samples[0]) * nbuckets);
+
+    for (size_t i = 0; i < ring->count; i++) {
+        const struct history_sample *hs = history_at(ring, i);
+        if (hs->t_ms < start_ms) continue;
+        uint32_t b = (hs->t_ms - start_ms) / bucket_ms;
+        if (b >= nbuckets) b = nbuckets - 1;
+        samples[b]++;
+        if (hs->signal_dbm != INT8_MIN) history_agg_add(&buckets[b][AGG_SIGNAL], hs->signal_dbm);
+        if (hs->rssi != HISTORY_SCORE_NONE) history_agg_add(&buckets[b][AGG_RSSI], hs->rssi);
+        if (hs->link_tx != HISTORY_SCORE_NONE) history_agg_add(&buckets[b][AGG_TX], hs->link_tx);
+        if (hs->link_rx != HISTORY_SCORE_NONE) history_agg_add(&buckets[b][AGG_RX], hs->link_rx);
+        if (hs->link_all != HISTORY_SCORE_NONE) history_agg_add(&buckets[b][AGG_ALL], hs->link_all);
+    }
+
+    size_t off = 0;
+    buf_append(buf, len, &off, "{\"now\":%u,\"start\":%u,\"bucket_ms\":%u,\"buckets\":[",
+                   now_ms, start_ms, bucket_ms);
+    size_t emitted = 0;
+    for (uint32_t b = 0; b < nbuckets; b++) {
+        size_t mark = off;
+        buf_append(buf, len, &off, "%s{\"t\":%u,\"n\":%u", emitted ? "," : "",
+                       start_ms + b * bucket_ms, samples[b]);
+        history_agg_format(buf, len, &off, "signal", &buckets[b][AGG_SIGNAL], 1.0);
+        history_agg_format(buf, len, &off, "rssi", &buckets[b][AGG_RSSI], 0.5);
+        history_agg_format(buf, len, &off, "link_tx", &buckets[b][AGG_TX], 0.5);
+        history_agg_format(buf, len, &off, "link_rx", &buckets[b][AGG_RX], 0.5);
+        history_agg_format(buf, len, &off, "link_all", &buckets[b][AGG_ALL], 0.5);
+        if (buf_append(buf, len, &off, "}") != 0 || off + 4 >= len) {
+            off = mark;
+            break;
+        }
+        emitted++;
+    }
+    buf_append(buf, len, &off, "],\"count\":%zu}\n", emitted);
+    return off;
+}
+
+static void history_serve(struct history_ring *ring, uint32_t now_ms, int interval_ms) {
+    static char reply[HISTORY_REPLY_MAX];
+    char req[128];
+
+    for (;;) {
+        struct sockaddr_un peer;
+        socklen_t peer_len = sizeof(peer);
+        ssize_t n = recvfrom(ring->fd, req, sizeof(req) - 1, 0,
+                             (struct sockaddr *)&peer, &peer_len);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                fprintf(stderr, "history recvfrom failed: %s\n", strerror(errno));
+            }
+            return;
+        }
+        req[n] = '\0';
+        if (peer_len <= sizeof(sa_family_t)) {
+            continue;
+        }
+
+        char *cmd = trim(req);
+        size_t len = 0;
+        unsigned long a = 0, b = 0;
+        if (strncmp(cmd, "range", 5) == 0) {
+            unsigned long since = 0, max = HISTORY_MAX_SAMPLES;
+            sscanf(cmd + 5, "%lu %lu", &since, &max);
+            len = history_format_range(ring, now_ms, (uint32_t)since, (size_t)max,
+                                       reply, sizeof(reply));
+        } else if (strncmp(cmd, "agg", 3) == 0 && sscanf(cmd + 3, "%lu %lu", &a, &b) == 2) {
+            len = history_format_agg(ring, now_ms, (uint32_t)(a * 1000UL), (uint32_t)(b * 1000UL),
+                                     reply, sizeof(reply));
+        } else if (strcmp(cmd, "info") == 0) {
+            uint32_t oldest = ring->count ? history_at(ring, 0)->t_ms : 0;
+            int w = snprintf(reply, sizeof(reply),
+                             "{\"now\":%u,\"capacity\":%zu,\"count\":%zu,\"bytes\":%zu,"
+                             "\"interval_ms\":%d,\"oldest\":%u}\n",
+                             now_ms, ring->capacity, ring->count,
+                             ring->capacity * sizeof(struct history_sample),
+                             interval_ms, oldest);
+            len = w > 0 ? (size_t)w : 0;
+        } else {
+            int w = snprintf(reply, sizeof(reply),
+                             "{\"error\":\"usage: info | range SINCE_MS [MAX] | agg SECONDS BUCKET_S\"}\n");
+            len = w > 0 ? (size_t)w : 0;
+        }
+
+        if (sendto(ring->fd, reply, len, MSG_DONTWAIT,
+                   (struct sockaddr *)&peer, peer_len) < 0) {
+            fprintf(stderr, "history reply failed: %s\n", strerror(errno));
+        }
+    }
+}
+
+/* File numbers wrap at LOG_SEQ_MOD; a is newer than b when it is less than half the space ahead. */
+#define LOG_SEQ_MOD 1000000u
+
+static bool log_seq_after(unsigned a, unsigned b) {
+    unsigned d = (a + LOG_SEQ_MOD - b) % LOG_SEQ_MOD;
+    return d != 0 && d < LOG_SEQ_MOD / 2;
+}
+
+static bool log_parse_name(const char *name, unsigned *seq) {
+    unsigned value = 0;
+    int consumed = 0;
+    if (sscanf(name, "wm-%6u.wml%n", &value, &consumed) != 1) return false;
+    if (name[consumed] != '\0') return false;
+    *seq = value;
+    return true;
+}
+
+/* Removes the oldest closed files until the directory fits in cap_bytes. */
+static void log_prune(struct metrics_log *log) {
+    for (;;) {
+        DIR *d = opendir(log->dir);
+        if (!d) return;
+        uint64_t total = 0;
+        unsigned oldest = UINT_MAX, oldest_age = 0;
+        int files = 0;
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            unsigned seq;
+            if (!log_parse_name(de->d_name, &seq)) continue;
+            struct stat st;
+            if (fstatat(dirfd(d), de->d_name, &st, 0) != 0) continue;
+            total += (uint64_t)st.st_size;
+            files++;
+            /* Age behind the open file, so the order survives the wrap to wm-000000. */
+            unsigned age = (log->seq + LOG_SEQ_MOD - seq) % LOG_SEQ_MOD;
+            if (age > oldest_age) {
+                oldest_age = age;
+                oldest = seq;
+            }
+        }
+        closedir(d);
+        if (total <= log->cap_bytes || oldest == UINT_MAX || files <= 1) return;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/wm-%06u.wml", log->dir, oldest);
+        if (unlink(path) != 0) {
+            fprintf(stderr, "log: unlink(%s) failed: %s\n", path, strerror(errno));
+            return;
+        }
+    }
+}
+
+static int log_write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int log_open_next(struct metrics_log *log) {
+    char path[PATH_MAX];
+    for (int attempt = 0; attempt < 16; attempt++) {
+        log->seq = (log->seq + 1) % LOG_SEQ_MOD;
+        snprintf(path, sizeof(path), "%s/wm-%06u.wml", log->dir, log->seq);
+        int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            if (errno == EEXIST) continue;
+            fprintf(stderr, "log: open(%s) failed: %s\n", path, strerror(errno));
+            return -1;
+        }
+
+        uint8_t header[WMLOG_FILE_MAGIC_LEN + 4];
+        memcpy(header, WMLOG_FILE_MAGIC, WMLOG_FILE_MAGIC_LEN);
+        wmlog_put_u32(header + WMLOG_FILE_MAGIC_LEN, WMLOG_COLUMNS);
+        if (log_write_all(fd, header, sizeof(header)) != 0 || fsync(fd) != 0) {
+            fprintf(stderr, "log: header write to %s failed: %s\n", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        /* Make the new directory entry durable before any blocks depend on it. */
+        int dfd = open(log->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) {
+            fsync(dfd);
+            close(dfd);
+        }
+        log->fd = fd;
+        log->file_bytes = sizeof(header);
+        log->blocks_since_sync = 0;
+        log_prune(log);
+        return 0;
+    }
+    fprintf(stderr, "log: no free file name in %s\n", log->dir);
+    return -1;
+}
+
+static void log_close_file(struct metrics_log *log) {
+    if (log->fd < 0) return;
+    if (fsync(log->fd) != 0) {
+        fprintf(stderr, "log: fsync failed: %s\n", strerror(errno));
+    }
+    close(log->fd);
+    log->fd = -1;
+}
+
+static void log_flush_block(struct metrics_log *log) {
+    if (log->block_count == 0) return;
+    size_t count = log->block_count;
+    log->block_count = 0;
+
+    if (log->fd < 0 && log_open_next(log) != 0) {
+        atomic_fetch_add(&log->dropped, count);
+        return;
+    }
+
+    uint8_t *payload = log->buf + WMLOG_BLOCK_HEADER;
+    size_t payload_len = wmlog_encode_block(log->block, count, payload);
+    wmlog_put_u32(log->buf, WMLOG_BLOCK_MAGIC);
+    wmlog_put_u16(log->buf + 4, (uint16_t)count);
+    wmlog_put_u16(log->buf + 6, 0);
+    wmlog_put_u32(log->buf + 8, (uint32_t)payload_len);
+    wmlog_put_u32(log->buf + 12, wmlog_crc32(payload, payload_len));
+
+    size_t total = WMLOG_BLOCK_HEADER + payload_len;
+    if (log_write_all(log->fd, log->buf, total) != 0) {
+        fprintf(stderr, "log: write failed: %s\n", strerror(errno));
+        atomic_fetch_add(&log->dropped, count);
+        close(log->fd);
+        log->fd = -1;
+        return;
+    }
+    log->file_bytes += total;
+
+    if (++log->blocks_since_sync >= LOG_SYNC_BLOCKS) {
+        if (fdatasync(log->fd) != 0) {
+            fprintf(stderr, "log: fdatasync failed: %s\n", strerror(errno));
+        }
+        log->blocks_since_sync = 0;
+    }
+    if (log->file_bytes >= log->file_cap_bytes) {
+        log_close_file(log);
+    }
+}
+
+static void *log_writer_thread(void *arg) {
+    struct metrics_log *log = arg;
+
+    for (;;) {
+        bool stopping = atomic_load_explicit(&log->stop, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+
+        while (tail != head) {
+            if (log->block_count == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &log->block_start);
+            }
+            log->block[log->block_count++] = log->queue[tail & (LOG_QUEUE_SLOTS - 1)];
+            tail++;
+            atomic_store_explicit(&log->tail, tail, memory_order_release);
+            if (log->block_count == WMLOG_BLOCK_RECORDS) {
+                log_flush_block(log);
+            }
+        }
+
+        if (log->block_count > 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (stopping || timespec_diff_seconds(&now, &log->block_start) * 1000.0 >= LOG_FLUSH_MS) {
+                log_flush_block(log);
+            }
+        }
+
+        if (stopping) break;
+
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = LOG_POLL_MS * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    log_close_file(log);
+    return NULL;
+}
+
+static int log_start(struct metrics_log *log, const char *dir, int cap_mb) {
+    memset(log, 0, sizeof(*log));
+    log->fd = -1;
+    log->dir = dir;
+    log->cap_bytes = (uint64_t)(cap_mb > 0 ? cap_mb : 64) * 1024u * 1024u;
+    log->file_cap_bytes = log->cap_bytes / LOG_MAX_FILES;
+    if (log->file_cap_bytes < 64u * 1024u) log->file_cap_bytes = 64u * 1024u;
+    atomic_init(&log->head, 0);
+    atomic_init(&log->tail, 0);
+    atomic_init(&log->stop, false);
+    atomic_init(&log->dropped, 0);
+
+    /* Never append to a file that may end in a torn block; continue numbering instead. */
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "log: opendir(%s) failed: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    struct dirent *de;
+    bool have_seq = false;
+    while ((de = readdir(d)) != NULL) {
+        unsigned seq;
+        if (!log_parse_name(de->d_name, &seq)) continue;
+        if (!have_seq || log_seq_after(seq, log->seq)) log->seq = seq;
+        have_seq = true;
+    }
+    closedir(d);
+
+    int rc = pthread_create(&log->thread, NULL, log_writer_thread, log);
+    if (rc != 0) {
+        fprintf(stderr, "log: pthread_create failed: %s\n", strerror(rc));
+        return -1;
+    }
+    log->running = true;
+    printf("Logging to %s (cap %llu bytes, %llu per file)\n", dir,
+           (unsigned long long)log->cap_bytes, (unsigned long long)log->file_cap_bytes);
+    fflush(stdout);
+    return 0;
+}
+
+static void log_stop(struct metrics_log *log) {
+    if (!log->running) return;
+    atomic_store_explicit(&log->stop, true, memory_order_release);
+    pthread_join(log->thread, NULL);
+    log->running = false;
+    unsigned long dropped = atomic_load(&log->dropped);
+    if (dropped) {
+        fprintf(stderr, "log: %lu records dropped\n", dropped);
+    }
+}
+
+static int64_t log_scaled(bool valid, double value) {
+    return (valid && !isnan(value)) ? (int64_t)llround(value * 100.0) : WMLOG_MISSING;
+}
+
+static int64_t log_counter(const struct station_sample *st, enum counter_id id) {
+    return SAMPLE_HAS(st, id) ? (int64_t)st->counter[id] : WMLOG_MISSING;
+}
+
+/* Called from the sample loop: never blocks, drops the record if the writer lags. */
+static void log_push(struct metrics_log *log, const struct metrics *m) {
+    if (!log->running) return;
+    size_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_acquire);
+    if (head - tail >= LOG_QUEUE_SLOTS) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    const struct station_sample *st = &m->raw_station;
+    struct wmlog_record *rec = &log->queue[head & (LOG_QUEUE_SLOTS - 1)];
+    rec->v[WMLOG_COL_TIME_MS] = (int64_t)wall.tv_sec * 1000 + wall.tv_nsec / 1000000;
+    rec->v[WMLOG_COL_SIGNAL_DBM] = isnan(st->signal_dbm) ? WMLOG_MISSING : (int64_t)lround(st->signal_dbm);
+    rec->v[WMLOG_COL_RSSI_X100] = log_scaled(m->valid_rssi, m->rssi_norm);
+    rec->v[WMLOG_COL_LINK_TX_X100] = log_scaled(m->valid_link_tx, m->link_tx_norm);
+    rec->v[WMLOG_COL_LINK_RX_X100] = log_scaled(m->valid_link_rx, m->link_rx_norm);
+    rec->v[WMLOG_COL_LINK_ALL_X100] = log_scaled(m->valid_link_all, m->link_all_norm);
+    rec->v[WMLOG_COL_TX_PACKETS] = log_counter(st, CTR_TX_PACKETS);
+    rec->v[WMLOG_COL_TX_RETRIES] = log_counter(st, CTR_TX_RETRIES);
+    rec->v[WMLOG_COL_TX_FAILED] = log_counter(st, CTR_TX_FAILED);
+    rec->v[WMLOG_COL_BEACON_LOSS] = log_counter(st, CTR_BEACON_LOSS);
+    rec->v[WMLOG_COL_RX_PACKETS] = log_counter(st, CTR_RX_PACKETS);
+    rec->v[WMLOG_COL_RX_DUPLICATES] = log_counter(st, CTR_RX_DUPLICATES);
+    rec->v[WMLOG_COL_RX_DROP_MISC] = log_counter(st, CTR_RX_DROP_MISC);
+    atomic_store_explicit(&log->head, head + 1, memory_order_release);
+}
+
+static void latency_observe(struct latency_histogram *h, double seconds) {
+    size_t i = 0;
+    while (i < LATENCY_BUCKETS && seconds > latency_bounds_s[i]) i++;
+    h->buckets[i]++;
+    h->sum_s += seconds;
+    h->count++;
+}
+
+static int exporter_open(struct exporter *ex, const char *spec) {
+    memset(ex, 0, sizeof(*ex));
+    ex->listen_fd = -1;
+    for (size_t i = 0; i < EXPORTER_CLIENTS; i++) ex->clients[i].fd = -1;
+
+    char addr_buf[64] = "0.0.0.0";
+    const char *port_str = spec;
+    const char *colon = strrchr(spec, ':');
+    if (colon) {
+        size_t n = (size_t)(colon - spec);
+        if (n >= sizeof(addr_buf)) {
+            fprintf(stderr, "Invalid exporter address: %s\n", spec);
+            return -1;
+        }
+        memcpy(addr_buf, spec, n);
+        addr_buf[n] = '\0';
+        port_str = colon + 1;
+    }
+    int port = atoi(port_str);
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "Invalid exporter port: %s\n", spec);
+        return -1;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+    };
+    if (inet_pton(AF_INET, addr_buf, &addr.sin_addr) != 1) {
+        fprintf(stderr, "inet_pton failed for exporter address %s\n", addr_buf);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket(AF_INET,SOCK_STREAM) failed: %s\n", strerror(errno));
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, EXPORTER_CLIENTS) < 0) {
+        fprintf(stderr, "exporter bind/listen on %s:%d failed: %s\n", addr_buf, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    ex->listen_fd = fd;
+    printf("Serving OpenMetrics on http://%s:%d/metrics\n", addr_buf, port);
+    fflush(stdout);
+    return 0;
+}
+
+static void exporter_close(struct exporter *ex) {
+    for (size_t i = 0; i < EXPORTER_CLIENTS; i++) {
+        if (ex->clients[i].fd >= 0) close(ex->clients[i].fd);
+        ex->clients[i].fd = -1;
+    }
+    if (ex->listen_fd >= 0) close(ex->listen_fd);
+    ex->listen_fd = -1;
+}
+
+static void exporter_update(struct exporter *ex, const struct metrics *m,
+                            const char *device, const char *station) {
+    struct exporter_snapshot *snap = &ex->snap;
+    snap->metrics = *m;
+    snap->have_metrics = true;
+    snprintf(snap->device, sizeof(snap->device), "%s", device ? device : "");
+    snprintf(snap->station, sizeof(snap->station), "%s", station ? station : "");
+    clock_gettime(CLOCK_REALTIME, &snap->updated);
+}
+
+/* No station sample right now (lost, or the interface went away): stop serving the last one. */
+static void exporter_invalidate(struct exporter *ex) {
+    ex->snap.have_metrics = false;
+    ex->snap.station[0] = '\0';
+}
+
+static void exporter_gauge(char *buf, size_t len, size_t *off, const char *name,
+                           const char *help, const char *labels, bool valid, double value) {
+    buf_append(buf, len, off, "# TYPE %s gauge\n# HELP %s %s\n", name, name, help);
+    if (valid && !isnan(value) && !isinf(value)) {
+        buf_append(buf, len, off, "%s%s%s%s %.15g\n", name,
+                   labels[0] ? "{" : "", labels, labels[0] ? "}" : "", value);
+    }
+}
+
+static void exporter_counter(char *buf, size_t len, size_t *off, const char *name,
+                             const char *help, const char *labels, double value) {
+    buf_append(buf, len, off, "# TYPE %s counter\n# HELP %s %s\n", name, name, help);
+    if (!isnan(value)) {
+        buf_append(buf, len, off, "%s_total%s%s%s %.0f\n", name,
+                   labels[0] ? "{" : "", labels, labels[0] ? "}" : "", value);
+    }
+}
+
+static void exporter_histogram(char *buf, size_t len, size_t *off, const char *name,
+                               const char *help, const struct latency_histogram *h) {
+    buf_append(buf, len, off, "# TYPE %s histogram\n# HELP %s %s\n# UNIT %s seconds\n",
+                   name, name, help, name);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        cumulative += h->buckets[i];
+        buf_append(buf, len, off, "%s_bucket{le=\"%g\"} %llu\n",
+                       name, latency_bounds_s[i], (unsigned long long)cumulative);
+    }
+    cumulative += h->buckets[LATENCY_BUCKETS];
+    buf_append(buf, len, off, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.6f\n%s_count %llu\n",
+                   name, (unsigned long long)cumulative, name, h->sum_s,
+                   name, (unsigned long long)h->count);
+}
+
+static size_t exporter_render(struct exporter *ex) {
+    const struct exporter_snapshot *snap = &ex->snap;
+    const struct metrics *m = &snap->metrics;
+    const struct station_sample *st = &m->raw_station;
+    char *buf = ex->body;
+    size_t len = sizeof(ex->body);
+    size_t off = 0;
+    char labels[128];
+    snprintf(labels, sizeof(labels), "device=\"%s\",station=\"%s\"", snap->device, snap->station);
+    bool ok = snap->have_metrics;
+
+    /* Per-station series below are omitted while this is 0. */
+    exporter_gauge(buf, len, &off, "wifi_metrics_up", "1 while a station is sampled, 0 after it was lost.",
+                   "", true, ok ? 1.0 : 0.0);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rssi_score", "Normalised RSSI score (0-100).",
+                   labels, ok && m->valid_rssi, m->rssi_norm);
+    exporter_gauge(buf, len, &off, "wifi_metrics_link_tx_score", "EMA-smoothed TX link health (0-100).",
+                   labels, ok && m->valid_link_tx, m->link_tx_norm);
+    exporter_gauge(buf, len, &off, "wifi_metrics_link_rx_score", "EMA-smoothed RX link health (0-100).",
+                   labels, ok && m->valid_link_rx, m->link_rx_norm);
+    exporter_gauge(buf, len, &off, "wifi_metrics_link_all_score", "Combined link health (0-100).",
+                   labels, ok && m->valid_link_all, m->link_all_norm);
+    exporter_gauge(buf, len, &off, "wifi_metrics_queue_score", "EMA-smoothed queue health from aqm (0-100).",
+                   labels, ok && m->queue.valid, m->queue.score);
+    exporter_gauge(buf, len, &off, "wifi_metrics_queue_delay_seconds", "Estimated queueing delay (backlog / drain rate).",
+                   labels, ok && m->queue.valid, m->queue.delay_ms / 1000.0);
+    exporter_gauge(buf, len, &off, "wifi_metrics_queue_drop_rate", "aqm drops plus overlimit per second.",
+                   labels, ok && m->queue.valid, m->queue.drop_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_queue_mark_rate", "aqm ECN marks per second.",
+                   labels, ok && m->queue.valid, m->queue.mark_rate);
+    buf_append(buf, len, &off, "# TYPE wifi_metrics_queue_backlog_bytes gauge\n"
+               "# HELP wifi_metrics_queue_backlog_bytes Bytes queued in mac80211 per access category.\n");
+    for (int ac = 0; ac < AQM_ACS && ok && m->queue.valid; ac++) {
+        buf_append(buf, len, &off, "wifi_metrics_queue_backlog_bytes{%s,ac=\"%s\"} %.0f\n",
+                   labels, aqm_ac_names[ac], m->queue.ac_backlog_bytes[ac]);
+    }
+    const struct host_metrics *h = &m->host;
+    bool host_ok = ok && h->valid;
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_score", "EMA-smoothed router load health (0-100).",
+                   labels, host_ok, h->score);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_cpu_busy_ratio", "Non-idle CPU share over the last tick.",
+                   labels, host_ok, h->cpu_busy_pct / 100.0);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_softirq_ratio", "CPU share spent in softirq.",
+                   labels, host_ok, h->softirq_pct / 100.0);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_net_rx_softirq_rate", "NET_RX softirqs per second.",
+                   labels, host_ok, h->net_rx_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_net_tx_softirq_rate", "NET_TX softirqs per second.",
+                   labels, host_ok, h->net_tx_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_softnet_drop_rate", "softnet backlog drops per second.",
+                   labels, host_ok, h->softnet_drop_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_softnet_squeeze_rate", "NAPI budget exhaustions per second.",
+                   labels, host_ok, h->softnet_squeeze_rate);
+    buf_append(buf, len, &off, "# TYPE wifi_metrics_host_pressure_some_avg10 gauge\n"
+               "# HELP wifi_metrics_host_pressure_some_avg10 PSI some avg10 in percent per resource.\n");
+    for (int i = 0; host_ok && i < HOST_PSI_COUNT; i++) {
+        if (isnan(h->psi_some_avg10[i])) continue;
+        buf_append(buf, len, &off, "wifi_metrics_host_pressure_some_avg10{%s,resource=\"%s\"} %.2f\n",
+                   labels, host_psi_names[i], h->psi_some_avg10[i]);
+    }
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_mem_available_ratio", "MemAvailable / MemTotal.",
+                   labels, host_ok, h->mem_avail_pct / 100.0);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_zram_orig_bytes", "Uncompressed bytes stored in zram0.",
+                   labels, host_ok, h->zram_orig_bytes);
+    exporter_gauge(buf, len, &off, "wifi_metrics_host_zram_used_bytes", "Memory used by zram0.",
+                   labels, host_ok, h->zram_used_bytes);
+    const struct rf_metrics *rf = &m->rf;
+    bool rf_ok = ok && rf->valid;
+    exporter_gauge(buf, len, &off, "wifi_metrics_interference_score", "EMA-smoothed co-channel interference health (0-100).",
+                   labels, rf_ok, rf->score);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rf_fcs_error_rate", "Frames failing FCS per second on the phy.",
+                   labels, rf_ok, rf->fcs_error_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rf_fcs_error_ratio", "FCS errors / (FCS errors + station RX packets).",
+                   labels, rf_ok, rf->fcs_error_ratio);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rf_false_cca_rate", "mt76 false CCA per second.",
+                   labels, rf_ok, rf->false_cca_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rf_ack_failure_rate", "dot11ACKFailureCount per second.",
+                   labels, rf_ok, rf->ack_fail_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rf_rts_failure_ratio", "RTS failures / RTS attempts.",
+                   labels, rf_ok, rf->rts_fail_ratio);
+    const struct probe_stats *pb = &snap->probe;
+    bool probe_ok = snap->have_probe;
+    buf_append(buf, len, &off, "# TYPE wifi_metrics_probe_rtt_seconds gauge\n"
+               "# HELP wifi_metrics_probe_rtt_seconds Probe RTT quantiles over the last %d pings.\n", PROBE_WINDOW);
+    static const double probe_q[] = { 0.5, 0.9, 0.99 };
+    for (size_t i = 0; probe_ok && i < 3; i++) {
+        double v = i == 0 ? pb->rtt_p50_ms : i == 1 ? pb->rtt_p90_ms : pb->rtt_p99_ms;
+        if (isnan(v)) continue;
+        buf_append(buf, len, &off, "wifi_metrics_probe_rtt_seconds{%s,quantile=\"%g\"} %.6f\n",
+                   labels, probe_q[i], v / 1000.0);
+    }
+    exporter_gauge(buf, len, &off, "wifi_metrics_probe_loss_ratio", "Share of probes without an echo.",
+                   labels, probe_ok, pb->loss);
+    exporter_gauge(buf, len, &off, "wifi_metrics_probe_capacity_mbps", "Bottleneck rate from packet-train dispersion.",
+                   labels, probe_ok, pb->capacity_mbps);
+    exporter_counter(buf, len, &off, "wifi_metrics_probe_budget_skips", "Probes skipped because the airtime budget was spent.",
+                     labels, probe_ok ? (double)pb->budget_skips : NAN);
+    exporter_gauge(buf, len, &off, "wifi_metrics_signal_dbm", "Last station signal in dBm.",
+                   labels, ok, st->signal_dbm);
+    const struct fast_sample *f = &snap->fast;
+    bool fast_ok = ok && snap->have_fast;
+    buf_append(buf, len, &off, "# TYPE wifi_metrics_chain_signal_dbm gauge\n"
+               "# HELP wifi_metrics_chain_signal_dbm Per-chain signal from the fast path.\n");
+    for (int i = 0; fast_ok && i < f->chains; i++) {
+        if (isnan(f->chain_dbm[i])) continue;
+        buf_append(buf, len, &off, "wifi_metrics_chain_signal_dbm{%s,chain=\"%d\"} %.0f\n",
+                   labels, i, f->chain_dbm[i]);
+    }
+    exporter_gauge(buf, len, &off, "wifi_metrics_chain_imbalance_db", "Strongest minus weakest chain.",
+                   labels, fast_ok, f->imbalance_db);
+    exporter_gauge(buf, len, &off, "wifi_metrics_chain_combining_gain_db", "Combined signal minus strongest chain.",
+                   labels, fast_ok, f->combining_gain_db);
+    exporter_counter(buf, len, &off, "wifi_metrics_best_chain_switches", "Changes of the strongest chain.",
+                     labels, fast_ok ? (double)f->best_chain_switches : NAN);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rx_bitrate_mbps", "Last RX bitrate from the fast path.",
+                   labels, fast_ok, f->rx_rate_mbps);
+    exporter_gauge(buf, len, &off, "wifi_metrics_tx_retry_ratio", "Weighted TX retry/fail ratio over the last tick.",
+                   labels, ok, m->tx_retry_ratio);
+    exporter_gauge(buf, len, &off, "wifi_metrics_tx_retry_rate", "TX retries per second.",
+                   labels, ok, m->tx_retry_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_tx_fail_rate", "TX failures per second.",
+                   labels, ok, m->tx_fail_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_tx_beacon_loss_rate", "Beacon losses per second.",
+                   labels, ok, m->tx_beacon_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_tx_packet_rate", "TX packets per second.",
+                   labels, ok, m->tx_packet_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rx_retry_ratio", "RX duplicate ratio over the last tick.",
+                   labels, ok, m->rx_retry_ratio);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rx_retry_rate", "RX duplicates per second.",
+                   labels, ok, m->rx_retry_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rx_drop_rate", "RX misc drops per second.",
+                   labels, ok, m->rx_drop_rate);
+    exporter_gauge(buf, len, &off, "wifi_metrics_rx_packet_rate", "RX packets per second.",
+                   labels, ok, m->rx_packet_rate);
+
+    exporter_counter(buf, len, &off, "wifi_metrics_station_tx_packets", "Station TX packets.",
+                     labels, ok ? sample_counter(st, CTR_TX_PACKETS) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_tx_retries", "Station TX retries.",
+                     labels, ok ? sample_counter(st, CTR_TX_RETRIES) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_tx_failed", "Station TX failures.",
+                     labels, ok ? sample_counter(st, CTR_TX_FAILED) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_beacon_loss", "Station beacon losses.",
+                     labels, ok ? sample_counter(st, CTR_BEACON_LOSS) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_rx_packets", "Station RX packets.",
+                     labels, ok ? sample_counter(st, CTR_RX_PACKETS) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_rx_duplicates", "Station RX duplicates.",
+                     labels, ok ? sample_counter(st, CTR_RX_DUPLICATES) : NAN);
+    exporter_counter(buf, len, &off, "wifi_metrics_station_rx_drop_misc", "Station RX misc drops.",
+                     labels, ok ? sample_counter(st, CTR_RX_DROP_MISC) : NAN);
+
+    exporter_counter(buf, len, &off, "wifi_metrics_ticks", "Sample loop iterations.",
+                     "", (double)snap->ticks);
+    exporter_counter(buf, len, &off, "wifi_metrics_send_errors", "Failed UDP sends.",
+                     "", (double)snap->send_errors);
+    exporter_counter(buf, len, &off, "wifi_metrics_fetch_errors", "Failed station fetches.",
+                     "", (double)snap->fetch_errors);
+    exporter_counter(buf, len, &off, "wifi_metrics_counter_wraps", "Station counters that wrapped at 32 bits.",
+                     "", (double)snap->counter_wraps);
+    exporter_counter(buf, len, &off, "wifi_metrics_counter_resets", "Driver resets of station counters.",
+                     "", (double)snap->counter_resets);
+    exporter_gauge(buf, len, &off, "wifi_metrics_last_update_seconds", "Wall-clock time of the last snapshot.",
+                   "", ok, (double)snap->updated.tv_sec + snap->updated.tv_nsec / 1e9);
+    exporter_histogram(buf, len, &off, "wifi_metrics_tick_seconds",
+                       "Time spent per sample tick (fetch, scoring and send).", &snap->tick_latency);
+    exporter_histogram(buf, len, &off, "wifi_metrics_fetch_seconds",
+                       "Time spent fetching station counters.", &snap->fetch_latency);
+    if (buf_append(buf, len, &off, "# EOF\n") != 0) {
+        fprintf(stderr, "exporter: body truncated at %zu bytes\n", off);
+    }
+    return off;
+}
+
+static void exporter_drop(struct exporter_client *c) {
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void exporter_flush(struct exporter_client *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            exporter_drop(c);
+            return;
+        }
+        c->out_off += (size_t)n;
+    }
+    exporter_drop(c);
+}
+
+static void exporter_respond(struct exporter *ex, struct exporter_client *c) {
+    bool is_get = strncmp(c->req, "GET ", 4) == 0;
+    const char *path = c->req + 4;
+    bool metrics_path = is_get &&
+        (strncmp(path, "/metrics ", 9) == 0 || strncmp(path, "/ ", 2) == 0);
+
+    int w;
+    if (metrics_path) {
+        size_t body_len = exporter_render(ex);
+        w = snprintf(c->out, sizeof(c->out),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_len);
+        if (w < 0 || (size_t)w + body_len > sizeof(c->out)) {
+            exporter_drop(c);
+            return;
+        }
+        memcpy(c->out + w, ex->body, body_len);
+        c->out_len = (size_t)w + body_len;
+    } else {
+        w = snprintf(c->out, sizeof(c->out),
+                     "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        c->out_len = w > 0 ? (size_t)w : 0;
+    }
+    c->out_off = 0;
+    exporter_flush(c);
+}
+
+static void exporter_accept(struct exporter *ex) {
+    for (;;) {
+        int fd = accept4(ex->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        struct exporter_client *slot = NULL;
+        for (size_t i = 0; i < EXPORTER_CLIENTS; i++) {
+            if (ex->clients[i].fd < 0) {
+                slot = &ex->clients[i];
+                break;
+            }
+        }
+        if (!slot) {
+            close(fd);
+            continue;
+        }
+        slot->fd = fd;
+        slot->req_len = 0;
+        slot->out_len = 0;
+        slot->out_off = 0;
+    }
+}
+
+static void exporter_read(struct exporter *ex, struct exporter_client *c) {
+    for (;;) {
+        if (c->req_len + 1 >= sizeof(c->req)) {
+            exporter_drop(c);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) exporter_drop(c);
+            return;
+        }
+        if (n == 0) {
+            exporter_drop(c);
+            return;
+        }
+        c->req_len += (size_t)n;
+        c->req[c->req_len] = '\0';
+        if (strstr(c->req, "\r\n\r\n") || strstr(c->req, "\n\n")) {
+            exporter_respond(ex, c);
+            return;
+        }
+    }
+}
+
+static uint32_t ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double s = timespec_diff_seconds(&now, start);
+    return s <= 0.0 ? 0 : (uint32_t)(s * 1000.0);
+}
+
+#ifdef WITH_UBUS
+/* Persistent ubus connection: iwinfo collector (-U) and the wifi_metrics object (-u). */
+struct ubus_link {
+    struct ubus_context *ctx;
+    const char *path;
+    uint32_t iwinfo_id;
+    bool have_iwinfo;
+    bool publish;
+    bool lost;                   /* ubusd went away; fd closed until a reconnect works */
+    int backoff_ms;              /* wait after last_try before the next reconnect */
+    struct timespec last_try;
+    const struct exporter_snapshot *snap;
+    struct blob_buf req;
+    struct blob_buf reply;
+};
+
+#define UBUS_RETRY_MIN_MS 500
+#define UBUS_RETRY_MAX_MS 30000
+
+static struct ubus_link *g_ubus_link;
+
+enum { ASSOC_RESULTS, __ASSOC_MAX };
+static const struct blobmsg_policy assoc_policy[__ASSOC_MAX] = {
+    [ASSOC_RESULTS] = { .name = "results", .type = BLOBMSG_TYPE_ARRAY },
+};
+
+enum { ASSOC_STA_MAC, ASSOC_STA_SIGNAL, ASSOC_STA_RX, ASSOC_STA_TX, __ASSOC_STA_MAX };
+static const struct blobmsg_policy assoc_sta_policy[__ASSOC_STA_MAX] = {
+    [ASSOC_STA_MAC]    = { .name = "mac",    .type = BLOBMSG_TYPE_STRING },
+    [ASSOC_STA_SIGNAL] = { .name = "signal", .type = BLOBMSG_TYPE_INT32 },
+    [ASSOC_STA_RX]     = { .name = "rx",     .type = BLOBMSG_TYPE_TABLE },
+    [ASSOC_STA_TX]     = { .name = "tx",     .type = BLOBMSG_TYPE_TABLE },
+};
+
+enum { ASSOC_DIR_PACKETS, ASSOC_DIR_RETRIES, ASSOC_DIR_FAILED, __ASSOC_DIR_MAX };
+static const struct blobmsg_policy assoc_dir_policy[__ASSOC_DIR_MAX] = {
+    [ASSOC_DIR_PACKETS] = { .name = "packets", .type = BLOBMSG_TYPE_INT32 },
+    [ASSOC_DIR_RETRIES] = { .name = "retries", .type = BLOBMSG_TYPE_INT32 },
+    [ASSOC_DIR_FAILED]  = { .name = "failed",  .type = BLOBMSG_TYPE_INT32 },
+};
+
+struct ubus_station_req {
+    const char *target_mac;
+    struct station_sample *out;
+    char *matched;
+    size_t matched_len;
+    bool found;
+};
+
+static void ubus_assoclist_cb(struct ubus_request *req, int type, struct blob_attr *msg) {
+    (void)type;
+    struct ubus_station_req *sr = req->priv;
+    struct blob_attr *tb[__ASSOC_MAX];
+    blobmsg_parse(assoc_policy, __ASSOC_MAX, tb, blob_data(msg), blob_len(msg));
+    if (!tb[ASSOC_RESULTS]) return;
+
+    struct blob_attr *cur;
+    size_t rem;
+    blobmsg_for_each_attr(cur, tb[ASSOC_RESULTS], rem) {
+        struct blob_attr *st[__ASSOC_STA_MAX];
+        blobmsg_parse(assoc_sta_policy, __ASSOC_STA_MAX, st, blobmsg_data(cur), blobmsg_data_len(cur));
+        if (!st[ASSOC_STA_MAC]) continue;
+
+        char mac[32];
+        normalize_mac(blobmsg_get_string(st[ASSOC_STA_MAC]), mac, sizeof(mac));
+        if (sr->target_mac && sr->target_mac[0] && !mac_equal(mac, sr->target_mac)) continue;
+
+        if (sr->matched && sr->matched_len) {
+            snprintf(sr->matched, sr->matched_len, "%s", mac);
+        }
+        if (sr->out) {
+            struct station_sample *out = sr->out;
+            if (st[ASSOC_STA_SIGNAL]) {
+                out->signal_dbm = (double)(int32_t)blobmsg_get_u32(st[ASSOC_STA_SIGNAL]);
+            }
+            struct blob_attr *dir[__ASSOC_DIR_MAX];
+            if (st[ASSOC_STA_TX]) {
+                blobmsg_parse(assoc_dir_policy, __ASSOC_DIR_MAX, dir,
+                              blobmsg_data(st[ASSOC_STA_TX]), blobmsg_data_len(st[ASSOC_STA_TX]));
+                if (dir[ASSOC_DIR_PACKETS]) sample_set(out, CTR_TX_PACKETS, blobmsg_get_u32(dir[ASSOC_DIR_PACKETS]));
+                if (dir[ASSOC_DIR_RETRIES]) sample_set(out, CTR_TX_RETRIES, blobmsg_get_u32(dir[ASSOC_DIR_RETRIES]));
+                if (dir[ASSOC_DIR_FAILED])  sample_set(out, CTR_TX_FAILED, blobmsg_get_u32(dir[ASSOC_DIR_FAILED]));
+            }
+            if (st[ASSOC_STA_RX]) {
+                blobmsg_parse(assoc_dir_policy, __ASSOC_DIR_MAX, dir,
+                              blobmsg_data(st[ASSOC_STA_RX]), blobmsg_data_len(st[ASSOC_STA_RX]));
+                if (dir[ASSOC_DIR_PACKETS]) sample_set(out, CTR_RX_PACKETS, blobmsg_get_u32(dir[ASSOC_DIR_PACKETS]));
+            }
+            /* iwinfo does not report beacon loss; treat it as a flat counter. */
+            sample_set(out, CTR_BEACON_LOSS, 0);
+        }
+        sr->found = true;
+        break;
+    }
+}
+
+static void ubus_add_number(struct blob_buf *b, const char *name, bool valid, double value) {
+    if (valid && !isnan(value) && !isinf(value)) {
+        blobmsg_add_double(b, name, value);
+    }
+}
+
+static int ubus_get_method(struct ubus_context *ctx, struct ubus_object *obj,
+                           struct ubus_request_data *req, const char *method,
+                           struct blob_attr *msg) {
+    (void)obj; (void)method; (void)msg;
+    struct ubus_link *link = g_ubus_link;
+    if (!link || !link->snap) return UBUS_STATUS_NO_DATA;
+    const struct exporter_snapshot *snap = link->snap;
+    const struct metrics *m = &snap->metrics;
+    bool ok = snap->have_metrics;
+
+    blob_buf_init(&link->reply, 0);
+    blobmsg_add_string(&link->reply, "device", snap->device);
+    blobmsg_add_string(&link->reply, "station", snap->station);
+    blobmsg_add_u64(&link->reply, "updated_ms",
+                    (uint64_t)snap->updated.tv_sec * 1000u + (uint64_t)snap->updated.tv_nsec / 1000000u);
+    blobmsg_add_u64(&link->reply, "ticks", snap->ticks);
+    ubus_add_number(&link->reply, "rssi", ok && m->valid_rssi, m->rssi_norm);
+    ubus_add_number(&link->reply, "link_tx", ok && m->valid_link_tx, m->link_tx_norm);
+    ubus_add_number(&link->reply, "link_rx", ok && m->valid_link_rx, m->link_rx_norm);
+    ubus_add_number(&link->reply, "link_all", ok && m->valid_link_all, m->link_all_norm);
+    ubus_add_number(&link->reply, "queue", ok && m->queue.valid, m->queue.score);
+    ubus_add_number(&link->reply, "host", ok && m->host.valid, m->host.score);
+    ubus_add_number(&link->reply, "interference", ok && m->rf.valid, m->rf.score);
+
+    void *raw = blobmsg_open_table(&link->reply, "raw");
+    ubus_add_number(&link->reply, "signal", ok, m->raw_station.signal_dbm);
+    ubus_add_number(&link->reply, "tx_retry_ratio", ok, m->tx_retry_ratio);
+    ubus_add_number(&link->reply, "tx_retry_rate", ok, m->tx_retry_rate);
+    ubus_add_number(&link->reply, "tx_fail_rate", ok, m->tx_fail_rate);
+    ubus_add_number(&link->reply, "tx_beacon_rate", ok, m->tx_beacon_rate);
+    ubus_add_number(&link->reply, "tx_packet_rate", ok, m->tx_packet_rate);
+    ubus_add_number(&link->reply, "rx_retry_ratio", ok, m->rx_retry_ratio);
+    ubus_add_number(&link->reply, "rx_retry_rate", ok, m->rx_retry_rate);
+    ubus_add_number(&link->reply, "rx_drop_rate", ok, m->rx_drop_rate);
+    ubus_add_number(&link->reply, "rx_packet_rate", ok, m->rx_packet_rate);
+    ubus_add_number(&link->reply, "queue_backlog", ok && m->queue.valid, m->queue.backlog_bytes);
+    ubus_add_number(&link->reply, "queue_delay_ms", ok && m->queue.valid, m->queue.delay_ms);
+    ubus_add_number(&link->reply, "queue_drop_rate", ok && m->queue.valid, m->queue.drop_rate);
+    ubus_add_number(&link->reply, "queue_mark_rate", ok && m->queue.valid, m->queue.mark_rate);
+    ubus_add_number(&link->reply, "host_cpu_pct", ok && m->host.valid, m->host.cpu_busy_pct);
+    ubus_add_number(&link->reply, "host_softirq_pct", ok && m->host.valid, m->host.softirq_pct);
+    ubus_add_number(&link->reply, "host_softnet_drop_rate", ok && m->host.valid, m->host.softnet_drop_rate);
+    ubus_add_number(&link->reply, "host_psi_cpu", ok && m->host.valid, m->host.psi_some_avg10[HOST_PSI_CPU]);
+    ubus_add_number(&link->reply, "host_psi_memory", ok && m->host.valid, m->host.psi_some_avg10[HOST_PSI_MEMORY]);
+    ubus_add_number(&link->reply, "host_mem_avail_pct", ok && m->host.valid, m->host.mem_avail_pct);
+    ubus_add_number(&link->reply, "rf_fcs_rate", ok && m->rf.valid, m->rf.fcs_error_rate);
+    ubus_add_number(&link->reply, "rf_fcs_ratio", ok && m->rf.valid, m->rf.fcs_error_ratio);
+    ubus_add_number(&link->reply, "rf_false_cca_rate", ok && m->rf.valid, m->rf.false_cca_rate);
+    ubus_add_number(&link->reply, "rf_ack_fail_rate", ok && m->rf.valid, m->rf.ack_fail_rate);
+    ubus_add_number(&link->reply, "rf_rts_fail_ratio", ok && m->rf.valid, m->rf.rts_fail_ratio);
+    blobmsg_close_table(&link->reply, raw);
+
+    return ubus_send_reply(ctx, req, link->reply.head);
+}
+
+static const struct ubus_method wifi_metrics_methods[] = {
+    UBUS_METHOD_NOARG("get", ubus_get_method),
+};
+
+static struct ubus_object_type wifi_metrics_type =
+    UBUS_OBJECT_TYPE("wifi_metrics", wifi_metrics_methods);
+
+static struct ubus_object wifi_metrics_object = {
+    .name = "wifi_metrics",
+    .type = &wifi_metrics_type,
+    .methods = wifi_metrics_methods,
+    .n_methods = sizeof(wifi_metrics_methods) / sizeof(wifi_metrics_methods[0]),
+};
+
+/*
+ * ubusd closed the socket (EOF on it). Stop polling the dead fd, which
+ * would otherwise stay readable and spin wait_interval, and let
+ * ubus_link_retry reconnect with backoff.
+ */
+static void ubus_link_lost(struct ubus_context *ctx) {
+    struct ubus_link *link = g_ubus_link;
+    if (ctx->sock.fd >= 0) close(ctx->sock.fd);
+    ctx->sock.fd = -1;
+    if (!link || link->lost) return;
+    fprintf(stderr, "ubus connection lost, reconnecting\n");
+    link->lost = true;
+    link->have_iwinfo = false;
+    link->backoff_ms = 0;
+}
+
+/* (Re-)registers wifi_metrics unless ubus_reconnect already restored it. */
+static int ubus_link_publish(struct ubus_link *link) {
+    uint32_t id;
+    if (wifi_metrics_object.id && ubus_lookup_id(link->ctx, wifi_metrics_object.name, &id) == 0 &&
+        id == wifi_metrics_object.id) {
+        return 0;
+    }
+    int rc = ubus_add_object(link->ctx, &wifi_metrics_object);
+    if (rc != 0) {
+        fprintf(stderr, "ubus_add_object(wifi_metrics) failed: %s\n", ubus_strerror(rc));
+        return -1;
+    }
+    printf("Registered ubus object wifi_metrics\n");
+    fflush(stdout);
+    return 0;
+}
+
+/* Reconnects a lost link once its backoff expired; 0 when the link is usable. */
+static int ubus_link_retry(struct ubus_link *link) {
+    if (!link->ctx) return -1;
+    if (!link->lost) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespec_diff_seconds(&now, &link->last_try) * 1000.0 < link->backoff_ms) return -1;
+    if (ubus_reconnect(link->ctx, link->path) == 0 && (!link->publish || ubus_link_publish(link) == 0)) {
+        link->lost = false;
+        printf("ubus reconnected\n");
+        fflush(stdout);
+        return 0;
+    }
+    link->last_try = now;
+    link->backoff_ms = link->backoff_ms < UBUS_RETRY_MIN_MS ? UBUS_RETRY_MIN_MS
+                     : link->backoff_ms * 2 > UBUS_RETRY_MAX_MS ? UBUS_RETRY_MAX_MS : link->backoff_ms * 2;
+    return -1;
+}
+
+static int ubus_link_open(struct ubus_link *link, const char *path, bool publish,
+                          const struct exporter_snapshot *snap) {
+    memset(link, 0, sizeof(*link));
+    link->path = path;
+    link->ctx = ubus_connect(path);
+    if (!link->ctx) {
+        fprintf(stderr, "ubus_connect failed\n");
+        return -1;
+    }
+    link->ctx->connection_lost = ubus_link_lost;
+    link->snap = snap;
+    link->publish = publish;
+    g_ubus_link = link;
+    if (publish && ubus_link_publish(link) != 0) {
+        ubus_free(link->ctx);
+        link->ctx = NULL;
+        g_ubus_link = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void ubus_link_close(struct ubus_link *link) {
+    if (!link->ctx) return;
+    if (link->publish && !link->lost) ubus_remove_object(link->ctx, &wifi_metrics_object);
+    ubus_free(link->ctx);
+    link->ctx = NULL;
+    blob_buf_free(&link->req);
+    blob_buf_free(&link->reply);
+    g_ubus_link = NULL;
+}
+
+static int ubus_link_fd(const struct ubus_link *link) {
+    return link->ctx && !link->lost ? link->ctx->sock.fd : -1;
+}
+
+static void ubus_link_dispatch(struct ubus_link *link) {
+    if (link->ctx) ubus_handle_event(link->ctx);
+}
+
+/* Returns 0 when the station was found, 1 when absent, -1 on ubus errors. */
+static int ubus_query_station(struct ubus_link *link, const char *iface, const char *target_mac,
+                              struct station_sample *out, char *matched, size_t matched_len) {
+    if (ubus_link_retry(link) != 0) return -1;
+    if (!link->have_iwinfo) {
+        if (ubus_lookup_id(link->ctx, "iwinfo", &link->iwinfo_id) != 0) {
+            fprintf(stderr, "ubus object iwinfo not available\n");
+            return -1;
+        }
+        link->have_iwinfo = true;
+    }
+
+    if (out) {
+        memset(out, 0, sizeof(*out));
+        out->signal_dbm = NAN;
+    }
+
+    struct ubus_station_req sr = {
+        .target_mac = target_mac,
+        .out = out,
+        .matched = matched,
+        .matched_len = matched_len,
+    };
+    blob_buf_init(&link->req, 0);
+    blobmsg_add_string(&link->req, "device", iface);
+    int rc = ubus_invoke(link->ctx, link->iwinfo_id, "assoclist", link->req.head,
+                         ubus_assoclist_cb, &sr, 1000);
+    if (rc != 0) {
+        fprintf(stderr, "ubus call iwinfo assoclist failed: %s\n", ubus_strerror(rc));
+        link->have_iwinfo = false;
+        return -1;
+    }
+    return sr.found ? 0 : 1;
+}
+#else
+struct ubus_link {
+    int unused;
+};
+
+static int ubus_link_open(struct ubus_link *link, const char *path, bool publish,
+                          const struct exporter_snapshot *snap) {
+    (void)link; (void)path; (void)publish; (void)snap;
+    fprintf(stderr, "Built without ubus support; rebuild with -DWITH_UBUS -lubus -lubox\n");
+    return -1;
+}
+
+static void ubus_link_close(struct ubus_link *link) { (void)link; }
+static int ubus_link_fd(const struct ubus_link *link) { (void)link; return -1; }
+static int ubus_link_retry(struct ubus_link *link) { (void)link; return -1; }
+static void ubus_link_dispatch(struct ubus_link *link) { (void)link; }
+
+static int ubus_query_station(struct ubus_link *link, const char *iface, const char *target_mac,
+                              struct station_sample *out, char *matched, size_t matched_len) {
+    (void)link; (void)iface; (void)target_mac; (void)out; (void)matched; (void)matched_len;
+    return -1;
+}
+#endif
+
+/*
+ * Fast RSSI path. The full sample forks `iw` and reads debugfs, which is
+ * too slow for the OSD's RSSI; this issues one NL80211_CMD_GET_STATION on
+ * a persistent generic-netlink socket every -F ms from the wait loop and
+ * sends a small {"type":"fast",...} datagram with signal, per-chain RSSI
+ * and the last RX rate. osd_feed merges it into the RSSI entry.
+ */
+struct fast_path {
+    int fd;
+    uint16_t family;
+    uint32_t seq;
+    int ifindex;
+    uint8_t mac[6];
+    bool have_mac;
+    int interval_ms;
+    struct timespec next;
+    int sock;
+    const struct sockaddr_in *dest;
+    struct exporter_snapshot *snap;
+    struct fast_sample last;
+    uint64_t errors;
+    struct osd_publisher *osd;
+    char buf[8192];
+};
+
+static void nl_put_attr(char *buf, size_t *off, uint16_t type, const void *data, uint16_t len) {
+    struct nlattr *a = (struct nlattr *)(buf + *off);
+    a->nla_type = type;
+    a->nla_len = (uint16_t)(NLA_HDRLEN + len);
+    memcpy((char *)a + NLA_HDRLEN, data, len);
+    *off += NLA_ALIGN(a->nla_len);
+}
+
+/* Walks the attributes in [data, data + len) into tb[0..max]. */
+static void nl_parse_attrs(const void *data, size_t len, const struct nlattr **tb, int max) {
+    for (int i = 0; i <= max; i++) tb[i] = NULL;
+    const struct nlattr *a = data;
+    while (len >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= len) {
+        int type = a->nla_type & NLA_TYPE_MASK;
+        if (type <= max) tb[type] = a;
+        size_t step = NLA_ALIGN(a->nla_len);
+        if (step >= len) break;
+        len -= step;
+        a = (const struct nlattr *)((const char *)a + step);
+    }
+}
+
+static const void *nl_data(const struct nlattr *a) { return (const char *)a + NLA_HDRLEN; }
+static size_t nl_len(const struct nlattr *a) { return a->nla_len - NLA_HDRLEN; }
+
+/* Sends one genetlink request and waits (bounded by SO_RCVTIMEO) for its reply in buf. */
+static const struct genlmsghdr *genl_request(int fd, uint32_t *seq, char *buf, size_t buf_len,
+                                             uint16_t family, uint8_t cmd,
+                                             const char *attrs, size_t attrs_len, size_t *payload_len) {
+    char req[256];
+    if (NLMSG_HDRLEN + GENL_HDRLEN + attrs_len > sizeof(req)) return NULL;
+    struct nlmsghdr *n = (struct nlmsghdr *)req;
+    n->nlmsg_len = (uint32_t)(NLMSG_HDRLEN + GENL_HDRLEN + attrs_len);
+    n->nlmsg_type = family;
+    n->nlmsg_flags = NLM_F_REQUEST;
+    n->nlmsg_seq = ++*seq;
+    n->nlmsg_pid = 0;
+    struct genlmsghdr *g = (struct genlmsghdr *)(req + NLMSG_HDRLEN);
+    memset(g, 0, sizeof(*g));
+    g->cmd = cmd;
+    g->version = 1;
+    memcpy(req + NLMSG_HDRLEN + GENL_HDRLEN, attrs, attrs_len);
+    if (send(fd, req, n->nlmsg_len, 0) < 0) return NULL;
+
+    for (;;) {
+        ssize_t len = recv(fd, buf, buf_len, 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) return NULL;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_seq != *seq) continue; /* late reply to a timed-out request */
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *e = NLMSG_DATA(h);
+                errno = e->error ? -e->error : ENOMSG;
+                return NULL;
+            }
+            if (h->nlmsg_type != family || h->nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN) continue;
+            *payload_len = h->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN;
+            return NLMSG_DATA(h);
+        }
+    }
+}
+
+/* Opens a bound genetlink socket and resolves the nl80211 family id; returns the fd or -1. Quiet when who is NULL. */
+static int genl_open_nl80211(uint32_t *seq, char *buf, size_t buf_len, uint16_t *family, const char *who) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0) {
+        if (who) fprintf(stderr, "%s: netlink socket failed: %s\n", who, strerror(errno));
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_nl local = { .nl_family = AF_NETLINK };
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        if (who) fprintf(stderr, "%s: netlink bind failed: %s\n", who, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    char attrs[64];
+    size_t off = 0;
+    nl_put_attr(attrs, &off, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, sizeof(NL80211_GENL_NAME));
+    size_t plen = 0;
+    const struct genlmsghdr *g = genl_request(fd, seq, buf, buf_len, GENL_ID_CTRL, CTRL_CMD_GETFAMILY,
+                                              attrs, off, &plen);
+    const struct nlattr *tb[CTRL_ATTR_MAX + 1];
+    if (g) nl_parse_attrs((const char *)g + GENL_HDRLEN, plen, tb, CTRL_ATTR_MAX);
+    if (!g || !tb[CTRL_ATTR_FAMILY_ID]) {
+        if (who) fprintf(stderr, "%s: nl80211 family not available\n", who);
+        close(fd);
+        return -1;
+    }
+    *family = *(const uint16_t *)nl_data(tb[CTRL_ATTR_FAMILY_ID]);
+    return fd;
+}
+
+static void fast_path_close(struct fast_path *fp) {
+    if (fp->fd >= 0) close(fp->fd);
+    fp->fd = -1;
+}
+
+static int fast_path_open(struct fast_path *fp, const char *iface, int interval_ms) {
+    fp->ifindex = (int)if_nametoindex(iface);
+    if (fp->ifindex == 0) {
+        fprintf(stderr, "Fast path: unknown interface %s\n", iface);
+        return -1;
+    }
+    fp->fd = genl_open_nl80211(&fp->seq, fp->buf, sizeof(fp->buf), &fp->family, "Fast path");
+    if (fp->fd < 0) return -1;
+    fp->interval_ms = interval_ms;
+    clock_gettime(CLOCK_MONOTONIC, &fp->next);
+    return 0;
+}
+
+static void fast_path_set_station(struct fast_path *fp, const char *mac) {
+    unsigned int b[6];
+    fp->have_mac = mac && mac[0] &&
+        sscanf(mac, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) == 6;
+    for (int i = 0; fp->have_mac && i < 6; i++) fp->mac[i] = (uint8_t)b[i];
+}
+
+static void fast_parse_rate(const struct nlattr *rate, struct fast_sample *out) {
+    const struct nlattr *tb[NL80211_RATE_INFO_MAX + 1];
+    nl_parse_attrs(nl_data(rate), nl_len(rate), tb, NL80211_RATE_INFO_MAX);
+    if (tb[NL80211_RATE_INFO_BITRATE32]) {
+        out->rx_rate_mbps = *(const uint32_t *)nl_data(tb[NL80211_RATE_INFO_BITRATE32]) / 10.0;
+    } else if (tb[NL80211_RATE_INFO_BITRATE]) {
+        out->rx_rate_mbps = *(const uint16_t *)nl_data(tb[NL80211_RATE_INFO_BITRATE]) / 10.0;
+    }
+    if (tb[NL80211_RATE_INFO_VHT_MCS]) {
+        out->rx_mcs = *(const uint8_t *)nl_data(tb[NL80211_RATE_INFO_VHT_MCS]);
+    } else if (tb[NL80211_RATE_INFO_MCS]) {
+        out->rx_mcs = *(const uint8_t *)nl_data(tb[NL80211_RATE_INFO_MCS]);
+    }
+}
+
+/* Decodes a NEW_STATION payload (the attributes after the genetlink header). */
+static int fast_parse_station(const void *attrs, size_t len, const struct fast_sample *prev,
+                              struct fast_sample *out) {
+    const struct nlattr *tb[NL80211_ATTR_MAX + 1];
+    nl_parse_attrs(attrs, len, tb, NL80211_ATTR_MAX);
+    if (!tb[NL80211_ATTR_STA_INFO]) return -1;
+    const struct nlattr *sta[NL80211_STA_INFO_MAX + 1];
+    nl_parse_attrs(nl_data(tb[NL80211_ATTR_STA_INFO]), nl_len(tb[NL80211_ATTR_STA_INFO]), sta, NL80211_STA_INFO_MAX);
+
+    out->signal_dbm = sta[NL80211_STA_INFO_SIGNAL] ? *(const int8_t *)nl_data(sta[NL80211_STA_INFO_SIGNAL]) : NAN;
+    out->signal_avg_dbm = sta[NL80211_STA_INFO_SIGNAL_AVG] ? *(const int8_t *)nl_data(sta[NL80211_STA_INFO_SIGNAL_AVG]) : NAN;
+    out->chains = 0;
+    for (int i = 0; i < FAST_MAX_CHAINS; i++) out->chain_dbm[i] = NAN;
+    if (sta[NL80211_STA_INFO_CHAIN_SIGNAL]) {
+        /* The nest is keyed by chain index; chains without a reading are simply absent. */
+        const struct nlattr *ch[FAST_MAX_CHAINS];
+        nl_parse_attrs(nl_data(sta[NL80211_STA_INFO_CHAIN_SIGNAL]), nl_len(sta[NL80211_STA_INFO_CHAIN_SIGNAL]),
+                       ch, FAST_MAX_CHAINS - 1);
+        for (int i = 0; i < FAST_MAX_CHAINS; i++) {
+            if (!ch[i]) continue;
+            out->chain_dbm[i] = *(const int8_t *)nl_data(ch[i]);
+            out->chains = i + 1;
+        }
+    }
+    out->rx_rate_mbps = NAN;
+    out->rx_mcs = -1;
+    if (sta[NL80211_STA_INFO_RX_BITRATE]) fast_parse_rate(sta[NL80211_STA_INFO_RX_BITRATE], out);
+
+    out->imbalance_db = NAN;
+    out->combining_gain_db = NAN;
+    out->best_chain = -1;
+    if (out->chains > 0) {
+        double lo = INFINITY, hi = -INFINITY;
+        int best = -1;
+        for (int i = 0; i < out->chains; i++) {
+            if (isnan(out->chain_dbm[i])) continue;
+            if (out->chain_dbm[i] < lo) lo = out->chain_dbm[i];
+            if (out->chain_dbm[i] > hi) {
+                hi = out->chain_dbm[i];
+                best = i;
+            }
+        }
+        out->imbalance_db = hi - lo;
+        out->combining_gain_db = out->signal_dbm - hi;
+        out->best_chain = best;
+    }
+    out->best_chain_switches = prev->best_chain_switches;
+    if (out->best_chain >= 0 && prev->best_chain >= 0 && out->best_chain != prev->best_chain) {
+        out->best_chain_switches++;
+    }
+    return 0;
+}
+
+static int fast_path_sample(struct fast_path *fp, struct fast_sample *out) {
+    char attrs[64];
+    size_t off = 0;
+    uint32_t ifindex = (uint32_t)fp->ifindex;
+    nl_put_attr(attrs, &off, NL80211_ATTR_IFINDEX, &ifindex, sizeof(ifindex));
+    nl_put_attr(attrs, &off, NL80211_ATTR_MAC, fp->mac, sizeof(fp->mac));
+    size_t plen = 0;
+    const struct genlmsghdr *g = genl_request(fp->fd, &fp->seq, fp->buf, sizeof(fp->buf), fp->family,
+                                              NL80211_CMD_GET_STATION, attrs, off, &plen);
+    if (!g) return -1;
+    return fast_parse_station((const char *)g + GENL_HDRLEN, plen, &fp->last, out);
+}
+
+static void fast_path_send(struct fast_path *fp, const struct fast_sample *f) {
+    osd_publisher_rssi(fp->osd, normalize_linear(f->signal_dbm, -85.0, -20.0));
+    if (fp->sock < 0) return;
+    char payload[384];
+    size_t off = 0;
+    char num[32];
+    format_number(num, sizeof(num), normalize_linear(f->signal_dbm, -85.0, -20.0), "%.2f");
+    buf_append(payload, sizeof(payload), &off, "{\"type\":\"fast\",\"rssi\":%s", num);
+    format_number(num, sizeof(num), f->signal_dbm, "%.0f");
+    buf_append(payload, sizeof(payload), &off, ",\"signal\":%s", num);
+    format_number(num, sizeof(num), f->signal_avg_dbm, "%.0f");
+    buf_append(payload, sizeof(payload), &off, ",\"signal_avg\":%s,\"chains\":[", num);
+    for (int i = 0; i < f->chains; i++) {
+        format_number(num, sizeof(num), f->chain_dbm[i], "%.0f");
+        buf_append(payload, sizeof(payload), &off, "%s%s", i ? "," : "", num);
+    }
+    format_number(num, sizeof(num), f->imbalance_db, "%.0f");
+    buf_append(payload, sizeof(payload), &off, "],\"imbalance_db\":%s", num);
+    format_number(num, sizeof(num), f->combining_gain_db, "%.0f");
+    buf_append(payload, sizeof(payload), &off, ",\"combining_gain_db\":%s,\"best_chain\":%d,\"chain_switches\":%llu",
+               num, f->best_chain, (unsigned long long)f->best_chain_switches);
+    format_number(num, sizeof(num), f->rx_rate_mbps, "%.1f");
+    if (buf_append(payload, sizeof(payload), &off, ",\"rx_rate_mbps\":%s,\"rx_mcs\":%d}\n", num, f->rx_mcs) != 0) {
+        return;
+    }
+    sendto(fp->sock, payload, off, 0, (const struct sockaddr *)fp->dest, sizeof(*fp->dest));
+}
+
+static void fast_path_tick(struct fast_path *fp) {
+    struct fast_sample f;
+    if (fast_path_sample(fp, &f) != 0 || isnan(f.signal_dbm)) {
+        fp->errors++;
+        return;
+    }
+    fp->last = f;
+    fast_path_send(fp, &f);
+    fp->snap->fast = f;
+    fp->snap->have_fast = true;
+}
+
+/* Milliseconds until the next fast sample (0 if due), or -1 when the fast path is idle. */
+static int fast_path_due_ms(struct fast_path *fp, const struct timespec *now) {
+    if (!fp || fp->fd < 0 || !fp->have_mac) return -1;
+    double left = timespec_diff_seconds(&fp->next, now);
+    if (left > 0.0) return (int)ceil(left * 1000.0);
+    fp->next.tv_nsec += (long)fp->interval_ms * 1000000L;
+    fp->next.tv_sec += fp->next.tv_nsec / 1000000000L;
+    fp->next.tv_nsec %= 1000000000L;
+    if (timespec_diff_seconds(&fp->next, now) < 0.0) fp->next = *now; /* fell behind: don't burst */
+    return 0;
+}
+
+/*
+ * Active probing (-k). Small timestamped pings go to the receiver every -k
+ * ms; osd_feed echoes each one at once with its own receive time. Every
+ * PROBE_TRAIN_EVERY_MS a train of PROBE_TRAIN_LEN full-size packets goes out
+ * back to back, and the spread of the reflector's receive times over the
+ * train gives the bottleneck rate (packet-train dispersion). Pings, trains
+ * and the expected echoes are all paid from a token bucket of -b bytes/s;
+ * when it runs dry a probe is skipped, never queued, so probing cannot crowd
+ * out video. Echoes carry kernel receive stamps (SO_TIMESTAMPNS) on both
+ * ends, so a tick spent forking iw does not inflate the RTT and a train the
+ * reflector reads in one batch still shows its on-air spacing.
+ */
+enum probe_state { PROBE_FREE, PROBE_PENDING, PROBE_ECHOED, PROBE_LOST };
+
+struct probe_slot {
+    uint32_t seq;
+    uint64_t t_us;
+    uint64_t sent_real_us;    /* CLOCK_REALTIME, matched against kernel RX stamps */
+    double rtt_ms;
+    enum probe_state state;
+};
+
+struct prober {
+    int fd;
+    struct sockaddr_in dest;
+    int interval_ms;
+    double budget_bps;
+    double tokens;
+    uint64_t last_refill_us;
+    uint64_t next_ping_us;
+    uint64_t next_train_us;
+    uint64_t next_report_us;
+    uint32_t seq;
+    struct probe_slot ping[PROBE_WINDOW];
+    uint32_t train_id;
+    uint64_t train_sent_us;
+    bool train_open;
+    int train_got;
+    int train_idx_first, train_idx_last;
+    uint64_t train_rx_first, train_rx_last;
+    double capacity[PROBE_CAPACITY_KEEP];
+    size_t capacity_count;
+    struct probe_stats stats;
+    struct exporter_snapshot *snap;
+    char buf[PROBE_TRAIN_BYTES + 64];
+};
+
+static int prober_open(struct prober *pr, const struct sockaddr_in *dest, int interval_ms, int budget_bps) {
+    memset(pr, 0, sizeof(*pr));
+    pr->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pr->fd < 0) {
+        fprintf(stderr, "probe socket failed: %s\n", strerror(errno));
+        return -1;
+    }
+    int on = 1;
+    setsockopt(pr->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    pr->dest = *dest;
+    pr->interval_ms = interval_ms;
+    pr->budget_bps = budget_bps > 0 ? budget_bps : 4000;
+    pr->tokens = pr->budget_bps;
+    uint64_t now = osd_now_us();
+    pr->last_refill_us = now;
+    pr->next_ping_us = now;
+    pr->next_train_us = now + PROBE_TRAIN_EVERY_MS * 1000ull / 2;
+    pr->next_report_us = now + PROBE_REPORT_MS * 1000ull;
+    pr->stats.capacity_mbps = NAN;
+    return 0;
+}
+
+static void prober_close(struct prober *pr) {
+    if (pr->fd >= 0) close(pr->fd);
+    pr->fd = -1;
+}
+
+static double prober_train_cost(void) {
+    return PROBE_TRAIN_LEN * (double)(PROBE_TRAIN_BYTES + PROBE_UDP_OVERHEAD + PROBE_ECHO_BYTES);
+}
+
+static void prober_refill(struct prober *pr, uint64_t now) {
+    pr->tokens += pr->budget_bps * (double)(now - pr->last_refill_us) / 1e6;
+    pr->last_refill_us = now;
+    /* Enough to save up for one train plus a second of pings, no more. */
+    double cap = prober_train_cost() + pr->budget_bps;
+    if (pr->tokens > cap) pr->tokens = cap;
+}
+
+static bool prober_spend(struct prober *pr, double bytes) {
+    if (pr->tokens < bytes) {
+        pr->stats.budget_skips++;
+        return false;
+    }
+    pr->tokens -= bytes;
+    return true;
+}
+
+static uint64_t realtime_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+static void prober_send_ping(struct prober *pr, uint64_t now) {
+    char msg[96];
+    int len = snprintf(msg, sizeof(msg), "{\"type\":\"probe\",\"seq\":%u,\"t_us\":%llu}\n",
+                       pr->seq, (unsigned long long)now);
+    if (len < 0 || (size_t)len >= sizeof(msg)) return;
+    if (!prober_spend(pr, len + PROBE_UDP_OVERHEAD + PROBE_ECHO_BYTES)) return;
+    struct probe_slot *slot = &pr->ping[pr->seq % PROBE_WINDOW];
+    if (sendto(pr->fd, msg, (size_t)len, 0, (const struct sockaddr *)&pr->dest, sizeof(pr->dest)) < 0) return;
+    *slot = (struct probe_slot){ .seq = pr->seq, .t_us = now, .sent_real_us = realtime_us(),
+                                 .state = PROBE_PENDING };
+    pr->seq++;
+    pr->stats.sent++;
+}
+
+static void prober_send_train(struct prober *pr, uint64_t now) {
+    if (!prober_spend(pr, prober_train_cost())) return;
+    pr->train_id++;
+    pr->train_open = true;
+    pr->train_sent_us = now;
+    pr->train_got = 0;
+    for (int i = 0; i < PROBE_TRAIN_LEN; i++) {
+        int len = snprintf(pr->buf, sizeof(pr->buf),
+                           "{\"type\":\"probe\",\"train\":%u,\"idx\":%d,\"t_us\":%llu,\"pad\":\"",
+                           pr->train_id, i, (unsigned long long)now);
+        if (len < 0 || len + 3 > PROBE_TRAIN_BYTES) return;
+        memset(pr->buf + len, 'x', PROBE_TRAIN_BYTES - 3 - (size_t)len);
+        memcpy(pr->buf + PROBE_TRAIN_BYTES - 3, "\"}\n", 3);
+        sendto(pr->fd, pr->buf, PROBE_TRAIN_BYTES, 0, (const struct sockaddr *)&pr->dest, sizeof(pr->dest));
+    }
+    pr->stats.trains++;
+}
+
+static bool probe_field(const char *msg, const char *key, uint64_t *out) {
+    const char *p = strstr(msg, key);
+    if (!p) return false;
+    p += strlen(key);
+    char *end;
+    unsigned long long v = strtoull(p, &end, 10);
+    if (end == p) return false;
+    *out = v;
+    return true;
+}
+
+/* Echo: {"type":"probe_echo","seq":N|"train":N,"idx":I,"t_us":T,"rx_us":R} */
+static void prober_read(struct prober *pr) {
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(struct timespec))];
+        struct iovec iov = { .iov_base = pr->buf, .iov_len = sizeof(pr->buf) - 1 };
+        struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1,
+                             .msg_control = control, .msg_controllen = sizeof(control) };
+        ssize_t n = recvmsg(pr->fd, &mh, 0);
+        if (n <= 0) return;
+        pr->buf[n] = '\0';
+        uint64_t arrived_us = realtime_us();
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                arrived_us = (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+            }
+        }
+        uint64_t seq, train, idx, rx_us;
+        if (!strstr(pr->buf, "\"type\":\"probe_echo\"") || !probe_field(pr->buf, "\"rx_us\":", &rx_us)) continue;
+        if (probe_field(pr->buf, "\"train\":", &train)) {
+            if (!pr->train_open || train != pr->train_id ||
+                !probe_field(pr->buf, "\"idx\":", &idx) || idx >= PROBE_TRAIN_LEN) continue;
+            if (pr->train_got == 0 || rx_us < pr->train_rx_first) {
+                pr->train_rx_first = rx_us;
+                pr->train_idx_first = (int)idx;
+            }
+            if (pr->train_got == 0 || rx_us > pr->train_rx_last) {
+                pr->train_rx_last = rx_us;
+                pr->train_idx_last = (int)idx;
+            }
+            pr->train_got++;
+        } else if (probe_field(pr->buf, "\"seq\":", &seq)) {
+            struct probe_slot *slot = &pr->ping[seq % PROBE_WINDOW];
+            if (slot->state != PROBE_PENDING || slot->seq != (uint32_t)seq) continue;
+            slot->rtt_ms = arrived_us > slot->sent_real_us
+                ? (double)(arrived_us - slot->sent_real_us) / 1000.0 : 0.0;
+            slot->state = PROBE_ECHOED;
+            pr->stats.echoed++;
+        }
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_sorted(const double *v, size_t n, double q) {
+    if (n == 0) return NAN;
+    size_t i = (size_t)ceil(q * (double)n);
+    return v[i > 0 ? i - 1 : 0];
+}
+
+static void prober_close_train(struct prober *pr) {
+    pr->train_open = false;
+    int packets = pr->train_idx_last - pr->train_idx_first;
+    if (pr->train_got < 2 || packets <= 0 || pr->train_rx_last <= pr->train_rx_first) return;
+    double bits = (double)packets * (PROBE_TRAIN_BYTES + PROBE_UDP_OVERHEAD) * 8.0;
+    double mbps = bits / (double)(pr->train_rx_last - pr->train_rx_first);
+    if (pr->capacity_count == PROBE_CAPACITY_KEEP) {
+        memmove(pr->capacity, pr->capacity + 1, sizeof(pr->capacity[0]) * (PROBE_CAPACITY_KEEP - 1));
+        pr->capacity_count--;
+    }
+    pr->capacity[pr->capacity_count++] = mbps;
+    double sorted[PROBE_CAPACITY_KEEP];
+    memcpy(sorted, pr->capacity, sizeof(sorted[0]) * pr->capacity_count);
+    qsort(sorted, pr->capacity_count, sizeof(sorted[0]), compare_double);
+    pr->stats.capacity_mbps = sorted[pr->capacity_count / 2];
+}
+
+static void prober_report(struct prober *pr) {
+    double rtts[PROBE_WINDOW];
+    size_t n = 0, lost = 0;
+    for (size_t i = 0; i < PROBE_WINDOW; i++) {
+        if (pr->ping[i].state == PROBE_ECHOED) rtts[n++] = pr->ping[i].rtt_ms;
+        if (pr->ping[i].state == PROBE_LOST) lost++;
+    }
+    qsort(rtts, n, sizeof(rtts[0]), compare_double);
+    struct probe_stats *st = &pr->stats;
+    st->rtt_p50_ms = percentile_sorted(rtts, n, 0.50);
+    st->rtt_p90_ms = percentile_sorted(rtts, n, 0.90);
+    st->rtt_p99_ms = percentile_sorted(rtts, n, 0.99);
+    st->loss = n + lost ? (double)lost / (double)(n + lost) : NAN;
+    pr->snap->probe = *st;
+    pr->snap->have_probe = true;
+
+    char msg[320], p50[32], p90[32], p99[32], loss[32], cap[32];
+    format_number(p50, sizeof(p50), st->rtt_p50_ms, "%.2f");
+    format_number(p90, sizeof(p90), st->rtt_p90_ms, "%.2f");
+    format_number(p99, sizeof(p99), st->rtt_p99_ms, "%.2f");
+    format_number(loss, sizeof(loss), st->loss, "%.3f");
+    format_number(cap, sizeof(cap), st->capacity_mbps, "%.1f");
+    int len = snprintf(msg, sizeof(msg),
+                       "{\"type\":\"probe_report\",\"rtt_p50_ms\":%s,\"rtt_p90_ms\":%s,\"rtt_p99_ms\":%s,"
+                       "\"loss\":%s,\"capacity_mbps\":%s,\"sent\":%llu,\"trains\":%llu,\"budget_skips\":%llu}\n",
+                       p50, p90, p99, loss, cap, (unsigned long long)st->sent,
+                       (unsigned long long)st->trains, (unsigned long long)st->budget_skips);
+    if (len > 0 && (size_t)len < sizeof(msg)) {
+        sendto(pr->fd, msg, (size_t)len, 0, (const struct sockaddr *)&pr->dest, sizeof(pr->dest));
+    }
+}
+
+static void prober_tick(struct prober *pr) {
+    uint64_t now = osd_now_us();
+    prober_refill(pr, now);
+    for (size_t i = 0; i < PROBE_WINDOW; i++) {
+        struct probe_slot *slot = &pr->ping[i];
+        if (slot->state == PROBE_PENDING && now - slot->t_us > PROBE_TIMEOUT_MS * 1000ull) {
+            slot->state = PROBE_LOST;
+        }
+    }
+    if (pr->train_open && (pr->train_got == PROBE_TRAIN_LEN ||
+                           now - pr->train_sent_us > PROBE_TIMEOUT_MS * 1000ull)) {
+        prober_close_train(pr);
+    }
+    if (now >= pr->next_train_us && !pr->train_open) {
+        prober_send_train(pr, now);
+        pr->next_train_us = now + PROBE_TRAIN_EVERY_MS * 1000ull;
+    }
+    if (now >= pr->next_ping_us) {
+        prober_send_ping(pr, now);
+        pr->next_ping_us += (uint64_t)pr->interval_ms * 1000ull;
+        if (pr->next_ping_us < now) pr->next_ping_us = now; /* fell behind: don't burst */
+    }
+    if (now >= pr->next_report_us) {
+        prober_report(pr);
+        pr->next_report_us = now + PROBE_REPORT_MS * 1000ull;
+    }
+}
+
+/* Milliseconds until the prober next needs a tick (0 if due), or -1 when probing is off. */
+static int prober_due_ms(const struct prober *pr) {
+    if (!pr || pr->fd < 0) return -1;
+    uint64_t now = osd_now_us();
+    uint64_t next = pr->next_ping_us < pr->next_report_us ? pr->next_ping_us : pr->next_report_us;
+    if (!pr->train_open && pr->next_train_us < next) next = pr->next_train_us;
+    if (pr->train_open) {
+        uint64_t close_us = pr->train_sent_us + PROBE_TIMEOUT_MS * 1000ull;
+        if (close_us < next) next = close_us;
+    }
+    return next <= now ? 0 : (int)((next - now + 999) / 1000);
+}
+
+/*
+ * Interface discovery and tracking. Without -d the candidates are the
+ * netdevs with a /sys/class/net/X/phy80211 link, and the first one that
+ * NL80211_CMD_GET_INTERFACE reports as a station wins. An RTNLGRP_LINK
+ * subscription then follows the interface through `wifi reload`: removal,
+ * re-creation (same name with -d, any new station otherwise), renames and
+ * operstate changes. The main loop applies `changed` at its next tick and
+ * wait_interval returns early, so recovery needs no polling.
+ */
+#define LINK_OPER_UNKNOWN 0 /* IF_OPER_* from RFC 2863; <linux/if.h> clashes with <net/if.h> on musl */
+#define LINK_OPER_UP 6
+
+struct iface_watch {
+    int fd;
+    bool auto_pick;
+    char want[IFNAMSIZ];
+    char name[IFNAMSIZ];
+    char phy[64];
+    int ifindex;
+    bool up;
+    bool changed;
+    char buf[8192];
+};
+
+/* NL80211_IFTYPE_* of ifindex, or -1 when nl80211 cannot be asked. */
+static int nl80211_iftype(int ifindex) {
+    static char buf[4096];
+    uint32_t seq = 0;
+    uint16_t family;
+    int fd = genl_open_nl80211(&seq, buf, sizeof(buf), &family, NULL);
+    if (fd < 0) return -1;
+    char attrs[16];
+    size_t off = 0;
+    uint32_t idx = (uint32_t)ifindex;
+    nl_put_attr(attrs, &off, NL80211_ATTR_IFINDEX, &idx, sizeof(idx));
+    size_t plen = 0;
+    const struct genlmsghdr *g = genl_request(fd, &seq, buf, sizeof(buf), family, NL80211_CMD_GET_INTERFACE,
+                                              attrs, off, &plen);
+    int type = -1;
+    if (g) {
+        const struct nlattr *tb[NL80211_ATTR_MAX + 1];
+        nl_parse_attrs((const char *)g + GENL_HDRLEN, plen, tb, NL80211_ATTR_MAX);
+        if (tb[NL80211_ATTR_IFTYPE]) type = (int)*(const uint32_t *)nl_data(tb[NL80211_ATTR_IFTYPE]);
+    }
+    close(fd);
+    return type;
+}
+
+static bool iface_is_wireless(const char *name) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/phy80211", name);
+    return access(path, F_OK) == 0;
+}
+
+/* Lowest-ifindex station interface; any wireless one if nl80211 can't tell. */
+static int iface_discover(char *out, size_t out_len) {
+    DIR *dir = opendir("/sys/class/net");
+    if (!dir) {
+        fprintf(stderr, "opendir(/sys/class/net) failed: %s\n", strerror(errno));
+        return -1;
+    }
+    int best = 0, fallback = 0;
+    char best_name[IFNAMSIZ] = {0}, fallback_name[IFNAMSIZ] = {0};
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] == '.' || strlen(de->d_name) >= IFNAMSIZ || !iface_is_wireless(de->d_name)) continue;
+        int idx = (int)if_nametoindex(de->d_name);
+        if (idx == 0) continue;
+        int type = nl80211_iftype(idx);
+        if (type == NL80211_IFTYPE_STATION && (!best || idx < best)) {
+            best = idx;
+            snprintf(best_name, sizeof(best_name), "%s", de->d_name);
+        } else if (type < 0 && (!fallback || idx < fallback)) {
+            fallback = idx;
+            snprintf(fallback_name, sizeof(fallback_name), "%s", de->d_name);
+        }
+    }
+    closedir(dir);
+    const char *pick = best ? best_name : fallback ? fallback_name : NULL;
+    if (!best && pick) fprintf(stderr, "nl80211 unavailable; taking the first wireless interface\n");
+    if (!pick) {
+        fprintf(stderr, "No station-mode wireless interface under /sys/class/net\n");
+        return -1;
     }
-    return m;
+    snprintf(out, out_len, "%s", pick);
+    return 0;
 }
 
-static void format_number(char *buf, size_t len, double value, const char *fmt) {
-    if (isnan(value) || isinf(value)) {
-        snprintf(buf, len, "null");
-    } else {
-        snprintf(buf, len, fmt, value);
+/* Operational as far as sampling goes: administratively up, and not dormant or lower-layer down. */
+static bool link_is_up(unsigned flags, int oper) {
+    return (flags & IFF_UP) && (oper < 0 || oper == LINK_OPER_UP || oper == LINK_OPER_UNKNOWN);
+}
+
+/* IFLA_IFNAME and IFLA_OPERSTATE of an RTM_NEWLINK/DELLINK message; oper is -1 when absent. */
+static void link_attrs(const struct nlmsghdr *h, const char **name, int *oper) {
+    const struct ifinfomsg *ifi = NLMSG_DATA(h);
+    int alen = (int)IFLA_PAYLOAD(h);
+    *name = NULL;
+    *oper = -1;
+    for (const struct rtattr *a = IFLA_RTA(ifi); RTA_OK(a, alen); a = RTA_NEXT(a, alen)) {
+        if (a->rta_type == IFLA_IFNAME) *name = RTA_DATA(a);
+        else if (a->rta_type == IFLA_OPERSTATE) *oper = *(const uint8_t *)RTA_DATA(a);
     }
 }
 
-static int send_udp_packet(int sock, const struct sockaddr_in *addr,
-                           const struct metrics *m) {
-    char payload[512];
-    char raw_signal[32];
-    char raw_tx_ratio[32], raw_tx_retry_rate[32], raw_tx_fail_rate[32], raw_tx_beacon_rate[32], raw_tx_packet_rate[32];
-    char raw_rx_ratio[32], raw_rx_retry_rate[32], raw_rx_drop_rate[32], raw_rx_packet_rate[32];
+/* Current state of ifindex via RTM_GETLINK: 1 up, 0 down or gone, -1 when rtnetlink cannot be asked. */
+static int link_query_up(int ifindex) {
+    static char buf[16384];
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+    struct timeval tv = { .tv_sec = 1 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct {
+        struct nlmsghdr n;
+        struct ifinfomsg i;
+    } req = {
+        .n = { .nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)), .nlmsg_type = RTM_GETLINK,
+               .nlmsg_flags = NLM_F_REQUEST, .nlmsg_seq = 1 },
+        .i = { .ifi_family = AF_UNSPEC, .ifi_index = ifindex },
+    };
+    int rc = -1;
+    if (send(fd, &req, req.n.nlmsg_len, 0) == (ssize_t)req.n.nlmsg_len) {
+        ssize_t len;
+        do {
+            len = recv(fd, buf, sizeof(buf), 0);
+        } while (len < 0 && errno == EINTR);
+        struct nlmsghdr *h = (struct nlmsghdr *)buf;
+        if (len > 0 && NLMSG_OK(h, (size_t)len)) {
+            if (h->nlmsg_type == RTM_NEWLINK && h->nlmsg_len >= NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+                const char *name;
+                int oper;
+                link_attrs(h, &name, &oper);
+                rc = link_is_up(((const struct ifinfomsg *)NLMSG_DATA(h))->ifi_flags, oper);
+            } else if (h->nlmsg_type == NLMSG_ERROR && h->nlmsg_len >= NLMSG_LENGTH(sizeof(struct nlmsgerr)) &&
+                       ((const struct nlmsgerr *)NLMSG_DATA(h))->error == -ENODEV) {
+                rc = 0;
+            }
+        }
+    }
+    close(fd);
+    return rc;
+}
 
-    format_number(raw_signal, sizeof(raw_signal), m->raw_station.signal_dbm, "%.2f");
-    format_number(raw_tx_ratio, sizeof(raw_tx_ratio), m->tx_retry_ratio, "%.6f");
-    format_number(raw_tx_retry_rate, sizeof(raw_tx_retry_rate), m->tx_retry_rate, "%.3f");
-    format_number(raw_tx_fail_rate, sizeof(raw_tx_fail_rate), m->tx_fail_rate, "%.3f");
-    format_number(raw_tx_beacon_rate, sizeof(raw_tx_beacon_rate), m->tx_beacon_rate, "%.3f");
-    format_number(raw_tx_packet_rate, sizeof(raw_tx_packet_rate), m->tx_packet_rate, "%.3f");
-    format_number(raw_rx_ratio, sizeof(raw_rx_ratio), m->rx_retry_ratio, "%.6f");
-    format_number(raw_rx_retry_rate, sizeof(raw_rx_retry_rate), m->rx_retry_rate, "%.3f");
-    format_number(raw_rx_drop_rate, sizeof(raw_rx_drop_rate), m->rx_drop_rate, "%.3f");
-    format_number(raw_rx_packet_rate, sizeof(raw_rx_packet_rate), m->rx_packet_rate, "%.3f");
+static void iface_watch_close(struct iface_watch *w) {
+    if (w->fd >= 0) close(w->fd);
+    w->fd = -1;
+}
 
-    const char *labels[4];
-    double values[4];
-    size_t count = 0;
+/* Resolves the starting interface (want, or discovery when NULL) and subscribes to link events. */
+static int iface_watch_open(struct iface_watch *w, const char *want) {
+    w->fd = -1;
+    w->auto_pick = !want;
+    if (want) {
+        snprintf(w->name, sizeof(w->name), "%s", want);
+    } else if (iface_discover(w->name, sizeof(w->name)) != 0) {
+        return -1;
+    }
+    snprintf(w->want, sizeof(w->want), "%s", w->name);
 
-    if (m->valid_rssi) {
-        labels[count] = "RSSI";
-        values[count] = m->rssi_norm;
-        count++;
+    /* Join RTMGRP_LINK before asking for the state: a change between the two
+     * is then queued on the socket instead of lost. */
+    w->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    struct sockaddr_nl local = { .nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK };
+    if (w->fd < 0 || bind(w->fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        fprintf(stderr, "Link events unavailable (%s); %s is not tracked across reloads\n",
+                strerror(errno), w->name);
+        iface_watch_close(w);
     }
-    if (m->valid_link_tx) {
-        labels[count] = "Link TX";
-        values[count] = m->link_tx_norm;
-        count++;
+
+    w->ifindex = (int)if_nametoindex(w->name);
+    w->up = w->ifindex > 0 && link_query_up(w->ifindex) != 0; /* unknown counts as up, as before */
+    if (resolve_phy_name(w->name, w->phy, sizeof(w->phy)) != 0) {
+        iface_watch_close(w);
+        return -1;
     }
-    if (m->valid_link_rx) {
-        labels[count] = "Link RX";
-        values[count] = m->link_rx_norm;
-        count++;
+    if (w->ifindex > 0 && !w->up) printf("Interface %s is down; waiting for it\n", w->name);
+    return 0;
+}
+
+static bool iface_watch_ready(const struct iface_watch *w) {
+    return w->ifindex > 0 && w->up;
+}
+
+static void iface_watch_link(struct iface_watch *w, uint16_t type, const struct ifinfomsg *ifi,
+                             const char *name, int oper) {
+    bool up = link_is_up(ifi->ifi_flags, oper);
+    if (ifi->ifi_index == w->ifindex) {
+        if (type == RTM_DELLINK) {
+            printf("Interface %s removed\n", w->name);
+            w->ifindex = 0;
+            w->up = false;
+            w->changed = true;
+            return;
+        }
+        if (name && strcmp(name, w->name) != 0) {
+            printf("Interface %s renamed to %s\n", w->name, name);
+            snprintf(w->name, sizeof(w->name), "%s", name);
+            snprintf(w->want, sizeof(w->want), "%s", name);
+            w->changed = true;
+        }
+        if (up != w->up) {
+            printf("Interface %s %s\n", w->name, up ? "up" : "down");
+            w->up = up;
+            w->changed = true;
+        }
+        return;
     }
-    if (m->valid_link_all) {
-        labels[count] = "Link ALL";
-        values[count] = m->link_all_norm;
-        count++;
+    if (w->ifindex > 0 || type != RTM_NEWLINK || !name || !iface_is_wireless(name)) return;
+    if (w->auto_pick) {
+        int iftype = nl80211_iftype(ifi->ifi_index);
+        if (iftype >= 0 && iftype != NL80211_IFTYPE_STATION) return; /* same fallback as iface_discover */
+    } else if (strcmp(name, w->want) != 0) {
+        return;
     }
+    char phy[sizeof(w->phy)];
+    if (resolve_phy_name(name, phy, sizeof(phy)) != 0) return;
+    snprintf(w->name, sizeof(w->name), "%s", name);
+    snprintf(w->phy, sizeof(w->phy), "%s", phy);
+    w->ifindex = ifi->ifi_index;
+    w->up = up;
+    w->changed = true;
+    printf("Interface %s (%s) is back, %s\n", w->name, w->phy, up ? "up" : "down");
+}
 
-    char text_buf[256] = "[";
-    char value_buf[256] = "[";
-    size_t text_off = 1;
-    size_t value_off = 1;
-    bool first = true;
-    for (size_t i = 0; i < count; i++) {
-        if (!first) {
-            text_buf[text_off++] = ',';
-            value_buf[value_off++] = ',';
+static void iface_watch_read(struct iface_watch *w) {
+    for (;;) {
+        ssize_t len = recv(w->fd, w->buf, sizeof(w->buf), 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len < 0 && errno == ENOBUFS) {
+            /* Overran: events were lost, so re-check the watched name and its state directly. */
+            int idx = (int)if_nametoindex(w->name);
+            bool up = idx > 0 && link_query_up(idx) != 0;
+            if (idx != w->ifindex || up != w->up) {
+                printf("Interface %s %s (resynced after lost link events)\n", w->name,
+                       idx <= 0 ? "gone" : up ? "up" : "down");
+                w->ifindex = idx;
+                w->up = up;
+                w->changed = true;
+            }
+            continue;
         }
-        int wt = snprintf(text_buf + text_off, sizeof(text_buf) - text_off,
-                          "\"%s\"", labels[i]);
-        if (wt < 0 || text_off + (size_t)wt >= sizeof(text_buf)) return -1;
-        text_off += (size_t)wt;
+        if (len <= 0) break;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)w->buf; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if ((h->nlmsg_type != RTM_NEWLINK && h->nlmsg_type != RTM_DELLINK) ||
+                h->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+                continue;
+            }
+            const char *name;
+            int oper;
+            link_attrs(h, &name, &oper);
+            iface_watch_link(w, h->nlmsg_type, NLMSG_DATA(h), name, oper);
+        }
+    }
+}
 
-        int wv = snprintf(value_buf + value_off, sizeof(value_buf) - value_off,
-                          "%.2f", values[i]);
-        if (wv < 0 || value_off + (size_t)wv >= sizeof(value_buf)) return -1;
-        value_off += (size_t)wv;
-        first = false;
+struct services {
+    struct history_ring *history;
+    struct exporter *exporter;
+    struct ubus_link *ubus;
+    struct fast_path *fast;
+    struct prober *prober;
+    struct iface_watch *watch;
+    const struct timespec *start_ts;
+    int interval_ms;
+};
+
+/* Sleeps for interval_ms while servicing the auxiliary sockets. */
+static void wait_interval(int interval_ms, struct services *svc) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += interval_ms / 1000;
+    deadline.tv_nsec += (interval_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
-    text_buf[text_off++] = ']';
-    text_buf[text_off] = '\0';
-    value_buf[value_off++] = ']';
-    value_buf[value_off] = '\0';
 
-    double link_tx = m->valid_link_tx ? m->link_tx_norm : NAN;
-    double link_rx = m->valid_link_rx ? m->link_rx_norm : NAN;
-    double link_all = m->valid_link_all ? m->link_all_norm : NAN;
+    enum { SVC_HISTORY, SVC_UBUS, SVC_PROBE, SVC_LINK, SVC_EXPORTER, SVC_CLIENT0, SVC_MAX = SVC_CLIENT0 + EXPORTER_CLIENTS };
 
-    double link_fallback = !isnan(link_all) ? link_all :
-                           !isnan(link_tx) ? link_tx :
-                           !isnan(link_rx) ? link_rx : 0.0;
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double remaining = timespec_diff_seconds(&deadline, &now);
+        if (remaining <= 0.0 || g_stop || (svc->watch && svc->watch->changed)) return;
 
-    double rssi_value = m->valid_rssi ? m->rssi_norm : 0.0;
-    double link_value = link_fallback;
-    double link_tx_value = !isnan(link_tx) ? link_tx : link_value;
-    double link_rx_value = !isnan(link_rx) ? link_rx : link_value;
-    double link_all_value = !isnan(link_all) ? link_all : link_value;
+        int fast_ms = fast_path_due_ms(svc->fast, &now);
+        if (fast_ms == 0) {
+            fast_path_tick(svc->fast);
+            continue;
+        }
+        int probe_ms = prober_due_ms(svc->prober);
+        if (probe_ms == 0) {
+            prober_tick(svc->prober);
+            continue;
+        }
+        if (probe_ms >= 0 && (fast_ms < 0 || probe_ms < fast_ms)) fast_ms = probe_ms;
 
-    char raw_link_tx[32], raw_link_rx[32], raw_link_all[32];
-    format_number(raw_link_tx, sizeof(raw_link_tx), link_tx, "%.2f");
-    format_number(raw_link_rx, sizeof(raw_link_rx), link_rx, "%.2f");
-    format_number(raw_link_all, sizeof(raw_link_all), link_all, "%.2f");
+        struct pollfd pfds[SVC_MAX];
+        for (size_t i = 0; i < SVC_MAX; i++) {
+            pfds[i].fd = -1;
+            pfds[i].events = 0;
+            pfds[i].revents = 0;
+        }
+        bool any = false;
+        if (svc->history && svc->history->fd >= 0) {
+            pfds[SVC_HISTORY].fd = svc->history->fd;
+            pfds[SVC_HISTORY].events = POLLIN;
+            any = true;
+        }
+        if (svc->ubus) ubus_link_retry(svc->ubus); /* -u alone: nothing else reconnects */
+        if (svc->ubus && ubus_link_fd(svc->ubus) >= 0) {
+            pfds[SVC_UBUS].fd = ubus_link_fd(svc->ubus);
+            pfds[SVC_UBUS].events = POLLIN;
+            any = true;
+        }
+        if (svc->prober && svc->prober->fd >= 0) {
+            pfds[SVC_PROBE].fd = svc->prober->fd;
+            pfds[SVC_PROBE].events = POLLIN;
+            any = true;
+        }
+        if (svc->watch && svc->watch->fd >= 0) {
+            pfds[SVC_LINK].fd = svc->watch->fd;
+            pfds[SVC_LINK].events = POLLIN;
+            any = true;
+        }
+        struct exporter *ex = svc->exporter;
+        if (ex && ex->listen_fd >= 0) {
+            pfds[SVC_EXPORTER].fd = ex->listen_fd;
+            pfds[SVC_EXPORTER].events = POLLIN;
+            for (size_t i = 0; i < EXPORTER_CLIENTS; i++) {
+                struct exporter_client *c = &ex->clients[i];
+                if (c->fd < 0) continue;
+                pfds[SVC_CLIENT0 + i].fd = c->fd;
+                pfds[SVC_CLIENT0 + i].events = c->out_len ? POLLOUT : POLLIN;
+            }
+            any = true;
+        }
 
-    int len = snprintf(payload, sizeof(payload),
-        "{\"rssi\":%.2f,\"link\":%.2f,\"link_tx\":%.2f,\"link_rx\":%.2f,\"link_all\":%.2f,"
-        "\"text\":%s,\"value\":%s,"
-        "\"raw\":{\"signal\":%s,"
-        "\"tx_retry_ratio\":%s,\"tx_retry_rate\":%s,\"tx_fail_rate\":%s,\"tx_beacon_rate\":%s,\"tx_packet_rate\":%s,"
-        "\"rx_retry_ratio\":%s,\"rx_retry_rate\":%s,\"rx_drop_rate\":%s,\"rx_packet_rate\":%s,"
-        "\"link_tx\":%s,\"link_rx\":%s,\"link_all\":%s}}\n",
-        rssi_value,
-        link_value,
-        link_tx_value,
-        link_rx_value,
-        link_all_value,
-        text_buf,
-        value_buf,
-        raw_signal,
-        raw_tx_ratio,
-        raw_tx_retry_rate,
-        raw_tx_fail_rate,
-        raw_tx_beacon_rate,
-        raw_tx_packet_rate,
-        raw_rx_ratio,
-        raw_rx_retry_rate,
-        raw_rx_drop_rate,
-        raw_rx_packet_rate,
-        raw_link_tx,
-        raw_link_rx,
-        raw_link_all);
-    if (len < 0 || (size_t)len >= sizeof(payload)) {
-        fprintf(stderr, "Failed to format payload\n");
-        return -1;
-    }
+        if (!any && fast_ms < 0) {
+            struct timespec ts = {
+                .tv_sec = (time_t)remaining,
+                .tv_nsec = (long)((remaining - (double)(time_t)remaining) * 1e9),
+            };
+            nanosleep(&ts, NULL);
+            return;
+        }
 
-    ssize_t sent = sendto(sock, payload, len, 0,
-                          (const struct sockaddr *)addr, sizeof(*addr));
-    if (sent < 0) {
-        fprintf(stderr, "sendto failed: %s\n", strerror(errno));
-        return -1;
+        int timeout = (int)ceil(remaining * 1000.0);
+        if (fast_ms >= 0 && fast_ms < timeout) timeout = fast_ms;
+        int rc = poll(pfds, SVC_MAX, timeout);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+            return;
+        }
+        if (rc == 0) continue;
+
+        if (pfds[SVC_HISTORY].revents & POLLIN) {
+            history_serve(svc->history, ms_since(svc->start_ts), svc->interval_ms);
+        }
+        if (pfds[SVC_UBUS].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ubus_link_dispatch(svc->ubus);
+        }
+        if (pfds[SVC_PROBE].revents & POLLIN) {
+            prober_read(svc->prober);
+        }
+        if (pfds[SVC_LINK].revents & POLLIN) {
+            iface_watch_read(svc->watch);
+        }
+        if (ex && ex->listen_fd >= 0) {
+            for (size_t i = 0; i < EXPORTER_CLIENTS; i++) {
+                struct exporter_client *c = &ex->clients[i];
+                short rev = pfds[SVC_CLIENT0 + i].revents;
+                if (c->fd < 0 || !rev) continue;
+                if (rev & (POLLERR | POLLHUP | POLLNVAL)) {
+                    exporter_drop(c);
+                } else if (rev & POLLOUT) {
+                    exporter_flush(c);
+                } else if (rev & POLLIN) {
+                    exporter_read(ex, c);
+                }
+            }
+            if (pfds[SVC_EXPORTER].revents & POLLIN) {
+                exporter_accept(ex);
+            }
+        }
     }
-    return 0;
 }
 
+#ifndef WIFI_METRICS_NO_MAIN
 int main(int argc, char **argv) {
     const char *device = NULL;
     const char *host = "127.0.0.1";
@@ -775,18 +4417,52 @@ int main(int argc, char **argv) {
     int list_only = 0;
     int verbose = 0;
     char mac_filter[32] = {0};
+    const char *history_path = NULL;
+    int history_depth_s = 3600;
+    const char *log_dir = NULL;
+    int log_cap_mb = 64;
+    const char *exporter_spec = NULL;
+    bool ubus_collect = false;
+    bool ubus_publish = false;
+    const char *ubus_path = NULL;
+    int rate_report_s = 0;
+    int fast_ms = 0;
+    int thin_max = 1;
+    const char *osd_path = NULL;
+    bool host_given = false;
+    int probe_ms = 0;
+    int probe_budget = 4000;
+    int fec_depth = 0;
+    int fec_budget = FEC_BUDGET_DEFAULT;
 
     int opt;
-    while ((opt = getopt(argc, argv, "d:H:p:i:c:m:Lvh")) != -1) {
+    while ((opt = getopt(argc, argv, "d:H:p:i:c:m:Q:R:W:S:P:F:T:O:e:E:k:b:r:B:s:UuLvh")) != -1) {
         switch (opt) {
             case 'd': device = optarg; break;
-            case 'H': host = optarg; break;
+            case 'H': host = optarg; host_given = true; break;
             case 'p': port = atoi(optarg); break;
             case 'i': interval_ms = atoi(optarg); break;
             case 'c': count = atoi(optarg); break;
             case 'm':
                 normalize_mac(optarg, mac_filter, sizeof(mac_filter));
                 break;
+            case 'Q': history_path = optarg; break;
+            case 'R': history_depth_s = atoi(optarg); break;
+            case 'W': log_dir = optarg; break;
+            case 'S': log_cap_mb = atoi(optarg); break;
+            case 'P': exporter_spec = optarg; break;
+            case 'F': fast_ms = atoi(optarg); break;
+            case 'T': thin_max = atoi(optarg); break;
+            case 'O': osd_path = optarg; break;
+            case 'e': fec_depth = atoi(optarg); break;
+            case 'E': fec_budget = atoi(optarg); break;
+            case 'k': probe_ms = atoi(optarg); break;
+            case 'b': probe_budget = atoi(optarg); break;
+            case 'r': rate_report_s = atoi(optarg); break;
+            case 'B': return rc_benchmark(optarg);
+            case 'U': ubus_collect = true; break;
+            case 'u': ubus_publish = true; break;
+            case 's': ubus_path = optarg; break;
             case 'L': list_only = 1; break;
             case 'v': verbose = 1; break;
             case 'h': usage(argv[0]); return 0;
@@ -799,19 +4475,27 @@ int main(int argc, char **argv) {
         return 1;
     }
     if (interval_ms < 0) interval_ms = 0;
+    if (fec_depth < 0 || fec_depth > FEC_MAX_DEPTH || fec_budget < 0 || fec_budget > FEC_BUDGET_MAX) {
+        fprintf(stderr, "Invalid -e/-E: depth 0..%d, budget 0..%d bytes\n", FEC_MAX_DEPTH, FEC_BUDGET_MAX);
+        return 1;
+    }
 
-    char detected_device[64] = {0};
-    if (!device) {
-        if (detect_default_interface(detected_device, sizeof(detected_device)) != 0) {
-            fprintf(stderr, "Failed to detect interface; use -d\n");
-            return 1;
-        }
-        device = detected_device;
+    /* device and phy_name alias the watch, so renames and re-creation show through. */
+    static struct iface_watch watch = {.fd = -1};
+    bool detect = !device;
+    if (iface_watch_open(&watch, device) != 0) {
+        if (detect) fprintf(stderr, "Failed to detect interface; use -d\n");
+        return 1;
+    }
+    device = watch.name;
+    const char *phy_name = watch.phy;
+    if (detect) {
         printf("Detected interface: %s\n", device);
         fflush(stdout);
     }
 
     if (list_only) {
+        iface_watch_close(&watch);
         int rc = list_stations(device);
         return rc == 0 ? 0 : 1;
     }
@@ -823,11 +4507,6 @@ int main(int argc, char **argv) {
         target_mac[sizeof(target_mac) - 1] = '\0';
     }
 
-    char phy_name[64];
-    if (resolve_phy_name(device, phy_name, sizeof(phy_name)) != 0) {
-        return 1;
-    }
-
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) {
         fprintf(stderr, "socket failed: %s\n", strerror(errno));
@@ -844,9 +4523,101 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    struct tx_counter_snapshot prev_tx = {.valid = false};
-    struct rx_snapshot prev_rx = {0};
-    bool prev_rx_valid = false;
+    struct transport transport = {
+        .sock = sock,
+        .event_sock = -1,
+        .dest = dest,
+        .thin_max = thin_max,
+        .fec_depth = fec_depth,
+        .fec_budget = fec_budget,
+    };
+    transport_open_events(&transport);
+
+    /* -O alone drops the UDP hop entirely; with -H both outputs run. */
+    bool udp_out = !osd_path || host_given;
+    static struct osd_publisher osd = {.fd = -1};
+    if (osd_path) {
+        if (osd_publisher_open(&osd, osd_path, verbose) != 0) {
+            transport_close(&transport);
+            close(sock);
+            return 1;
+        }
+        transport.osd = &osd;
+        if (!udp_out) transport.sock = -1;
+        printf("OSD publisher on %s%s\n", osd_path, udp_out ? ", UDP output kept" : "");
+    }
+    if (rate_report_s > 0 && !udp_out)
+        fprintf(stderr, "Warning: -r reports go over UDP only; add -H to send them alongside -O\n");
+
+    struct timespec start_ts;
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    struct history_ring history = {.fd = -1};
+    if (history_path) {
+        if (history_depth_s <= 0) history_depth_s = 3600;
+        if (history_open(&history, history_path, history_depth_s, interval_ms) != 0) {
+            close(sock);
+            return 1;
+        }
+    }
+
+    static struct metrics_log metrics_log;
+    if (log_dir && log_start(&metrics_log, log_dir, log_cap_mb) != 0) {
+        history_close(&history);
+        close(sock);
+        return 1;
+    }
+
+    static struct exporter exporter = {.listen_fd = -1};
+    if (exporter_spec && exporter_open(&exporter, exporter_spec) != 0) {
+        log_stop(&metrics_log);
+        history_close(&history);
+        close(sock);
+        return 1;
+    }
+
+    static struct ubus_link ubus_link;
+    if ((ubus_collect || ubus_publish) &&
+        ubus_link_open(&ubus_link, ubus_path, ubus_publish, &exporter.snap) != 0) {
+        exporter_close(&exporter);
+        log_stop(&metrics_log);
+        history_close(&history);
+        close(sock);
+        return 1;
+    }
+
+    static struct fast_path fast = {.fd = -1};
+    if (fast_ms > 0) {
+        fast.sock = udp_out ? sock : -1;
+        fast.osd = transport.osd;
+        fast.dest = &dest;
+        fast.snap = &exporter.snap;
+        if (fast_path_open(&fast, device, fast_ms) == 0) {
+            printf("Fast path: nl80211 station sample every %d ms\n", fast_ms);
+        }
+    }
+
+    static struct prober prober = {.fd = -1};
+    if (probe_ms > 0 && prober_open(&prober, &dest, probe_ms, probe_budget) == 0) {
+        prober.snap = &exporter.snap;
+        printf("Probing %s:%d every %d ms, budget %d B/s\n", host, port, probe_ms, (int)prober.budget_bps);
+    }
+
+    struct services services = {
+        .history = &history,
+        .exporter = &exporter,
+        .ubus = &ubus_link,
+        .fast = &fast,
+        .prober = &prober,
+        .watch = &watch,
+        .start_ts = &start_ts,
+        .interval_ms = interval_ms,
+    };
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct counter_set counters = {0};
     struct rx_link_metrics prev_rx_link = {0};
     bool prev_rx_metrics_valid = false;
     char active_mac[32] = {0};
@@ -855,15 +4626,23 @@ int main(int argc, char **argv) {
     double ema_tx = 100.0;
     double ema_rx = 100.0;
     double ema_all = 100.0;
+    double ema_queue = 100.0;
+    double ema_host = 100.0;
+    double ema_rf = 100.0;
+    static struct host_reader host_load;
+    host_open(&host_load);
+    static struct rf_reader rf;
+    static struct rc_table rc;
     const double ema_alpha = 0.4;
+    static struct aqm_reader aqm = {.fd = -1};
     int sent = 0;
     const double mac_retry_interval_s = 10.0;
     struct timespec last_mac_attempt = {0};
     bool have_last_mac_attempt = false;
     bool notified_waiting = false;
 
-    for (;;) {
-        struct station_sample sample;
+    while (!g_stop) {
+        struct station_sample sample = {0};
         char matched_mac[32] = {0};
 
         struct timespec now_ts;
@@ -882,6 +4661,30 @@ int main(int argc, char **argv) {
         last_ts = now_ts;
         have_last_ts = true;
 
+        if (watch.changed) {
+            watch.changed = false;
+            fast.ifindex = watch.ifindex;
+            aqm_close(&aqm);
+            if (iface_watch_ready(&watch)) {
+                have_last_mac_attempt = false; /* search now rather than after the retry interval */
+                notified_waiting = false;
+            } else if (active_mac[0]) {
+                transport_send_event(&transport, EVENT_DISCONNECT, active_mac, 0);
+            }
+            fflush(stdout);
+        }
+        if (!iface_watch_ready(&watch)) {
+            exporter_invalidate(&exporter);
+            counter_set_reset(&counters);
+            fast_path_set_station(&fast, NULL);
+            have_last_ts = false;
+            target_mac[0] = '\0';
+            active_mac[0] = '\0';
+            if (interval_ms <= 0) break;
+            wait_interval(interval_ms, &services);
+            continue;
+        }
+
         if (!target_mac[0]) {
             bool should_attempt = !have_last_mac_attempt;
             if (!should_attempt && have_last_mac_attempt) {
@@ -895,7 +4698,9 @@ int main(int argc, char **argv) {
                 int rc = -1;
                 if (auto_select_mac) {
                     char first_mac[32] = {0};
-                    rc = find_first_station(device, first_mac, sizeof(first_mac));
+                    rc = ubus_collect
+                        ? ubus_query_station(&ubus_link, device, NULL, NULL, first_mac, sizeof(first_mac))
+                        : find_first_station(device, first_mac, sizeof(first_mac));
                     if (rc == 0) {
                         strncpy(target_mac, first_mac, sizeof(target_mac) - 1);
                         target_mac[sizeof(target_mac) - 1] = '\0';
@@ -910,7 +4715,9 @@ int main(int argc, char **argv) {
                     }
                 } else {
                     char discovered[32] = {0};
-                    rc = find_station_by_mac(device, mac_filter, discovered, sizeof(discovered));
+                    rc = ubus_collect
+                        ? ubus_query_station(&ubus_link, device, mac_filter, NULL, discovered, sizeof(discovered))
+                        : find_station_by_mac(device, mac_filter, discovered, sizeof(discovered));
                     if (rc == 0) {
                         strncpy(target_mac, discovered, sizeof(target_mac) - 1);
                         target_mac[sizeof(target_mac) - 1] = '\0';
@@ -932,26 +4739,35 @@ int main(int argc, char **argv) {
             }
 
             if (!target_mac[0]) {
-                prev_tx.valid = false;
-                prev_rx_valid = false;
+                counter_set_reset(&counters);
+                fast_path_set_station(&fast, NULL);
                 have_last_ts = false;
                 active_mac[0] = '\0';
                 if (interval_ms <= 0) {
                     break;
                 }
-                struct timespec ts = {
-                    .tv_sec = interval_ms / 1000,
-                    .tv_nsec = (interval_ms % 1000) * 1000000L,
-                };
-                nanosleep(&ts, NULL);
+                wait_interval(interval_ms, &services);
                 continue;
             }
         }
 
-        if (fetch_station_metrics(device, target_mac,
-                                  &sample, matched_mac, sizeof(matched_mac)) != 0) {
-            prev_tx.valid = false;
-            prev_rx_valid = false;
+        int fetch_rc;
+        if (ubus_collect) {
+            fetch_rc = ubus_query_station(&ubus_link, device, target_mac,
+                                          &sample, matched_mac, sizeof(matched_mac)) == 0 ? 0 : -1;
+        } else {
+            fetch_rc = fetch_station_metrics(device, target_mac,
+                                             &sample, matched_mac, sizeof(matched_mac));
+        }
+        struct timespec fetched_ts;
+        clock_gettime(CLOCK_MONOTONIC, &fetched_ts);
+        latency_observe(&exporter.snap.fetch_latency, timespec_diff_seconds(&fetched_ts, &now_ts));
+        if (fetch_rc != 0) {
+            exporter.snap.fetch_errors++;
+            exporter_invalidate(&exporter);
+            if (active_mac[0]) transport_send_event(&transport, EVENT_DISCONNECT, active_mac, 0);
+            counter_set_reset(&counters);
+            fast_path_set_station(&fast, NULL);
             have_last_ts = false;
             fprintf(stderr, "Unable to fetch metrics for %s\n", device);
             target_mac[0] = '\0';
@@ -962,11 +4778,7 @@ int main(int argc, char **argv) {
             if (interval_ms <= 0) {
                 break;
             }
-            struct timespec ts = {
-                .tv_sec = interval_ms / 1000,
-                .tv_nsec = (interval_ms % 1000) * 1000000L,
-            };
-            nanosleep(&ts, NULL);
+            wait_interval(interval_ms, &services);
             continue;
         } else {
             if (matched_mac[0]) {
@@ -975,30 +4787,40 @@ int main(int argc, char **argv) {
             }
             const char *mac_for_path = matched_mac[0] ? matched_mac : target_mac;
             if (mac_for_path && mac_for_path[0]) {
-                double rx_dup = NAN;
+                uint64_t rx_dup;
                 if (fetch_rx_duplicates(phy_name, device, mac_for_path, &rx_dup) == 0) {
-                    sample.rx_duplicates = rx_dup;
+                    sample_set(&sample, CTR_RX_DUPLICATES, rx_dup);
                 }
             }
-            if (isnan(sample.rx_duplicates)) sample.rx_duplicates = 0.0;
-            if (isnan(sample.rx_packets)) sample.rx_packets = 0.0;
-            if (isnan(sample.rx_drop_misc)) sample.rx_drop_misc = 0.0;
 
             if (matched_mac[0] && strcmp(matched_mac, active_mac) != 0) {
                 strncpy(active_mac, matched_mac, sizeof(active_mac) - 1);
                 active_mac[sizeof(active_mac) - 1] = '\0';
-                prev_tx.valid = false;
-                prev_rx_valid = false;
-                ema_tx = ema_rx = ema_all = 100.0;
+                counter_set_reset(&counters);
+                ema_tx = ema_rx = ema_all = ema_queue = 100.0;
+                aqm_close(&aqm);
+                rc.have_prev = false;
+                fast_path_set_station(&fast, active_mac);
                 have_last_ts = false;
+                transport_send_event(&transport, EVENT_CONNECT, active_mac, 0);
                 printf("Tracking station %s on %s\n", active_mac, device);
                 fflush(stdout);
             }
 
-    struct tx_link_metrics tx_link = {0};
-    bool tx_ready = compute_tx_link_metrics(&sample,
-                                            prev_tx.valid ? &prev_tx : NULL,
-                                            interval_s, &tx_link);
+            uint32_t reset_sources = counter_set_update(&counters, &sample, interval_s);
+            exporter.snap.counter_wraps = counters.wraps;
+            exporter.snap.counter_resets = counters.resets;
+            const struct counter_track *beacon = &counters.c[CTR_BEACON_LOSS];
+            if (beacon->has_delta && beacon->delta >= EVENT_BEACON_BURST) {
+                transport_send_event(&transport, EVENT_BEACON_LOSS, active_mac, (double)beacon->delta);
+            }
+            if (reset_sources && verbose) {
+                printf("Counter reset on %s (source mask 0x%x), deltas restart from zero\n",
+                       active_mac, (unsigned)reset_sources);
+            }
+
+            struct tx_link_metrics tx_link = {0};
+            bool tx_ready = compute_tx_link_metrics(&counters, interval_s, &tx_link);
             if (tx_ready) {
                 if (tx_link.has_delta) {
                     ema_tx = ema_alpha * tx_link.composite + (1.0 - ema_alpha) * ema_tx;
@@ -1006,29 +4828,19 @@ int main(int argc, char **argv) {
                 tx_link.composite = ema_tx;
             }
 
-            struct rx_snapshot rx_sample = {
-                .rx_packets = sample.rx_packets,
-                .rx_duplicates = sample.rx_duplicates,
-                .rx_drop_misc = sample.rx_drop_misc,
-            };
             struct rx_link_metrics rx_link = prev_rx_metrics_valid ? prev_rx_link : (struct rx_link_metrics){0};
-            bool rx_ready = false;
-            if (!isnan(sample.rx_packets)) {
-                struct rx_link_metrics tmp = {0};
-                rx_ready = compute_rx_link_metrics(&rx_sample,
-                                                   prev_rx_valid ? &prev_rx : NULL,
-                                                   interval_s, &tmp);
-                if (rx_ready) {
-                    if (tmp.has_delta) {
-                        ema_rx = ema_alpha * tmp.composite + (1.0 - ema_alpha) * ema_rx;
-                        rx_link = tmp;
-                        rx_link.composite = ema_rx;
-                        prev_rx_link = rx_link;
-                        prev_rx_link.has_delta = true;
-                        prev_rx_metrics_valid = true;
-                    } else {
-                        rx_link.composite = ema_rx;
-                    }
+            struct rx_link_metrics rx_tmp = {0};
+            bool rx_ready = compute_rx_link_metrics(&counters, interval_s, &rx_tmp);
+            if (rx_ready) {
+                if (rx_tmp.has_delta) {
+                    ema_rx = ema_alpha * rx_tmp.composite + (1.0 - ema_alpha) * ema_rx;
+                    rx_link = rx_tmp;
+                    rx_link.composite = ema_rx;
+                    prev_rx_link = rx_link;
+                    prev_rx_link.has_delta = true;
+                    prev_rx_metrics_valid = true;
+                } else {
+                    rx_link.composite = ema_rx;
                 }
             }
             if (!rx_ready && prev_rx_metrics_valid) {
@@ -1058,6 +4870,7 @@ int main(int argc, char **argv) {
                                                     tx_ready ? &tx_link : NULL,
                                                     rx_ready ? &rx_link : NULL,
                                                     link_all, link_all_valid);
+            metrics.t_us = (uint64_t)fetched_ts.tv_sec * 1000000ull + (uint64_t)fetched_ts.tv_nsec / 1000ull;
 
             if (!metrics.valid_link_tx && tx_ready) {
                 metrics.link_tx_norm = ema_tx;
@@ -1072,16 +4885,68 @@ int main(int argc, char **argv) {
                 metrics.valid_link_all = true;
             }
 
-            if (send_udp_packet(sock, &dest, &metrics) != 0) {
+            if (aqm_open(&aqm, phy_name, device, mac_for_path) == 0 &&
+                aqm_update(&aqm, interval_s, &metrics.queue)) {
+                ema_queue = ema_alpha * metrics.queue.score + (1.0 - ema_alpha) * ema_queue;
+                metrics.queue.score = ema_queue;
+            }
+            if (host_update(&host_load, interval_s, &metrics.host)) {
+                ema_host = ema_alpha * metrics.host.score + (1.0 - ema_alpha) * ema_host;
+                metrics.host.score = ema_host;
+            }
+            rf_open(&rf, phy_name);
+            if (rf_update(&rf, sample.signal_dbm, rx_ready ? rx_link.packets_per_s : NAN, interval_s, &metrics.rf)) {
+                ema_rf = ema_alpha * metrics.rf.score + (1.0 - ema_alpha) * ema_rf;
+                metrics.rf.score = ema_rf;
+            }
+
+            uint32_t now_ms = ms_since(&start_ts);
+            if (rate_report_s > 0 && udp_out && mac_for_path && mac_for_path[0] &&
+                (!rc.tried || now_ms - rc.last_try_ms >= (uint32_t)rate_report_s * 1000u)) {
+                char rc_path[PATH_MAX], mac_lower[32];
+                normalize_mac(mac_for_path, mac_lower, sizeof(mac_lower));
+                snprintf(rc_path, sizeof(rc_path),
+                         "/sys/kernel/debug/ieee80211/%s/netdev:%s/stations/%s/rc_stats_csv",
+                         phy_name, device, mac_lower);
+                double span_s = rc.have_prev ? (now_ms - rc.last_report_ms) / 1000.0 : 0.0;
+                struct rc_report report;
+                rc.tried = true;
+                rc.last_try_ms = now_ms;
+                if (rc_parse_file(&rc, rc_path) == 0) {
+                    if (rc_compute(&rc, &report)) {
+                        send_rate_report(sock, &dest, &rc, &report, mac_lower, span_s);
+                        if (verbose) {
+                            printf("rates: attempts=%llu per=%.3f goodput=%.1f Mbit/s top=%s\n",
+                                   (unsigned long long)report.attempts, report.per, report.goodput_mbps,
+                                   report.count ? rc.cur[report.top[0].idx].name : "-");
+                        }
+                    }
+                    rc.last_report_ms = now_ms;
+                }
+            }
+
+            if (transport_send_sample(&transport, &metrics) < 0) {
                 fprintf(stderr, "Failed to send UDP payload\n");
+                exporter.snap.send_errors++;
             }
 
+            struct timespec done_ts;
+            clock_gettime(CLOCK_MONOTONIC, &done_ts);
+            latency_observe(&exporter.snap.tick_latency, timespec_diff_seconds(&done_ts, &now_ts));
+            exporter_update(&exporter, &metrics, device, active_mac);
+
+            history_record(&history, ms_since(&start_ts), &metrics);
+            log_push(&metrics_log, &metrics);
+
             if (verbose) {
                 double hz = interval_s > 0.0 ? (1.0 / interval_s) : 0.0;
                 printf("mac=%s Hz=%.2f rssi=%.1f dBm (norm %.1f) "
                        "link_tx=%.1f link_rx=%.1f link_all=%.1f "
                        "tx_ratio=%.4f tx_retries/s=%.2f tx_fail/s=%.2f tx_beacon/s=%.2f tx_packets/s=%.2f "
-                       "rx_ratio=%.4f rx_retries/s=%.2f rx_drop/s=%.2f rx_packets/s=%.2f\n",
+                       "rx_ratio=%.4f rx_retries/s=%.2f rx_drop/s=%.2f rx_packets/s=%.2f "
+                       "queue=%.1f backlog=%.0fB delay=%.1fms qdrop/s=%.2f mark/s=%.2f "
+                       "host=%.1f cpu=%.1f%% si=%.1f%% netdrop/s=%.2f psi_mem=%.2f mem_avail=%.1f%% "
+                       "intf=%.1f fcs/s=%.1f fcs=%.3f cca/s=%.0f rts_fail=%.3f\n",
                        active_mac[0] ? active_mac : matched_mac,
                        hz,
                        sample.signal_dbm,
@@ -1097,24 +4962,26 @@ int main(int argc, char **argv) {
                        rx_ready ? rx_link.ratio : NAN,
                        rx_ready ? rx_link.retry_rate : NAN,
                        rx_ready ? rx_link.drop_rate : NAN,
-                       rx_ready ? rx_link.packets_per_s : NAN);
+                       rx_ready ? rx_link.packets_per_s : NAN,
+                       metrics.queue.valid ? metrics.queue.score : NAN,
+                       metrics.queue.valid ? metrics.queue.backlog_bytes : NAN,
+                       metrics.queue.valid ? metrics.queue.delay_ms : NAN,
+                       metrics.queue.valid ? metrics.queue.drop_rate : NAN,
+                       metrics.queue.valid ? metrics.queue.mark_rate : NAN,
+                       metrics.host.valid ? metrics.host.score : NAN,
+                       metrics.host.valid ? metrics.host.cpu_busy_pct : NAN,
+                       metrics.host.valid ? metrics.host.softirq_pct : NAN,
+                       metrics.host.valid ? metrics.host.softnet_drop_rate : NAN,
+                       metrics.host.valid ? metrics.host.psi_some_avg10[HOST_PSI_MEMORY] : NAN,
+                       metrics.host.valid ? metrics.host.mem_avail_pct : NAN,
+                       metrics.rf.valid ? metrics.rf.score : NAN,
+                       metrics.rf.valid ? metrics.rf.fcs_error_rate : NAN,
+                       metrics.rf.valid ? metrics.rf.fcs_error_ratio : NAN,
+                       metrics.rf.valid ? metrics.rf.false_cca_rate : NAN,
+                       metrics.rf.valid ? metrics.rf.rts_fail_ratio : NAN);
                 fflush(stdout);
             }
 
-            if (!isnan(sample.tx_packets) && !isnan(sample.tx_retries) &&
-                !isnan(sample.tx_failed) && !isnan(sample.beacon_loss)) {
-                prev_tx.tx_packets = sample.tx_packets;
-                prev_tx.tx_retries = sample.tx_retries;
-                prev_tx.tx_failed  = sample.tx_failed;
-                prev_tx.beacon_loss = sample.beacon_loss;
-                prev_tx.valid = true;
-            } else {
-                prev_tx.valid = false;
-            }
-
-            prev_rx = rx_sample;
-            prev_rx_valid = true;
-
             if (rx_ready) {
                 prev_rx_link = rx_link;
                 prev_rx_metrics_valid = true;
@@ -1123,17 +4990,38 @@ int main(int argc, char **argv) {
             }
         }
 
+        exporter.snap.ticks++;
         sent++;
         if (count > 0 && sent >= count) break;
         if (interval_ms <= 0) break;
 
-        struct timespec ts = {
-            .tv_sec = interval_ms / 1000,
-            .tv_nsec = (interval_ms % 1000) * 1000000L,
-        };
-        nanosleep(&ts, NULL);
+        wait_interval(interval_ms, &services);
     }
 
+    if (fast.errors) {
+        fprintf(stderr, "Fast path: %llu failed station samples\n", (unsigned long long)fast.errors);
+    }
+    if (transport.thinned) {
+        printf("Thinned %llu routine samples\n", (unsigned long long)transport.thinned);
+    }
+    if (prober.fd >= 0 && prober.stats.sent) {
+        printf("Probes: %llu sent, %llu echoed, %llu trains, %llu skipped for budget\n",
+               (unsigned long long)prober.stats.sent, (unsigned long long)prober.stats.echoed,
+               (unsigned long long)prober.stats.trains, (unsigned long long)prober.stats.budget_skips);
+    }
+    prober_close(&prober);
+    iface_watch_close(&watch);
+    transport_close(&transport);
+    osd_publisher_close(&osd);
+    fast_path_close(&fast);
+    aqm_close(&aqm);
+    host_close(&host_load);
+    rf_close(&rf);
+    ubus_link_close(&ubus_link);
+    exporter_close(&exporter);
+    log_stop(&metrics_log);
+    history_close(&history);
     close(sock);
     return 0;
 }
+#endif
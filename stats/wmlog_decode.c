@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wmlog_format.h"
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [-H] FILE...\n"
+        "  Decode wifi_metrics_sender -W logs (wm-NNNNNN.wml) to CSV on stdout.\n"
+        "  Files are processed in the order given; pass them oldest first (by name, or by\n"
+        "  mtime once the numbering has wrapped past 999999).\n"
+        "  -H          Omit the CSV header line\n",
+        argv0);
+}
+
+static void print_value(int col, int64_t v) {
+    if (v == WMLOG_MISSING) return;
+    if (wmlog_column_scaled(col)) {
+        printf("%.2f", (double)v / 100.0);
+    } else {
+        printf("%lld", (long long)v);
+    }
+}
+
+static int decode_file(const char *path, unsigned long *records_out) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "fopen(%s) failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    uint8_t header[WMLOG_FILE_MAGIC_LEN + 4];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+        memcmp(header, WMLOG_FILE_MAGIC, WMLOG_FILE_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s: not a metrics log\n", path);
+        fclose(fp);
+        return -1;
+    }
+    uint32_t columns = wmlog_get_u32(header + WMLOG_FILE_MAGIC_LEN);
+    if (columns != WMLOG_COLUMNS) {
+        fprintf(stderr, "%s: unsupported column count %u\n", path, columns);
+        fclose(fp);
+        return -1;
+    }
+
+    static uint8_t payload[WMLOG_BLOCK_PAYLOAD_MAX];
+    static struct wmlog_record recs[WMLOG_BLOCK_RECORDS];
+    long offset = (long)sizeof(header);
+    unsigned long records = 0;
+
+    for (;;) {
+        uint8_t bh[WMLOG_BLOCK_HEADER];
+        size_t got = fread(bh, 1, sizeof(bh), fp);
+        if (got == 0) break;
+
+        uint32_t magic = got == sizeof(bh) ? wmlog_get_u32(bh) : 0;
+        uint16_t count = wmlog_get_u16(bh + 4);
+        uint32_t len = wmlog_get_u32(bh + 8);
+        uint32_t crc = wmlog_get_u32(bh + 12);
+        if (magic != WMLOG_BLOCK_MAGIC || count == 0 || count > WMLOG_BLOCK_RECORDS ||
+            len > sizeof(payload) || fread(payload, 1, len, fp) != len ||
+            wmlog_crc32(payload, len) != crc ||
+            wmlog_decode_block(payload, len, count, recs) != 0) {
+            fprintf(stderr, "%s: stopping at torn or corrupt block at offset %ld\n", path, offset);
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            for (int col = 0; col < WMLOG_COLUMNS; col++) {
+                if (col) putchar(',');
+                print_value(col, recs[i].v[col]);
+            }
+            putchar('\n');
+        }
+        records += count;
+        offset += (long)(sizeof(bh) + len);
+    }
+
+    fclose(fp);
+    *records_out += records;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool header = true;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-H") == 0) {
+        header = false;
+        first = 2;
+    } else if (argc > 1 && strcmp(argv[1], "-h") == 0) {
+        usage(argv[0]);
+        return 0;
+    }
+    if (first >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (header) {
+        for (int col = 0; col < WMLOG_COLUMNS; col++) {
+            printf("%s%s", col ? "," : "", wmlog_column_names[col]);
+        }
+        putchar('\n');
+    }
+
+    int rc = 0;
+    unsigned long records = 0;
+    for (int i = first; i < argc; i++) {
+        if (decode_file(argv[i], &records) != 0) rc = 1;
+    }
+    fprintf(stderr, "Decoded %lu records\n", records);
+    return rc;
+}
@@ -0,0 +1,156 @@
+#ifndef WMLOG_FORMAT_H
+#define WMLOG_FORMAT_H
+
+/*
+ * On-disk format shared by wifi_metrics_sender (-W) and wmlog_decode.
+ *
+ * File:   "WMLOG01\n" followed by a little-endian u32 column count.
+ * Block:  u32 magic, u16 record count, u16 reserved, u32 payload length,
+ *         u32 CRC-32 of the payload, then the payload.
+ * Payload is columnar: for each column, the first value as a zigzag varint
+ * followed by (count - 1) zigzag varint deltas. A block whose header or CRC
+ * does not check out marks the end of valid data (torn write after a crash).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WMLOG_FILE_MAGIC      "WMLOG01\n"
+#define WMLOG_FILE_MAGIC_LEN  8
+#define WMLOG_BLOCK_MAGIC     0x424c4d57u /* "WMLB" */
+#define WMLOG_BLOCK_HEADER    16
+#define WMLOG_BLOCK_RECORDS   64
+#define WMLOG_MISSING         INT64_MIN
+
+enum wmlog_column {
+    WMLOG_COL_TIME_MS,
+    WMLOG_COL_SIGNAL_DBM,
+    WMLOG_COL_RSSI_X100,
+    WMLOG_COL_LINK_TX_X100,
+    WMLOG_COL_LINK_RX_X100,
+    WMLOG_COL_LINK_ALL_X100,
+    WMLOG_COL_TX_PACKETS,
+    WMLOG_COL_TX_RETRIES,
+    WMLOG_COL_TX_FAILED,
+    WMLOG_COL_BEACON_LOSS,
+    WMLOG_COL_RX_PACKETS,
+    WMLOG_COL_RX_DUPLICATES,
+    WMLOG_COL_RX_DROP_MISC,
+    WMLOG_COLUMNS
+};
+
+static const char *const wmlog_column_names[WMLOG_COLUMNS] = {
+    "time_ms", "signal_dbm", "rssi", "link_tx", "link_rx", "link_all",
+    "tx_packets", "tx_retries", "tx_failed", "beacon_loss",
+    "rx_packets", "rx_duplicates", "rx_drop_misc",
+};
+
+/* Columns stored as value * 100. */
+static inline int wmlog_column_scaled(int col) {
+    return col >= WMLOG_COL_RSSI_X100 && col <= WMLOG_COL_LINK_ALL_X100;
+}
+
+/* Worst case: every value needs a 10-byte varint. */
+#define WMLOG_BLOCK_PAYLOAD_MAX (WMLOG_COLUMNS * WMLOG_BLOCK_RECORDS * 10)
+
+struct wmlog_record {
+    int64_t v[WMLOG_COLUMNS];
+};
+
+static inline uint64_t wmlog_zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t wmlog_unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline size_t wmlog_put_varint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Returns bytes consumed, or 0 on truncated/overlong input. */
+static inline size_t wmlog_get_varint(const uint8_t *in, size_t len, uint64_t *v) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < len && i < 10; i++) {
+        result |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *v = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static inline void wmlog_put_u16(uint8_t *out, uint16_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wmlog_put_u32(uint8_t *out, uint32_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t wmlog_get_u16(const uint8_t *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t wmlog_get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) |
+           ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint32_t wmlog_crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1u));
+        }
+    }
+    return ~crc;
+}
+
+/* Encodes count records column by column; returns the payload length. */
+static inline size_t wmlog_encode_block(const struct wmlog_record *recs, size_t count,
+                                        uint8_t *payload) {
+    size_t off = 0;
+    for (int col = 0; col < WMLOG_COLUMNS; col++) {
+        int64_t prev = 0;
+        for (size_t i = 0; i < count; i++) {
+            int64_t v = recs[i].v[col];
+            off += wmlog_put_varint(payload + off, wmlog_zigzag((int64_t)((uint64_t)v - (uint64_t)prev)));
+            prev = v;
+        }
+    }
+    return off;
+}
+
+/* Returns 0 on success, -1 if the payload is malformed. */
+static inline int wmlog_decode_block(const uint8_t *payload, size_t len, size_t count,
+                                     struct wmlog_record *recs) {
+    size_t off = 0;
+    for (int col = 0; col < WMLOG_COLUMNS; col++) {
+        int64_t prev = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t raw;
+            size_t used = wmlog_get_varint(payload + off, len - off, &raw);
+            if (!used) return -1;
+            off += used;
+            prev = (int64_t)((uint64_t)prev + (uint64_t)wmlog_unzigzag(raw));
+            recs[i].v[col] = prev;
+        }
+    }
+    return off == len ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * fake_wpas: a stand-in for wpa_supplicant's control socket in tests.
+ * Binds PATH, answers the commands sta_connect -w sends and appends each one
+ * to LOG. SELECT_NETWORK is followed by the scan/auth/assoc/4-way event
+ * sequence of a successful connect to the attached monitor, unless -d is
+ * given and the network has a bssid set (a directed attempt that never finds
+ * its AP). Runs until SIGTERM.
+ */
+
+static volatile sig_atomic_t g_stop;
+static void on_term(int sig) { (void)sig; g_stop = 1; }
+
+static void reply(int fd, const struct sockaddr_un *to, socklen_t to_len, const char *msg) {
+    if (sendto(fd, msg, strlen(msg), 0, (const struct sockaddr *)to, to_len) < 0) {
+        fprintf(stderr, "fake_wpas: sendto failed: %s\n", strerror(errno));
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL, *log_path = "/dev/null", *bssid = "02:00:00:00:01:00";
+    int freq = 5180, opt;
+    bool fail_directed = false;
+    while ((opt = getopt(argc, argv, "s:l:b:f:d")) != -1) {
+        switch (opt) {
+            case 's': path = optarg; break;
+            case 'l': log_path = optarg; break;
+            case 'b': bssid = optarg; break;
+            case 'f': freq = atoi(optarg); break;
+            case 'd': fail_directed = true; break;
+            default: path = NULL; optind = argc; break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s -s PATH [-l LOG] [-b BSSID] [-f MHZ] [-d]\n", argv[0]);
+        return 2;
+    }
+    struct sigaction act = { .sa_handler = on_term };   /* no SA_RESTART: recvfrom must return */
+    sigaction(SIGTERM, &act, NULL);
+    sigaction(SIGINT, &act, NULL);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        fprintf(stderr, "fake_wpas: bind(%s) failed: %s\n", path, strerror(errno));
+        return 1;
+    }
+    FILE *log = fopen(log_path, "a");
+    if (!log) return 1;
+    setvbuf(log, NULL, _IOLBF, 0);
+
+    struct sockaddr_un mon = {0};
+    socklen_t mon_len = 0;
+    bool have_bssid = false;
+    char buf[512];
+    while (!g_stop) {
+        struct sockaddr_un from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        buf[n] = '\0';
+        fprintf(log, "%s\n", buf);
+
+        if (strcmp(buf, "ATTACH") == 0) {
+            mon = from;
+            mon_len = from_len;
+            reply(fd, &from, from_len, "OK\n");
+        } else if (strcmp(buf, "ADD_NETWORK") == 0) {
+            reply(fd, &from, from_len, "0\n");
+        } else if (strncmp(buf, "REMOVE_NETWORK", 14) == 0) {
+            have_bssid = false;
+            reply(fd, &from, from_len, "OK\n");
+        } else if (strncmp(buf, "SET_NETWORK", 11) == 0) {
+            if (strstr(buf, " bssid ")) have_bssid = true;
+            reply(fd, &from, from_len, "OK\n");
+        } else if (strncmp(buf, "SELECT_NETWORK", 14) == 0) {
+            reply(fd, &from, from_len, "OK\n");
+            if (!mon_len || (fail_directed && have_bssid)) continue;
+            char connected[128];
+            snprintf(connected, sizeof(connected),
+                     "<3>CTRL-EVENT-CONNECTED - Connection to %s completed [id=0 id_str=]", bssid);
+            const char *events[] = {
+                "<3>CTRL-EVENT-SCAN-STARTED ",
+                "<3>CTRL-EVENT-SCAN-RESULTS ",
+                "<3>SME: Trying to authenticate with the AP",
+                "<3>Trying to associate with the AP",
+                "<3>Associated with the AP",
+                "<3>WPA: Key negotiation completed with the AP",
+                connected,
+            };
+            for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+                nanosleep(&(struct timespec){ .tv_nsec = 5000000 }, NULL);
+                reply(fd, &mon, mon_len, events[i]);
+            }
+        } else if (strcmp(buf, "STATUS") == 0) {
+            char status[256];
+            snprintf(status, sizeof(status), "bssid=%s\nfreq=%d\nssid=test\nwpa_state=COMPLETED\n", bssid, freq);
+            reply(fd, &from, from_len, status);
+        } else if (strcmp(buf, "DETACH") == 0) {
+            mon_len = 0;
+            reply(fd, &from, from_len, "OK\n");
+        } else {
+            reply(fd, &from, from_len, "UNKNOWN COMMAND\n");
+        }
+    }
+    fclose(log);
+    close(fd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+
+#include "mtk_rate.h"
+
+/* FixedRate tuple encoding/validation and Last TX Rate parsing (mtk_rate.c). */
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void check_tuple(const struct mtk_fixed_rate *r, const char *want) {
+    char buf[64];
+    CHECK(mtk_fixed_rate_validate(r) == NULL);
+    CHECK(mtk_fixed_rate_format(r, buf, sizeof(buf)) == (int)strlen(want));
+    if (strcmp(buf, want) != 0) {
+        fprintf(stderr, "tuple %s, want %s\n", buf, want);
+        failures++;
+    }
+}
+
+static void test_encoding(void) {
+    struct mtk_fixed_rate r;
+
+    /* set_rate.sh defaults: WCID 1, HT, 20 MHz, LGI, preamble 1 */
+    mtk_fixed_rate_init_ht(&r, 5);
+    check_tuple(&r, "1-2-0-5-0-0-1-0-0-0");
+
+    mtk_fixed_rate_init_ht(&r, 7);
+    r.wcid = 3;
+    r.bw = 1;
+    r.sgi = 1;
+    r.stbc = 1;
+    r.ldpc = 1;
+    check_tuple(&r, "3-2-1-7-0-1-1-1-1-0");
+
+    mtk_fixed_rate_init_ht(&r, 9);
+    r.mode = MTK_MODE_VHT;
+    r.vht_nss = 2;
+    r.bw = 2;
+    check_tuple(&r, "1-4-2-9-2-0-1-0-0-0");
+
+    char small[8];
+    mtk_fixed_rate_init_ht(&r, 0);
+    CHECK(mtk_fixed_rate_format(&r, small, sizeof(small)) == -1);
+}
+
+static void test_validation(void) {
+    struct mtk_fixed_rate r;
+
+    mtk_fixed_rate_init_ht(&r, 33);
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+    mtk_fixed_rate_init_ht(&r, 32);
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);       /* MCS 32 needs 40 MHz */
+    r.bw = 1;
+    CHECK(mtk_fixed_rate_validate(&r) == NULL);
+    mtk_fixed_rate_init_ht(&r, 7);
+    r.bw = 2;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);       /* HT has no 80 MHz */
+    mtk_fixed_rate_init_ht(&r, 7);
+    r.sgi = 2;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+    mtk_fixed_rate_init_ht(&r, 7);
+    r.wcid = 256;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+
+    mtk_fixed_rate_init_ht(&r, 9);
+    r.mode = MTK_MODE_VHT;
+    r.vht_nss = 1;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);       /* VHT MCS 9 at 20 MHz */
+    r.vht_nss = 3;
+    CHECK(mtk_fixed_rate_validate(&r) == NULL);
+    r.vht_nss = 0;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+
+    mtk_fixed_rate_init_ht(&r, 3);
+    r.mode = MTK_MODE_CCK;
+    CHECK(mtk_fixed_rate_validate(&r) == NULL);
+    r.bw = 1;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+    mtk_fixed_rate_init_ht(&r, 8);
+    r.mode = MTK_MODE_OFDM;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+    r.mode = 3;
+    CHECK(mtk_fixed_rate_validate(&r) != NULL);
+}
+
+static void expect_rate(const char *stat, int mode, int mcs, int bw_mhz, int sgi) {
+    struct mtk_tx_rate t;
+    CHECK(mtk_parse_last_tx_rate(stat, &t) == 0);
+    if (t.mode != mode || t.mcs != mcs || t.bw_mhz != bw_mhz || t.sgi != sgi) {
+        fprintf(stderr, "parsed mode=%d mcs=%d bw=%d sgi=%d, want %d/%d/%d/%d from:\n%s\n",
+                t.mode, t.mcs, t.bw_mhz, t.sgi, mode, mcs, bw_mhz, sgi, stat);
+        failures++;
+    }
+}
+
+static void test_stat_parsing(void) {
+    /* The three driver formats from mtk_rate.h, inside a full stat dump. */
+    expect_rate("Tx success                      = 1205\n"
+                "Tx retry count                  = 87\n"
+                "Last TX Rate                    = MCS7, BW20, SGI\n"
+                "Last RX Rate                    = MCS5, BW20, LGI\n"
+                "RSSI                            = -41 -43 -127\n",
+                -1, 7, 20, 1);
+    expect_rate("Last TX Rate = HT MCS 7 40M LGI\n", MTK_MODE_HT, 7, 40, 0);
+    expect_rate("Last TX Rate = VHT 1SS MCS9, 80MHz, 400ns GI\n", MTK_MODE_VHT, 9, 80, 1);
+    expect_rate("Last TX Rate = OFDM 54M\n", MTK_MODE_OFDM, -1, -1, -1);
+
+    /* Only the TX line counts, even when RX comes first. */
+    expect_rate("Last RX Rate = MCS2, BW40, LGI\nLast TX Rate = MCS4, BW20, SGI\n", -1, 4, 20, 1);
+
+    struct mtk_tx_rate t;
+    CHECK(mtk_parse_last_tx_rate("Tx success = 10\nRSSI = -50\n", &t) == -1);
+    CHECK(t.mcs == -1);
+    CHECK(mtk_parse_last_tx_rate("Last TX Rate\n", &t) == -1);
+}
+
+static void test_matching(void) {
+    struct mtk_fixed_rate want;
+    struct mtk_tx_rate seen;
+
+    mtk_fixed_rate_init_ht(&want, 7);
+    want.sgi = 1;
+    mtk_parse_last_tx_rate("Last TX Rate = MCS7, BW20, SGI\n", &seen);
+    CHECK(mtk_tx_rate_matches(&want, &seen));
+    mtk_parse_last_tx_rate("Last TX Rate = MCS7\n", &seen);
+    CHECK(mtk_tx_rate_matches(&want, &seen));         /* unreported fields pass */
+    mtk_parse_last_tx_rate("Last TX Rate = MCS7, BW40, SGI\n", &seen);
+    CHECK(!mtk_tx_rate_matches(&want, &seen));
+    mtk_parse_last_tx_rate("Last TX Rate = MCS7, BW20, LGI\n", &seen);
+    CHECK(!mtk_tx_rate_matches(&want, &seen));
+    mtk_parse_last_tx_rate("Last TX Rate = VHT 1SS MCS7, 20MHz, 400ns GI\n", &seen);
+    CHECK(!mtk_tx_rate_matches(&want, &seen));
+    mtk_parse_last_tx_rate("Last TX Rate = MCS6, BW20, SGI\n", &seen);
+    CHECK(!mtk_tx_rate_matches(&want, &seen));
+}
+
+int main(void) {
+    test_encoding();
+    test_validation();
+    test_stat_parsing();
+    test_matching();
+    if (failures) {
+        fprintf(stderr, "mtk_rate_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("mtk_rate_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# set_rate_sh.sh -- Exit codes of set_rate.sh on top of the native set_rate
+# Usage:
+#   tests/set_rate_sh.sh [SET_RATE]     # default: ./set_rate (make)
+#
+# Runs set_rate.sh under `set -e` with SET_RATE_BIN pointing at the binary and
+# set_rate's mock ioctl layer (-M). The old script exited 0 whenever the driver
+# took the tuple, verified or not, and 1 on bad arguments or a rejected set:
+#   rate shows up in Last TX Rate     -> 0
+#   idle link (native exit 2)         -> 0
+#   invalid MCS                       -> 1
+
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+BIN=${1:-$DIR/set_rate}
+[ -x "$BIN" ] || { echo "set_rate_sh: no $BIN (make)" >&2; exit 1; }
+
+TMP=$(mktemp -d /tmp/set-rate-sh.XXXXXX)
+trap 'rm -rf "$TMP"' EXIT INT TERM
+fail() { echo "set_rate_sh: FAIL, $1" >&2; exit 1; }
+
+# run EXPECTED_RC ARGS...: calls set_rate.sh the way a set -e caller would.
+run() {
+  want=$1; shift
+  SET_RATE_BIN="$BIN" sh -ec '"$@"; echo reached' sh sh "$DIR/set_rate.sh" "$@" \
+    >"$TMP/out" 2>&1
+  rc=$?
+  [ "$rc" -eq "$want" ] || { cat "$TMP/out" >&2; fail "set_rate.sh $* exited $rc, want $want"; }
+  if [ "$want" -eq 0 ]; then
+    grep -q reached "$TMP/out" || fail "set -e caller stopped after set_rate.sh $*"
+  fi
+}
+
+printf 'Last TX Rate = MCS5, BW20, LGI\n' >"$TMP/mock.stat"
+run 0 -M "$TMP/mock" -t 50 apcli0 5 20 0
+grep -q "apcli0 set FixedRate=1-2-0-5-0-0-1-0-0-0" "$TMP/mock" || fail "tuple not applied"
+
+printf 'Last TX Rate = MCS0, BW20, LGI\n' >"$TMP/mock.stat"
+run 0 -M "$TMP/mock" -t 20 apcli0 7 40 1
+"$BIN" -M "$TMP/mock" -t 20 apcli0 7 40 1 >/dev/null 2>&1
+[ $? -eq 2 ] || fail "native set_rate no longer exits 2 on an idle link"
+
+run 1 -M "$TMP/mock" apcli0 33
+run 1 -M "$TMP/mock" apcli0 5 20 2
+
+echo "set_rate_sh: ok"
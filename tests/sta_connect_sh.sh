@@ -0,0 +1,80 @@
+#!/bin/sh
+# sta_connect_sh.sh -- sta_connect against the ApCli mock and a fake wpa_supplicant
+# Usage:
+#   tests/sta_connect_sh.sh [STA_CONNECT]   # default: ./sta_connect (make)
+#
+# ApCli: runs with -M, so the iwpriv sets land in a log and the AP comes from
+# MOCK.ap; checks the sets, the cache entry and the directed retry from it.
+# wpa_supplicant: runs with -w -C against tests/fake_wpas; checks the commands,
+# the phase split and the fallback scan when the cached AP does not answer.
+# The BSSID cache goes to a temporary file (STA_CONNECT_CACHE). Exits 77 (skip)
+# when tests/fake_wpas is not built.
+
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+BIN=${1:-$DIR/sta_connect}
+FAKE=$DIR/tests/fake_wpas
+[ -x "$BIN" ] || { echo "sta_connect_sh: no $BIN (make)" >&2; exit 1; }
+[ -x "$FAKE" ] || { echo "sta_connect_sh: skipped, no $FAKE (make tests/fake_wpas)"; exit 77; }
+
+TMP=$(mktemp -d /tmp/sta-connect-sh.XXXXXX)
+FAKE_PID=
+trap '[ -n "$FAKE_PID" ] && kill $FAKE_PID 2>/dev/null; rm -rf "$TMP"' EXIT INT TERM
+fail() { echo "sta_connect_sh: FAIL, $1" >&2; [ -f "$TMP/out" ] && cat "$TMP/out" >&2; exit 1; }
+export STA_CONNECT_CACHE="$TMP/cache"
+
+# sta ARGS...: runs sta_connect without DHCP, output in $TMP/out, returns its exit code.
+sta() { "$BIN" -N "$@" >"$TMP/out" 2>&1; }
+
+# --- ApCli backend ---
+printf '02:00:00:00:00:01 36\n' >"$TMP/mock.ap"
+sta -M "$TMP/mock" -i apclii0 -t 2000 "Drone Net" secret123 || fail "ApCli connect exited $?"
+for set in ApCliEnable=0 ApCliAuthMode=WPA2PSK ApCliEncrypType=AES "ApCliSsid=Drone Net" \
+           ApCliWPAPSK=secret123 ApCliBssid=00:00:00:00:00:00 ApCliEnable=1; do
+  grep -qx "apclii0 set $set" "$TMP/mock" || fail "missing iwpriv set $set"
+done
+grep -q "associated to 02:00:00:00:00:01 on channel 36" "$TMP/out" || fail "association not reported"
+grep -qx "apclii0 02:00:00:00:00:01 36 Drone Net" "$TMP/cache" || fail "cache entry not written"
+
+: >"$TMP/mock"
+sta -M "$TMP/mock" -i apclii0 -t 2000 -m "Drone Net" secret123 || fail "directed ApCli connect exited $?"
+grep -qx "apclii0 set ApCliBssid=02:00:00:00:00:01" "$TMP/mock" || fail "cached BSSID not used"
+grep -qx "apclii0 set Channel=36" "$TMP/mock" || fail "cached channel not used"
+grep -qx "apclii0 set ApCliAuthMode=WPA1WPA2" "$TMP/mock" || fail "-m did not select WPA1WPA2"
+grep -q "total=[0-9]* directed" "$TMP/out" || fail "timing line does not say directed"
+
+rm -f "$TMP/mock.ap"
+sta -M "$TMP/mock" -i apclii0 -t 300 -n "Drone Net" secret123 && fail "ApCli without an AP exited 0"
+grep -q "no association on apclii0 within 300 ms" "$TMP/out" || fail "timeout not reported"
+
+# --- wpa_supplicant backend ---
+mkdir "$TMP/ctrl"
+start_fake() {
+  "$FAKE" -s "$TMP/ctrl/wlan0" -l "$TMP/wpas.log" -b 02:00:00:00:00:02 -f 5180 "$@" &
+  FAKE_PID=$!
+  i=0
+  until [ -S "$TMP/ctrl/wlan0" ]; do
+    i=$((i + 1)); [ $i -lt 50 ] || fail "fake_wpas did not start"; sleep 0.1
+  done
+}
+stop_fake() { kill $FAKE_PID; wait $FAKE_PID 2>/dev/null; FAKE_PID=; }
+
+start_fake
+sta -w -C "$TMP/ctrl" -i wlan0 -t 2000 -n Wpas pass4567 || fail "wpa_supplicant connect exited $?"
+for cmd in ATTACH "REMOVE_NETWORK all" ADD_NETWORK 'SET_NETWORK 0 ssid "Wpas"' \
+           'SET_NETWORK 0 psk "pass4567"' "SET_NETWORK 0 key_mgmt WPA-PSK" "SELECT_NETWORK 0" STATUS DETACH; do
+  grep -qxF "$cmd" "$TMP/wpas.log" || fail "wpa_supplicant never got '$cmd'"
+done
+grep -q "scan=[0-9]* auth=[0-9]* assoc=[0-9]* 4way=[0-9]*" "$TMP/out" || fail "no phase split"
+grep -qx "wlan0 02:00:00:00:00:02 5180 Wpas" "$TMP/cache" || fail "wpa_supplicant cache entry not written"
+stop_fake
+
+# The cached AP is gone: the directed attempt times out, a full scan connects.
+: >"$TMP/wpas.log"
+start_fake -d
+sta -w -C "$TMP/ctrl" -i wlan0 -t 2000 Wpas pass4567 || fail "fallback connect exited $?"
+grep -qxF "SET_NETWORK 0 bssid 02:00:00:00:00:02" "$TMP/wpas.log" || fail "cached BSSID not tried"
+grep -qxF "SET_NETWORK 0 scan_freq 5180" "$TMP/wpas.log" || fail "cached frequency not tried"
+grep -q "directed fallback-scan" "$TMP/out" || fail "fallback not reported"
+stop_fake
+
+echo "sta_connect_sh: ok"